@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "lib_6par_batch.h"
+
+const double module6par_batch::similar_tol = 0.1;
+
+namespace {
+	/// Counts Newton iterations reported through the solver callback
+	class iteration_counter : public notification_interface
+	{
+	public:
+		int iterations;
+		iteration_counter() : iterations(0) { }
+		virtual bool notify(int, double[], double[], const int) {
+			iterations++;
+			return true;
+		}
+	};
+
+	double reldiff(double x, double ref) {
+		return std::fabs(x - ref) / std::fabs(ref);
+	}
+}
+
+module6par_batch::module6par_batch(int max_iter, double tol)
+	: m_maxIter(max_iter), m_maxIterWarm(std::min(max_iter, 50)), m_tol(tol)
+{
+}
+
+double module6par_batch::distance(const module6par &a, const module6par &b) const
+{
+	if (a.Type != b.Type || a.Nser != b.Nser)
+		return std::numeric_limits<double>::infinity();
+	return std::max(std::max(reldiff(a.Vmp, b.Vmp), reldiff(a.Imp, b.Imp)),
+		std::max(reldiff(a.Voc, b.Voc), reldiff(a.Isc, b.Isc)));
+}
+
+void module6par_batch::solveChunk(std::vector<module6par> &modules, const std::vector<size_t> &order, size_t begin, size_t end, bool warm_start, std::vector<status> &result) const
+{
+	for (size_t k = begin; k < end; k++)
+	{
+		size_t i = order[k];
+		module6par &mod = modules[i];
+		status &st = result[i];
+		iteration_counter counter;
+		st.err = -99;
+		st.warm_source = -1;
+
+		// closest module already solved in this chunk
+		int prev = -1;
+		double dmin = similar_tol;
+		for (size_t kk = begin; warm_start && kk < k; kk++)
+		{
+			size_t j = order[kk];
+			double d = distance(mod, modules[j]);
+			if (result[j].err == 0 && d <= dmin)
+			{
+				prev = (int)j;
+				dmin = d;
+			}
+		}
+
+		if (prev >= 0)
+		{
+			// scale the neighbor's solution: the modified ideality factor follows the open circuit
+			// voltage, the light current the short circuit current, and the resistances the ratio of
+			// the two.  the saturation current is then set so that the current at open circuit is zero.
+			const module6par &ref = modules[prev];
+			double rscale = (mod.Voc / mod.Isc) / (ref.Voc / ref.Isc);
+			mod.a = ref.a * mod.Voc / ref.Voc;
+			mod.Il = ref.Il * mod.Isc / ref.Isc;
+			mod.Rs = ref.Rs * rscale;
+			mod.Rsh = ref.Rsh * rscale;
+			mod.Io = (mod.Il - mod.Voc / mod.Rsh) / (exp(mod.Voc / mod.a) - 1);
+			mod.Adj = ref.Adj;
+			st.err = mod.solve<double>(m_maxIterWarm, m_tol, &counter);
+			if (st.err == 0)
+				st.warm_source = prev;
+		}
+
+		if (st.err < 0)
+			st.err = mod.solve_with_sanity_and_heuristics<double>(m_maxIter, m_tol, &counter);
+
+		st.iterations = counter.iterations;
+	}
+}
+
+void module6par_batch::solve(std::vector<module6par> &modules, std::vector<status> &result, size_t nthreads, bool warm_start)
+{
+	result.resize(modules.size());
+
+	// sort so that similar datasheets are neighbors
+	std::vector<size_t> order(modules.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&modules](size_t i, size_t j) {
+		const module6par &a = modules[i], &b = modules[j];
+		if (a.Type != b.Type) return a.Type < b.Type;
+		if (a.Nser != b.Nser) return a.Nser < b.Nser;
+		if (a.Voc != b.Voc) return a.Voc < b.Voc;
+		return a.Isc < b.Isc;
+	});
+
+	size_t nchunks = (order.size() + chunk_size - 1) / chunk_size;
+	if (nthreads == 0)
+		nthreads = std::max(1u, std::thread::hardware_concurrency());
+	nthreads = std::min(nthreads, nchunks);
+
+	// chunks are handed out in order to whichever thread is free
+	std::atomic<size_t> next(0);
+	auto run = [&]()
+	{
+		size_t c;
+		while ((c = next++) < nchunks)
+			solveChunk(modules, order, c * chunk_size, std::min(order.size(), (c + 1) * chunk_size), warm_start, result);
+	};
+
+	if (nthreads > 1)
+	{
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < nthreads; i++)
+			threads.push_back(std::thread(run));
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+	}
+	else
+		run();
+}
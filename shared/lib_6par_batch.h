@@ -0,0 +1,56 @@
+#ifndef __LIB_6PAR_BATCH_H__
+#define __LIB_6PAR_BATCH_H__
+
+#include <vector>
+
+#include "6par_jacobian.h"
+#include "6par_lu.h"
+#include "6par_search.h"
+#include "6par_newton.h"
+#include "6par_gamma.h"
+#include "6par_solve.h"
+
+/**
+*  Fits the CEC 6 parameter model to a table of module datasheets.
+*
+*  Modules are ordered by technology, cells in series, and module Voc and Isc so that
+*  similar datasheets are adjacent, then split into fixed-size chunks that are solved in parallel.
+*  Within a chunk each module starts Newton's method from the scaled solution of the most similar
+*  module already solved, and falls back to module6par::solve_with_sanity_and_heuristics when the warm
+*  start fails.  The chunking does not depend on the number of threads, so results are the same
+*  for any thread count.
+*/
+class module6par_batch
+{
+public:
+	/// Per-module convergence diagnostics
+	struct status
+	{
+		int err;          ///< 0 on success, otherwise the negative code from module6par::solve
+		int iterations;   ///< Newton iterations summed over all attempts
+		int warm_source;  ///< index of the module whose solution was the accepted starting point, -1 for the heuristic guess
+	};
+
+	/// Modules adjacent in the sorted order are solved sequentially within a chunk of this size
+	static const size_t chunk_size = 32;
+
+	/// Relative difference in Vmp, Imp, Voc and Isc below which a solved module is used as a warm start
+	static const double similar_tol;
+
+	/// A warm start that has not converged within 50 iterations is abandoned for the heuristic guess
+	module6par_batch(int max_iter = 300, double tol = 1e-7);
+
+	/// Solve all modules in place using nthreads (0 uses the hardware concurrency)
+	void solve(std::vector<module6par> &modules, std::vector<status> &result, size_t nthreads = 0, bool warm_start = true);
+
+private:
+	int m_maxIter;
+	int m_maxIterWarm;
+	double m_tol;
+
+	/// Largest relative difference in the datasheet values, infinite for a different technology or cell count
+	double distance(const module6par &a, const module6par &b) const;
+	void solveChunk(std::vector<module6par> &modules, const std::vector<size_t> &order, size_t begin, size_t end, bool warm_start, std::vector<status> &result) const;
+};
+
+#endif
@@ -52,6 +52,7 @@
 #include <cfloat>
 #include <sstream>
 #include <algorithm>
+#include <limits>
 
 #include "lib_battery.h"
 
@@ -144,6 +145,36 @@ void capacity_t::copy(capacity_t * capacity)
 	_prev_charge = capacity->_prev_charge;
 	_charge = capacity->_charge;
 }
+void capacity_t::save_state(capacity_state & state) const
+{
+	state.q0 = _q0;
+	state.qmax = _qmax;
+	state.qmax_thermal = _qmax_thermal;
+	state.I = _I;
+	state.I_loss = _I_loss;
+	state.SOC = _SOC;
+	state.DOD = _DOD;
+	state.DOD_prev = _DOD_prev;
+	state.dt_hour = _dt_hour;
+	state.chargeChange = _chargeChange;
+	state.prev_charge = _prev_charge;
+	state.charge = _charge;
+}
+void capacity_t::restore_state(const capacity_state & state)
+{
+	_q0 = state.q0;
+	_qmax = state.qmax;
+	_qmax_thermal = state.qmax_thermal;
+	_I = state.I;
+	_I_loss = state.I_loss;
+	_SOC = state.SOC;
+	_DOD = state.DOD;
+	_DOD_prev = state.DOD_prev;
+	_dt_hour = state.dt_hour;
+	_chargeChange = state.chargeChange;
+	_prev_charge = state.prev_charge;
+	_charge = state.charge;
+}
 void capacity_t::check_charge_change()
 {
 	_charge = NO_CHARGE;
@@ -269,6 +300,22 @@ void capacity_kibam_t::copy(capacity_t * capacity)
 	_q20 = tmp->_q20;
 	_I20 = tmp->_I20;
 }
+void capacity_kibam_t::save_state(capacity_state & state) const
+{
+	capacity_t::save_state(state);
+	state.q1_0 = _q1_0;
+	state.q2_0 = _q2_0;
+	state.q1 = _q1;
+	state.q2 = _q2;
+}
+void capacity_kibam_t::restore_state(const capacity_state & state)
+{
+	capacity_t::restore_state(state);
+	_q1_0 = state.q1_0;
+	_q2_0 = state.q2_0;
+	_q1 = state.q1;
+	_q2 = state.q2;
+}
 
 void capacity_kibam_t::replace_battery()
 {
@@ -522,10 +569,16 @@ void voltage_t::copy(voltage_t * voltage)
 	// doesn't change;
 	//_batt_voltage_matrix = voltage->_batt_voltage_matrix;
 }
+void voltage_t::save_state(voltage_state & state) const { state.cell_voltage = _cell_voltage; }
+void voltage_t::restore_state(const voltage_state & state) { _cell_voltage = state.cell_voltage; }
 double voltage_t::battery_voltage(){ return _num_cells_series*_cell_voltage; }
 double voltage_t::battery_voltage_nominal(){ return _num_cells_series * _cell_voltage_nominal; }
 double voltage_t::cell_voltage(){ return _cell_voltage; }
 double voltage_t::R_battery(){ return _R_battery; }
+double voltage_t::calculate_current_for_target_power(double P, capacity_t * , double )
+{
+	return P / battery_voltage_nominal();
+}
 
 // Voltage Table 
 voltage_table_t::voltage_table_t(int num_cells_series, int num_strings, double voltage, util::matrix_t<double> &voltage_table, double R) :
@@ -535,10 +588,70 @@ voltage_t(voltage_t::VOLTAGE_TABLE, num_cells_series, num_strings, voltage, volt
 		_voltage_table.push_back(table_point(_batt_voltage_matrix.at(r, 0), _batt_voltage_matrix.at(r, 1)));
 	
 	std::sort(_voltage_table.begin(), _voltage_table.end(), byDOD());
+	initialize_grid();
 
 	_R = R;
 }
 
+void voltage_table_t::initialize_grid()
+{
+	// a cell no wider than the closest pair of rows holds at most one row, capped for very fine tables
+	const size_t max_cells = 10000;
+	size_t nrows = _voltage_table.size();
+	_grid_rows_below.clear();
+	_DOD_grid_min = 0.;
+	_DOD_grid_step = 1.;
+	if (nrows == 0)
+		return;
+
+	_DOD_grid_min = _voltage_table[0].DOD();
+	double DOD_range = _voltage_table[nrows - 1].DOD() - _DOD_grid_min;
+	double DOD_gap = DOD_range;
+	for (size_t r = 1; r != nrows; r++)
+	{
+		double gap = _voltage_table[r].DOD() - _voltage_table[r - 1].DOD();
+		if (gap > 0 && gap < DOD_gap)
+			DOD_gap = gap;
+	}
+	size_t ncells = 1;
+	if (DOD_range > 0)
+	{
+		ncells = (size_t)std::min(std::ceil(DOD_range / DOD_gap), (double)max_cells);
+		_DOD_grid_step = DOD_range / ncells;
+	}
+
+	size_t r = 0;
+	for (size_t c = 0; c != ncells; c++)
+	{
+		double DOD_cell = _DOD_grid_min + c * _DOD_grid_step;
+		while (r < nrows && _voltage_table[r].DOD() < DOD_cell)
+			r++;
+		_grid_rows_below.push_back(r);
+	}
+}
+
+size_t voltage_table_t::rows_below(double DOD)
+{
+	// start from the grid cell, then step over the row or two between the cell edge and DOD
+	size_t nrows = _voltage_table.size();
+	if (_grid_rows_below.empty())
+		return 0;
+
+	double cell = (DOD - _DOD_grid_min) / _DOD_grid_step;
+	size_t c = 0;
+	if (cell >= (double)_grid_rows_below.size())
+		c = _grid_rows_below.size() - 1;
+	else if (cell > 0)
+		c = (size_t)cell;
+
+	size_t r = _grid_rows_below[c];
+	while (r < nrows && _voltage_table[r].DOD() < DOD)
+		r++;
+	while (r > 0 && _voltage_table[r - 1].DOD() >= DOD)
+		r--;
+	return r;
+}
+
 voltage_table_t * voltage_table_t::clone(){ return new voltage_table_t(*this); }
 void voltage_table_t::copy(voltage_t * voltage)
 {
@@ -573,45 +686,82 @@ void voltage_table_t::updateVoltage(capacity_t * capacity, thermal_t * , double
 
 bool voltage_table_t::exactVoltageFound(double DOD, double & V)
 {
-	bool contained = false;
-	for (size_t r = 0; r != _voltage_table.size(); r++)
+	// the first row at or above DOD is the only one which can match
+	size_t r = rows_below(DOD);
+	if (r < _voltage_table.size() && _voltage_table[r].DOD() == DOD)
 	{
-		if (_voltage_table[r].DOD() == DOD)
-		{
-			V = _voltage_table[r].V();
-			contained = true;
-			break;
-		}
+		V = _voltage_table[r].V();
+		return true;
 	}
-	return contained;
+	return false;
 }
 
 void voltage_table_t::prepareInterpolation(double & DOD_lo, double & V_lo, double & DOD_hi, double & V_hi, double DOD)
 {
+	// the last row below DOD and the first row above it, or the end row off either end of the table
 	size_t nrows = _voltage_table.size();
-	DOD_lo = _voltage_table[0].DOD();
-	DOD_hi = _voltage_table[nrows - 1].DOD();
-	V_lo = _voltage_table[0].V();
-	V_hi = _voltage_table[nrows - 1].V();
+	size_t r = rows_below(DOD);
+	size_t r_lo = (r > 0 ? r - 1 : 0);
+	size_t r_hi = (r < nrows ? r : nrows - 1);
 
-	for (size_t r = 0; r != nrows; r++)
-	{
-		double DOD_r = _voltage_table[r].DOD();
-		double V_r = _voltage_table[r].V();
+	DOD_lo = _voltage_table[r_lo].DOD();
+	V_lo = _voltage_table[r_lo].V();
+	DOD_hi = _voltage_table[r_hi].DOD();
+	V_hi = _voltage_table[r_hi].V();
+}
 
-		if (DOD_r <= DOD)
+double voltage_table_t::calculate_current_for_target_power(double P, capacity_t * capacity, double dt)
+{
+	size_t nrows = _voltage_table.size();
+	double qmax = capacity->qmax_thermal();
+	if (P == 0 || nrows == 0 || qmax <= 0)
+		return voltage_t::calculate_current_for_target_power(P, capacity, dt);
+
+	// over a segment the cell voltage at the end of the step is linear in current, c0 + c1*I,
+	// since DOD moves by 100*I*dt/qmax and the resistive drop is R*I per string
+	double DOD = 100. * (1. - capacity->q0() / qmax);
+	double dDOD_dI = 100. * dt / qmax;
+	double I = P / battery_voltage_nominal();
+
+	// walk segments in the direction DOD moves until the solution lands on the segment it was solved on,
+	// segment r lies between rows r-1 and r, segments 0 and nrows are the flat ends of the table
+	size_t r = rows_below(DOD);
+	for (size_t n = 0; n <= nrows + 1; n++)
+	{
+		double slope = 0., V_r = _voltage_table[std::min(r, nrows - 1)].V(), DOD_r = DOD;
+		if (r > 0 && r < nrows)
 		{
-			DOD_lo = DOD_r;
-			V_lo = V_r;
+			const table_point & lo = _voltage_table[r - 1];
+			const table_point & hi = _voltage_table[r];
+			if (hi.DOD() > lo.DOD())
+				slope = (hi.V() - lo.V()) / (hi.DOD() - lo.DOD());
+			V_r = lo.V();
+			DOD_r = lo.DOD();
 		}
+		double c0 = V_r + slope * (DOD - DOD_r);
+		double c1 = slope * dDOD_dI - _R / _num_strings;
 
-		if (DOD_r >= DOD)
-		{
-			DOD_hi = DOD_r;
-			V_hi = V_r;
+		// P = Ns*(c0 + c1*I)*I, taking the root nearest P/(Ns*c0)
+		double P_cell = P / _num_cells_series;
+		double disc = c0 * c0 + 4 * c1 * P_cell;
+		if (c0 <= 0 || disc < 0)
+			break;
+		I = 2 * P_cell / (c0 + std::sqrt(disc));
+
+		double DOD_new = DOD + dDOD_dI * I;
+		if (I > 0 && r < nrows && DOD_new > _voltage_table[r].DOD())
+			r++;
+		else if (I < 0 && r > 0 && DOD_new < _voltage_table[r - 1].DOD())
+			r--;
+		else
 			break;
-		}
 	}
+
+	// the voltage doesn't rise while discharging, so the present voltage delivers the power
+	if (I > 0 && I * battery_voltage() < P)
+		I = P / battery_voltage();
+
+	return I;
 }
 
 // Dynamic voltage model
@@ -681,6 +831,51 @@ void voltage_dynamic_t::updateVoltage(capacity_t * capacity, thermal_t * , doubl
 		_cell_voltage = cell_voltage;
 }
 
+double voltage_dynamic_t::calculate_current_for_target_power(double P, capacity_t * capacity, double dt)
+{
+	double I = P / battery_voltage_nominal();
+	if (P == 0)
+		return 0.;
+
+	// per string, with the charge at the end of the step q0 - I*dt
+	double Q = capacity->qmax() / _num_strings;
+	double q0 = capacity->q0() / _num_strings;
+	double P_cell = P / (_num_strings * _num_cells_series);
+	double I_string = I / _num_strings;
+
+	// Newton's method on I*V(I) - P, with V'(I) from the model directly
+	bool converged = false;
+	for (size_t n = 0; n != 10; n++)
+	{
+		double q = q0 - I_string * dt;
+		if (q <= 0 || q > Q)
+			break;
+		double exp_term = _A * std::exp(-_B0 * (Q - q));
+		double V = _E0 - _K * (Q / q) + exp_term - _R * I_string;
+		double dV_dI = -_K * Q * dt / (q * q) - _B0 * dt * exp_term - _R;
+		double f = I_string * V - P_cell;
+		double df = V + I_string * dV_dI;
+		if (V <= 0 || V > _Vfull * 1.25 || df <= 0)
+			break;
+
+		double dI = f / df;
+		I_string -= dI;
+		if (std::fabs(dI) <= 1e-6 * std::fabs(I_string))
+		{
+			converged = true;
+			break;
+		}
+	}
+	if (converged)
+		I = I_string * _num_strings;
+
+	// the voltage doesn't rise while discharging, so the present voltage delivers the power
+	if (I > 0 && I * battery_voltage() < P)
+		I = P / battery_voltage();
+
+	return I;
+}
+
 double voltage_dynamic_t::voltage_model_tremblay_hybrid(double Q, double I, double q0)
 {
 	// everything in here is on a per-cell basis
@@ -801,6 +996,22 @@ void lifetime_t::copy(lifetime_t * lifetime)
 	_replacement_scheduled = lifetime->_replacement_scheduled;
 	_q = lifetime->_q;
 }
+void lifetime_t::save_state(lifetime_state & state) const
+{
+	_lifetime_cycle->save_state(state.cycle);
+	_lifetime_calendar->save_state(state.calendar);
+	state.replacements = _replacements;
+	state.replacement_scheduled = _replacement_scheduled;
+	state.q = _q;
+}
+void lifetime_t::restore_state(const lifetime_state & state)
+{
+	_lifetime_cycle->restore_state(state.cycle);
+	_lifetime_calendar->restore_state(state.calendar);
+	_replacements = state.replacements;
+	_replacement_scheduled = state.replacement_scheduled;
+	_q = state.q;
+}
 double lifetime_t::capacity_percent(){ return _q; }
 void lifetime_t::runLifetimeModels(size_t idx, capacity_t * capacity, double T_battery)
 {
@@ -857,6 +1068,8 @@ lifetime_cycle_t::lifetime_cycle_t(const util::matrix_t<double> &batt_lifetime_m
 		_cycles_vect.push_back(batt_lifetime_matrix.at(i,1));
 		_capacities_vect.push_back(batt_lifetime_matrix.at(i, 2));
 	}
+	initialize_surface();
+
 	// initialize other member variables
 	_nCycles = 0;
 	_Dlt = 0;
@@ -891,6 +1104,30 @@ void lifetime_cycle_t::copy(lifetime_cycle_t * lifetime_cycle)
 	_Range = lifetime_cycle->_Range;
 	_average_range = lifetime_cycle->_average_range;
 }
+void lifetime_cycle_t::save_state(lifetime_cycle_state & state) const
+{
+	state.nCycles = _nCycles;
+	state.q = _q;
+	state.Dlt = _Dlt;
+	state.jlt = _jlt;
+	state.Xlt = _Xlt;
+	state.Ylt = _Ylt;
+	state.Peaks = _Peaks;
+	state.Range = _Range;
+	state.average_range = _average_range;
+}
+void lifetime_cycle_t::restore_state(const lifetime_cycle_state & state)
+{
+	_nCycles = state.nCycles;
+	_q = state.q;
+	_Dlt = state.Dlt;
+	_jlt = state.jlt;
+	_Xlt = state.Xlt;
+	_Ylt = state.Ylt;
+	_Peaks = state.Peaks;
+	_Range = state.Range;
+	_average_range = state.average_range;
+}
 double lifetime_cycle_t::computeCycleDamageAtDOD(double DOD)
 {
 	if (DOD == 0)
@@ -980,18 +1217,17 @@ int lifetime_cycle_t::rainflow_compareRanges()
 		_nCycles++;
 
 		// the capacity percent cannot increase
-		if (bilinear(_average_range, _nCycles) <= _q)
-			_q = bilinear(_average_range, _nCycles);
+		double q = bilinear(_average_range, _nCycles);
+		if (q <= _q)
+			_q = q;
 
 		if (_q < 0)
 			_q = 0.;
 		
 		// discard peak & valley of Y
-		double save = _Peaks[_jlt]; 
-		_Peaks.pop_back(); 
+		_Peaks[_jlt - 2] = _Peaks[_jlt];
 		_Peaks.pop_back();
 		_Peaks.pop_back();
-		_Peaks.push_back(save);
 		_jlt -= 2;
 		// stay in while loop
 		retCode = LT_RERANGE;
@@ -1018,141 +1254,112 @@ double lifetime_cycle_t::cycle_range(){ return _Range; }
 double lifetime_cycle_t::bilinear(double DOD, int cycle_number)
 {
 	/*
-	Work could be done to make this simpler
-	Current idea is to interpolate first along the C = f(n) curves for each DOD to get C_DOD_, C_DOD_+ 
+	Interpolate first along the C = f(n) curves for the DOD levels bracketing DOD to get C_DOD_, C_DOD_+
 	Then interpolate C_, C+ to get C at the DOD of interest
 	*/
+	const size_t nlevels = _DOD_levels.size();
+	const double nan = std::numeric_limits<double>::quiet_NaN();
 
-	std::vector<double> D_unique_vect;
-	std::vector<double> C_n_low_vect;
-	std::vector<double> D_high_vect;
-	std::vector<double> C_n_high_vect;
-	std::vector<int> low_indices;
-	std::vector<int> high_indices;
-	double D = 0.;
-	size_t n = 0;
-	double C = 100;
-
-	// get unique values of D
-	D_unique_vect.push_back(_DOD_vect[0]);
-	for (int i = 0; i < (int)_DOD_vect.size(); i++){
-		bool contained = false;
-		for (int j = 0; j < (int)D_unique_vect.size(); j++){
-			if (_DOD_vect[i] == D_unique_vect[j]){
-				contained = true;
-				break;
-			}
-		}
-		if (!contained){
-			D_unique_vect.push_back(_DOD_vect[i]);
-		}
-	}
-	n = D_unique_vect.size();
+	// just have one level, single level interpolation
+	if (nlevels < 2)
+		return (nlevels == 0) ? nan : interpolate_cycles(0, _level_start[1], cycle_number);
 
-	if (n > 1)
-	{
-		// get where DOD is bracketed [D_lo, DOD, D_hi]
-		double D_lo = 0;
-		double D_hi = 100;
+	auto find_level = [&](double D) {
+		std::vector<double>::const_iterator it = std::lower_bound(_DOD_levels.begin(), _DOD_levels.end(), D);
+		return (it != _DOD_levels.end() && *it == D) ? (size_t)(it - _DOD_levels.begin()) : nlevels;
+	};
 
-		for (int i = 0; i < (int)_DOD_vect.size(); i++)
-		{
-			D = _DOD_vect[i];
-			if (D < DOD && D > D_lo)
-				D_lo = D;
-			else if (D >= DOD && D < D_hi)
-				D_hi = D;
-		}
+	// get where DOD is bracketed [D_lo, DOD, D_hi], with D_lo above 0 and D_hi below 100 if the table has such levels
+	size_t k = (size_t)(std::lower_bound(_DOD_levels.begin(), _DOD_levels.end(), DOD) - _DOD_levels.begin());
+	double D_lo = (k > 0 && _DOD_levels[k - 1] > 0) ? _DOD_levels[k - 1] : 0.;
+	double D_hi = (k < nlevels && _DOD_levels[k] < 100) ? _DOD_levels[k] : 100.;
 
-		// Seperate table into bins
-		double D_min = 100.;
-		double D_max = 0.;
-		
-		for (int i = 0; i < (int)_DOD_vect.size(); i++)
-		{
-			D = _DOD_vect[i];
-			if (D == D_lo)
-				low_indices.push_back(i);
-			else if (D == D_hi)
-				high_indices.push_back(i);
-
-			if (D < D_min){ D_min = D; }
-			else if (D > D_max){ D_max = D; }
-		}
+	size_t lo = find_level(D_lo);
+	size_t hi = (D_hi != D_lo) ? find_level(D_hi) : nlevels;
 
-		// if we're out of the bounds, just make the upper bound equal to the highest input
-		if (high_indices.size() == 0)
-		{
-			for (int i = 0; i != (int)_DOD_vect.size(); i++)
-			{
-				if (_DOD_vect[i] == D_max)
-					high_indices.push_back(i);
-			}
-		}
+	// if we're out of the bounds, just make the upper bound equal to the highest input
+	if (hi == nlevels)
+		hi = find_level(_DOD_max);
 
-		size_t n_rows_lo = low_indices.size();
-		size_t n_rows_hi = high_indices.size();
-		size_t n_cols = 2;
+	size_t n_rows_hi = (hi < nlevels) ? _level_start[hi + 1] - _level_start[hi] : 0;
+	size_t n_rows_lo = (lo < nlevels) ? _level_start[lo + 1] - _level_start[lo] : n_rows_hi;
 
-		// If we aren't bounded, fill in values
-		if (n_rows_lo == 0)
-		{
-			// Assumes 0% DOD
-			for (int i = 0; i < (int)n_rows_hi; i++)
-			{
-				C_n_low_vect.push_back(0. + i * 500); // cycles
-				C_n_low_vect.push_back(100.); // 100 % capacity
-			}
-		}
-		
-		if (n_rows_lo != 0)
-		{
-			for (int i = 0; i < (int)n_rows_lo; i++)
-			{
-				C_n_low_vect.push_back(_cycles_vect[low_indices[i]]);
-				C_n_low_vect.push_back(_capacities_vect[low_indices[i]]);
-			}
-		}
-		if (n_rows_hi != 0)
-		{
-			for (int i = 0; i < (int)n_rows_hi; i++)
-			{
-				C_n_high_vect.push_back(_cycles_vect[high_indices[i]]);
-				C_n_high_vect.push_back(_capacities_vect[high_indices[i]]);
-			}
-		}
-		n_rows_lo = C_n_low_vect.size() / n_cols;
-		n_rows_hi = C_n_high_vect.size() / n_cols;
+	// Compute C(D_lo, n), C(D_hi, n), the upper curve is read over as many rows as the lower curve.
+	// If we aren't bounded below, the lower curve assumes 0% DOD at 100% capacity
+	double C_Dlo = (lo < nlevels) ? interpolate_cycles(lo, n_rows_lo, cycle_number) : ((n_rows_lo < 2) ? nan : 100.);
+	double C_Dhi = (hi < nlevels) ? interpolate_cycles(hi, std::min(n_rows_lo, n_rows_hi), cycle_number) : nan;
 
-		if (n_rows_lo == 0 || n_rows_hi == 0)
-		{
-			// need a safeguard here
-		}
+	if (C_Dlo < 0.)
+		C_Dlo = 0.;
+	if (C_Dhi > 100.)
+		C_Dhi = 100.;
 
-		util::matrix_t<double> C_n_low(n_rows_lo, n_cols, &C_n_low_vect);
-		util::matrix_t<double> C_n_high(n_rows_lo, n_cols, &C_n_high_vect);
+	// Interpolate to get C(D, n)
+	return util::interpolate(D_lo, C_Dlo, D_hi, C_Dhi, DOD);
+}
 
-		// Compute C(D_lo, n), C(D_hi, n)
-		double C_Dlo = util::linterp_col(C_n_low, 0, cycle_number, 1);
-		double C_Dhi = util::linterp_col(C_n_high, 0, cycle_number, 1);
+double lifetime_cycle_t::interpolate_cycles(size_t level, size_t nrows, double cycle_number)
+{
+	// same as util::linterp_col along the first nrows of the level's capacity vs cycles curve
+	if (nrows < 2)
+		return std::numeric_limits<double>::quiet_NaN();
 
-		if (C_Dlo < 0.)
-			C_Dlo = 0.;
-		if (C_Dhi > 100.)
-			C_Dhi = 100.;
+	const double *cycles = &_level_cycles[_level_start[level]];
+	const double *capacities = &_level_capacities[_level_start[level]];
+	size_t nsorted = std::min(nrows, _level_sorted[level]);
 
-		// Interpolate to get C(D, n)
-		C = util::interpolate(D_lo, C_Dlo, D_hi, C_Dhi, DOD);
+	// first row after the first with more cycles than cycle_number
+	size_t i = (size_t)(std::upper_bound(cycles + 1, cycles + nsorted, cycle_number) - cycles);
+	if (i == nsorted)
+	{
+		// cycles must be in increasing order up to the interpolation point
+		if (nsorted < nrows)
+			return std::numeric_limits<double>::quiet_NaN();
+		i = nrows - 1;
 	}
-	// just have one row, single level interpolation
-	else
+	return util::interpolate(cycles[i - 1], capacities[i - 1], cycles[i], capacities[i], cycle_number);
+}
+
+void lifetime_cycle_t::initialize_surface()
+{
+	_DOD_levels = _DOD_vect;
+	std::sort(_DOD_levels.begin(), _DOD_levels.end());
+	_DOD_levels.erase(std::unique(_DOD_levels.begin(), _DOD_levels.end()), _DOD_levels.end());
+
+	// rows of each level, in table order
+	_level_start.assign(1, 0);
+	_level_sorted.clear();
+	_level_cycles.clear();
+	_level_capacities.clear();
+	for (size_t l = 0; l < _DOD_levels.size(); l++)
 	{
-		C = util::linterp_col(_batt_lifetime_matrix, 1, cycle_number, 2);
+		size_t start = _level_cycles.size();
+		size_t nsorted = 0;
+		for (size_t i = 0; i < _DOD_vect.size(); i++)
+		{
+			if (_DOD_vect[i] != _DOD_levels[l])
+				continue;
+			size_t row = _level_cycles.size() - start;
+			if (nsorted == row && (row == 0 || _cycles_vect[i] >= _level_cycles.back()))
+				nsorted++;
+			_level_cycles.push_back(_cycles_vect[i]);
+			_level_capacities.push_back(_capacities_vect[i]);
+		}
+		_level_start.push_back(_level_cycles.size());
+		_level_sorted.push_back(nsorted);
 	}
 
-	return C;
+	// upper DOD bound, found the same way as the table search this replaces, where a row that lowers the
+	// minimum is not compared with the maximum
+	double D_min = 100.;
+	_DOD_max = 0.;
+	for (size_t i = 0; i < _DOD_vect.size(); i++)
+	{
+		double D = _DOD_vect[i];
+		if (D < D_min){ D_min = D; }
+		else if (D > _DOD_max){ _DOD_max = D; }
+	}
 }
-
 /*
 Lifetime Calendar Model
 */
@@ -1208,6 +1415,22 @@ void lifetime_calendar_t::copy(lifetime_calendar_t * lifetime_calendar)
 	_b = lifetime_calendar->_b;
 	_c = lifetime_calendar->_c;
 }
+void lifetime_calendar_t::save_state(lifetime_calendar_state & state) const
+{
+	state.day_age_of_battery = _day_age_of_battery;
+	state.last_idx = _last_idx;
+	state.q = _q;
+	state.dq_old = _dq_old;
+	state.dq_new = _dq_new;
+}
+void lifetime_calendar_t::restore_state(const lifetime_calendar_state & state)
+{
+	_day_age_of_battery = state.day_age_of_battery;
+	_last_idx = state.last_idx;
+	_q = state.q;
+	_dq_old = state.dq_old;
+	_dq_new = state.dq_new;
+}
 double lifetime_calendar_t::runLifetimeCalendarModel(size_t idx, double T, double SOC)
 {
 	if (_calendar_choice != lifetime_calendar_t::NONE)
@@ -1312,12 +1535,60 @@ thermal_t::thermal_t(double mass, double length, double width, double height,
 	//initialize maximum temperature
 	_T_max = 400.;
 
+	// computed on the first step
+	_dt_decay = 0.;
+	_decay = 1.;
+
 	// curve fit
 	size_t n = _cap_vs_temp.nrows();
 	for (int i = 0; i < (int)n; i++)
 	{
 		_cap_vs_temp(i,0) += 273.15; // convert C to K
 	}
+	initialize_grid();
+}
+void thermal_t::initialize_grid()
+{
+	// a cell no wider than the closest pair of rows holds at most one row, capped for very fine tables
+	const size_t max_cells = 10000;
+	size_t n = _cap_vs_temp.nrows();
+	_grid_row_above.clear();
+	_T_grid_min = 0.;
+	_T_grid_step = 1.;
+
+	// leave unsorted or short tables to the search, which reports them
+	if (n < 2 || _cap_vs_temp.ncols() < 2)
+		return;
+	for (size_t i = 1; i < n; i++)
+	{
+		if (_cap_vs_temp.at(i, 0) < _cap_vs_temp.at(i - 1, 0))
+			return;
+	}
+
+	_T_grid_min = _cap_vs_temp.at(0, 0);
+	double T_range = _cap_vs_temp.at(n - 1, 0) - _T_grid_min;
+	double T_gap = T_range;
+	for (size_t i = 1; i < n; i++)
+	{
+		double gap = _cap_vs_temp.at(i, 0) - _cap_vs_temp.at(i - 1, 0);
+		if (gap > 0 && gap < T_gap)
+			T_gap = gap;
+	}
+	size_t ncells = 1;
+	if (T_range > 0)
+	{
+		ncells = (size_t)std::min(std::ceil(T_range / T_gap), (double)max_cells);
+		_T_grid_step = T_range / ncells;
+	}
+
+	size_t i = 1;
+	for (size_t c = 0; c != ncells; c++)
+	{
+		double T_cell = _T_grid_min + c * _T_grid_step;
+		while (i < n && _cap_vs_temp.at(i, 0) <= T_cell)
+			i++;
+		_grid_row_above.push_back(i);
+	}
 }
 thermal_t * thermal_t::clone(){ return new thermal_t(*this); }
 void thermal_t::copy(thermal_t * thermal)
@@ -1334,6 +1605,20 @@ void thermal_t::copy(thermal_t * thermal)
 	_T_battery = thermal->_T_battery;
 	_capacity_percent = thermal->_capacity_percent;
 	_T_max = thermal->_T_max;
+	_dt_decay = thermal->_dt_decay;
+	_decay = thermal->_decay;
+}
+void thermal_t::save_state(thermal_state & state) const
+{
+	state.T_battery = _T_battery;
+	state.capacity_percent = _capacity_percent;
+	state.R = _R;
+}
+void thermal_t::restore_state(const thermal_state & state)
+{
+	_T_battery = state.T_battery;
+	_capacity_percent = state.capacity_percent;
+	_R = state.R;
 }
 void thermal_t::replace_battery()
 { 
@@ -1347,12 +1632,9 @@ void thermal_t::replace_battery()
 void thermal_t::updateTemperature(double I, double R, double dt)
 {
 	_R = R;
-	if (trapezoidal(I, dt*HR2SEC) < _T_max && trapezoidal(I, dt*HR2SEC) > 0)
-		_T_battery = trapezoidal(I, dt*HR2SEC);
-	else if (rk4(I, dt*HR2SEC) < _T_max && rk4(I, dt*HR2SEC) > 0)
-		_T_battery = rk4(I, dt*HR2SEC);
-	else if (implicit_euler(I, dt*HR2SEC) < _T_max && implicit_euler(I, dt*HR2SEC) > 0)
-		_T_battery = implicit_euler(I, dt*HR2SEC);
+	double T_battery = closed_form(I, dt*HR2SEC);
+	if (T_battery < _T_max && T_battery > 0)
+		_T_battery = T_battery;
 	else
 		_message.add("Computed battery temperature below zero or greater than max allowed, consider reducing C-rate");
 }
@@ -1387,10 +1669,55 @@ double thermal_t::implicit_euler(double I, double dt)
 
 	return (_T_battery + dt*(B*C*_T_room + D)) / (1 + dt*B*C);
 }
+double thermal_t::closed_form(double I, double dt)
+{
+	double B = 1 / (_mass*_Cp); // [K/J]
+	double C = _h*_A;			// [W/K]
+	double D = pow(I, 2)*_R;	// [Ohm A*A]
+
+	// with no heat transfer the resistive heating all goes into the battery
+	if (C <= 0)
+		return _T_battery + dt*B*D;
+
+	// dT/dt = B*(C*(T_room - T) + D) decays to T_room + D/C at the rate B*C, which only changes with the step
+	if (dt != _dt_decay)
+	{
+		_decay = std::exp(-B*C*dt);
+		_dt_decay = dt;
+	}
+	double T_steady = _T_room + D / C;
+	return T_steady + (_T_battery - T_steady)*_decay;
+}
 double thermal_t::T_battery(){ return _T_battery; }
+double thermal_t::capacity_percent_at(double T_battery)
+{
+	if (_grid_row_above.empty())
+		return util::linterp_col(_cap_vs_temp, 0, T_battery, 1);
+
+	// the first row above T_battery from the grid cell, then the last two rows off the end of the table,
+	// as util::linterp_col finds them
+	size_t n = _cap_vs_temp.nrows();
+	double cell = (T_battery - _T_grid_min) / _T_grid_step;
+	size_t c = 0;
+	if (cell >= (double)_grid_row_above.size())
+		c = _grid_row_above.size() - 1;
+	else if (cell > 0)
+		c = (size_t)cell;
+
+	size_t i = _grid_row_above[c];
+	while (i < n && _cap_vs_temp.at(i, 0) <= T_battery)
+		i++;
+	while (i > 1 && _cap_vs_temp.at(i - 1, 0) > T_battery)
+		i--;
+	if (i == n)
+		i--;
+
+	return util::interpolate(_cap_vs_temp.at(i - 1, 0), _cap_vs_temp.at(i - 1, 1),
+		_cap_vs_temp.at(i, 0), _cap_vs_temp.at(i, 1), T_battery);
+}
 double thermal_t::capacity_percent()
 { 
-	double percent = util::linterp_col(_cap_vs_temp, 0, _T_battery, 1); 
+	double percent = capacity_percent_at(_T_battery); 
 	
 	if (percent < 0 || percent > 100)
 	{
@@ -1462,23 +1789,13 @@ battery_t::battery_t(double dt_hour, int battery_chemistry)
 	_dt_min = dt_hour * 60;
 	_battery_chemistry = battery_chemistry;
 	_last_idx = 0;
-
-	if (battery_chemistry != battery_t::LEAD_ACID) {
-		_capacity_initial = new capacity_lithium_ion_t();
-	}
-	else {
-		_capacity_initial = new capacity_kibam_t();
-	}
-	_thermal_initial = new thermal_t();
 }
 
 battery_t::battery_t(const battery_t& battery)
 {
 	_capacity = battery.capacity_model()->clone();
-	_capacity_initial = battery.capacity_initial_model()->clone();
 	_voltage = battery.voltage_model()->clone();
 	_thermal = battery.thermal_model()->clone();
-	_thermal_initial = battery.thermal_initial_model()->clone();
 	_lifetime = battery.lifetime_model()->clone();
 	_losses = battery.losses_model()->clone();
 	_battery_chemistry = battery._battery_chemistry;
@@ -1487,21 +1804,13 @@ battery_t::battery_t(const battery_t& battery)
 	_last_idx = battery._last_idx;
 }
 
-battery_t::~battery_t()
-{
-	if (_capacity_initial)
-		delete _capacity_initial;
-	if (_thermal_initial)
-		delete _thermal_initial;
-}
+battery_t::~battery_t(){}
 
 // copy from battery to this
 void battery_t::copy(const battery_t * battery)
 {
 	_capacity->copy(battery->capacity_model());
-	_capacity_initial->copy(battery->capacity_initial_model());
 	_thermal->copy(battery->thermal_model());
-	_thermal_initial->copy(battery->thermal_initial_model());
 	_lifetime->copy(battery->lifetime_model());
 	_voltage->copy(battery->voltage_model());
 	_losses->copy(battery->losses_model());
@@ -1512,6 +1821,25 @@ void battery_t::copy(const battery_t * battery)
 	_last_idx = battery->_last_idx;
 }
 
+void battery_t::save_state(battery_state & state) const
+{
+	_capacity->save_state(state.capacity);
+	_voltage->save_state(state.voltage);
+	_thermal->save_state(state.thermal);
+	_lifetime->save_state(state.lifetime);
+	_losses->save_state(state.losses_nCycle);
+	state.last_idx = _last_idx;
+}
+void battery_t::restore_state(const battery_state & state)
+{
+	_capacity->restore_state(state.capacity);
+	_voltage->restore_state(state.voltage);
+	_thermal->restore_state(state.thermal);
+	_lifetime->restore_state(state.lifetime);
+	_losses->restore_state(state.losses_nCycle);
+	_last_idx = state.last_idx;
+}
+
 void battery_t::delete_clone()
 {
 	if (_capacity) delete _capacity;
@@ -1531,9 +1859,6 @@ void battery_t::initialize(capacity_t *capacity, voltage_t * voltage, lifetime_t
 	_voltage = voltage;
 	_thermal = thermal;
 	_losses = losses;
-
-	_capacity_initial->copy(_capacity);
-	_thermal_initial->copy(_thermal);
 }
 
 void battery_t::run(size_t idx, double I)
@@ -1542,8 +1867,10 @@ void battery_t::run(size_t idx, double I)
 	// Temperature affects capacity, but capacity model can reduce current, which reduces temperature, need to iterate
 	double I_initial = I;
 	size_t iterate_count = 0;
-	_capacity_initial->copy(_capacity);
-	_thermal_initial->copy(_thermal);
+	capacity_state capacity_initial;
+	thermal_state thermal_initial;
+	_capacity->save_state(capacity_initial);
+	_thermal->save_state(thermal_initial);
 
 	while (iterate_count < 5)
 	{
@@ -1552,8 +1879,8 @@ void battery_t::run(size_t idx, double I)
 
 		if (fabs(I - I_initial)/fabs(I_initial) > tolerance)
 		{
-			_thermal->copy(_thermal_initial);
-			_capacity->copy(_capacity_initial);
+			_thermal->restore_state(thermal_initial);
+			_capacity->restore_state(capacity_initial);
 			I_initial = I;
 			iterate_count++;
 		} 
@@ -1605,11 +1932,9 @@ void battery_t::runLossesModel(size_t idx)
 	}
 }
 capacity_t * battery_t::capacity_model() const { return _capacity; }
-capacity_t * battery_t::capacity_initial_model() const { return _capacity_initial; }
 voltage_t * battery_t::voltage_model() const { return _voltage; }
 lifetime_t * battery_t::lifetime_model() const { return _lifetime; }
 thermal_t * battery_t::thermal_model() const { return _thermal; }
-thermal_t * battery_t::thermal_initial_model() const { return _thermal_initial; }
 losses_t * battery_t::losses_model() const { return _losses; }
 
 double battery_t::battery_charge_needed(double SOC_max)
@@ -1642,4 +1967,8 @@ double battery_t::battery_charge_maximum_thermal() { return _capacity->qmax_ther
 double battery_t::cell_voltage(){ return _voltage->cell_voltage();}
 double battery_t::battery_voltage(){ return _voltage->battery_voltage();}
 double battery_t::battery_voltage_nominal(){ return _voltage->battery_voltage_nominal(); }
+double battery_t::calculate_current_for_power_kw(double P)
+{
+	return _voltage->calculate_current_for_target_power(util::kilowatt_to_watt * P, _capacity, _dt_hour);
+}
 double battery_t::battery_soc(){ return _capacity->SOC(); }
@@ -84,6 +84,18 @@ protected:
 	std::vector<int> count;
 };
 
+/*
+Battery state structures.  Each holds only the quantities of a model that change as the battery runs,
+so that a battery can be saved and restored by value without copying the models and their tables
+*/
+struct capacity_state
+{
+	double q0, qmax, qmax_thermal, I, I_loss, SOC, DOD, DOD_prev, dt_hour;
+	bool chargeChange;
+	int prev_charge, charge;
+	double q1_0, q2_0, q1, q2;	// KiBaM only
+};
+
 /*
 Base class from which capacity models derive
 Note, all capacity models are based on the capacity of one battery
@@ -102,6 +114,10 @@ public:
 	// shallow copy from capacity to this
 	virtual void copy(capacity_t *);
 
+	// save and restore the running state
+	virtual void save_state(capacity_state &) const;
+	virtual void restore_state(const capacity_state &);
+
 	// virtual destructor
 	virtual ~capacity_t(){};
 	
@@ -170,6 +186,9 @@ public:
 	// copy from capacity to this
 	void copy(capacity_t *);
 
+	void save_state(capacity_state &) const;
+	void restore_state(const capacity_state &);
+
 	void updateCapacity(double &I, double dt);
 	void updateCapacityForThermal(double capacity_percent);
 	void updateCapacityForLifetime(double capacity_percent);
@@ -238,6 +257,11 @@ public:
 protected:
 };
 
+struct voltage_state
+{
+	double cell_voltage;
+};
+
 /*
 Voltage Base class.  
 All voltage models are based on one-cell, but return the voltage for one battery
@@ -254,12 +278,19 @@ public:
 	// copy from voltage to this
 	virtual void copy(voltage_t *);
 
+	// save and restore the running state
+	void save_state(voltage_state &) const;
+	void restore_state(const voltage_state &);
 
 	virtual ~voltage_t(){};
 
 	virtual void updateVoltage(capacity_t * capacity, thermal_t * thermal, double dt)=0;
 	virtual double battery_voltage(); // voltage of one battery
 
+	// return the battery current [A] which delivers power P [W] (>0 discharging) over the next step of dt [h],
+	// at the voltage the battery will have at the end of the step.  Defaults to the nominal voltage
+	virtual double calculate_current_for_target_power(double P, capacity_t * capacity, double dt);
+
 	double battery_voltage_nominal(); // nominal voltage of battery
 	double cell_voltage(); // voltage of one cell
 	double R_battery(); // computed battery resistance
@@ -310,13 +341,23 @@ public:
 
 	void updateVoltage(capacity_t * capacity, thermal_t * thermal, double dt);
 
+	// solve the quadratic in current of the linear segment the step ends on
+	double calculate_current_for_target_power(double P, capacity_t * capacity, double dt);
+
 protected:
 
 	bool exactVoltageFound(double DOD, double &V);
 	void prepareInterpolation(double & DOD_lo, double & V_lo, double & DOD_hi, double & V_hi, double DOD);
 
+	// index the sorted table on a uniform DOD grid, so lookups don't search the table
+	void initialize_grid();
+	size_t rows_below(double DOD);
+
 private:
 	std::vector<table_point> _voltage_table;
+	double _DOD_grid_min;					// DOD of the first grid cell
+	double _DOD_grid_step;					// width of a grid cell, no wider than the closest table rows
+	std::vector<size_t> _grid_rows_below;	// number of table rows below the start of each grid cell
 };
 
 // Shepard + Tremblay Model
@@ -334,6 +375,9 @@ public:
 	void parameter_compute();
 	void updateVoltage(capacity_t * capacity, thermal_t * thermal, double dt);
 
+	// Newton's method on the model with its analytic derivative, no battery model runs
+	double calculate_current_for_target_power(double P, capacity_t * capacity, double dt);
+
 protected:
 	double voltage_model_tremblay_hybrid(double capacity, double current, double q0);
 
@@ -381,6 +425,58 @@ private:
 };
 
 
+/*
+Residual turning points of the rainflow count.  Each counted cycle removes two points, and the ranges
+between the residual points shrink toward the top of the stack, so it rarely holds more than a few
+dozen points.  These are kept inline, which makes copying the cycle model allocation free, and any
+further points spill over into a vector so that the count stays exact.
+*/
+class rainflow_stack
+{
+public:
+	rainflow_stack() : _n(0) {}
+
+	size_t size() const { return _n; }
+	bool empty() const { return _n == 0; }
+	double & operator[](size_t i) { return (i < INLINE_SIZE) ? _inline[i] : _overflow[i - INLINE_SIZE]; }
+	double operator[](size_t i) const { return (i < INLINE_SIZE) ? _inline[i] : _overflow[i - INLINE_SIZE]; }
+
+	void push_back(double x)
+	{
+		if (_n < INLINE_SIZE)
+			_inline[_n] = x;
+		else
+			_overflow.push_back(x);
+		_n++;
+	}
+	void pop_back()
+	{
+		_n--;
+		if (_n >= INLINE_SIZE)
+			_overflow.pop_back();
+	}
+	void clear()
+	{
+		_n = 0;
+		_overflow.clear();
+	}
+
+protected:
+	enum { INLINE_SIZE = 32 };
+	double _inline[INLINE_SIZE];
+	std::vector<double> _overflow;
+	size_t _n;
+};
+
+struct lifetime_cycle_state
+{
+	int nCycles;
+	double q, Dlt;
+	int jlt;
+	double Xlt, Ylt, Range, average_range;
+	rainflow_stack Peaks;
+};
+
 /*
 Lifetime cycling class.  
 */
@@ -398,6 +494,10 @@ public:
 	// copy from lifetime_cycle to this
 	void copy(lifetime_cycle_t *);
 
+	// save and restore the running state
+	void save_state(lifetime_cycle_state &) const;
+	void restore_state(const lifetime_cycle_state &);
+
 	// return q, the effective capacity percent
 	double runCycleLifetime(double DOD);
 
@@ -416,12 +516,22 @@ protected:
 	int rainflow_compareRanges();
 	double bilinear(double DOD, int cycle_number);
 
+	// group the cycles vs DOD table by DOD once, so that capacity lookups do not search or copy the table
+	void initialize_surface();
+	double interpolate_cycles(size_t level, size_t nrows, double cycle_number);
+
 	util::matrix_t<double> _cycles_vs_DOD;
 	util::matrix_t<double> _batt_lifetime_matrix;
 	std::vector<double> _DOD_vect;
 	std::vector<double> _cycles_vect;
 	std::vector<double> _capacities_vect;
 
+	std::vector<double> _DOD_levels;		// distinct DOD values of the table, sorted
+	std::vector<size_t> _level_start;		// first row of each DOD level in _level_cycles and _level_capacities
+	std::vector<size_t> _level_sorted;		// leading rows of each level with cycles in increasing order
+	std::vector<double> _level_cycles;
+	std::vector<double> _level_capacities;
+	double _DOD_max;						// DOD level used above the table
 
 	int _nCycles;
 	double _q;				// relative capacity %
@@ -429,7 +539,7 @@ protected:
 	int _jlt;			    // last index in Peaks, i.e, if Peaks = [0,1], then _jlt = 1
 	double _Xlt;
 	double _Ylt;
-	std::vector<double> _Peaks;
+	rainflow_stack _Peaks;	// residual turning points
 	double _Range;
 	double _average_range;
 
@@ -440,6 +550,13 @@ protected:
 		LT_RERANGE
 	};
 };
+struct lifetime_calendar_state
+{
+	int day_age_of_battery;
+	size_t last_idx;
+	double q, dq_old, dq_new;
+};
+
 /*
 Lifetime calendar model
 */
@@ -456,6 +573,10 @@ public:
 	// copy from lifetime_calendar to this
 	void copy(lifetime_calendar_t *);
 
+	// save and restore the running state
+	void save_state(lifetime_calendar_state &) const;
+	void restore_state(const lifetime_calendar_state &);
+
 	/// Given the index of the simulation, the tempertature and SOC, return the effective capacity percent
 	double runLifetimeCalendarModel(size_t idx, double T, double SOC);
 
@@ -494,6 +615,15 @@ private:
 	float _c;  // K
 };
 
+struct lifetime_state
+{
+	lifetime_cycle_state cycle;
+	lifetime_calendar_state calendar;
+	int replacements;
+	bool replacement_scheduled;
+	double q;
+};
+
 /*
 Class to encapsulate multiple lifetime models, and linearly combined the associated degradation and handle replacements
 */
@@ -512,6 +642,10 @@ public:
 	// copy lifetime to this
 	void copy(lifetime_t *);
 
+	// save and restore the running state
+	void save_state(lifetime_state &) const;
+	void restore_state(const lifetime_state &);
+
 	void runLifetimeModels(size_t idx, capacity_t *, double T_battery);
 
 	double capacity_percent();
@@ -541,6 +675,11 @@ protected:
 };
 
 
+struct thermal_state
+{
+	double T_battery, capacity_percent, R;
+};
+
 /*
 Thermal classes
 */
@@ -558,6 +697,10 @@ public:
 	// copy thermal to this
 	void copy(thermal_t *);
 
+	// save and restore the running state
+	void save_state(thermal_state &) const;
+	void restore_state(const thermal_state &);
+
 	void updateTemperature(double I, double R, double dt);
 	void replace_battery();
 
@@ -572,9 +715,19 @@ protected:
 	double trapezoidal(double I, double dt);
 	double implicit_euler(double I, double dt);
 
+	// exact solution of the lumped model over a step of constant current, decaying to the steady state temperature
+	double closed_form(double I, double dt);
+
+	// index the capacity table on a uniform temperature grid, so lookups don't search the table
+	void initialize_grid();
+	double capacity_percent_at(double T_battery);
+
 protected:
 
 	util::matrix_t<double> _cap_vs_temp;
+	double _T_grid_min;						// [K] - temperature of the first grid cell
+	double _T_grid_step;					// [K] - width of a grid cell, no wider than the closest table rows
+	std::vector<size_t> _grid_row_above;	// first row above the start of each grid cell, empty if the table can't be indexed
 
 	double _mass;		// [kg]
 	double _length;		// [m]
@@ -588,6 +741,8 @@ protected:
 	double _T_battery;   // [K]
 	double _capacity_percent; //[%]
 	double _T_max;		 // [K]
+	double _dt_decay;	 // [s] - step the decay factor was computed for
+	double _decay;		 // [-] - fraction of the distance to steady state left after a step
 	message _message;
 
 };
@@ -605,6 +760,10 @@ public:
 	// copy losses to this
 	void copy(losses_t *);
 
+	// save and restore the running state, the cycle count since replacement
+	void save_state(int &nCycle) const { nCycle = _nCycle; }
+	void restore_state(int nCycle) { _nCycle = nCycle; }
+
 	// main APIs
 	void run_losses(double dt_hour, size_t index);
 	void replace_battery();
@@ -626,6 +785,20 @@ protected:
 	double_vec  _full_loss;
 };
 
+/*
+Running state of a battery and all its models.  Dispatch saves this before trying a current and restores it
+to try again, which is much cheaper than copying a battery
+*/
+struct battery_state
+{
+	capacity_state capacity;
+	voltage_state voltage;
+	thermal_state thermal;
+	lifetime_state lifetime;
+	int losses_nCycle;
+	size_t last_idx;
+};
+
 /*
 Class which encapsulates a battery and all its models
 */
@@ -642,6 +815,10 @@ public:
 	// copy members from battery to this
 	void copy(const battery_t * battery);
 
+	// save and restore the running state of all models
+	void save_state(battery_state &) const;
+	void restore_state(const battery_state &);
+
 	// virtual destructor, does nothing as no memory allocated in constructor
 	virtual ~battery_t();
 
@@ -661,11 +838,9 @@ public:
 	void runLossesModel(size_t idx);
 
 	capacity_t * capacity_model() const;
-	capacity_t * capacity_initial_model() const;
 	voltage_t * voltage_model() const;
 	lifetime_t * lifetime_model() const;
 	thermal_t * thermal_model() const;
-	thermal_t * thermal_initial_model() const;
 	losses_t * losses_model() const;
 
 	// Get capacity quantities
@@ -683,15 +858,16 @@ public:
 	double battery_voltage(); // the actual battery voltage
 	double battery_voltage_nominal(); // the nominal battery voltage
 
+	// the current [A] which delivers power P [kW] (>0 discharging) over the next step
+	double calculate_current_for_power_kw(double P);
+
 	enum CHEMS{ LEAD_ACID, LITHIUM_ION, VANADIUM_REDOX, IRON_FLOW};
 	enum REPLACE{ NO_REPLACEMENTS, REPLACE_BY_CAPACITY, REPLACE_BY_SCHEDULE};
 
 
 private:
 	capacity_t * _capacity;
-	capacity_t * _capacity_initial;
 	thermal_t * _thermal;
-	thermal_t * _thermal_initial;
 	lifetime_t * _lifetime;
 	voltage_t * _voltage;
 	losses_t * _losses;
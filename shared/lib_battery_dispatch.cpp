@@ -68,9 +68,9 @@ dispatch_t::dispatch_t(battery_t * Battery, double dt_hour, double SOC_min, doub
 	m_batteryPower->powerBatteryDischargeMax = Pd_max;
 	m_batteryPower->meterPosition = battMeterPosition;
 
-	// initalize Battery and a copy of the Battery for iteration
+	// initalize Battery and its state for iteration
 	_Battery = Battery;
-	_Battery_initial = new battery_t(*_Battery);
+	_Battery->save_state(_Battery_initial);
 
 	// Call the dispatch init method
 	init(_Battery, dt_hour, current_choice, t_min, mode);
@@ -114,7 +114,7 @@ dispatch_t::dispatch_t(const dispatch_t& dispatch)
 	m_batteryPower = m_batteryPowerFlow->getBatteryPower();
 
 	_Battery = new battery_t(*dispatch._Battery);
-	_Battery_initial = new battery_t(*dispatch._Battery_initial);
+	_Battery_initial = dispatch._Battery_initial;
 	init(_Battery, dispatch._dt_hour, dispatch._current_choice, dispatch._t_min, dispatch._mode);
 }
 
@@ -122,7 +122,7 @@ dispatch_t::dispatch_t(const dispatch_t& dispatch)
 void dispatch_t::copy(const dispatch_t * dispatch)
 {
 	_Battery->copy(dispatch->_Battery);
-	_Battery_initial->copy(dispatch->_Battery_initial);
+	_Battery_initial = dispatch->_Battery_initial;
 	init(_Battery, dispatch->_dt_hour,  dispatch->_current_choice, dispatch->_t_min, dispatch->_mode);
 
 	// can't create shallow copy of unique ptr
@@ -132,19 +132,16 @@ void dispatch_t::copy(const dispatch_t * dispatch)
 }
 void dispatch_t::delete_clone()
 {
-	// need to delete both, since allocated memory for both in deep copy 
+	// need to delete, since allocated memory in deep copy 
 	if (_Battery) delete _Battery;
-	if (_Battery_initial) delete _Battery_initial;
 }
 dispatch_t::~dispatch_t()
 {
 	// original _Battery doesn't need deleted, since was a pointer passed in
-	_Battery_initial->delete_clone();
-	delete _Battery_initial;
 }
 void dispatch_t::finalize(size_t idx, double &I)
 {
-	_Battery->copy(_Battery_initial);
+	_Battery->restore_state(_Battery_initial);
 	m_batteryPower->powerBattery = 0;
 	m_batteryPower->powerGridToBattery = 0;
 	m_batteryPower->powerBatteryToGrid = 0;
@@ -209,7 +206,7 @@ bool dispatch_t::check_constraints(double &I, size_t count)
 	// reset
 	if (iterate)
 	{
-		_Battery->copy(_Battery_initial);
+		_Battery->restore_state(_Battery_initial);
 		m_batteryPower->powerBattery = 0;
 		m_batteryPower->powerGridToBattery = 0;
 		m_batteryPower->powerBatteryToGrid = 0;
@@ -261,11 +258,10 @@ void dispatch_t::switch_controller()
 	}
 	_t_at_mode += (int)(round(_dt_hour * util::hour_to_min));
 }
-double dispatch_t::current_controller(double battery_voltage)
+double dispatch_t::current_controller()
 {
-	double P, I = 0.; // [W],[V]
-	P = util::kilowatt_to_watt*m_batteryPower->powerBattery;
-	I = P / battery_voltage;
+	// the current which delivers the power at the voltage the battery ends the step on
+	double I = _Battery->calculate_current_for_power_kw(m_batteryPower->powerBattery);
 	restrict_current(I);
 	return I;
 }
@@ -337,10 +333,10 @@ void dispatch_t::runDispatch(size_t year, size_t hour_of_year, size_t step)
 	switch_controller();
 
 	// Calculate current, and ensure the battery falls within the current limits
-	double I = current_controller(_Battery->battery_voltage_nominal());
+	double I = current_controller();
 
 	// Setup battery iteration
-	_Battery_initial->copy(_Battery);
+	_Battery->save_state(_Battery_initial);
 	bool iterate = true;
 	size_t count = 0;
 	size_t idx = util::index_year_hour_step(year, hour_of_year, step, static_cast<size_t>(1 / _dt_hour));
@@ -543,7 +539,7 @@ bool dispatch_manual_t::check_constraints(double &I, size_t count)
 		// reset
 		if (iterate)
 		{
-			_Battery->copy(_Battery_initial);
+			_Battery->restore_state(_Battery_initial);
 			m_batteryPower->powerBattery = 0;
 			m_batteryPower->powerGridToBattery = 0;
 			m_batteryPower->powerBatteryToGrid = 0;
@@ -627,6 +623,7 @@ dispatch_automatic_t::dispatch_automatic_t(
 
 	_mode = dispatch_mode;
 	_safety_factor = 0.03;
+	_P_pv_dc = NULL;
 
 	m_batteryPower->canClipCharge = can_clip_charge;
 	m_batteryPower->canPVCharge = can_charge;
@@ -649,6 +646,7 @@ void dispatch_automatic_t::init_with_pointer(const dispatch_automatic_t * tmp)
 	_look_ahead_hours = tmp->_look_ahead_hours;
 	_d_index_update = tmp->_d_index_update;
 	_index_last_updated = tmp->_index_last_updated;
+	_P_pv_dc = tmp->_P_pv_dc;
 }
 
 // deep copy from dispatch to this
@@ -667,7 +665,7 @@ void dispatch_automatic_t::copy(const dispatch_t * dispatch)
 	init_with_pointer(tmp);
 }
 
-void dispatch_automatic_t::update_pv_data(std::vector<double> P_pv_dc){ _P_pv_dc = P_pv_dc;}
+void dispatch_automatic_t::update_pv_data(const double_vec & P_pv_dc){ _P_pv_dc = &P_pv_dc;}
 void dispatch_automatic_t::set_custom_dispatch(std::vector<double> P_batt_dc) { _P_battery_use = P_batt_dc; }
 int dispatch_automatic_t::get_mode(){ return _mode; }
 
@@ -791,7 +789,7 @@ bool dispatch_automatic_t::check_constraints(double &I, size_t count)
 		// reset
 		if (iterate)
 		{
-			_Battery->copy(_Battery_initial);
+			_Battery->restore_state(_Battery_initial);
 			m_batteryPower->powerBattery = 0;
 			m_batteryPower->powerGridToBattery = 0;
 			m_batteryPower->powerBatteryToGrid = 0;
@@ -848,6 +846,13 @@ void dispatch_automatic_behind_the_meter_t::init_with_pointer(const dispatch_aut
 	_P_load_dc = tmp->_P_load_dc;
 	_P_target_use = tmp->_P_target_use;
 	sorted_grid = tmp->sorted_grid;
+
+	m_dispatchOpt = tmp->m_dispatchOpt;
+	m_peakDemand = tmp->m_peakDemand;
+	if (tmp->m_utilityRateCalculator) {
+		std::unique_ptr<UtilityRateCalculator> rate(new UtilityRateCalculator(*tmp->m_utilityRateCalculator));
+		m_utilityRateCalculator = std::move(rate);
+	}
 }
 
 // deep copy from dispatch to this
@@ -879,10 +884,20 @@ void dispatch_automatic_behind_the_meter_t::dispatch(size_t year,
 
 	update_dispatch(hour_of_year, step, idx);
 	dispatch_automatic_t::dispatch(year, hour_of_year, step, P_system, P_system_clipping_dc, P_load_ac);
+
+	if (m_utilityRateCalculator)
+		update_peak_demand(hour_of_year);
 }
 
 void dispatch_automatic_behind_the_meter_t::update_load_data(std::vector<double> P_load_dc){ _P_load_dc = P_load_dc; }
 void dispatch_automatic_behind_the_meter_t::set_target_power(std::vector<double> P_target){ _P_target_input = P_target; }
+void dispatch_automatic_behind_the_meter_t::setup_rate_optimization(UtilityRate * utilityRate, double time_limit_seconds)
+{
+	std::unique_ptr<UtilityRateCalculator> tmp(new UtilityRateCalculator(utilityRate, _steps_per_hour));
+	m_utilityRateCalculator = std::move(tmp);
+	m_dispatchOpt.set_time_limit(time_limit_seconds);
+	m_peakDemand.assign(m_utilityRateCalculator->getNumberOfDemandPeriods() + 1, 0.);
+}
 void dispatch_automatic_behind_the_meter_t::update_dispatch(size_t hour_of_year, size_t step, size_t idx)
 {
 	bool debug = false;
@@ -905,15 +920,19 @@ void dispatch_automatic_behind_the_meter_t::update_dispatch(size_t hour_of_year,
 			// setup vectors
 			initialize(hour_of_year);
 
-			// compute grid power, sort highest to lowest
-			sort_grid(p, debug, idx);
+			// optimize against the utility rate, falling back to peak shaving if no solution is found
+			if (_mode != dispatch_t::OPTIMIZED_LOOK_AHEAD || !optimize_dispatch(hour_of_year, idx))
+			{
+				// compute grid power, sort highest to lowest
+				sort_grid(p, debug, idx);
 
-			// Peak shaving scheme
-			compute_energy(p, debug, E_max);
-			target_power(p, debug, E_max, idx);
+				// Peak shaving scheme
+				compute_energy(p, debug, E_max);
+				target_power(p, debug, E_max, idx);
 
-			// Set battery power profile
-			set_battery_power(p, debug);
+				// Set battery power profile
+				set_battery_power(p, debug);
+			}
 		}
 		// save for extraction
 		_P_target_current = _P_target_use[_day_index];
@@ -958,9 +977,81 @@ void dispatch_automatic_behind_the_meter_t::check_new_month(size_t hour_of_year,
 	if ((hour_of_year == hours) && step == 0)
 	{
 		_P_target_month = -1e16;
+		std::fill(m_peakDemand.begin(), m_peakDemand.end(), 0.);
 		_month < 12 ? _month++ : _month = 1;
 	}
 }
+bool dispatch_automatic_behind_the_meter_t::optimize_dispatch(size_t hour_of_year, size_t idx)
+{
+	if (!m_utilityRateCalculator)
+		return false;
+
+	dispatch_opt_window window;
+	window.dt_hour = _dt_hour;
+	for (size_t i = 0; i != _num_steps; i++)
+	{
+		size_t hour = (hour_of_year + i / _steps_per_hour) % 8760;
+		window.P_net.push_back(_P_load_dc[idx + i] - (*_P_pv_dc)[idx + i]);
+		window.price_buy.push_back(m_utilityRateCalculator->getEnergyRate(hour));
+		window.price_sell.push_back(m_utilityRateCalculator->getEnergySellRate(hour));
+		window.demand_period.push_back(m_utilityRateCalculator->getDemandPeriod(hour));
+	}
+
+	// the window never crosses a month, so the current month's demand charges apply throughout
+	window.tier_peak.resize(m_peakDemand.size());
+	window.tier_charge.resize(m_peakDemand.size());
+	m_utilityRateCalculator->getFlatDemandTiers(_month - 1, window.tier_peak[0], window.tier_charge[0]);
+	for (size_t period = 1; period < m_peakDemand.size(); period++)
+		m_utilityRateCalculator->getDemandTiers(period, window.tier_peak[period], window.tier_charge[period]);
+	window.peak_to_date = m_peakDemand;
+
+	double kWh_per_percent = _Battery->battery_voltage() * _Battery->battery_charge_maximum() * 0.01 * util::watt_to_kilowatt;
+	window.E_max = kWh_per_percent * (m_batteryPower->stateOfChargeMax - m_batteryPower->stateOfChargeMin);
+	window.E_initial = std::max(0., std::min(window.E_max, kWh_per_percent * (_Battery->battery_soc() - m_batteryPower->stateOfChargeMin)));
+
+	double P_current_charge = m_batteryPower->currentChargeMax * _Battery->battery_voltage() * util::watt_to_kilowatt;
+	double P_current_discharge = m_batteryPower->currentDischargeMax * _Battery->battery_voltage() * util::watt_to_kilowatt;
+	window.P_charge_max = m_batteryPower->powerBatteryChargeMax;
+	window.P_discharge_max = m_batteryPower->powerBatteryDischargeMax;
+	if (_current_choice == dispatch_t::RESTRICT_CURRENT) {
+		window.P_charge_max = P_current_charge;
+		window.P_discharge_max = P_current_discharge;
+	}
+	else if (_current_choice == dispatch_t::RESTRICT_BOTH) {
+		window.P_charge_max = std::min(window.P_charge_max, P_current_charge);
+		window.P_discharge_max = std::min(window.P_discharge_max, P_current_discharge);
+	}
+
+	if (m_batteryPower->connectionMode == dispatch_t::AC_CONNECTED) {
+		window.eta_charge = m_batteryPower->singlePointEfficiencyACToDC;
+		window.eta_discharge = m_batteryPower->singlePointEfficiencyDCToAC;
+	}
+	else {
+		window.eta_charge = m_batteryPower->singlePointEfficiencyDCToDC;
+		window.eta_discharge = m_batteryPower->singlePointEfficiencyDCToDC;
+	}
+	window.can_grid_charge = m_batteryPower->canGridCharge;
+
+	std::vector<double> P_battery, P_grid;
+	if (!m_dispatchOpt.solve(window, P_battery, P_grid))
+		return false;
+
+	// the solution is power at the battery terminals, > 0 discharging, as powerBatteryTarget takes it.  The peak shaving
+	// sets _P_battery_use to the grid power less the target instead, which leaves out the conversion losses
+	_P_battery_use = P_battery;
+	_P_target_use = P_grid;
+	return true;
+}
+void dispatch_automatic_behind_the_meter_t::update_peak_demand(size_t hour_of_year)
+{
+	// grid power < 0 is drawn from the grid
+	double P_import = std::max(-m_batteryPower->powerGrid, 0.);
+	size_t period = m_utilityRateCalculator->getDemandPeriod(hour_of_year % 8760);
+
+	m_peakDemand[0] = std::max(m_peakDemand[0], P_import);
+	if (period > 0 && period < m_peakDemand.size())
+		m_peakDemand[period] = std::max(m_peakDemand[period], P_import);
+}
 void dispatch_automatic_behind_the_meter_t::check_debug(FILE *&p, bool & debug, size_t hour_of_year, size_t)
 {
 	// for now, don't enable
@@ -992,11 +1083,11 @@ void dispatch_automatic_behind_the_meter_t::sort_grid(FILE *p, bool debug, size_
 	{
 		for (size_t step = 0; step != _steps_per_hour; step++)
 		{
-			grid[count] = grid_point(_P_load_dc[idx] - _P_pv_dc[idx], hour, step);
+			grid[count] = grid_point(_P_load_dc[idx] - (*_P_pv_dc)[idx], hour, step);
 			sorted_grid[count] = grid[count];
 
 			if (debug)
-				fprintf(p, "%zu\t %.1f\t %.1f\t %.1f\n", count, _P_load_dc[idx], _P_pv_dc[idx], _P_load_dc[idx] - _P_pv_dc[idx]);
+				fprintf(p, "%zu\t %.1f\t %.1f\t %.1f\n", count, _P_load_dc[idx], (*_P_pv_dc)[idx], _P_load_dc[idx] - (*_P_pv_dc)[idx]);
 
 			idx++;
 			count++;
@@ -1215,6 +1306,7 @@ dispatch_automatic_front_of_meter_t::dispatch_automatic_front_of_meter_t(
 	}
 	
 	setup_cost_vector(ppa_weekday_schedule, ppa_weekend_schedule);
+	setup_forecast_days();
 }
 dispatch_automatic_front_of_meter_t::~dispatch_automatic_front_of_meter_t(){ /* NOTHING TO DO */}
 void dispatch_automatic_front_of_meter_t::init_with_pointer(const dispatch_automatic_front_of_meter_t* tmp)
@@ -1223,6 +1315,7 @@ void dispatch_automatic_front_of_meter_t::init_with_pointer(const dispatch_autom
 	_inverter_paco = tmp->_inverter_paco;
 	_ppa_factors = tmp->_ppa_factors;
 	_ppa_cost_vector = tmp->_ppa_cost_vector;
+	_forecast_days = tmp->_forecast_days;
 
 	m_battReplacementCostPerKWH = tmp->m_battReplacementCostPerKWH;
 	m_etaPVCharge = tmp->m_etaPVCharge;
@@ -1255,6 +1348,27 @@ void dispatch_automatic_front_of_meter_t::setup_cost_vector(util::matrix_t<size_
 	}
 }
 
+void dispatch_automatic_front_of_meter_t::setup_forecast_days()
+{
+	_forecast_days.resize(365);
+
+	for (size_t hour_of_year = 0; hour_of_year != 8760; hour_of_year++)
+	{
+		forecast_day & day = _forecast_days[hour_of_year / 24];
+		size_t hour = hour_of_year % 24;
+
+		// an empty look ahead compares the current hour only
+		double ppa_cost = _ppa_cost_vector[hour_of_year];
+		double ppa_cost_max = ppa_cost;
+		for (size_t h = hour_of_year + 1; h < hour_of_year + _look_ahead_hours; h++)
+			ppa_cost_max = std::fmax(ppa_cost_max, _ppa_cost_vector[h]);
+
+		day.ppa_cost[hour] = ppa_cost;
+		day.ppa_cost_max[hour] = ppa_cost_max;
+		day.usage_cost[hour] = m_utilityRateCalculator ? m_utilityRateCalculator->getEnergyRate(hour_of_year) : ppa_cost;
+	}
+}
+
 // deep copy from dispatch to this
 dispatch_automatic_front_of_meter_t::dispatch_automatic_front_of_meter_t(const dispatch_t & dispatch) :
 dispatch_automatic_t(dispatch)
@@ -1310,15 +1424,14 @@ void dispatch_automatic_front_of_meter_t::update_dispatch(size_t hour_of_year, s
 			/*! Cost to cycle the battery at all, using maximum DOD or user input */
 			costToCycle();
 			 
-			// Compute forecast variables which don't change from year to year
-			auto max_ppa_cost = std::max_element(_ppa_cost_vector.begin() + hour_of_year, _ppa_cost_vector.begin() + hour_of_year + _look_ahead_hours);
-			double ppa_cost = _ppa_cost_vector[hour_of_year];
+			// Look up forecast variables which don't change from year to year
+			const forecast_day & day = _forecast_days[hour_of_year / 24];
+			size_t hour = hour_of_year % 24;
+			double max_ppa_cost = day.ppa_cost_max[hour];
+			double ppa_cost = day.ppa_cost[hour];
 
 			/*! Cost to purchase electricity from the utility */
-			double usage_cost = ppa_cost;
-			if (m_utilityRateCalculator) {
-				usage_cost = m_utilityRateCalculator->getEnergyRate(hour_of_year);
-			}
+			double usage_cost = day.usage_cost[hour];
 
 			// Compute forecast variables which potentially do change from year to year
 			double energyToStoreClipped = 0;
@@ -1327,19 +1440,19 @@ void dispatch_automatic_front_of_meter_t::update_dispatch(size_t hour_of_year, s
 			}
 
 			/*! Economic benefit of charging from the grid in current time step to discharge sometime in next X hours ($/kWh)*/
-			double benefitToGridCharge = *max_ppa_cost * m_etaDischarge - usage_cost / m_etaGridCharge;
+			double benefitToGridCharge = max_ppa_cost * m_etaDischarge - usage_cost / m_etaGridCharge;
 
 			/*! Economic benefit of charging from regular PV in current time step to discharge sometime in next X hours ($/kWh)*/
-			double benefitToPVCharge = *max_ppa_cost * m_etaDischarge - ppa_cost / m_etaPVCharge;
+			double benefitToPVCharge = max_ppa_cost * m_etaDischarge - ppa_cost / m_etaPVCharge;
 
 			/*! Economic benefit of charging from clipped PV in current time step to discharge sometime in the next X hours (clipped PV is free) ($/kWh) */
-			double benefitToClipCharge = *max_ppa_cost * m_etaDischarge;
+			double benefitToClipCharge = max_ppa_cost * m_etaDischarge;
 
 			/*! Energy need to charge the battery (kWh) */
 			double energyNeededToFillBattery = _Battery->battery_energy_to_fill(m_batteryPower->stateOfChargeMax);
 
 			/* Booleans to assist decisions */
-			bool highValuePeriod = ppa_cost == *max_ppa_cost;
+			bool highValuePeriod = ppa_cost == max_ppa_cost;
 			bool excessAcCapacity = _inverter_paco > m_batteryPower->powerPVThroughSharedInverter;
 			bool batteryHasDischargeCapacity = _Battery->battery_soc() >= m_batteryPower->stateOfChargeMin + 1.0;
 
@@ -1404,8 +1517,9 @@ void dispatch_automatic_front_of_meter_t::update_dispatch(size_t hour_of_year, s
 	m_batteryPower->powerBattery = m_batteryPower->powerBatteryTarget;
 }
 
-void dispatch_automatic_front_of_meter_t::update_cliploss_data(double_vec P_cliploss)
+void dispatch_automatic_front_of_meter_t::update_cliploss_data(const double_vec & P_cliploss)
 {
+	_P_cliploss_dc.reserve(P_cliploss.size() + _look_ahead_hours * _steps_per_hour);
 	_P_cliploss_dc = P_cliploss;
 
 	// append to end to allow for look-ahead
@@ -51,6 +51,7 @@
 
 #include "lib_battery_powerflow.h"
 #include "lib_battery.h"
+#include "lib_battery_dispatch_opt.h"
 #include "lib_utility_rate.h"
 
 #ifndef __LIB_BATTERY_DISPATCH_H__
@@ -69,7 +70,7 @@ class dispatch_t
 public:
 
 	enum FOM_MODES { FOM_LOOK_AHEAD, FOM_LOOK_BEHIND, FOM_FORECAST, FOM_CUSTOM_DISPATCH, FOM_MANUAL };
-	enum BTM_MODES { LOOK_AHEAD, LOOK_BEHIND, MAINTAIN_TARGET, CUSTOM_DISPATCH, MANUAL };
+	enum BTM_MODES { LOOK_AHEAD, LOOK_BEHIND, MAINTAIN_TARGET, CUSTOM_DISPATCH, MANUAL, OPTIMIZED_LOOK_AHEAD };
 	enum METERING { BEHIND, FRONT };
 	enum PV_PRIORITY { MEET_LOAD, CHARGE_BATTERY };
 	enum CURRENT_CHOICE { RESTRICT_POWER, RESTRICT_CURRENT, RESTRICT_BOTH };
@@ -168,12 +169,12 @@ protected:
 	// Controllers
 	virtual	void SOC_controller();
 	void switch_controller();
-	double current_controller(double battery_voltage);
+	double current_controller();
 	bool restrict_current(double &I);
 	bool restrict_power(double &I);
 
 	battery_t * _Battery;
-	battery_t * _Battery_initial;
+	battery_state _Battery_initial;		// battery state at the start of the step, restored to iterate
 
 	double _dt_hour;
 
@@ -367,8 +368,8 @@ public:
 	/*! Compute the updated power to send to the battery over the next N hours */
 	virtual void update_dispatch(size_t hour_of_year, size_t step, size_t idx)=0;
 
-	/*! Pass in the PV power forecast */
-	virtual void update_pv_data(std::vector<double> P_pv_dc);
+	/*! Pass in the PV power forecast, which is held by reference and must outlive the dispatch */
+	virtual void update_pv_data(const double_vec & P_pv_dc);
 
 	/*! Pass in the user-defined dispatch power vector */
 	virtual void set_custom_dispatch(std::vector<double> P_batt_dc);
@@ -384,8 +385,8 @@ protected:
 	/*! Return the dispatch mode */
 	int get_mode();
 
-	/*! Full time-series of PV production [kW] */
-	double_vec _P_pv_dc;		
+	/*! Full time-series of PV production [kW], not owned */
+	const double_vec * _P_pv_dc;
 	
 	/*! The index of the current day (hour * steps_per_hour + step) */
 	size_t _day_index;				
@@ -488,6 +489,9 @@ public:
 	/*! Pass in the grid power target vector */
 	void set_target_power(std::vector<double> P_target);
 
+	/*! Set the utility rate and solve-time budget per day [s] for the optimized look ahead */
+	void setup_rate_optimization(UtilityRate * utilityRate, double time_limit_seconds);
+
 	/*! Target power outputs */
 	double power_grid_target(){ return _P_target_current; };
 	double power_batt_target() { return m_batteryPower->powerBattery; };
@@ -506,6 +510,8 @@ protected:
 	void target_power(FILE*p, bool debug, double E_max, size_t idx);
 	void set_battery_power(FILE *p, bool debug);
 	void check_new_month(size_t hour_of_year, size_t step);
+	bool optimize_dispatch(size_t hour_of_year, size_t idx);
+	void update_peak_demand(size_t hour_of_year);
 
 	/*! Full time-series of loads [kW] */
 	double_vec _P_load_dc;
@@ -527,6 +533,15 @@ protected:
 
 	/* Vector of length (24 hours * steps_per_hour) containing sorted grid calculation [P_grid, hour, step] */
 	grid_vec sorted_grid;
+
+	/*! Utility rate information for the optimized look ahead */
+	std::unique_ptr<UtilityRateCalculator> m_utilityRateCalculator;
+
+	/*! Optimization of each look ahead window, warm started from the previous one */
+	dispatch_opt_lp m_dispatchOpt;
+
+	/*! The month-to-date peak grid demand, flat charge first then by demand period [kW] */
+	std::vector<double> m_peakDemand;
 };
 
 /*! Automated Front of Meter DC-connected battery dispatch */
@@ -594,7 +609,7 @@ public:
 	void update_dispatch(size_t hour_of_year, size_t step, size_t idx);
 
 	/// Update cliploss data
-	void update_cliploss_data(double_vec P_cliploss);
+	void update_cliploss_data(const double_vec & P_cliploss);
 
 	/*! Calculate the cost to cycle */
 	void costToCycle();
@@ -606,6 +621,15 @@ protected:
 	
 	void init_with_pointer(const dispatch_automatic_front_of_meter_t* tmp);
 	void setup_cost_vector(util::matrix_t<size_t> ppa_weekday_schedule, util::matrix_t<size_t> ppa_weekend_schedule);
+	void setup_forecast_days();
+
+	/*! Forecast prices for each hour of a day, which don't change from year to year */
+	struct forecast_day
+	{
+		double ppa_cost[24];			///< PPA price at the hour
+		double ppa_cost_max[24];		///< Highest PPA price over the look ahead from the hour
+		double usage_cost[24];			///< Cost to purchase electricity at the hour
+	};
 
 	/*! Full clipping loss due to AC power limits vector */
 	double_vec _P_cliploss_dc;
@@ -617,6 +641,9 @@ protected:
 	std::vector<double> _ppa_factors;
 	std::vector<double> _ppa_cost_vector;
 
+	/*! Forecast prices by day of year, computed once for all years */
+	std::vector<forecast_day> _forecast_days;
+
 	/*! Utility rate information */
 	std::unique_ptr<UtilityRateCalculator> m_utilityRateCalculator;
 
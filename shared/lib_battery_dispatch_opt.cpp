@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+
+#include "lp_lib.h"
+#include "lib_battery_dispatch_opt.h"
+
+namespace
+{
+	/// Columns at each step: battery charge, battery discharge, grid import, grid export, energy at the end of the step
+	enum { COL_CHARGE, COL_DISCHARGE, COL_IMPORT, COL_EXPORT, COL_ENERGY, COLS_PER_STEP };
+
+	/// Cost per kWh through the battery, so it doesn't charge and discharge in the same step when that costs nothing ($/kWh)
+	const double cycle_penalty = 1e-4;
+}
+
+dispatch_opt_lp::dispatch_opt_lp(double time_limit_seconds)
+{
+	set_time_limit(time_limit_seconds);
+}
+
+void dispatch_opt_lp::set_time_limit(double seconds)
+{
+	m_timeout = std::max(1L, static_cast<long>(std::ceil(seconds)));
+}
+
+bool dispatch_opt_lp::solve(const dispatch_opt_window & w, std::vector<double> & P_battery, std::vector<double> & P_grid)
+{
+	int nt = static_cast<int>(w.P_net.size());
+	size_t n_groups = w.tier_peak.size();
+
+	// demand tier segments follow the step columns, one run of columns per group
+	int ncols = nt * COLS_PER_STEP;
+	std::vector<int> group_col(n_groups, 0);
+	for (size_t j = 0; j != n_groups; j++)
+	{
+		group_col[j] = ncols + 1;
+		ncols += static_cast<int>(w.tier_peak[j].size());
+	}
+
+	// a tier cheaper than the one below is non-convex, order the two with a binary
+	std::vector<std::pair<size_t, size_t>> ordered;
+	for (size_t j = 0; j != n_groups; j++)
+	{
+		for (size_t k = 0; k + 1 < w.tier_charge[j].size(); k++)
+		{
+			if (w.tier_charge[j][k + 1] < w.tier_charge[j][k])
+				ordered.push_back(std::make_pair(j, k));
+		}
+	}
+	int binary_col = ncols + 1;
+	ncols += static_cast<int>(ordered.size());
+
+	// the largest grid demand possible in the window, bounds the open-ended tiers where binaries need it
+	double P_demand_max = 1.;
+	for (int t = 0; t != nt; t++)
+		P_demand_max = std::max(P_demand_max, w.P_net[t]);
+	if (w.can_grid_charge)
+		P_demand_max += w.P_charge_max / w.eta_charge;
+	for (size_t j = 0; j != w.peak_to_date.size(); j++)
+		P_demand_max = std::max(P_demand_max, w.peak_to_date[j]);
+
+	lprec *lp = make_lp(0, ncols);
+	if (lp == NULL)
+		return false;
+
+	std::vector<REAL> row(ncols + 1, 0.);
+	std::vector<int> col(ncols + 1, 0);
+
+	// objective: energy charges, demand charges, less the value of the energy left at the end of the window
+	double price_min = 1e30;
+	for (int t = 0; t != nt; t++)
+		price_min = std::min(price_min, w.price_buy[t]);
+
+	int n = 0;
+	for (int t = 0; t != nt; t++)
+	{
+		int c0 = t * COLS_PER_STEP + 1;
+		col[n] = c0 + COL_CHARGE;		row[n++] = cycle_penalty * w.dt_hour;
+		col[n] = c0 + COL_DISCHARGE;	row[n++] = cycle_penalty * w.dt_hour;
+		col[n] = c0 + COL_IMPORT;		row[n++] = w.price_buy[t] * w.dt_hour;
+		col[n] = c0 + COL_EXPORT;		row[n++] = -w.price_sell[t] * w.dt_hour;
+	}
+	col[n] = (nt - 1) * COLS_PER_STEP + 1 + COL_ENERGY;
+	row[n++] = -price_min * w.eta_discharge;
+
+	for (size_t j = 0; j != n_groups; j++)
+	{
+		for (size_t k = 0; k != w.tier_charge[j].size(); k++)
+		{
+			col[n] = group_col[j] + static_cast<int>(k);
+			row[n++] = w.tier_charge[j][k];
+		}
+	}
+	set_obj_fnex(lp, n, &row[0], &col[0]);
+	set_minim(lp);
+
+	set_add_rowmode(lp, TRUE);
+
+	for (int t = 0; t != nt; t++)
+	{
+		int c0 = t * COLS_PER_STEP + 1;
+		double P_surplus = std::max(-w.P_net[t], 0.);
+		double P_deficit = std::max(w.P_net[t], 0.);
+
+		// discharge only serves the load, charge comes from PV unless the grid is allowed
+		double P_charge_max = w.can_grid_charge ? w.P_charge_max : std::min(w.P_charge_max, P_surplus * w.eta_charge);
+		set_upbo(lp, c0 + COL_CHARGE, P_charge_max);
+		set_upbo(lp, c0 + COL_DISCHARGE, std::min(w.P_discharge_max, P_deficit / w.eta_discharge));
+		set_upbo(lp, c0 + COL_ENERGY, w.E_max);
+
+		// power balance on the AC bus
+		col[0] = c0 + COL_IMPORT;		row[0] = 1.;
+		col[1] = c0 + COL_EXPORT;		row[1] = -1.;
+		col[2] = c0 + COL_CHARGE;		row[2] = -1. / w.eta_charge;
+		col[3] = c0 + COL_DISCHARGE;	row[3] = w.eta_discharge;
+		add_constraintex(lp, 4, &row[0], &col[0], EQ, w.P_net[t]);
+
+		// stored energy
+		col[0] = c0 + COL_ENERGY;		row[0] = 1.;
+		col[1] = c0 + COL_CHARGE;		row[1] = -w.dt_hour;
+		col[2] = c0 + COL_DISCHARGE;	row[2] = w.dt_hour;
+		if (t == 0)
+			add_constraintex(lp, 3, &row[0], &col[0], EQ, w.E_initial);
+		else
+		{
+			col[3] = c0 - COLS_PER_STEP + COL_ENERGY;	row[3] = -1.;
+			add_constraintex(lp, 4, &row[0], &col[0], EQ, 0.);
+		}
+
+		// grid import sets the peak of the flat group and of the step's demand period
+		for (size_t j = 0; j != n_groups; j++)
+		{
+			if (w.tier_peak[j].empty() || (j != 0 && j != w.demand_period[t]))
+				continue;
+
+			n = 0;
+			col[n] = c0 + COL_IMPORT;	row[n++] = 1.;
+			for (size_t k = 0; k != w.tier_peak[j].size(); k++)
+			{
+				col[n] = group_col[j] + static_cast<int>(k);
+				row[n++] = -1.;
+			}
+			add_constraintex(lp, n, &row[0], &col[0], LE, 0.);
+		}
+	}
+
+	// tier widths, and the peak already set this month is paid regardless
+	for (size_t j = 0; j != n_groups; j++)
+	{
+		double peak_below = 0.;
+		n = 0;
+		for (size_t k = 0; k != w.tier_peak[j].size(); k++)
+		{
+			if (k + 1 < w.tier_peak[j].size())
+				set_upbo(lp, group_col[j] + static_cast<int>(k), std::max(w.tier_peak[j][k] - peak_below, 0.));
+			peak_below = w.tier_peak[j][k];
+
+			col[n] = group_col[j] + static_cast<int>(k);
+			row[n++] = 1.;
+		}
+		if (n > 0 && j < w.peak_to_date.size())
+			add_constraintex(lp, n, &row[0], &col[0], GE, w.peak_to_date[j]);
+	}
+
+	// the tier above may only be used once the tier below is full
+	for (size_t b = 0; b != ordered.size(); b++)
+	{
+		size_t j = ordered[b].first;
+		size_t k = ordered[b].second;
+		int z = binary_col + static_cast<int>(b);
+		int s = group_col[j] + static_cast<int>(k);
+		double width = w.tier_peak[j][k] - (k > 0 ? w.tier_peak[j][k - 1] : 0.);
+		double width_above = (k + 2 < w.tier_peak[j].size()) ? w.tier_peak[j][k + 1] - w.tier_peak[j][k] : P_demand_max;
+
+		set_binary(lp, z, TRUE);
+
+		col[0] = s;		row[0] = 1.;
+		col[1] = z;		row[1] = -width;
+		add_constraintex(lp, 2, &row[0], &col[0], GE, 0.);
+
+		col[0] = s + 1;	row[0] = 1.;
+		col[1] = z;		row[1] = -width_above;
+		add_constraintex(lp, 2, &row[0], &col[0], LE, 0.);
+	}
+
+	set_add_rowmode(lp, FALSE);
+
+	set_verbose(lp, 0);
+	set_timeout(lp, m_timeout);
+
+	// warm start from the previous window when the problem has the same shape
+	if (m_basis.size() == static_cast<size_t>(1 + get_Nrows(lp) + get_Ncolumns(lp)))
+	{
+		if (!set_basis(lp, &m_basis[0], TRUE))
+			default_basis(lp);
+	}
+
+	int ret = ::solve(lp);
+	bool return_ok = ret == OPTIMAL || ret == SUBOPTIMAL;
+
+	if (return_ok)
+	{
+		std::vector<REAL> vars(ncols, 0.);
+		get_variables(lp, &vars[0]);
+
+		P_battery.resize(nt);
+		P_grid.resize(nt);
+		for (int t = 0; t != nt; t++)
+		{
+			int c0 = t * COLS_PER_STEP;
+			P_battery[t] = vars[c0 + COL_DISCHARGE] - vars[c0 + COL_CHARGE];
+			P_grid[t] = vars[c0 + COL_IMPORT] - vars[c0 + COL_EXPORT];
+		}
+
+		m_basis.resize(1 + get_Nrows(lp) + get_Ncolumns(lp));
+		if (!get_basis(lp, &m_basis[0], TRUE))
+			m_basis.clear();
+	}
+	else
+		m_basis.clear();
+
+	delete_lp(lp);
+	return return_ok;
+}
@@ -0,0 +1,57 @@
+#ifndef __LIB_BATTERY_DISPATCH_OPT_H__
+#define __LIB_BATTERY_DISPATCH_OPT_H__
+
+#include <vector>
+
+/**
+* Inputs for one behind-the-meter look-ahead window.  Demand charges are grouped: group 0 is the flat
+* monthly charge which applies at every step, groups 1..n are the time-of-use demand periods.
+*/
+struct dispatch_opt_window
+{
+	double dt_hour;							///< The timestep in hours
+	std::vector<double> P_net;				///< The load less PV at each step, > 0 is drawn from the grid (kW)
+	std::vector<double> price_buy;			///< The energy buy rate at each step ($/kWh)
+	std::vector<double> price_sell;			///< The energy sell rate at each step ($/kWh)
+	std::vector<size_t> demand_period;		///< The time-of-use demand period at each step, 0 if none
+
+	std::vector<std::vector<double>> tier_peak;		///< The upper peak demand of each tier by group (kW)
+	std::vector<std::vector<double>> tier_charge;	///< The demand charge of each tier by group ($/kW)
+	std::vector<double> peak_to_date;				///< The month-to-date peak grid demand by group (kW)
+
+	double E_max;							///< The energy between the minimum and maximum state of charge (kWh)
+	double E_initial;						///< The energy above the minimum state of charge at the start of the window (kWh)
+	double P_charge_max;					///< The maximum battery charge power (kW)
+	double P_discharge_max;					///< The maximum battery discharge power (kW)
+	double eta_charge;						///< The conversion efficiency from the AC bus into the battery (0 - 1)
+	double eta_discharge;					///< The conversion efficiency from the battery to the AC bus (0 - 1)
+	bool can_grid_charge;					///< Whether the battery may charge from the grid
+};
+
+/**
+* Linear program which minimizes the energy and demand charges over a look-ahead window.
+* Tiered demand charges are modeled as segments, with a binary ordering variable only where a
+* tier is cheaper than the one below it, so most rates solve as a pure LP.  The final basis of
+* each window is kept to warm start the next window with the same problem shape.
+*/
+class dispatch_opt_lp
+{
+public:
+	dispatch_opt_lp(double time_limit_seconds = 1.);
+
+	/// Set the solve-time budget per window [s].  lpsolve takes whole seconds, so the budget is rounded up, to at least 1 s
+	void set_time_limit(double seconds);
+
+	/// Solve the window, return false if no solution was found.  P_grid > 0 imports (kW).  P_battery > 0 discharges, and is
+	/// the power at the battery terminals (kW), so it reaches the AC bus after eta_discharge or is drawn as P_battery / eta_charge
+	bool solve(const dispatch_opt_window & window, std::vector<double> & P_battery, std::vector<double> & P_grid);
+
+protected:
+	/// The final basis of the previous window
+	std::vector<int> m_basis;
+
+	/// The solve-time budget per window, in the whole seconds set_timeout takes [s]
+	long m_timeout;
+};
+
+#endif
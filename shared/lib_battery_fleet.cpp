@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include "lib_battery.h"
+#include "lib_battery_fleet.h"
+
+namespace
+{
+	/// Exposes the KiBaM constants capacity_kibam_t fits from the rated capacities
+	class kibam_parameters_t : public capacity_kibam_t
+	{
+	public:
+		kibam_parameters_t(double q20, double t1, double q1, double q10, double SOC_init, double SOC_max, double SOC_min) :
+			capacity_kibam_t(q20, t1, q1, q10, SOC_init, SOC_max, SOC_min){}
+		double c() const { return _c; }
+		double k() const { return _k; }
+	};
+}
+
+battery_fleet_t::battery_fleet_t(size_t n, double dt_hour, double V_nominal, double q, double SOC_init, double SOC_max, double SOC_min)
+{
+	m_chem = LITHIUM_ION;
+	m_c = 0.;
+	m_k = 0.;
+	m_exp_kdt = 1.;
+	m_denom_kdt = 0.;
+	initialize(n, dt_hour, V_nominal, q, SOC_init, SOC_max, SOC_min);
+}
+
+battery_fleet_t::battery_fleet_t(size_t n, double dt_hour, double V_nominal, double q20, double t1, double q1, double q10,
+	double SOC_init, double SOC_max, double SOC_min)
+{
+	kibam_parameters_t kibam(q20, t1, q1, q10, SOC_init, SOC_max, SOC_min);
+
+	m_chem = LEAD_ACID;
+	m_c = kibam.c();
+	m_k = kibam.k();
+	m_exp_kdt = exp(-m_k*dt_hour);
+	m_denom_kdt = 1 - m_exp_kdt + m_c*(m_k*dt_hour - 1 + m_exp_kdt);
+	initialize(n, dt_hour, V_nominal, kibam.qmax(), SOC_init, SOC_max, SOC_min);
+
+	// charge starts split between the available and bound wells as capacity_kibam_t splits it
+	m_q0.assign(n, kibam.q0());
+	m_q1.assign(n, kibam.q1());
+	m_q2.assign(n, kibam.q2());
+}
+
+void battery_fleet_t::initialize(size_t n, double dt_hour, double V_nominal, double q, double SOC_init, double SOC_max, double SOC_min)
+{
+	m_n = n;
+	m_dt_hour = dt_hour;
+	m_V_nominal = V_nominal;
+	m_qmax = q;
+	m_SOC_max = SOC_max;
+	m_SOC_min = SOC_min;
+	m_I_charge_max = 1e38;
+	m_I_discharge_max = 1e38;
+
+	m_q0.assign(n, 0.01*SOC_init*q);
+	m_SOC.assign(n, SOC_init);
+	m_I.assign(n, 0.);
+}
+
+void battery_fleet_t::set_current_limits(double I_charge_max, double I_discharge_max)
+{
+	m_I_charge_max = I_charge_max;
+	m_I_discharge_max = I_discharge_max;
+}
+
+void battery_fleet_t::run(const double * P_target, double * P_battery)
+{
+	double q_upper = m_qmax * m_SOC_max * 0.01;
+	double q_lower = m_qmax * m_SOC_min * 0.01;
+	double A_per_kW = util::kilowatt_to_watt / m_V_nominal;
+	double per_hour = 1. / m_dt_hour;
+	const double * q0 = m_q0.data();
+	double * I = m_I.data();
+
+	// the current for each target within the current limits and the charge left before the state-of-charge limits,
+	// without branches so the loop vectorizes
+	for (size_t i = 0; i != m_n; i++)
+	{
+		double I_i = P_target[i] * A_per_kW;
+		I_i = std::max(-m_I_charge_max, std::min(I_i, m_I_discharge_max));
+		I_i = std::min(I_i, std::max((q0[i] - q_lower) * per_hour, 0.));
+		I_i = std::max(I_i, std::min((q0[i] - q_upper) * per_hour, 0.));
+		I[i] = I_i;
+	}
+
+	update_capacity(I);
+
+	for (size_t i = 0; i != m_n; i++)
+		P_battery[i] = I[i] * m_V_nominal * util::watt_to_kilowatt;
+}
+
+void battery_fleet_t::update_capacity(double * I)
+{
+	if (m_chem == LEAD_ACID)
+		update_capacity_kibam(I);
+	else
+		update_capacity_lithium_ion(I);
+
+	if (I != m_I.data())
+		std::copy(I, I + m_n, m_I.begin());
+}
+
+void battery_fleet_t::update_capacity_lithium_ion(double * I)
+{
+	// capacity_lithium_ion_t::updateCapacity, check_SOC, and update_SOC, at full thermal capacity
+	double q_upper = m_qmax * m_SOC_max * 0.01;
+	double q_lower = m_qmax * m_SOC_min * 0.01;
+	double * q0 = m_q0.data();
+	double * SOC = m_SOC.data();
+
+	for (size_t i = 0; i != m_n; i++)
+	{
+		double I_orig = I[i];
+		double q0_i = q0[i] - I_orig*m_dt_hour;
+
+		// the charge beyond either limit is taken back out of the current, unless that reverses it,
+		// written as selects rather than branches so the loop vectorizes
+		double dq = (q0_i > q_upper ? q0_i - q_upper : (q0_i < q_lower ? q0_i - q_lower : 0.));
+		double I_i = I_orig + dq / m_dt_hour;
+		I_i = (I_i / I_orig < 0 ? 0. : I_i);
+		I_i = (dq != 0. && fabs(I_orig) > tolerance ? I_i : I_orig);
+		q0_i = std::min(std::max(q0_i, q_lower), q_upper);
+
+		double SOC_i = (m_qmax > 0 ? 100.*(q0_i / m_qmax) : 0.);
+		SOC[i] = std::max(0., std::min(SOC_i, 100.));
+		q0[i] = q0_i;
+		I[i] = I_i;
+	}
+}
+
+void battery_fleet_t::update_capacity_kibam(double * I)
+{
+	// capacity_kibam_t::updateCapacity and update_SOC, at full thermal capacity
+	double dt = m_dt_hour;
+	double e = m_exp_kdt;
+	double * q0 = m_q0.data();
+	double * q1 = m_q1.data();
+	double * q2 = m_q2.data();
+	double * SOC = m_SOC.data();
+
+	for (size_t i = 0; i != m_n; i++)
+	{
+		double I_i = I[i];
+		if (fabs(I_i) < low_tolerance)
+			I_i = 0;
+
+		// the largest current the available well supports over the step
+		if (I_i > 0)
+		{
+			double Idmax = (m_k*q1[i] * e + q0[i] * m_k*m_c*(1 - e)) / m_denom_kdt;
+			I_i = fmin(I_i, Idmax);
+		}
+		else if (I_i < 0)
+		{
+			double Icmax = (-m_k*m_c*m_qmax + m_k*q1[i] * e + q0[i] * m_k*m_c*(1 - e)) / m_denom_kdt;
+			I_i = -fmin(fabs(I_i), fabs(Icmax));
+		}
+
+		// new charge levels
+		double q1_i = q1[i] * e + (q0[i] * m_k*m_c - I_i)*(1 - e) / m_k - I_i*m_c*(m_k*dt - 1 + e) / m_k;
+		double q2_i = q2[i] * e + q0[i] * (1 - m_c)*(1 - e) - I_i*(1 - m_c)*(m_k*dt - 1 + e) / m_k;
+
+		if (q1_i + q2_i > m_qmax)
+		{
+			double q0_i = q1_i + q2_i;
+			double p1 = q1_i / q0_i;
+			double p2 = q2_i / q0_i;
+			q1_i = m_qmax*p1;
+			q2_i = m_qmax*p2;
+		}
+
+		q1[i] = q1_i;
+		q2[i] = q2_i;
+		q0[i] = q1_i + q2_i;
+
+		double SOC_i = (m_qmax > 0 ? 100.*(q0[i] / m_qmax) : 0.);
+		SOC[i] = std::max(0., std::min(SOC_i, 100.));
+		I[i] = I_i;
+	}
+}
+
+double battery_fleet_t::q0_total() const
+{
+	double q = 0.;
+	for (size_t i = 0; i != m_n; i++)
+		q += m_q0[i];
+	return q;
+}
@@ -0,0 +1,77 @@
+#ifndef __LIB_BATTERY_FLEET_H__
+#define __LIB_BATTERY_FLEET_H__
+
+#include <vector>
+
+/**
+* A fleet of identical batteries, each with its own load, PV, and dispatch target.  The state of the
+* fleet is stored as one array per variable rather than as a battery_t per unit, and each step applies
+* the capacity_lithium_ion_t or capacity_kibam_t update across the arrays in one loop, with the
+* constants of the step computed once for the fleet.
+*
+* Power is converted to current at the nominal voltage.  The thermal, lifetime, and loss models
+* are not run, so capacity stays at its rated value.
+*/
+class battery_fleet_t
+{
+public:
+	enum CHEMS{ LEAD_ACID, LITHIUM_ION };
+
+	/// A fleet of lithium ion batteries of capacity q (Ah)
+	battery_fleet_t(size_t n, double dt_hour, double V_nominal, double q, double SOC_init, double SOC_max, double SOC_min);
+
+	/// A fleet of lead acid batteries with the KiBaM parameters of capacity_kibam_t
+	battery_fleet_t(size_t n, double dt_hour, double V_nominal, double q20, double t1, double q1, double q10,
+		double SOC_init, double SOC_max, double SOC_min);
+
+	/// Limit the current of every battery, the charge limit as a positive number (A)
+	void set_current_limits(double I_charge_max, double I_discharge_max);
+
+	/// Move each battery toward its power target P_target, > 0 discharging (kW).  P_battery returns the power delivered (kW)
+	void run(const double * P_target, double * P_battery);
+
+	/// Step the capacity of each battery with current I, > 0 discharging (A), which returns the current the battery took
+	void update_capacity(double * I);
+
+	/// Number of batteries in the fleet
+	size_t size() const { return m_n; }
+
+	/// Per battery state: charge (Ah), state of charge (%), and current of the last step (A)
+	const std::vector<double> & q0() const { return m_q0; }
+	const std::vector<double> & SOC() const { return m_SOC; }
+	const std::vector<double> & I() const { return m_I; }
+
+	/// The charge of every battery (Ah)
+	double q0_total() const;
+
+protected:
+
+	void initialize(size_t n, double dt_hour, double V_nominal, double q, double SOC_init, double SOC_max, double SOC_min);
+	void update_capacity_lithium_ion(double * I);
+	void update_capacity_kibam(double * I);
+
+	int m_chem;
+	size_t m_n;
+	double m_dt_hour;
+	double m_V_nominal;		// [V]
+	double m_qmax;			// [Ah]
+	double m_SOC_max;		// [%]
+	double m_SOC_min;		// [%]
+	double m_I_charge_max;	// [A]
+	double m_I_discharge_max;	// [A]
+
+	// KiBaM constants, and the terms of the step which depend only on them and the step length
+	double m_c;
+	double m_k;
+	double m_exp_kdt;		// exp(-k*dt)
+	double m_denom_kdt;		// 1 - exp(-k*dt) + c*(k*dt - 1 + exp(-k*dt))
+
+	// state, one entry per battery
+	std::vector<double> m_q0;	// [Ah] - total charge
+	std::vector<double> m_q1;	// [Ah] - available charge, KiBaM
+	std::vector<double> m_q2;	// [Ah] - bound charge, KiBaM
+	std::vector<double> m_SOC;	// [%]
+	std::vector<double> m_I;	// [A]
+};
+
+#endif
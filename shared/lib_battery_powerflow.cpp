@@ -24,6 +24,7 @@ BatteryPower::BatteryPower(double dtHour) :
 		powerBatteryDischargeMax(0),
 		powerSystemLoss(0),
 		powerConversionLoss(0),
+		voltageSystem(0),
 		connectionMode(0),
 		singlePointEfficiencyACToDC(0.96),
 		singlePointEfficiencyDCToAC(0.96), 
@@ -187,14 +187,10 @@ bool cec6par_module_t::operator() ( pvinput_t &input, double TcellC, double opvo
 bool noct_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double , double &Tcell )
 {
 	double G_total, Geff_total;
-	double tau_al = fabs(TauAlpha);
 
 	double theta_z = input.Zenith;
 	if (theta_z > 86.0) theta_z = 86.0; // !Zenith angle must be < 90 (?? why 86?)
 	if (theta_z < 0) theta_z = 0; // Zenith angle must be >= 0
-	
-	double W_spd = input.Wspd;
-	if (W_spd < 0.001) W_spd = 0.001;
 
 	if( input.radmode != 3){ // Determine if the model needs to skip the cover effects (will only be skipped if the user is using POA reference cell data) 
 		G_total = input.Ibeam + input.Idiff + input.Ignd; // total incident irradiance on tilted surface, W/m2
@@ -207,9 +203,6 @@ bool noct_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 			input.Ibeam,
 			input.Idiff,
 			input.Ignd );
-
-		if (G_total > 0)
-			tau_al *= Geff_total/G_total;
 			
 		// !Calculation of Air Mass Modifier
 		Geff_total *= air_mass_modifier( theta_z, input.Elev, amavec );	
@@ -223,8 +216,6 @@ bool noct_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 
 	}
 
-	// TODO - shouldn't tau_al above include AM correction below?
-	
 	if (Geff_total > 0)
 	{
 		double Imp = module.ImpRef();
@@ -232,13 +223,12 @@ bool noct_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 		double Area = module.AreaRef();
 
 		// calculate cell temperature, kelvin
-		//double G_total = input.Ibeam + input.Idiff + input.Ignd;		
 		double eff_ref = Imp *Vmp / ( I_ref*Area );
-		double tau_al = fabs(TauAlpha);  // Sev: What's the point of recalculating this??
+		double tau_al = fabs(TauAlpha);
+		if (G_total > 0) tau_al *= Geff_total/G_total; // includes the air mass modifier
 
 		double W_spd = input.Wspd * ffv_wind; //added 1/11/12 to account for FFV_wind correction factor internally
 		if (W_spd < 0.001) W_spd = 0.001;		
-		if (G_total > 0) tau_al *= Geff_total/G_total;		
 
 		double Tnoct_adj = Tnoct + standoff_tnoct_adj; // added 1/11/12 for adjustment to NOCT as in the CECPV calculator based on standoff height, used in eqn below.
 		Tcell = (input.Tdry+273.15) + (G_total/I_noct * (Tnoct_adj - Tamb_noct) * (1.0-eff_ref/tau_al))*9.5/(5.7 + 3.8*W_spd);
@@ -259,51 +249,50 @@ bool noct_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 
 
 // !*****************************************************************
-static double free_convection_194( double TC, double TA, double SLOPE, double rho_air, 
-	double Pr_air, double mu_air, double Area, double Length, double Width, double k_air)
+// Prandtl number dependent constants of the free convection correlations
+static const double C_lam_194 = 0.671/pow(1. + pow(0.492/Pr_air, 9./16.) , 4./9.); //  !Eq. 6-49 (Nellis&Klein)
+static const double C_turb_194 = 0.14*((1.+0.0107*Pr_air)/(1.+0.01*Pr_air)); // !Eq. 6-58 (Nellis&Klein)
+static const double C_vert_194 = pow(1+ pow(0.492/Pr_air, 9./16.), (8./27.)); // !(Incropera et al.,2006)
+static const double C_down_194 = pow(1.+pow(1.9/Pr_air,0.9),2./9.); //    !Eq. 6-59  (Nellis&Klein)
+static const double Pr_air_13 = cbrt(Pr_air);
+
+static double free_convection_194( double TC, double TA, double cos_slope, double sin_slope, double rho_air, 
+	double L_ch_f, double L_ch_f3, double Length, double Length3 )
 {      
 // !Function added by TN (2010)
 // !Solution for free convection coefficienet as presented in Nellis and Klein (2008) and EES
+// Characteristic lengths (L_ch_f = Area/(2*(Length+Width)), Eq. 6-54 Nellis&Klein) and their cubes are precomputed by the caller
 	 
-	double L_ch_f,nu,Beta,g_spec,Gr,Ra,C_lam,Nu_lam,C_turb,Nu_turb,Nu_bar,h_up,h_vert,h_down;
+	double nu,Beta,Gr_L3,Ra,Nu_lam,Nu_turb,Nu_bar,h_up,h_vert,h_down;
 	static const double grav = 9.81;
 
-	L_ch_f    = Area/(2.*(Length+Width));//  !Eq. 6-54 (Nellis&Klein)
-
-	if (TA > TC) SLOPE = 180.0 - SLOPE;
+	if (TA > TC) cos_slope = -cos_slope; // SLOPE = 180 - SLOPE
 
 	// !Properties Constant for Each Plate Scenario
 	nu        = mu_air / rho_air; //          !Kinematic Viscosity
 	Beta      = 1. / ((TA+TC)/2.); //         !volumetric coefficient of thermal expansion
+	Gr_L3     = grav*Beta*fabs(TC-TA)/(nu*nu); // Grashof number per unit length cubed, before adjustment of the gravity vector
 
 	// !Horizontal Heated Upward Facing Plate (L_ch_f)
 	// !OR Cooled Downward Facing Plate
-	g_spec    = grav*MAX(0.,cosd(SLOPE));//  !Adjustment of gravity vector;
-	Gr        = g_spec*Beta*fabs(TC-TA)*pow(L_ch_f,3)/pow(nu,2); //    !Grashof Number
-	Ra        = MAX(0.0001,Gr*Pr_air); //                 !Rayleigh Number
-
-	C_lam     = 0.671/pow(1. + pow(0.492/Pr_air, 9./16.) , 4./9.); //  !Eq. 6-49 (Nellis&Klein)
-	Nu_lam    = 1.4/log(1.+(1.4/(0.835*C_lam*pow(Ra,0.25)))); // !Eq. 6-56 (Nellis&Klein)
-	C_turb    = 0.14*((1.+0.0107*Pr_air)/(1.+0.01*Pr_air)); // !Eq. 6-58 (Nellis&Klein)
-	Nu_turb   = C_turb*pow(Ra,1./3.); //        !Eq. 6-57  (Nellis&Klein)
+	Ra        = MAX(0.0001,MAX(0.,cos_slope)*Gr_L3*L_ch_f3*Pr_air); //                 !Rayleigh Number
+
+	Nu_lam    = 1.4/log(1.+(1.4/(0.835*C_lam_194*pow(Ra,0.25)))); // !Eq. 6-56 (Nellis&Klein)
+	Nu_turb   = C_turb_194*cbrt(Ra); //        !Eq. 6-57  (Nellis&Klein)
 	Nu_bar    = pow(pow(Nu_lam,10) + pow(Nu_turb,10.), (1./10.)); // !Eq. 6-55  (Nellis&Klein)
 	h_up      = Nu_bar*k_air/L_ch_f;
 
 	// !Vertical Plate (Length)
-	g_spec    = grav*sind(SLOPE);  //          !Adjustment of gravity vector
-	Gr        = g_spec*Beta*fabs(TC-TA)*pow(Length,3)/pow(nu,2);        
-	Ra        = MAX(0.0001,Gr*Pr_air);
+	Ra        = MAX(0.0001,sin_slope*Gr_L3*Length3*Pr_air);
 	
-	Nu_bar    = pow(0.825+(0.387*pow(Ra,(1./6.)))/pow(1+ pow(0.492/Pr_air, 9./16.), (8./27.)),2)  ;  // !(Incropera et al.,2006)
-	h_vert    = Nu_bar*k_air/Length;  
+	Nu_bar    = 0.825+(0.387*pow(Ra,(1./6.)))/C_vert_194;  // !(Incropera et al.,2006)
+	h_vert    = Nu_bar*Nu_bar*k_air/Length;  
 
 	// !Horizontal Heated Downward Facing Plate
 	// !OR Cooled Upward Facing Plate
-	g_spec    = grav*MAX(0.,-cosd(SLOPE));
-	Gr        = g_spec*Beta*fabs(TC-TA)*pow(L_ch_f,3)/pow(nu,2);
-	Ra        = MAX(0.0001,Gr*Pr_air);
+	Ra        = MAX(0.0001,MAX(0.,-cos_slope)*Gr_L3*L_ch_f3*Pr_air);
 
-	Nu_bar    = 2.5/log(1.+(2.5/(0.527*pow(Ra,0.2)))*pow(1.+pow(1.9/Pr_air,0.9),2./9.));//    !Eq. 6-59  (Nellis&Klein)
+	Nu_bar    = 2.5/log(1.+(2.5/(0.527*pow(Ra,0.2)))*C_down_194);//    !Eq. 6-59  (Nellis&Klein)
 	h_down    = Nu_bar*k_air/L_ch_f;
 
 	// !Take Maximum of 3 Calculated Heat Transfer Coefficients
@@ -320,7 +309,7 @@ static double ffd_194( double D_h, double Re_dh )
 	return pow( (-2.*log10(MAX(1.e-6,((2.*e/(7.54*D_h)-5.02/Re_dh*log10(2.*e/(7.54*D_h)+13./Re_dh)))))), -2.0 );
 }
 
-static double channel_free_194( double W_gap, double SLOPE, double TA, double T_cr, double k_air,
+static double channel_free_194( double W_gap, double sin_slope, double TA, double T_cr, double k_air,
 	double rho_air, double cp_air, double mu_air, double Length )
 {
 	// !Function added by TN (2010)
@@ -332,7 +321,7 @@ static double channel_free_194( double W_gap, double SLOPE, double TA, double T_
 
 	nu_air    = mu_air / rho_air; //          !Kinematic Viscosity 
 
-	g_spec    = MAX(0.1, sind(SLOPE)*grav);
+	g_spec    = MAX(0.1, sin_slope*grav);
 	Beta   	= 1./((T_cr+TA)/2.);
 	alpha 	= k_air / (rho_air * cp_air);
 	Ra	    = MAX(0.001,g_spec*pow(W_gap,3)*Beta*(T_cr-TA)/(nu_air*alpha));
@@ -341,15 +330,172 @@ static double channel_free_194( double W_gap, double SLOPE, double TA, double T_
 	return  Nu*k_air/W_gap;
 }
 
+static void cover_transmittance_194( double THETA, double &TransSurf, double &TransCoverAbs )
+{
+	double n2         = 1.526; //   !refractive index of glass
+
+	double RefrAng    = asind(sind(THETA)/n2);
+	TransSurf         = 1-0.5*( pow(sind(RefrAng-THETA),2)/pow(sind(RefrAng+THETA),2)
+			+ pow(tand(RefrAng-THETA),2)/pow(tand(RefrAng+THETA),2) );
+	TransCoverAbs     = exp(-k_trans*l_thick/cosd(RefrAng));
+}
+
+mcsp_celltemp_t::mcsp_celltemp_t()
+{
+	DcDerate = 1.0;
+	MC = 1;
+	HTD = 1;
+	MSO = 1;
+	Nrows = Ncols = 1;
+	Length = Width = Wgap = TbackInteg = std::numeric_limits<double>::quiet_NaN();
+	WarmStart = false;
+
+	m_cInit = false;
+	m_lastValid = false;
+	m_lastTC = m_lastPratio = 0;
+}
+
+void mcsp_celltemp_t::precompute( pvmodule_t &module, double tilt )
+{
+	constants &c = m_c;
+	c.area_base = module.AreaRef();
+	c.imp = module.ImpRef();
+	c.vmp = module.VmpRef();
+	c.mc_in = this->MC;
+	c.htd = HTD;
+	c.mso = MSO;
+	c.nrows_in = this->Nrows;
+	c.ncols_in = this->Ncols;
+	c.length_in = this->Length;
+	c.width_in = this->Width;
+	c.wgap = Wgap;
+	c.tilt = tilt;
+	c.valid = true;
+
+	c.Nrows = this->Nrows;
+	c.Ncols = this->Ncols;
+	c.Length = this->Length;
+	c.Width = this->Width;
+
+	if (HTD == 1)
+	{
+		c.Nrows = c.Ncols = 1;
+	}
+	else if (HTD == 2)
+	{
+		c.Length = c.Nrows*c.Length;
+		c.Width = c.Ncols*c.Width;
+	}
+
+	c.Area = c.area_base * c.Length * c.Width; // !Surface area of module
+	// !Define characteristic length
+	c.L_char = 4.0 * c.Length * c.Width / (2.0 * (c.Width + c.Length));
+	c.L_ch_f = c.Area/(2.*(c.Length+c.Width)); //  !Eq. 6-54 (Nellis&Klein)
+	c.L_ch_f3 = pow(c.L_ch_f,3);
+	c.Length3 = pow(c.Length,3);
+
+	c.MC = this->MC;
+	// !If gap is less than 1 mm, use flush mounting configuration
+	if (Wgap < 0.001 && c.MC == 4) c.MC = 2;
+
+	double R_gap = Wgap / c.Length;
+	if ( c.MC == 4  && R_gap > 1 && MSO == 1) c.MC = 1;
+
+	// !Guess power based on SRC efficiency and irradiance
+	if (c.MC == 5)
+		c.EFFREF = c.imp*c.vmp/(I_ref*c.area_base);   // !Efficiency of module at SRC conditions
+	else
+		c.EFFREF = c.imp*c.vmp/(I_ref*c.Area);   // !Efficiency of module at SRC conditions
+
+	c.A_c = c.L_charB = c.Per_cw = c.D_h = 0;
+	c.AR = 0;
+	if (c.MC == 4)
+	{
+		double L_str;
+		if ( MSO == 1)
+		{
+			// !Define channel length and width for gap mounting configuration that does not block air flow in any direction
+			// !Use minimum dimension for length so that MSO 1 will have lower temp than MSO 2 or 3
+			c.L_charB = MIN(c.Width, c.Length);
+			L_str   = MAX(c.Width, c.Length);
+				
+			// !These values are dependent on MSO
+			c.A_c        = Wgap * L_str;     // !Cross Sectional area of channel
+			c.Per_cw 	   = 2.*L_str;          // !Perimeter minus open sides
+			c.D_h 	   = (4.*c.A_c)/c.Per_cw;   // !Hydraulic diameter
+			c.AR = 1;
+		}
+		else if (MSO == 2) //  !Vertical supports
+		{
+			c.L_charB = c.Length;
+			L_str   = c.Width / c.Ncols;
+			c.A_c        = Wgap * L_str ; //         !Cross Sectional area of channel
+			c.Per_cw 	   = 2.*L_str + 2.*Wgap ; //   !Perimeter ACCOUNTING for supports: different than MSO 1
+			c.D_h 	   = (4.*c.A_c)/c.Per_cw ; //       !Hydraulic diameter
+			c.AR = c.Ncols;
+		}
+		else if (MSO == 3) // ! Horizontal supports
+		{
+			// !Flow is restricted to one direction.  Wind speed has already been adjusted using a cosine projection
+			c.L_charB = c.Width;
+			// !Width of channel is function of number of columns of modules.  Assuming that support structures are exactly the length of a module
+			L_str   = c.Length / c.Nrows;
+			c.A_c        = Wgap * L_str ; //         !Cross Sectional area of channel
+			c.Per_cw 	   = 2.*L_str + 2.*Wgap ; //   !Perimeter ACCOUNTING for supports: different than MSO 1
+			c.D_h 	   = (4.*c.A_c)/c.Per_cw ; //       !Hydraulic diameter
+			c.AR = c.Nrows;
+		}
+		else
+			c.valid = false; // invalid parameter specified
+	}
+
+	c.cos_tilt = cosd(tilt);
+	c.sin_tilt = sind(tilt);
+	c.Fcg        = (1. - c.cos_tilt)/2;  // !view factor between top of tilted plate and horizontal plane adjacent to bottom edge of plate
+	c.Fcs        = 1. - c.Fcg;              // !view factor between top of tilted plate and everything else (sky)
+	c.Fbs        = c.Fcg;                   // !view factor bewteen top and ground = bottom and sky
+	c.Fbg        = c.Fcs;                   // !view factor bewteen bottom and ground = top and sky
+
+	//!Evaluating transmittance at angle Normal to surface (0), use 1 to avoid probs.
+	double TransSurf2, TransCoverAbs2;
+	cover_transmittance_194( 1, TransSurf2, TransCoverAbs2 );
+	double tau2       = TransCoverAbs2*TransSurf2;
+	c.tau2 = tau2;
+
+	//!Evaluating transmittance at equivalent angle for diffuse 
+	double TransSurf3, TransCoverAbs3;
+	cover_transmittance_194( 59.7 - 0.1388*tilt  + 0.001497*pow(tilt,2), TransSurf3, TransCoverAbs3 );
+	c.TransCoverDiff = TransCoverAbs3;
+	c.TADIFF     = TransCoverAbs3*TransSurf3/tau2;
+
+	// !Evaluating transmittance at equivalent angle for ground reflected radiation 
+	cover_transmittance_194( 90.0 - 0.5788*tilt  + 0.002693*pow(tilt,2), TransSurf3, TransCoverAbs3 );
+	c.TransCoverGnd = TransCoverAbs3;
+	c.TAGND     = TransCoverAbs3*TransSurf3/tau2;
+
+	m_cInit = true;
+}
+
 bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double opvoltage, double &Tcell )
 {	
 
 	if ( input.Ibeam + input.Idiff + input.Ignd < 1 )
 	{
+		m_lastValid = false;
 		Tcell = input.Tdry;
 		return true;
 	}
 
+	double Area_base = module.AreaRef();
+	double Imp = module.ImpRef();
+	double Vmp = module.VmpRef();
+	if ( !m_cInit || m_c.tilt != input.Tilt || m_c.area_base != Area_base || m_c.imp != Imp || m_c.vmp != Vmp
+		|| m_c.mc_in != this->MC || m_c.htd != HTD || m_c.mso != MSO || m_c.nrows_in != this->Nrows || m_c.ncols_in != this->Ncols
+		|| m_c.length_in != this->Length || m_c.width_in != this->Width || m_c.wgap != Wgap )
+		precompute( module, input.Tilt );
+
+	const constants &c = m_c;
+
 	double THETAZ = input.Zenith;
 
 	if (THETAZ > 86.0) THETAZ = 86.0; // !Zenith angle must be < 90 degrees	  
@@ -358,130 +504,69 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 	double THETA = input.IncAng;
 	if (THETA < 0) THETA=1;
 
-	double n2         = 1.526; //   !refractive index of glass
-
-	double RefrAng1   = asind(sind(THETA)/n2);
-	double TransSurf1 = 1-0.5*( pow(sind(RefrAng1-THETA),2)/pow(sind(RefrAng1+THETA),2)
-			+ pow(tand(RefrAng1-THETA),2)/pow(tand(RefrAng1+THETA),2) );
-	double TransCoverAbs1 = exp(-k_trans*l_thick/cosd(RefrAng1));
-	double tau1       = TransCoverAbs1*TransSurf1;
-        
-	//!Evaluating transmittance at angle Normal to surface (0), use 1 to avoid probs.
-	double THETA2     = 1;
-	double RefrAng2   = asind(sind(THETA2)/n2);
-	double TransSurf2 = 1-0.5*( pow(sind(RefrAng2-1),2)/pow(sind(RefrAng2+1),2)
-		+ pow(tand(RefrAng2-1),2)/pow(tand(RefrAng2+1),2) );
-	double TransCoverAbs2 = exp(-k_trans*l_thick/cosd(RefrAng2));
-	double tau2       = TransCoverAbs2*TransSurf2;
-
-	//!Evaluating transmittance at equivalent angle for diffuse 
-	double THETA3 = 59.7 - 0.1388*input.Tilt  + 0.001497*pow(input.Tilt,2);
-	double RefrAng3   = asind(sind(THETA3)/n2);
-	double TransSurf3 = 1-.5*( pow(sind(RefrAng3-THETA3),2)/pow(sind(RefrAng3+THETA3),2)
-		+ pow(tand(RefrAng3-THETA3),2)/pow(tand(RefrAng3+THETA3),2) );
-	double TransCoverAbs3 = exp(-k_trans*l_thick/cosd(RefrAng3));
-	double TransCoverDiff = TransCoverAbs3;
-	double tau3       = TransCoverAbs3*TransSurf3;
-	double TADIR      = tau1/tau2;
-	double TADIFF     = tau3/tau2;
-//	double THETA3X	   = THETA3;
-
-	// !Evaluating transmittance at equivalent angle for ground reflected radiation 
-	THETA3 = 90.0 - 0.5788*input.Tilt  + 0.002693*pow(input.Tilt,2);
-	RefrAng3   = asind(sind(THETA3)/n2);
-	TransSurf3 = 1-.5*( pow(sind(RefrAng3-THETA3),2)/pow(sind(RefrAng3+THETA3),2)
-		+ pow(tand(RefrAng3-THETA3),2)/pow(tand(RefrAng3+THETA3),2) );
-	TransCoverAbs3 = exp(-k_trans*l_thick/cosd(RefrAng3));
-	tau3       = TransCoverAbs3*TransSurf3;
-	double TAGND     = tau3/tau2;
+	// transmittance at angle normal to the surface and for diffuse and ground reflected radiation depend only on tilt, see precompute()
+	double TransSurf1, TransCoverAbs1;
+	cover_transmittance_194( THETA, TransSurf1, TransCoverAbs1 );
+	double tau2       = c.tau2;
+	double TADIR      = TransCoverAbs1*TransSurf1/tau2;
       
 	// !Calculate HDKR COVER absorbed radiation for energy balance
-	double QDIFF = input.Idiff*(1.-TransCoverDiff);
-	double QGND = input.Ignd*(1.-TransCoverAbs3);
+	double QDIFF = input.Idiff*(1.-c.TransCoverDiff);
+	double QGND = input.Ignd*(1.-c.TransCoverGnd);
 	double QDIR = input.Ibeam*(1.-TransCoverAbs1);
 	double QHDKR = QDIFF+QGND+QDIR;
 
 	// !Calculate HDKR TOTAL (cover + cell) absorbed radiaion for energy balance
-	double SHDKR = input.Idiff*TADIFF*tau2+input.Ignd*TAGND*tau2+input.Ibeam*TADIR*tau2 + QHDKR;
+	double SHDKR = input.Idiff*c.TADIFF*tau2+input.Ignd*c.TAGND*tau2+input.Ibeam*TADIR*tau2 + QHDKR;
 
 	// !Calculation of Effective irradiance      
-	double SUNDIFF=input.Idiff*TADIFF;
-	double SUNGND=input.Ignd*TAGND;
+	double SUNDIFF=input.Idiff*c.TADIFF;
+	double SUNGND=input.Ignd*c.TAGND;
 	double SUNDIR=input.Ibeam*TADIR;
 	double SUNEFF = SUNDIFF+SUNGND+SUNDIR;
 
-//	double TAU_AL     = TauAlpha;
 	//IF (SUNTILT.GT.0) TAU_AL = TAMAX*SUNEFF/SUNTILT  !DAA: = TAMAX is used for CEC study
 	if (SUNEFF < 0)  SUNEFF=0;
 
 	//!Calculation of Air Mass Modifier
 	if  (THETAZ < 0) THETAZ=0;
-	//double AMASS      = 1/(cosd(THETAZ)+0.5057*pow(96.080-THETAZ,-1.634));
-	double MAM        = //a0+a1*AMASS+a2*pow(AMASS,2)+a3*pow(AMASS,3)+a4*pow(AMASS,4);
-		air_mass_modifier( THETAZ, input.Elev, amavec );
+	double MAM        = air_mass_modifier( THETAZ, input.Elev, amavec );
 	SUNEFF     = SUNEFF*MAM;
 
 	if (SUNEFF < 1)
 	{
+		m_lastValid = false;
 		Tcell = input.Tdry;
 		return true;
 	}
 
-	int Nrows = this->Nrows;
-	int Ncols = this->Ncols;
+	if (!c.valid)
+		return false; // invalid parameter specified
 
-	double Length = this->Length;
-	double Width = this->Width;
+	int Nrows = c.Nrows;
+	int Ncols = c.Ncols;
+	double Length = c.Length;
+	double Area = c.Area;
+	double L_char = c.L_char;
+	int MC = c.MC;
 
-	if (HTD == 1)
-	{
-		Nrows = Ncols = 1;
-	}
-	else if (HTD == 2)
-	{
-		Length = Nrows*Length;
-		Width = Ncols*Width;
-	}
-	
-	double Imp = module.ImpRef();
-	double Vmp = module.VmpRef();
-	
-	double Area_base = module.AreaRef();	 // !Use provided area for Duffie and Beckman model to maintain consistency w/ previous model
-	double Area = Area_base * Length * Width; // !Surface area of module
-    // !Define characteristic length
-    double L_char     = 4.0 * Length * Width / (2.0 * (Width + Length));
-       
-	int MC = this->MC;
-
-    // !If gap is less than 1 mm, use flush mounting configuration
-    if (Wgap < 0.001 && MC == 4) MC = 2;
-    
-	double R_gap = Wgap / Length;
-	if ( MC == 4  && R_gap > 1 && MSO == 1) MC = 1;	
-
-	double v_ch = 1.0, Fcg, Fcs, Fbs, Fbg, T_sky, T_ground, T_rw;
-	
+	double v_ch = 1.0, T_sky, T_ground, T_rw;
+	double Fcg = c.Fcg, Fcs = c.Fcs, Fbs = c.Fbs, Fbg = c.Fbg;
 	
 	// !Set cover wind speed to wind input; backside wind speed may change based on mounting configuration
 	double V_WIND = MAX(0.001,input.Wspd);
 	double V_cover = V_WIND;
-	double P_guess = 0;
 
 	// convert to kelvin
 	double TA = input.Tdry+273.15;
 	double Patm = input.Patm*100; // convert millibar into Pascal
+	double rho_coef = Patm*28.967/8314.34;
 
-	double EFFREF = 1e-3;
 		
 	// !Guess power based on SRC efficiency and irradiance
-	if (MC == 5)
-		EFFREF = Imp*Vmp/(I_ref*Area_base);   // !Efficiency of module at SRC conditions
-	else
-		EFFREF = Imp*Vmp/(I_ref*Area);   // !Efficiency of module at SRC conditions
-
-	P_guess = EFFREF * (SUNEFF*Area); // !Estimate performance based on SRC efficiency
-	if (HTD == 2) P_guess = P_guess * Nrows * Ncols;
-
+	double P_scale = SUNEFF*Area;
+	if (HTD == 2) P_scale = P_scale * Nrows * Ncols;
+	double P_guess = c.EFFREF * P_scale; // !Estimate performance based on SRC efficiency
 
 	// !Adjust backside wind speed based on mounting structure orientation for "gap" mounting configuration
 	if (MC == 4) {
@@ -490,10 +575,6 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 		v_ch = V_WIND * 0.3;   // !Give realistic starting value to channel air velocity
 	}
 
-	Fcg        = (1. - cosd(input.Tilt))/2;  // !view factor between top of tilted plate and horizontal plane adjacent to bottom edge of plate
-	Fcs        = 1. - Fcg;              // !view factor between top of tilted plate and everything else (sky)
-	Fbs        = Fcg;                   // !view factor bewteen top and ground = bottom and sky
-	Fbg        = Fcs;                   // !view factor bewteen bottom and ground = top and sky
 	T_sky      = TA*pow(0.711+0.0056*input.Tdew+0.000073*pow(input.Tdew,2)+0.013*cosd(input.HourOfDay), 0.25);   // !Sky Temperature: Berdahl and Martin  
 	T_ground   = TA;                    // !Set ground temp equal to ambient temp
 	T_rw       = TA;                    // !Initial guess for roof or wall temp
@@ -506,6 +587,20 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 	
 	double TC = input.Tdry+273.15;
 
+	// warm start: the previous time step's converged power ratio and cell temperature are usually much
+	// closer to this step's solution than the reference efficiency and ambient temperature.  the gap
+	// configuration's nested channel and roof iterations are capped and can stop at a different solution
+	// from a different start, so it is always started cold
+	if (WarmStart && m_lastValid && MC != 4)
+	{
+		P_guess = m_lastPratio * P_scale;
+		TC = m_lastTC;
+	}
+	m_lastValid = false;
+
+	double TbackK = TbackInteg + 273.15;
+	double sigma_sky_c = (Fcs*EmisC+Fbs*EmisB)*sigma, sigma_gnd_c = (Fcg*EmisC+Fbg*EmisB)*sigma;
+
 	while( p_iter <= 300 && fabs(err_P) > 0.1 )
 	{		  
 		double err_TC   = 100.; //  !Set initial temperature error. Must be > tolerance for temp error in do loop
@@ -520,26 +615,27 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 			while( fabs(err_TC) > 0.001 )
 			{
 
-				double rho_air    = Patm*28.967/8314.34*(1./((TA+TC)/2.)) ; // !density of air as a function of pressure and ambient temp
+				double rho_air    = rho_coef*(1./((TA+TC)/2.)) ; // !density of air as a function of pressure and ambient temp
 				double Re_forced  = MAX(0.1,rho_air*V_cover*L_char/mu_air) ; //  !Reynolds number of wind moving across module
-				double Nu_forced  = 0.037 * pow(Re_forced,4./5.) * pow(Pr_air, 1./3.) ; //  !Nusselt Number (Incropera et al., 2006)
+				double Nu_forced  = 0.037 * pow(Re_forced,4./5.) * Pr_air_13 ; //  !Nusselt Number (Incropera et al., 2006)
 				double h_forced   = Nu_forced * k_air / L_char;
 				double h_sky      = (TC*TC+T_sky*T_sky)*(TC+T_sky);
 				double h_ground   = (TC*TC+T_ground*T_ground)*(TC+T_ground);
-				double h_free_c   = free_convection_194(TC,TA,input.Tilt,rho_air,Pr_air,mu_air,Area,Length,Width,k_air) ; //   !Call function to calculate free convection on tilted surface (top)           
-				double h_free_b   = free_convection_194(TC,TA,180.0-input.Tilt,rho_air,Pr_air,mu_air,Area,Length,Width,k_air); // !Call function to calculate free convection on tilted surface (bottom)              
-				double h_conv_c   = pow( pow(h_forced,3.) + pow(h_free_c,3.) , 1./3.) ; // !Combine free and forced heat transfer coefficients (top)
-				double h_conv_b   = pow( pow(h_forced,3.) + pow(h_free_b,3.) , 1./3.) ; // !Combine free and forced heat transfer coefficients (bottom)
+				double h_free_c   = free_convection_194(TC,TA,c.cos_tilt,c.sin_tilt,rho_air,c.L_ch_f,c.L_ch_f3,Length,c.Length3) ; //   !Call function to calculate free convection on tilted surface (top)           
+				double h_free_b   = free_convection_194(TC,TA,-c.cos_tilt,c.sin_tilt,rho_air,c.L_ch_f,c.L_ch_f3,Length,c.Length3); // !Call function to calculate free convection on tilted surface (bottom)              
+				double h_forced3  = h_forced*h_forced*h_forced;
+				double h_conv_c   = cbrt( h_forced3 + h_free_c*h_free_c*h_free_c ) ; // !Combine free and forced heat transfer coefficients (top)
+				double h_conv_b   = cbrt( h_forced3 + h_free_b*h_free_b*h_free_b ) ; // !Combine free and forced heat transfer coefficients (bottom)
 			
 				// !Energy balance to calculate TC
 				double TC1 = ( (h_conv_c+h_conv_b)*TA 
-						+ (Fcs*EmisC+Fbs*EmisB)*sigma*h_sky*T_sky 
-						+ (Fcg*EmisC+Fbg*EmisB)*sigma*h_ground*T_ground
+						+ sigma_sky_c*h_sky*T_sky 
+						+ sigma_gnd_c*h_ground*T_ground
 						-(P_guess/Area)+SHDKR )
 						/ ( h_conv_c 
 						+ h_conv_b 
-						+ (Fcs*EmisC +Fbs*EmisB)*sigma*h_sky 
-						+ (Fcg*EmisC + Fbg*EmisB)*sigma*h_ground );
+						+ sigma_sky_c*h_sky 
+						+ sigma_gnd_c*h_ground );
 
 				// !Since some variables in TC1 calc are function of TC, iterative solving is required        
 				err_TC     = TC1 - TC; // !Error between n-1 and n temp calculations
@@ -553,13 +649,13 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 		case 2: // !Flush Mounting Configuration
 			while( fabs(err_TC) > 0.001)
 			{
-				double rho_air    = Patm*28.967/8314.34*(1 / ((TA+TC)/2.)); // !density of air a function of pressure and ambient temp
+				double rho_air    = rho_coef*(1 / ((TA+TC)/2.)); // !density of air a function of pressure and ambient temp
 				double Re_forced  = MAX(0.1,rho_air*V_cover*L_char/mu_air); //  !Reynolds number of wind moving across panel: function of L_char: array depen?
-				double Nu_forced  = 0.037 * pow(Re_forced, 4./5.) * pow(Pr_air, 1./3.);
+				double Nu_forced  = 0.037 * pow(Re_forced, 4./5.) * Pr_air_13;
 				double h_forced   = Nu_forced * k_air / L_char;
 				double h_sky      = (TC*TC+T_sky*T_sky)*(TC+T_sky);
 				double h_ground   = (TC*TC+T_ground*T_ground)*(TC+T_ground);
-				double h_free_c   = free_convection_194(TC,TA,input.Tilt,rho_air,Pr_air,mu_air,Area,Length,Width,k_air);
+				double h_free_c   = free_convection_194(TC,TA,c.cos_tilt,c.sin_tilt,rho_air,c.L_ch_f,c.L_ch_f3,Length,c.Length3);
 				double h_conv_c   = pow((pow(h_forced,3.) + pow(h_free_c,3.)), (1./3.));
 					
 				double TC1 = ((h_conv_c)*TA + (Fcs*EmisC)*sigma*h_sky*T_sky + (Fcg*EmisC)*sigma*h_ground*T_ground
@@ -576,17 +672,16 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 		case 3: // !Integrated Mounting Configuration
 			while( fabs(err_TC) > 0.001)
 			{
-				double TbackK = TbackInteg + 273.15;
-				double rho_air    = Patm*28.967/8314.34*(1 / ((TA+TC)/2.)); // !density of air a function of pressure and film temp
-				double rho_bk     = Patm*28.967/8314.34*(1 / ((TbackK+TC)/2.));
+				double rho_air    = rho_coef*(1 / ((TA+TC)/2.)); // !density of air a function of pressure and film temp
+				double rho_bk     = rho_coef*(1 / ((TbackK+TC)/2.));
 				double Re_forced  = MAX(0.1,rho_air*V_cover*L_char/mu_air); //  !Reynolds number of wind moving across panel: function of L_char: array depen?
-				double Nu_forced  = 0.037 * pow(Re_forced, 4./5.) * pow(Pr_air, 1./3.);
+				double Nu_forced  = 0.037 * pow(Re_forced, 4./5.) * Pr_air_13;
 				double h_forced   = Nu_forced * k_air / L_char;					
 				double h_sky      = (TC*TC+T_sky*T_sky)*(TC+T_sky);
 				double h_ground   = (TC*TC+T_ground*T_ground)*(TC+T_ground);				   
 				double h_radbk    = (TC*TC+TbackK*TbackK)*(TC+TbackK); // !Using TbackK now instead of TA					
-				double h_free_c   = free_convection_194(TC,TA,input.Tilt,rho_air,Pr_air,mu_air,Area,Length,Width,k_air);				 
-				double h_free_b   = free_convection_194(TC,TbackK,180.-input.Tilt,rho_bk,Pr_air,mu_air,Area,Length,Width,k_air);				 
+				double h_free_c   = free_convection_194(TC,TA,c.cos_tilt,c.sin_tilt,rho_air,c.L_ch_f,c.L_ch_f3,Length,c.Length3);				 
+				double h_free_b   = free_convection_194(TC,TbackK,-c.cos_tilt,c.sin_tilt,rho_bk,c.L_ch_f,c.L_ch_f3,Length,c.Length3);				 
 				double h_conv_c   = pow( pow(h_forced,3.) + pow(h_free_c,3.), (1./3.));
 				double h_conv_b   = h_free_b;// !No forced convection on backside
 					
@@ -604,45 +699,13 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 				
 		case 4: // !Gap (channel) Mounting Configuration
 			{
-				double A_c, L_charB, L_str, Per_cw, D_h;
-				
-				if ( MSO == 1)
-				{
-					// !Define channel length and width for gap mounting configuration that does not block air flow in any direction
-					// !Use minimum dimension for length so that MSO 1 will have lower temp than MSO 2 or 3
-					L_charB = MIN(Width, Length);
-					L_str   = MAX(Width, Length);
-						
-					// !These values are dependent on MSO
-					A_c        = Wgap * L_str;     // !Cross Sectional area of channel
-					Per_cw 	   = 2.*L_str;          // !Perimeter minus open sides
-					D_h 	   = (4.*A_c)/Per_cw;   // !Hydraulic diameter
-				}
-				else if (MSO == 2) //  !Vertical supports
-				{
-					L_charB = Length;
-					L_str   = Width / Ncols;
-					A_c        = Wgap * L_str ; //         !Cross Sectional area of channel
-					Per_cw 	   = 2.*L_str + 2.*Wgap ; //   !Perimeter ACCOUNTING for supports: different than MSO 1
-					D_h 	   = (4.*A_c)/Per_cw ; //       !Hydraulic diameter
-				}
-				else if (MSO == 3) // ! Horizontal supports
-				{
-					// !Flow is restricted to one direction.  Wind speed has already been adjusted using a cosine projection
-					L_charB = Width;
-					// !Width of channel is function of number of columns of modules.  Assuming that support structures are exactly the length of a module
-					L_str   = Length / Nrows;
-					A_c        = Wgap * L_str ; //         !Cross Sectional area of channel
-					Per_cw 	   = 2.*L_str + 2.*Wgap ; //   !Perimeter ACCOUNTING for supports: different than MSO 1
-					D_h 	   = (4.*A_c)/Per_cw ; //       !Hydraulic diameter
-				}
-				else
-					return false; // invalid parameter specified
+				// channel geometry depends on the mounting structure orientation, see precompute()
+				double A_c = c.A_c, L_charB = c.L_charB, Per_cw = c.Per_cw, D_h = c.D_h;
 					
 				// !Begin iteration to find cell temperature
 				while ( fabs(err_TC) > 0.001 )
 				{      
-					double rho_air    = Patm*28.967/8314.34*(1 / ((TA+TC)/2.)); // !density of air a function of pressure and film temp
+					double rho_air    = rho_coef*(1 / ((TA+TC)/2.)); // !density of air a function of pressure and film temp
 					double err_v      = 100; //                                     !set error for channel velocity iteration
 					double err_v_p    = 100;
 					double P_in       = 0.5*V_WIND*V_WIND * rho_air; //  !Dynamic pressure at inlet
@@ -669,18 +732,18 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 					
 					// !Heat transfer on cover of module: using un-adjusted wind speed input
 					double Re_forced  = MAX(0.1,rho_air*V_cover*L_char/mu_air); //  !Reynolds number of wind moving across panel
-					double Nu_forced  = 0.037*pow(Re_forced,4./5.)*pow(Pr_air,1./3.);
+					double Nu_forced  = 0.037*pow(Re_forced,4./5.)*Pr_air_13;
 					double h_forced   = Nu_forced * k_air / L_char;
 					double h_sky      = (TC*TC+T_sky*T_sky)*(TC+T_sky);
 					double h_ground   = (TC*TC+T_ground*T_ground)*(TC+T_ground);
-					double h_free_c   = free_convection_194(TC,TA,input.Tilt,rho_air,Pr_air,mu_air,Area,Length,Width,k_air);
+					double h_free_c   = free_convection_194(TC,TA,c.cos_tilt,c.sin_tilt,rho_air,c.L_ch_f,c.L_ch_f3,Length,c.Length3);
 					double h_conv_c   = pow(pow(h_forced,3.) + pow(h_free_c,3.), 1./3.);
 					
 					// !Reynolds number for channel flow
 					double Re_fp 	   = rho_air*v_ch*L_charB / mu_air;
 					// !Use calculated channel velocity in flat plate correlation to find heat transfer coefficient
 					// !This approach (rather than channel flow correlations) allows channel equations to approach open rack as gap increases
-					double Nus_ch     = 0.037*pow(Re_fp,4./5.)*pow(Pr_air,1./3.);
+					double Nus_ch     = 0.037*pow(Re_fp,4./5.)*Pr_air_13;
 					double h_ch       = Nus_ch * k_air / L_charB;
 					h_ch       = MIN(h_ch, h_forced); //           !Make sure gap mounted doesn't calc lower temps than open rack
 						
@@ -698,7 +761,7 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 						double h_fr = 0;
 							
 						if (MSO == 3) h_fr = 0; //  !If E-W supports then assume no free convection
-						else h_fr = channel_free_194(Wgap,input.Tilt,TA,T_cr,k_air,rho_air,cp_air,mu_air,Length); // !Call function for channel free convection        
+						else h_fr = channel_free_194(Wgap,c.sin_tilt,TA,T_cr,k_air,rho_air,cp_air,mu_air,Length); // !Call function for channel free convection        
 				 
 						double m_dot 	   = v_ch*rho_air*A_c ; // !mass flow rate through channel
 						double h_conv_b   = pow( pow(h_ch,3) + pow(h_fr,3) , (1./3.)) ; // !total heat transfer coefficient in channel
@@ -706,10 +769,7 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 						// !Calculate air temperature at the end of the channel 
 						// !For MSO 2 & 3 have been calculating gap HT per channel(not necessarily entire array), so need to consider that going forward
 							
-						int AR = 0;
-						if (MSO == 1) AR = 1;
-						if (MSO == 2) AR = Ncols;
-						if (MSO == 3) AR = Nrows;
+						int AR = c.AR;
 					
 						double T_m = T_cr-(T_cr-TA)*exp(-2*(Area/AR)*h_conv_b/(m_dot*cp_air));
 						 
@@ -787,6 +847,10 @@ bool mcsp_celltemp_t::operator() ( pvinput_t &input, pvmodule_t &module, double
 		}
 	}
 	
+	m_lastTC = TC;
+	m_lastPratio = P_guess / P_scale;
+	m_lastValid = true;
+
 	Tcell = TC - 273.15;
 	return true;
 }
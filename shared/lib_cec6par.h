@@ -112,8 +112,36 @@ public:
 	double Width; // module width, along vertical dimension, (m)
 	double Wgap;  // gap width spacing (m)
 	double TbackInteg;  // back surface temperature for integrated modules ('C)
+	bool WarmStart; // start the energy balance from the previous call's converged solution, off by default so results do not depend on call order.  set by callers that step in time order
+
+	mcsp_celltemp_t();
 	
 	virtual bool operator() ( pvinput_t &input, pvmodule_t &module, double opvoltage, double &Tcell );
+
+private:
+	/* module, mounting and tilt dependent constants, recalculated only when one of the inputs they depend on changes */
+	struct constants
+	{
+		// inputs the constants were calculated for
+		double area_base, imp, vmp, length_in, width_in, wgap, tilt;
+		int mc_in, htd, mso, nrows_in, ncols_in;
+
+		int MC, Nrows, Ncols;
+		double Length, Width, Area, L_char, EFFREF;
+		double L_ch_f, L_ch_f3, Length3; // free convection characteristic lengths
+		double A_c, L_charB, Per_cw, D_h; // channel geometry for gap mounting
+		int AR;
+		double cos_tilt, sin_tilt, Fcg, Fcs, Fbs, Fbg;
+		double tau2, TADIFF, TAGND, TransCoverDiff, TransCoverGnd;
+		bool valid;
+	};
+	constants m_c;
+	bool m_cInit;
+	void precompute( pvmodule_t &module, double tilt );
+
+	// converged cell temperature (K) and power ratio of the previous call, for warm starts
+	bool m_lastValid;
+	double m_lastTC, m_lastPratio;
 };
 
 #endif
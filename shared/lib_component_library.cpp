@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+
+#include "lib_component_library.h"
+
+const size_t component_library::npos;
+const size_t component_library::max_cached;
+
+component_library::component_library()
+{
+}
+
+bool component_library::load(const std::string &file)
+{
+	FILE *fp = fopen(file.c_str(), "rb");
+	if (!fp)
+	{
+		m_error = "could not open component library " + file;
+		return false;
+	}
+
+	std::string text;
+	char buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		text.append(buf, n);
+	fclose(fp);
+
+	if (!parse(text))
+	{
+		m_error += ": " + file;
+		return false;
+	}
+	return true;
+}
+
+bool component_library::parse(const std::string &text)
+{
+	m_text = text;
+	m_columns.clear();
+	m_rows.clear();
+	m_names.clear();
+	m_index.clear();
+	m_error.clear();
+
+	// skip a byte order mark written by spreadsheet programs
+	size_t pos = (m_text.compare(0, 3, "\xEF\xBB\xBF") == 0) ? 3 : 0;
+	pos = split(pos, m_columns, npos);
+	if (m_columns.size() < 2 || m_columns[0].empty())
+	{
+		m_error = "component library has no parameter columns";
+		return false;
+	}
+
+	std::vector<std::string> first;
+	while (pos < m_text.size())
+	{
+		size_t start = pos;
+		pos = split(pos, first, 1);
+		if (first.empty() || first[0].empty())
+			continue; // blank line
+
+		m_rows.push_back(start);
+		m_names.push_back(first[0]);
+		m_index.insert(std::make_pair(first[0], m_rows.size() - 1));
+	}
+	return true;
+}
+
+size_t component_library::split(size_t pos, std::vector<std::string> &values, size_t max_fields) const
+{
+	values.clear();
+	const size_t len = m_text.size();
+	bool end_of_row = (pos >= len);
+	while (!end_of_row)
+	{
+		std::string field;
+		if (pos < len && m_text[pos] == '"')
+		{
+			// quoted field, a doubled quote is a literal quote
+			pos++;
+			while (pos < len)
+			{
+				if (m_text[pos] == '"')
+				{
+					if (pos + 1 < len && m_text[pos + 1] == '"')
+					{
+						field += '"';
+						pos += 2;
+					}
+					else
+					{
+						pos++;
+						break;
+					}
+				}
+				else
+					field += m_text[pos++];
+			}
+			while (pos < len && m_text[pos] != ',' && m_text[pos] != '\n')
+				pos++;
+		}
+		else
+		{
+			size_t start = pos;
+			while (pos < len && m_text[pos] != ',' && m_text[pos] != '\n')
+				pos++;
+			size_t end = pos;
+			while (end > start && (m_text[end - 1] == '\r' || m_text[end - 1] == ' ' || m_text[end - 1] == '\t'))
+				end--;
+			while (start < end && (m_text[start] == ' ' || m_text[start] == '\t'))
+				start++;
+			field = m_text.substr(start, end - start);
+		}
+
+		end_of_row = (pos >= len || m_text[pos] == '\n');
+		pos++;
+
+		values.push_back(field);
+		if (!end_of_row && values.size() >= max_fields)
+		{
+			// the rest of the row is not needed
+			pos = m_text.find('\n', pos);
+			pos = (pos == std::string::npos) ? len : pos + 1;
+			break;
+		}
+	}
+	return pos;
+}
+
+size_t component_library::find(const std::string &name) const
+{
+	std::unordered_map<std::string, size_t>::const_iterator it = m_index.find(name);
+	return (it == m_index.end()) ? npos : it->second;
+}
+
+void component_library::fields(size_t i, std::vector<std::string> &values) const
+{
+	split(m_rows[i], values, m_columns.size());
+	values.resize(m_columns.size());
+}
+
+std::shared_ptr<const component_library> component_library::open(const std::string &file, std::string &error)
+{
+	struct cached
+	{
+		std::shared_ptr<const component_library> library;
+		time_t modified;
+		long long bytes;
+		unsigned long long opened;
+	};
+	static std::mutex lock;
+	static std::map<std::string, cached> libraries;
+	static unsigned long long opened = 0;
+
+	std::lock_guard<std::mutex> guard(lock);
+	std::map<std::string, cached>::iterator it = libraries.find(file);
+
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0)
+	{
+		if (it != libraries.end())
+			libraries.erase(it);
+		error = "could not open component library " + file;
+		return std::shared_ptr<const component_library>();
+	}
+
+	if (it != libraries.end() && it->second.modified == st.st_mtime && it->second.bytes == (long long)st.st_size)
+	{
+		it->second.opened = ++opened;
+		return it->second.library;
+	}
+
+	std::shared_ptr<component_library> library(new component_library);
+	if (!library->load(file))
+	{
+		if (it != libraries.end())
+			libraries.erase(it);
+		error = library->error();
+		return std::shared_ptr<const component_library>();
+	}
+
+	cached &c = libraries[file];
+	c.library = library;
+	c.modified = st.st_mtime;
+	c.bytes = (long long)st.st_size;
+	c.opened = ++opened;
+
+	// libraries still in use elsewhere stay alive through their other references
+	while (libraries.size() > max_cached)
+	{
+		std::map<std::string, cached>::iterator oldest = libraries.begin();
+		for (it = libraries.begin(); it != libraries.end(); ++it)
+			if (it->second.opened < oldest->second.opened)
+				oldest = it;
+		libraries.erase(oldest);
+	}
+	return library;
+}
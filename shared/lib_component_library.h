@@ -0,0 +1,67 @@
+#ifndef __LIB_COMPONENT_LIBRARY_H__
+#define __LIB_COMPONENT_LIBRARY_H__
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+*  A table of module or inverter parameters read from a comma-separated library file and indexed by
+*  component name.
+*
+*  The first row names the columns, which are the input variable names of the parameters, and the
+*  first column holds the component names.  Fields may be quoted, so names can contain commas.
+*  The file is held in memory as a single block of text; only the row positions and names are found
+*  when it is read, and the parameter fields of a component are split out when it is looked up, so
+*  a library of tens of thousands of components opens in one pass over the text.
+*/
+class component_library
+{
+public:
+	static const size_t npos = (size_t)-1;
+
+	component_library();
+
+	/// Read a library file, returns false and sets error() if it cannot be read or has no columns
+	bool load(const std::string &file);
+
+	/// Index library text already in memory
+	bool parse(const std::string &text);
+
+	/// Open a library file, shared with every other caller until the file changes on disk or drops out of the cache
+	static std::shared_ptr<const component_library> open(const std::string &file, std::string &error);
+
+	/// The number of library files open() keeps, the least recently opened is dropped first
+	static const size_t max_cached = 8;
+
+	/// Number of components in the library
+	size_t size() const { return m_rows.size(); }
+
+	/// Column names, the first is the component name column
+	const std::vector<std::string> &columns() const { return m_columns; }
+
+	/// Index of the named component, npos if it is not in the library.  If a name is listed twice the first entry is used
+	size_t find(const std::string &name) const;
+
+	/// Name of component i
+	const std::string &name(size_t i) const { return m_names[i]; }
+
+	/// Fields of component i, one per column, missing fields at the end of the row are empty
+	void fields(size_t i, std::vector<std::string> &values) const;
+
+	std::string error() const { return m_error; }
+
+private:
+	/// Split the row starting at pos into fields, returns the position of the next row
+	size_t split(size_t pos, std::vector<std::string> &values, size_t max_fields) const;
+
+	std::string m_text;
+	std::vector<std::string> m_columns;
+	std::vector<size_t> m_rows;			///< offset of each component row in m_text
+	std::vector<std::string> m_names;
+	std::unordered_map<std::string, size_t> m_index;
+	std::string m_error;
+};
+
+#endif
@@ -268,6 +268,92 @@ void solarpos(int year,int month,int day,int hour,double minute,double lat,doubl
 }
 
 
+/// Type of time step as reported in tsp[2] by solarpos_timestep():  0=sun down, 1=midday, 2=sunup, 3=sundown
+static int sun_timestep_type(double t_cur, double delt, double t_sunrise, double t_sunset)
+{
+	// recall: if delt <= 0.0, do not interpolate sunrise and sunset hours, just use specified time stamp
+	if ( delt > 0
+		&& t_cur >= t_sunrise - delt/2.0
+		&& t_cur < t_sunrise + delt/2.0 )
+		return 2;
+	else if ( delt > 0
+		&& t_cur > t_sunset - delt/2.0
+		&& t_cur <= t_sunset + delt/2.0 )
+		return 3;
+	else if (t_cur >= t_sunrise && t_cur <= t_sunset)
+		return 1;
+	else
+		return 0;
+}
+
+void solarpos_timestep(int year, int month, int day, int hour, double minute, double delt, double lat, double lng, double tz, double sun[9], int tsp[3])
+{
+	// calculate sunrise and sunset hours in local standard time for the current day
+	double noon[9];
+	solarpos( year, month, day, 12, 0.0, lat, lng, tz, noon );
+
+	solarpos_timestep( year, month, day, hour, minute, delt, lat, lng, tz, noon, sun, tsp );
+}
+
+void solarpos_timestep(int year, int month, int day, int hour, double minute, double delt, double lat, double lng, double tz, const double noon[9], double sun[9], int tsp[3])
+{
+	double t_cur = hour + minute/60.0;
+
+	for (int i = 0; i < 9; i++)
+		sun[i] = noon[i];
+
+	double t_sunrise = sun[4];
+	double t_sunset = sun[5];
+
+	int type = sun_timestep_type( t_cur, delt, t_sunrise, t_sunset );
+	if ( type == 2 )
+	{
+		// time step encompasses the sunrise
+		double t_calc = (t_sunrise + (t_cur+delt/2.0))/2.0; // midpoint of sunrise and end of timestep
+		int hr_calc = (int)t_calc;
+		double min_calc = (t_calc-hr_calc)*60.0;
+
+		tsp[0] = hr_calc;
+		tsp[1] = (int)min_calc;
+				
+		solarpos( year, month, day, hr_calc, min_calc, lat, lng, tz, sun );
+
+		tsp[2] = 2;				
+	}
+	else if ( type == 3 )
+	{
+		// timestep encompasses the sunset
+		double t_calc = ( (t_cur-delt/2.0) + t_sunset )/2.0; // midpoint of beginning of timestep and sunset
+		int hr_calc = (int)t_calc;
+		double min_calc = (t_calc-hr_calc)*60.0;
+
+		tsp[0] = hr_calc;
+		tsp[1] = (int)min_calc;
+				
+		solarpos( year, month, day, hr_calc, min_calc, lat, lng, tz, sun );
+
+		tsp[2] = 3;
+	}
+	else if ( type == 1 )
+	{
+		// timestep is not sunrise nor sunset, but sun is up  (calculate position at provided t_cur)			
+		tsp[0] = hour;
+		tsp[1] = (int)minute;
+		solarpos( year, month, day, hour, minute, lat, lng, tz, sun );
+		tsp[2] = 1;
+	}
+	else
+	{	
+		// sun is down, assign sundown values
+		sun[0] = -999*DTOR; //avoid returning a junk azimuth angle (return in radians)
+		sun[1] = -999*DTOR; //avoid returning a junk zenith angle (return in radians)
+		sun[2] = -999*DTOR; //avoid returning a junk elevation angle (return in radians)
+		tsp[0] = 0;
+		tsp[1] = 0;
+		tsp[2] = 0;
+	}
+}
+
 void incidence(int mode,double tilt,double sazm,double rlim,double zen,double azm, bool en_backtrack, double gcr, double angle[5])
 {
 	// Azimuth angles are for N=0 or 2pi, E=pi/2, S=pi, and W=3pi/2.  8/13/98
@@ -588,6 +674,25 @@ void poaDecomp( double , double angle[], double sun[], double alb, poaDecompReq
 
 	double r90(M_PI/2), r80( 80.0/180*M_PI ), r65(65.0/180*M_PI);
 
+	// another subarray with the same POA input and orientation may already have decomposed this step
+	poaDecompResult *shared = 0;
+	if ( pA->results && pA->i < pA->nResults ){
+		shared = &pA->results[ pA->i ];
+		if ( !pA->storeResults ){
+			if ( shared->stored.load(std::memory_order_acquire) == pA->pass + 1 ){
+				dn = shared->dn;
+				df = shared->df;
+				gh = shared->gh;
+				for( int k = 0; k < 3; k++ ){
+					poa[k] = shared->poa[k];
+					diffc[k] = shared->diffc[k];
+				}
+				return;
+			}
+			shared = 0;
+		}
+	}
+
 	if ( angle[0] < r90 ){  // Check if incident angle if greater than 90 degrees
 		
 		double gti[] = {pA->POA[ pA->i-1 ], pA->POA[ pA->i ], pA->POA[ pA->i+1 ]};
@@ -614,24 +719,36 @@ void poaDecomp( double , double angle[], double sun[], double alb, poaDecompReq
 		}
 
 
-		// Determine an average Kt prime value
-		int count = 0;
+		// Determine an average Kt prime value, which is the same for the rest of the half day while the dew point is unchanged
 		double avgKtp = 0;
 
-		for( size_t j = start; j < stop; j++ ){
+		if( start == pA->ktpStart && stop == pA->ktpStop && pA->doy == pA->ktpDoy && pA->tDew == pA->ktpTDew && alb == pA->ktpAlb ){
+			avgKtp = pA->ktpAvg;
+		} else {
+			int count = 0;
+
+			for( size_t j = start; j < stop; j++ ){
 
 
-			if( (pA->inc[j] < r80) && (pA->inc[j] > r65) ){
-				count++;
-				double gti[] = {pA->POA[ j-1 ], pA->POA[ j ], pA->POA[ j+1 ]};
-				double inc[] = {pA->inc[ j-1 ], pA->inc[ j ], pA->inc[ j+1 ]};
+				if( (pA->inc[j] < r80) && (pA->inc[j] > r65) ){
+					count++;
+					double gti[] = {pA->POA[ j-1 ], pA->POA[ j ], pA->POA[ j+1 ]};
+					double inc[] = {pA->inc[ j-1 ], pA->inc[ j ], pA->inc[ j+1 ]};
 
-				double dnTmp, dfTmp, ghTmp, poaTmp[3];
-				avgKtp += GTI_DIRINT( gti, inc, pA->zen[j], pA->tilt[j], pA->exTer[j], alb, pA->doy, pA->tDew, pA->elev, dnTmp, dfTmp, ghTmp, poaTmp );
+					double dnTmp, dfTmp, ghTmp, poaTmp[3];
+					avgKtp += GTI_DIRINT( gti, inc, pA->zen[j], pA->tilt[j], pA->exTer[j], alb, pA->doy, pA->tDew, pA->elev, dnTmp, dfTmp, ghTmp, poaTmp );
+				}
 			}
-		}
 
-		avgKtp /= count;
+			avgKtp /= count;
+
+			pA->ktpStart = start;
+			pA->ktpStop = stop;
+			pA->ktpDoy = pA->doy;
+			pA->ktpTDew = pA->tDew;
+			pA->ktpAlb = alb;
+			pA->ktpAvg = avgKtp;
+		}
 
 		//Calculate Kt
 		double am = Min(15.25, 1.0 / (cos(sun[1]) + 0.15 * (pow(93.9 - sun[1]*180/M_PI, -1.253)))); // air mass
@@ -660,6 +777,17 @@ void poaDecomp( double , double angle[], double sun[], double alb, poaDecompReq
 		perez( sun[8], dn, df, alb, angle[0], angle[1], sun[1], poa, diffc );
 	
 	}
+
+	if ( shared ){
+		shared->dn = dn;
+		shared->df = df;
+		shared->gh = gh;
+		for( int k = 0; k < 3; k++ ){
+			shared->poa[k] = poa[k];
+			shared->diffc[k] = diffc[k];
+		}
+		shared->stored.store(pA->pass + 1, std::memory_order_release);
+	}
 }
 
 void isotropic( double , double dn, double df, double alb, double inc, double tilt, double zen, double poa[3], double diffc[3] )
@@ -833,6 +961,49 @@ void perez( double , double dn, double df, double alb, double inc, double tilt,
 		}
 }
 
+daylight_mask::daylight_mask(double lat, double lon, double tz, double delt_hr)
+	: m_lat(lat), m_lon(lon), m_tz(tz), m_delt(delt_hr), m_year(-1), m_month(-1), m_day(-1)
+{
+	for (int i = 0; i < 9; i++)
+		m_noon[i] = 0;
+}
+
+bool daylight_mask::night(int year, int month, int day, int hour, double minute)
+{
+	if (year != m_year || month != m_month || day != m_day)
+	{
+		solarpos(year, month, day, 12, 0.0, m_lat, m_lon, m_tz, m_noon);
+		m_year = year;
+		m_month = month;
+		m_day = day;
+	}
+	return sun_timestep_type(hour + minute / 60.0, m_delt, m_noon[4], m_noon[5]) == 0;
+}
+
+void sunpos_cache::calc(const std::vector<weather_record> &records, double lat, double lon, double tz, double delt_hr)
+{
+	m_records.resize(records.size());
+
+	daylight_mask daylight(lat, lon, tz, delt_hr);
+	double sun[9];
+	int tsp[3];
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const weather_record &wf = records[i];
+		daylight.night(wf.year, wf.month, wf.day, wf.hour, wf.minute);
+		solarpos_timestep(wf.year, wf.month, wf.day, wf.hour, wf.minute, delt_hr, lat, lon, tz, daylight.noon(), sun, tsp);
+
+		record &r = m_records[i];
+		r.azimuth = sun[0];
+		r.zenith = sun[1];
+		r.elevation = sun[2];
+		r.hextra = sun[8];
+		r.sunrise = sun[4];
+		r.sunset = sun[5];
+		r.sunup = tsp[2];
+	}
+}
+
 void irrad::setup()
 {
 	year = month = day = hour = -999;
@@ -848,6 +1019,7 @@ void irrad::setup()
 	groundCoverageRatio = std::numeric_limits<double>::quiet_NaN();
 	enableBacktrack = false;
 	planeOfArrayIrradianceRearAverage = 0;
+	noonSunAnglesRadians = 0;
 
 	calculatedDirectNormal = directNormal;
 	calculatedDiffuseHorizontal = 0.0;
@@ -857,13 +1029,16 @@ irrad::irrad()
 	setup();
 }
 irrad::irrad(Irradiance_IO * irradianceIO, Subarray_IO * subarrayIO)
+	: irrad(irradianceIO, subarrayIO, irradianceIO->weatherRecord)
+{
+}
+irrad::irrad(Irradiance_IO * irradianceIO, Subarray_IO * subarrayIO, const weather_record & wf)
 {
 	setup();
 	irradiance = irradianceIO;
 	subarray = subarrayIO;
 
-	weather_record wf = irradiance->weatherRecord;
-	weather_header hdr = irradiance->weatherHeader;
+	const weather_header & hdr = irradiance->weatherHeader;
 
 	int month_idx = wf.month - 1;
 	if (irradiance->useWeatherFileAlbedo && std::isfinite(wf.alb) && wf.alb > 0 && wf.alb < 1) {
@@ -1046,6 +1221,11 @@ void irrad::set_poa_pyranometer( double planeOfArrayIrradianceFront, poaDecompRe
 	this->radiationMode = Irradiance_IO::POA_P;
 	this->poaAll = pA;
 }
+void irrad::set_noon_sun(const double sun[9])
+{
+	noonSunAnglesRadians = sun;
+}
+
 void irrad::set_sun_component(size_t index, double value)
 {
 	if (index < sizeof(sunAnglesRadians) / sizeof(sunAnglesRadians[0])) {
@@ -1069,67 +1249,11 @@ int irrad::calc()
 	planeOfArrayIrradianceFront: result from sky model
 	diff: broken out diffuse components from sky model
 */	
-	double t_cur = hour + minute/60.0;
-
-	// calculate sunrise and sunset hours in local standard time for the current day
-	solarpos( year, month, day, 12, 0.0, latitudeDegrees, longitudeDegrees, timezone, sunAnglesRadians );
-
-	double t_sunrise = sunAnglesRadians[4];
-	double t_sunset = sunAnglesRadians[5];
-
-	// recall: if delt <= 0.0, do not interpolate sunrise and sunset hours, just use specified time stamp
-	if ( delt > 0
-		&& t_cur >= t_sunrise - delt/2.0
-		&& t_cur < t_sunrise + delt/2.0 )
-	{
-		// time step encompasses the sunrise
-		double t_calc = (t_sunrise + (t_cur+delt/2.0))/2.0; // midpoint of sunrise and end of timestep
-		int hr_calc = (int)t_calc;
-		double min_calc = (t_calc-hr_calc)*60.0;
-
-		timeStepSunPosition[0] = hr_calc;
-		timeStepSunPosition[1] = (int)min_calc;
-				
-		solarpos( year, month, day, hr_calc, min_calc, latitudeDegrees, longitudeDegrees, timezone, sunAnglesRadians );
-
-		timeStepSunPosition[2] = 2;				
-	}
-	else if ( delt > 0
-		&& t_cur > t_sunset - delt/2.0
-		&& t_cur <= t_sunset + delt/2.0 )
-	{
-		// timestep encompasses the sunset
-		double t_calc = ( (t_cur-delt/2.0) + t_sunset )/2.0; // midpoint of beginning of timestep and sunset
-		int hr_calc = (int)t_calc;
-		double min_calc = (t_calc-hr_calc)*60.0;
-
-		timeStepSunPosition[0] = hr_calc;
-		timeStepSunPosition[1] = (int)min_calc;
-				
-		solarpos( year, month, day, hr_calc, min_calc, latitudeDegrees, longitudeDegrees, timezone, sunAnglesRadians );
-
-		timeStepSunPosition[2] = 3;
-	}
-	else if (t_cur >= t_sunrise && t_cur <= t_sunset)
-	{
-		// timestep is not sunrise nor sunset, but sun is up  (calculate position at provided t_cur)			
-		timeStepSunPosition[0] = hour;
-		timeStepSunPosition[1] = (int)minute;
-		solarpos( year, month, day, hour, minute, latitudeDegrees, longitudeDegrees, timezone, sunAnglesRadians );
-		timeStepSunPosition[2] = 1;
-	}
+	if (noonSunAnglesRadians != 0)
+		solarpos_timestep( year, month, day, hour, minute, delt, latitudeDegrees, longitudeDegrees, timezone, noonSunAnglesRadians, sunAnglesRadians, timeStepSunPosition );
 	else
-	{	
-		// sun is down, assign sundown values
-		sunAnglesRadians[0] = -999*DTOR; //avoid returning a junk azimuth angle (return in radians)
-		sunAnglesRadians[1] = -999*DTOR; //avoid returning a junk zenith angle (return in radians)
-		sunAnglesRadians[2] = -999*DTOR; //avoid returning a junk elevation angle (return in radians)
-		timeStepSunPosition[0] = 0;
-		timeStepSunPosition[1] = 0;
-		timeStepSunPosition[2] = 0;
-	}
+		solarpos_timestep( year, month, day, hour, minute, delt, latitudeDegrees, longitudeDegrees, timezone, sunAnglesRadians, timeStepSunPosition );
 
-			
 	planeOfArrayIrradianceFront[0]=planeOfArrayIrradianceFront[1]=planeOfArrayIrradianceFront[2] = 0;
 	diffuseIrradianceFront[0]=diffuseIrradianceFront[1]=diffuseIrradianceFront[2] = 0;
 	surfaceAnglesRadians[0]=surfaceAnglesRadians[1]=surfaceAnglesRadians[2]=surfaceAnglesRadians[3]=surfaceAnglesRadians[4] = 0;
@@ -2552,6 +2676,11 @@ double ModifiedDISC(const double g[3], const double z[3], double td, double alt,
         dn = bmax * cm[i][j][k][l];
         dn = Max(0.0, dn);
     }   // End of if present global >= 1
+    else
+    {
+        dn = 0;
+        kt1[1] = 0;
+    }
 
     return kt1[1];
 }   // End of ModifiedDISC
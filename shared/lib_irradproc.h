@@ -93,6 +93,35 @@
 */
 void solarpos(int year,int month,int day,int hour,double minute,double lat,double lng,double tz,double sunn[9]);
 
+/**
+*   solarpos_timestep function calculates the effective sun position for a time step of duration delt.
+*   For time steps that contain the sunrise or sunset, the sun position is calculated at the midpoint of
+*   the portion of the time step when the sun is above the horizon, as described for solarpos().
+*
+* \param[in] year (e.g. 1986)
+* \param[in] month (1-12)
+* \param[in] day day of month
+* \param[in] hour hour of day local standard time (0-23)
+* \param[in] minute minutes past the hour, local standard time
+* \param[in] delt time step in hours, if less than zero do not interpolate sunrise and sunset hours
+* \param[in] lat latitude in degrees, north positive
+* \param[in] lng longitude in degrees, east positive
+* \param[in] tz time zone, west longitudes negative
+* \param[out] sun sun parameters as returned by solarpos()
+* \param[out] tsp[0] effective hour of day used for sun position
+* \param[out] tsp[1] effective minute of hour used for sun position
+* \param[out] tsp[2] is sun up?  (0=no, 1=midday, 2=sunup, 3=sundown)
+*/
+void solarpos_timestep(int year, int month, int day, int hour, double minute, double delt, double lat, double lng, double tz, double sun[9], int tsp[3]);
+
+/**
+*   Same as solarpos_timestep() above, with the sun position at noon of the day already calculated by solarpos(),
+*   for example by a daylight_mask.  The sun position is not calculated again for night time steps.
+*
+* \param[in] noon sun parameters returned by solarpos() at 12:00 of the day
+*/
+void solarpos_timestep(int year, int month, int day, int hour, double minute, double delt, double lat, double lng, double tz, const double noon[9], double sun[9], int tsp[3]);
+
 /**
 * incidence function calculates the incident angle of direct beam radiation to a surface.
 * The calculation is done for a given sun position, latitude, and surface orientation. 
@@ -198,6 +227,10 @@ void hdkr( double hextra, double dn, double df, double alb, double inc, double t
 * \param[out] gh Global Horizontal Irradiance (W/m2)
 * \param[out] poa calculated plane-of-array irradiances (beam, sky diffuse, ground diffuse) (W/m2)
 * \param[out] diffc diffuse components (isotropic, circumsolar, horizon) (W/m2)
+*
+* The average Kt' used when the sun is behind the surface is kept in pA for the rest of the half day, and a step
+* already stored in pA->results for the same pass by another subarray of the same orientation is copied rather than
+* decomposed again.
 * 
 */
 void poaDecomp( double wfPOA, double angle[], double sun[], double alb, poaDecompReq* pA, double &dn, double &df, double &gh, double poa[3], double diffc[3]);
@@ -272,6 +305,69 @@ double shadeFraction1x(double solazi, double solzen, double tilt, double azimuth
 double backtrack(double solazi, double solzen, double tilt, double azimuth, double rotlim, double gcr, double rotation);
 
 
+/**
+* \class daylight_mask
+*
+*  The daylight_mask class identifies night time steps, when the sun is below the horizon for the whole step,
+*  without calculating the sun position for each step.  Sunrise and sunset are calculated once per day from the
+*  sun position at noon, and the time steps are classified with the same rules as solarpos_timestep(), so a
+*  step is night exactly when solarpos_timestep() reports the sun down.  Time steps are expected in order.
+*/
+class daylight_mask
+{
+public:
+	/// delt_hr as in irrad::set_time()
+	daylight_mask(double lat, double lon, double tz, double delt_hr);
+
+	/// Return true if the sun is down for the whole time step, updates the noon sun position when the day changes
+	bool night(int year, int month, int day, int hour, double minute);
+
+	/// Sun position at noon of the day of the last call to night(), as returned by solarpos()
+	const double *noon() const { return m_noon; }
+
+private:
+	double m_lat, m_lon, m_tz, m_delt;
+	int m_year, m_month, m_day;
+	double m_noon[9];
+};
+
+/**
+* \class sunpos_cache
+*
+*  The sunpos_cache class stores the effective sun position for every record of a weather time series.
+*  The sun position only depends on the time stamps and the location, so it is calculated once with
+*  solarpos_timestep() and shared by every surface that is evaluated against the same weather data.
+*/
+class sunpos_cache
+{
+public:
+	/// Sun position for a single weather record
+	struct record
+	{
+		double azimuth;		///< sun azimuth in radians, measured east from north
+		double zenith;		///< sun zenith in radians
+		double elevation;	///< sun elevation in radians
+		double hextra;		///< extraterrestrial solar irradiance on horizontal (W/m2)
+		double sunrise;		///< sunrise in local standard time (hrs)
+		double sunset;		///< sunset in local standard time (hrs)
+		int sunup;			///< is sun up?  (0=no, 1=midday, 2=sunup, 3=sundown)
+	};
+
+	sunpos_cache() {}
+
+	/// Calculate the sun position for each weather record, delt_hr as in irrad::set_time()
+	void calc(const std::vector<weather_record> &records, double lat, double lon, double tz, double delt_hr);
+
+	/// Number of records in the cache
+	size_t size() const { return m_records.size(); }
+
+	/// Return the sun position for record index i
+	const record &operator[](size_t i) const { return m_records[i]; }
+
+private:
+	std::vector<record> m_records;
+};
+
 /**
 * \class irrad
 *
@@ -327,6 +423,7 @@ protected:
 	double diffuseIrradianceRear[3];		///< Rear-side diffuse irradiance for isotropic, circumsolar, and horizon (W/m2)
 	int timeStepSunPosition[3];				///< [0] effective hour of day used for sun position, [1] effective minute of hour used for sun position, [2] is sun up?  (0=no, 1=midday, 2=sunup, 3=sundown)
 	double planeOfArrayIrradianceRearAverage; ///< Average rear side plane-of-array irradiance (W/m2)
+	const double *noonSunAnglesRadians;		///< Sun angles at noon of the current day if already calculated, otherwise null
 
 public:
 
@@ -339,6 +436,9 @@ public:
 	/// Construct the irrad class with an Irradiance_IO() object and Subarray_IO() object
 	irrad(Irradiance_IO * , Subarray_IO *);
 
+	/// Construct the irrad class for a given weather record, rather than the current record held by the Irradiance_IO() object
+	irrad(Irradiance_IO *, Subarray_IO *, const weather_record &);
+
 	/// Initialize irrad member data
 	void setup();
 
@@ -372,6 +472,9 @@ public:
 	/// Set the plane-of-array irradiance from a pyronometer
 	void set_poa_pyranometer( double poa, poaDecompReq* );
 
+	/// Use the sun angles already calculated by solarpos() at noon of the day, which must remain valid until calc() is called
+	void set_noon_sun(const double sun[9]);
+
 	/// Function to overwrite internally calculated sun position values, primarily to enable testing against other libraries using different sun position calculations
 	void set_sun_component(size_t index, double value);
 
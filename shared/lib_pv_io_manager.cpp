@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -50,6 +51,53 @@ void PVIOManager::allocateOutputs(compute_module* cm)
 	m_PVSystemIO->AllocateOutputs(cm);
 }
 
+void PVIOManager::flushOutputs(compute_module* cm)
+{
+	m_IrradianceIO->outputs.flush(cm);
+	for (size_t subarray = 0; subarray < m_PVSystemIO->subarrayOutputs.size(); subarray++)
+		m_PVSystemIO->subarrayOutputs[subarray].flush(cm);
+	m_PVSystemIO->dcOutputs.flush(cm);
+	m_PVSystemIO->acOutputs.flush(cm);
+}
+
+void output_block::add(const std::string &name, output_column * column)
+{
+	m_names.push_back(name);
+	m_columns.push_back(column);
+}
+
+void output_block::allocate(size_t nsteps)
+{
+	const size_t perLine = cacheLineBytes / sizeof(ssc_number_t);
+	m_steps = nsteps;
+	m_stride = (m_names.size() + perLine - 1) / perLine * perLine;
+	m_storage.assign(m_stride * m_steps + perLine, 0);
+
+	// advance to the first element on a cache line boundary
+	size_t offset = (cacheLineBytes - reinterpret_cast<uintptr_t>(m_storage.data()) % cacheLineBytes) % cacheLineBytes;
+	m_data = m_storage.data() + offset / sizeof(ssc_number_t);
+
+	for (size_t j = 0; j < m_columns.size(); j++)
+		*m_columns[j] = output_column(m_data + j, m_stride);
+}
+
+void output_block::flush(compute_module * cm)
+{
+	if (!m_data)
+		return;
+
+	for (size_t j = 0; j < m_names.size(); j++)
+	{
+		ssc_number_t * p = cm->allocate(m_names[j], m_steps);
+		const ssc_number_t * column = m_data + j;
+		for (size_t i = 0; i < m_steps; i++)
+			p[i] = column[i * m_stride];
+		*m_columns[j] = output_column();
+	}
+	std::vector<ssc_number_t>().swap(m_storage);
+	m_data = 0;
+}
+
 Irradiance_IO * PVIOManager::getIrradianceIO()  { return m_IrradianceIO.get(); }
 compute_module * PVIOManager::getComputeModule()  { return m_computeModule; }
 Subarray_IO * PVIOManager::getSubarrayIO(size_t subarrayNumber)  { return m_SubarraysIO[subarrayNumber].get(); }
@@ -228,33 +276,36 @@ void Irradiance_IO::checkWeatherFile(compute_module * cm, std::string cmName)
 
 void Irradiance_IO::AllocateOutputs(compute_module* cm)
 {
-	p_weatherFileGHI = cm->allocate("gh", numberOfWeatherFileRecords);
-	p_weatherFileDNI = cm->allocate("dn", numberOfWeatherFileRecords);
-	p_weatherFileDHI = cm->allocate("df", numberOfWeatherFileRecords);
-	p_sunPositionTime = cm->allocate("sunpos_hour", numberOfWeatherFileRecords);
-	p_weatherFileWindSpeed = cm->allocate("wspd", numberOfWeatherFileRecords);
-	p_weatherFileAmbientTemp = cm->allocate("tdry", numberOfWeatherFileRecords);
-	p_weatherFileAlbedo = cm->allocate("alb", numberOfWeatherFileRecords);
-	p_weatherFileSnowDepth = cm->allocate("snowdepth", numberOfWeatherFileRecords);
+	outputs.add("gh", &p_weatherFileGHI);
+	outputs.add("dn", &p_weatherFileDNI);
+	outputs.add("df", &p_weatherFileDHI);
+	outputs.add("sunpos_hour", &p_sunPositionTime);
+	outputs.add("wspd", &p_weatherFileWindSpeed);
+	outputs.add("tdry", &p_weatherFileAmbientTemp);
+	outputs.add("alb", &p_weatherFileAlbedo);
+	outputs.add("snowdepth", &p_weatherFileSnowDepth);
 
 	// If using input POA, must have POA for every subarray or assume POA applies to each subarray
+	p_weatherFilePOA.resize(numberOfSubarrays);
 	for (size_t subarray = 0; subarray != numberOfSubarrays; subarray++) {
 		std::string wfpoa = "wfpoa" + util::to_string(static_cast<int>(subarray + 1));
-		p_weatherFilePOA.push_back(cm->allocate(wfpoa, numberOfWeatherFileRecords));
+		outputs.add(wfpoa, &p_weatherFilePOA[subarray]);
 	}
 
 	//set up the calculated components of irradiance such that they aren't reported if they aren't assigned
 	//three possible calculated irradiance: gh, df, dn
-	if (radiationMode == DN_DF) p_IrradianceCalculated[0] = cm->allocate("gh_calc", numberOfWeatherFileRecords); //don't calculate global for POA models
-	if (radiationMode == DN_GH || radiationMode == POA_R || radiationMode == POA_P) p_IrradianceCalculated[1] = cm->allocate("df_calc", numberOfWeatherFileRecords);
-	if (radiationMode == GH_DF || radiationMode == POA_R || radiationMode == POA_P) p_IrradianceCalculated[2] = cm->allocate("dn_calc", numberOfWeatherFileRecords);
+	if (radiationMode == DN_DF) outputs.add("gh_calc", &p_IrradianceCalculated[0]); //don't calculate global for POA models
+	if (radiationMode == DN_GH || radiationMode == POA_R || radiationMode == POA_P) outputs.add("df_calc", &p_IrradianceCalculated[1]);
+	if (radiationMode == GH_DF || radiationMode == POA_R || radiationMode == POA_P) outputs.add("dn_calc", &p_IrradianceCalculated[2]);
 
 	//output arrays for solar position calculations- same for all four subarrays
-	p_sunZenithAngle = cm->allocate("sol_zen", numberOfWeatherFileRecords);
-	p_sunAltitudeAngle = cm->allocate("sol_alt", numberOfWeatherFileRecords);
-	p_sunAzimuthAngle = cm->allocate("sol_azi", numberOfWeatherFileRecords);
-	p_absoluteAirmass = cm->allocate("airmass", numberOfWeatherFileRecords);
-	p_sunUpOverHorizon = cm->allocate("sunup", numberOfWeatherFileRecords);
+	outputs.add("sol_zen", &p_sunZenithAngle);
+	outputs.add("sol_alt", &p_sunAltitudeAngle);
+	outputs.add("sol_azi", &p_sunAzimuthAngle);
+	outputs.add("airmass", &p_absoluteAirmass);
+	outputs.add("sunup", &p_sunUpOverHorizon);
+
+	outputs.allocate(numberOfWeatherFileRecords);
 }
 
 void Irradiance_IO::AssignOutputs(compute_module* cm)
@@ -520,55 +571,92 @@ void PVSystem_IO::AllocateOutputs(compute_module* cm)
 	size_t numberOfLifetimeRecords = Simulation->numberOfSteps;
 	size_t numberOfYears = Simulation->numberOfYears;
 
+	struct subarrayOutput {
+		const char * name;
+		std::vector<output_column> * column;
+	};
+	subarrayOutput subarrayOutputList[] = {
+		{ "aoi", &p_angleOfIncidence },
+		{ "aoi_modifier", &p_angleOfIncidenceModifier },
+		{ "surf_tilt", &p_surfaceTilt },
+		{ "surf_azi", &p_surfaceAzimuth },
+		{ "axisrot", &p_axisRotation },
+		{ "idealrot", &p_idealRotation },
+		{ "poa_nom", &p_poaNominalFront },
+		{ "poa_shaded", &p_poaShadedFront },
+		{ "poa_shaded_soiled", &p_poaShadedSoiledFront },
+		{ "poa_eff_beam", &p_poaBeamFront },
+		{ "poa_eff_diff", &p_poaDiffuseFront },
+		{ "poa_eff", &p_poaTotal },
+		{ "poa_rear", &p_poaRear },
+		{ "poa_front", &p_poaFront },
+		{ "soiling_derate", &p_derateSoiling },
+		{ "beam_shading_factor", &p_beamShadingFactor },
+		{ "celltemp", &p_temperatureCell },
+		{ "modeff", &p_moduleEfficiency },
+		{ "dc_voltage", &p_dcStringVoltage },
+		{ "voc", &p_voltageOpenCircuit },
+		{ "isc", &p_currentShortCircuit },
+		{ "dc_gross", &p_dcPowerGross },
+		{ "linear_derate", &p_derateLinear },
+		{ "ss_derate", &p_derateSelfShading },
+		{ "ss_diffuse_derate", &p_derateSelfShadingDiffuse },
+		{ "ss_reflected_derate", &p_derateSelfShadingReflected }
+	};
+	subarrayOutput snowOutputList[] = {
+		{ "snow_loss", &p_snowLoss },
+		{ "snow_coverage", &p_snowCoverage }
+	};
+	// ShadeDB validation, named shadedb_<prefix><name>
+	subarrayOutput shadeDBOutputList[] = {
+		{ "gpoa", &p_shadeDB_GPOA },
+		{ "dpoa", &p_shadeDB_DPOA },
+		{ "pv_cell_temp", &p_shadeDB_temperatureCell },
+		{ "mods_per_str", &p_shadeDB_modulesPerString },
+		{ "str_vmp_stc", &p_shadeDB_voltageMaxPowerSTC },
+		{ "mppt_lo", &p_shadeDB_voltageMPPTLow },
+		{ "mppt_hi", &p_shadeDB_voltageMPPTHigh }
+	};
+
+	// size the columns up front, the blocks keep pointers to them
+	size_t numberOfEnabledSubarrays = 0;
+	for (size_t subarray = 0; subarray < Subarrays.size(); subarray++)
+		if (Subarrays[subarray]->enable)
+			numberOfEnabledSubarrays++;
+	for (auto & output : subarrayOutputList)
+		output.column->resize(numberOfEnabledSubarrays);
+	for (auto & output : shadeDBOutputList)
+		output.column->resize(numberOfEnabledSubarrays);
+	p_shadeDBShadeFraction.resize(numberOfEnabledSubarrays);
+	if (enableSnowModel) {
+		for (auto & output : snowOutputList)
+			output.column->resize(numberOfEnabledSubarrays);
+	}
+	subarrayOutputs.resize(numberOfEnabledSubarrays);
+
+	size_t nn = 0;
 	for (size_t subarray = 0; subarray < Subarrays.size(); subarray++)
 	{
 		if (Subarrays[subarray]->enable)
 		{
 			std::string prefix = Subarrays[subarray]->prefix;
-			p_angleOfIncidence.push_back(cm->allocate(prefix + "aoi", numberOfWeatherFileRecords));
-			p_angleOfIncidenceModifier.push_back(cm->allocate(prefix + "aoi_modifier", numberOfWeatherFileRecords));
-			p_surfaceTilt.push_back(cm->allocate(prefix + "surf_tilt", numberOfWeatherFileRecords));
-			p_surfaceAzimuth.push_back(cm->allocate(prefix + "surf_azi", numberOfWeatherFileRecords));
-			p_axisRotation.push_back(cm->allocate(prefix + "axisrot", numberOfWeatherFileRecords));
-			p_idealRotation.push_back(cm->allocate(prefix + "idealrot", numberOfWeatherFileRecords));
-			p_poaNominalFront.push_back(cm->allocate(prefix + "poa_nom", numberOfWeatherFileRecords));
-			p_poaShadedFront.push_back(cm->allocate(prefix + "poa_shaded", numberOfWeatherFileRecords));
-			p_poaShadedSoiledFront.push_back(cm->allocate(prefix + "poa_shaded_soiled", numberOfWeatherFileRecords));
-			p_poaBeamFront.push_back(cm->allocate(prefix + "poa_eff_beam", numberOfWeatherFileRecords));
-			p_poaDiffuseFront.push_back(cm->allocate(prefix + "poa_eff_diff", numberOfWeatherFileRecords));
-			p_poaTotal.push_back(cm->allocate(prefix + "poa_eff", numberOfWeatherFileRecords));
-			p_poaRear.push_back(cm->allocate(prefix + "poa_rear", numberOfWeatherFileRecords));
-			p_poaFront.push_back(cm->allocate(prefix + "poa_front", numberOfWeatherFileRecords));
-			p_derateSoiling.push_back(cm->allocate(prefix + "soiling_derate", numberOfWeatherFileRecords));
-			p_beamShadingFactor.push_back(cm->allocate(prefix + "beam_shading_factor", numberOfWeatherFileRecords));
-			p_temperatureCell.push_back(cm->allocate(prefix + "celltemp", numberOfWeatherFileRecords));
-			p_moduleEfficiency.push_back(cm->allocate(prefix + "modeff", numberOfWeatherFileRecords));
-			p_dcStringVoltage.push_back(cm->allocate(prefix + "dc_voltage", numberOfWeatherFileRecords));
-			p_voltageOpenCircuit.push_back(cm->allocate(prefix + "voc", numberOfWeatherFileRecords));
-			p_currentShortCircuit.push_back(cm->allocate(prefix + "isc", numberOfWeatherFileRecords));
-			p_dcPowerGross.push_back(cm->allocate(prefix + "dc_gross", numberOfWeatherFileRecords));
-			p_derateLinear.push_back(cm->allocate(prefix + "linear_derate", numberOfWeatherFileRecords));
-			p_derateSelfShading.push_back(cm->allocate(prefix + "ss_derate", numberOfWeatherFileRecords));
-			p_derateSelfShadingDiffuse.push_back(cm->allocate(prefix + "ss_diffuse_derate", numberOfWeatherFileRecords));
-			p_derateSelfShadingReflected.push_back(cm->allocate(prefix + "ss_reflected_derate", numberOfWeatherFileRecords));
+			output_block & block = subarrayOutputs[nn];
+			for (auto & output : subarrayOutputList)
+				block.add(prefix + output.name, &(*output.column)[nn]);
 
 			if (enableSnowModel) {
-				p_snowLoss.push_back(cm->allocate(prefix + "snow_loss", numberOfWeatherFileRecords));
-				p_snowCoverage.push_back(cm->allocate(prefix + "snow_coverage", numberOfWeatherFileRecords));
+				for (auto & output : snowOutputList)
+					block.add(prefix + output.name, &(*output.column)[nn]);
 			}
 
 			if (Subarrays[subarray]->enableSelfShadingOutputs)
 			{
-				// ShadeDB validation
-				p_shadeDB_GPOA.push_back(cm->allocate("shadedb_" + prefix + "gpoa", numberOfWeatherFileRecords));
-				p_shadeDB_DPOA.push_back(cm->allocate("shadedb_" + prefix + "dpoa", numberOfWeatherFileRecords));
-				p_shadeDB_temperatureCell.push_back(cm->allocate("shadedb_" + prefix + "pv_cell_temp", numberOfWeatherFileRecords));
-				p_shadeDB_modulesPerString.push_back(cm->allocate("shadedb_" + prefix + "mods_per_str", numberOfWeatherFileRecords));
-				p_shadeDB_voltageMaxPowerSTC.push_back(cm->allocate("shadedb_" + prefix + "str_vmp_stc", numberOfWeatherFileRecords));
-				p_shadeDB_voltageMPPTLow.push_back(cm->allocate("shadedb_" + prefix + "mppt_lo", numberOfWeatherFileRecords));
-				p_shadeDB_voltageMPPTHigh.push_back(cm->allocate("shadedb_" + prefix + "mppt_hi", numberOfWeatherFileRecords));
+				for (auto & output : shadeDBOutputList)
+					block.add("shadedb_" + prefix + output.name, &(*output.column)[nn]);
 			}
-			p_shadeDBShadeFraction.push_back(cm->allocate("shadedb_" + prefix + "shade_frac", numberOfWeatherFileRecords));
+			block.add("shadedb_" + prefix + "shade_frac", &p_shadeDBShadeFraction[nn]);
+			block.allocate(numberOfWeatherFileRecords);
+			nn++;
 		}
 	}
 
@@ -578,32 +666,31 @@ void PVSystem_IO::AllocateOutputs(compute_module* cm)
 		p_dcPowerNetPerMppt.push_back(cm->allocate("inverterMppt" + std::to_string(mppt_input + 1) + "_NetDCPower", numberOfLifetimeRecords));
 	}
 
-	p_transformerNoLoadLoss = cm->allocate("xfmr_nll_ts", numberOfWeatherFileRecords);
-	p_transformerLoadLoss = cm->allocate("xfmr_ll_ts", numberOfWeatherFileRecords);
-	p_transformerLoss = cm->allocate("xfmr_loss_ts", numberOfWeatherFileRecords);
-
-	p_poaFrontNominalTotal = cm->allocate("poa_nom", numberOfWeatherFileRecords);
-	p_poaFrontBeamNominalTotal = cm->allocate("poa_beam_nom", numberOfWeatherFileRecords);
-	p_poaFrontBeamTotal = cm->allocate("poa_beam_eff", numberOfWeatherFileRecords);
-	p_poaFrontShadedTotal = cm->allocate("poa_shaded", numberOfWeatherFileRecords);
-	p_poaFrontShadedSoiledTotal = cm->allocate("poa_shaded_soiled", numberOfWeatherFileRecords);
-	p_poaFrontTotal = cm->allocate("poa_front", numberOfWeatherFileRecords);
-	p_poaRearTotal = cm->allocate("poa_rear", numberOfWeatherFileRecords);
-	p_poaTotalAllSubarrays = cm->allocate("poa_eff", numberOfWeatherFileRecords);
-
-	p_snowLossTotal = cm->allocate("dc_snow_loss", numberOfWeatherFileRecords);
-
-	p_inverterEfficiency = cm->allocate("inv_eff", numberOfWeatherFileRecords);
-	p_inverterClipLoss = cm->allocate("inv_cliploss", numberOfWeatherFileRecords);
-	p_inverterMPPTLoss = cm->allocate("dc_invmppt_loss", numberOfWeatherFileRecords);
-
-	p_inverterPowerConsumptionLoss = cm->allocate("inv_psoloss", numberOfWeatherFileRecords);
-	p_inverterNightTimeLoss = cm->allocate("inv_pntloss", numberOfWeatherFileRecords);
-	p_inverterThermalLoss = cm->allocate("inv_tdcloss", numberOfWeatherFileRecords);
-	p_inverterTotalLoss = cm->allocate("inv_total_loss", numberOfWeatherFileRecords);
+	dcOutputs.add("poa_nom", &p_poaFrontNominalTotal);
+	dcOutputs.add("poa_beam_nom", &p_poaFrontBeamNominalTotal);
+	dcOutputs.add("poa_beam_eff", &p_poaFrontBeamTotal);
+	dcOutputs.add("poa_shaded", &p_poaFrontShadedTotal);
+	dcOutputs.add("poa_shaded_soiled", &p_poaFrontShadedSoiledTotal);
+	dcOutputs.add("poa_front", &p_poaFrontTotal);
+	dcOutputs.add("poa_rear", &p_poaRearTotal);
+	dcOutputs.add("poa_eff", &p_poaTotalAllSubarrays);
+	dcOutputs.add("dc_snow_loss", &p_snowLossTotal);
+	dcOutputs.add("dc_invmppt_loss", &p_inverterMPPTLoss);
+	dcOutputs.allocate(numberOfWeatherFileRecords);
+
+	acOutputs.add("xfmr_nll_ts", &p_transformerNoLoadLoss);
+	acOutputs.add("xfmr_ll_ts", &p_transformerLoadLoss);
+	acOutputs.add("xfmr_loss_ts", &p_transformerLoss);
+	acOutputs.add("inv_eff", &p_inverterEfficiency);
+	acOutputs.add("inv_cliploss", &p_inverterClipLoss);
+	acOutputs.add("inv_psoloss", &p_inverterPowerConsumptionLoss);
+	acOutputs.add("inv_pntloss", &p_inverterNightTimeLoss);
+	acOutputs.add("inv_tdcloss", &p_inverterThermalLoss);
+	acOutputs.add("inv_total_loss", &p_inverterTotalLoss);
+	acOutputs.add("ac_wiring_loss", &p_acWiringLoss);
+	acOutputs.add("ac_transmission_loss", &p_transmissionLoss);
+	acOutputs.allocate(numberOfWeatherFileRecords);
 
-	p_acWiringLoss = cm->allocate("ac_wiring_loss", numberOfWeatherFileRecords);
-	p_transmissionLoss = cm->allocate("ac_transmission_loss", numberOfWeatherFileRecords);
 	p_systemDCPower = cm->allocate("dc_net", numberOfLifetimeRecords);
 	p_systemACPower = cm->allocate("gen", numberOfLifetimeRecords);
 
@@ -762,6 +849,8 @@ Module_IO::Module_IO(compute_module* cm, std::string cmName, double dcLoss)
 			mountingSpecificCellTemp.Nrows = cm->as_integer("cec_array_rows");
 			mountingSpecificCellTemp.Ncols = cm->as_integer("cec_array_cols");
 			mountingSpecificCellTemp.TbackInteg = cm->as_double("cec_backside_temp");
+			// each subarray has its own model, evaluated by one thread at a time in time order
+			mountingSpecificCellTemp.WarmStart = true;
 
 			cellTempModel = &mountingSpecificCellTemp;
 			mountingSpecificCellTemperatureForceNoPOA = true;
@@ -1,6 +1,7 @@
 #ifndef __LIB_PV_IO_MANAGER_H__
 #define __LIB_PV_IO_MANAGER_H__
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <math.h>
@@ -89,6 +90,65 @@ public:
 	}
 };
 
+/**
+* \class output_column
+*
+* A view of one timeseries output held in an output_block.  Consecutive steps of the output are one row
+* of the block apart, and the column is indexed by time step just like the var_table array it is copied to.
+*/
+class output_column
+{
+public:
+	output_column() : m_data(0), m_stride(0) {}
+	output_column(ssc_number_t * data, size_t stride) : m_data(data), m_stride(stride) {}
+
+	ssc_number_t & operator[](size_t step) { return m_data[step * m_stride]; }
+	const ssc_number_t & operator[](size_t step) const { return m_data[step * m_stride]; }
+
+	/// Whether the output is registered in a block that is currently allocated
+	bool enabled() const { return m_data != 0; }
+
+private:
+	ssc_number_t * m_data;
+	size_t m_stride;
+};
+
+/**
+* \class output_block
+*
+* This class stores the timeseries outputs written by one stage of the PV model in a single block, one row per time step,
+* so that the outputs written together in a step share a few cache lines rather than each touching its own array.
+* Rows are padded to whole cache lines and the block is cache-line aligned.  Only registered outputs take up space,
+* and they are copied to var_table arrays by flush once the simulation no longer writes them.
+*/
+class output_block
+{
+public:
+	output_block() : m_data(0), m_stride(0), m_steps(0) {}
+
+	/// Register an output, which is bound to column when the block is allocated
+	void add(const std::string &name, output_column * column);
+
+	/// Allocate zeroed rows for nsteps time steps and bind all registered columns
+	void allocate(size_t nsteps);
+
+	/// Copy each output to a var_table array of the same name, then release the block and unbind the columns
+	void flush(compute_module * cm);
+
+	/// The number of registered outputs
+	size_t size() const { return m_names.size(); }
+
+	static const size_t cacheLineBytes = 64;
+
+private:
+	std::vector<std::string> m_names;
+	std::vector<output_column *> m_columns;
+	std::vector<ssc_number_t> m_storage;
+	ssc_number_t * m_data;		///< First aligned element of m_storage
+	size_t m_stride;			///< Elements per row
+	size_t m_steps;
+};
+
 
 /**
 * \class PVIOManager
@@ -109,6 +169,9 @@ public:
 	/// Allocate Outputs
 	void allocateOutputs(compute_module*  cm);
 
+	/// Copy the timeseries outputs held in output blocks to the compute module, after the last time step is written
+	void flushOutputs(compute_module* cm);
+
 	/// Return pointer to compute module
 	compute_module * getComputeModule();
 
@@ -200,21 +263,23 @@ struct Irradiance_IO
 	std::vector<double> userSpecifiedMonthlyAlbedo;				  /// User can provide monthly ground albedo values (0-1)
 	
 	// Irradiance data Outputs (p_ is just a convention to organize all pointer outputs)
-	ssc_number_t * p_weatherFileGHI;			/// The Global Horizonal Irradiance from the weather file [W/m2]
-	ssc_number_t * p_weatherFileDNI;			/// The Direct Normal (Beam) Irradiance from the weather file [W/m2]
-	ssc_number_t * p_weatherFileDHI;			/// The Direct Normal (Beam) Irradiance from the weather file [W/m2]
-	std::vector<ssc_number_t *> p_weatherFilePOA; /// The Plane of Array Irradiance from the weather file [W/m2]
-	ssc_number_t * p_sunPositionTime;			/// <UNSURE>
-	ssc_number_t * p_weatherFileWindSpeed;		/// The Wind Speed from the weather file [m/s]
-	ssc_number_t * p_weatherFileAmbientTemp;	/// The ambient temperature from the weather file [C]
-	ssc_number_t * p_weatherFileAlbedo;			/// The ground albedo from the weather file
-	ssc_number_t * p_weatherFileSnowDepth;		/// The snow depth from the weather file
-	ssc_number_t * p_IrradianceCalculated[3];	/// The calculated components of the irradiance [W/m2]
-	ssc_number_t * p_sunZenithAngle;			/// The calculate sun zenith angle [degrees]
-	ssc_number_t * p_sunAltitudeAngle;			/// The calculated sun altitude angle [degrees]
-	ssc_number_t * p_sunAzimuthAngle;			/// The calculated sun azimuth angle [degrees]
-	ssc_number_t * p_absoluteAirmass;			/// The calculated absolute airmass
-	ssc_number_t * p_sunUpOverHorizon;			/// The calculation of whether the sun is up over the horizon
+	output_column p_weatherFileGHI;			/// The Global Horizonal Irradiance from the weather file [W/m2]
+	output_column p_weatherFileDNI;			/// The Direct Normal (Beam) Irradiance from the weather file [W/m2]
+	output_column p_weatherFileDHI;			/// The Direct Normal (Beam) Irradiance from the weather file [W/m2]
+	std::vector<output_column> p_weatherFilePOA; /// The Plane of Array Irradiance from the weather file [W/m2]
+	output_column p_sunPositionTime;			/// <UNSURE>
+	output_column p_weatherFileWindSpeed;		/// The Wind Speed from the weather file [m/s]
+	output_column p_weatherFileAmbientTemp;	/// The ambient temperature from the weather file [C]
+	output_column p_weatherFileAlbedo;			/// The ground albedo from the weather file
+	output_column p_weatherFileSnowDepth;		/// The snow depth from the weather file
+	output_column p_IrradianceCalculated[3];	/// The calculated components of the irradiance [W/m2]
+	output_column p_sunZenithAngle;			/// The calculate sun zenith angle [degrees]
+	output_column p_sunAltitudeAngle;			/// The calculated sun altitude angle [degrees]
+	output_column p_sunAzimuthAngle;			/// The calculated sun azimuth angle [degrees]
+	output_column p_absoluteAirmass;			/// The calculated absolute airmass
+	output_column p_sunUpOverHorizon;			/// The calculation of whether the sun is up over the horizon
+
+	output_block outputs;						/// Storage for the timeseries outputs above
 };
 
 struct Simulation_IO
@@ -274,50 +339,50 @@ struct PVSystem_IO
 	ssc_number_t transformerNoLoadLossFraction;
 
 	// Timeseries Subarray Level Outputs
-	std::vector<ssc_number_t *> p_angleOfIncidence; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_angleOfIncidenceModifier; /// The weighted angle of incidence modifier for total poa irradiation on subarrray
-	std::vector<ssc_number_t *> p_surfaceTilt; ///The tilt of the surface [degrees]   
-	std::vector<ssc_number_t *> p_surfaceAzimuth; ///The azimuth of the surface [degrees]   
-	std::vector<ssc_number_t *> p_axisRotation;     
-	std::vector<ssc_number_t *> p_idealRotation; 
-	std::vector<ssc_number_t *> p_poaNominalFront;     
-	std::vector<ssc_number_t *> p_poaShadedFront;		
-	std::vector<ssc_number_t *> p_poaShadedSoiledFront;  
-	std::vector<ssc_number_t *> p_poaBeamFront; 
-	std::vector<ssc_number_t *> p_poaDiffuseFront; 
-	std::vector<ssc_number_t *> p_poaFront; 
-	std::vector<ssc_number_t *> p_poaTotal; 
-	std::vector<ssc_number_t *> p_poaRear; 
-	std::vector<ssc_number_t *> p_derateSoiling; 
-	std::vector<ssc_number_t *> p_beamShadingFactor; 
-	std::vector<ssc_number_t *> p_temperatureCell; 
-	std::vector<ssc_number_t *> p_moduleEfficiency; 
-	std::vector<ssc_number_t *> p_dcStringVoltage; /// An output vector containing dc string voltage for each subarray [V]
-	std::vector<ssc_number_t *> p_voltageOpenCircuit; /// Open circuit voltage of a string in the subarray [V]
-	std::vector<ssc_number_t *> p_currentShortCircuit; 
-	std::vector<ssc_number_t *> p_dcPowerGross; 
-	std::vector<ssc_number_t *> p_derateLinear; 
-	std::vector<ssc_number_t *> p_derateSelfShading; 
-	std::vector<ssc_number_t *> p_derateSelfShadingDiffuse;
-	std::vector<ssc_number_t *> p_derateSelfShadingReflected; 
-	std::vector<ssc_number_t *> p_shadeDBShadeFraction; 
+	std::vector<output_column> p_angleOfIncidence; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_angleOfIncidenceModifier; /// The weighted angle of incidence modifier for total poa irradiation on subarrray
+	std::vector<output_column> p_surfaceTilt; ///The tilt of the surface [degrees]   
+	std::vector<output_column> p_surfaceAzimuth; ///The azimuth of the surface [degrees]   
+	std::vector<output_column> p_axisRotation;     
+	std::vector<output_column> p_idealRotation; 
+	std::vector<output_column> p_poaNominalFront;     
+	std::vector<output_column> p_poaShadedFront;		
+	std::vector<output_column> p_poaShadedSoiledFront;  
+	std::vector<output_column> p_poaBeamFront; 
+	std::vector<output_column> p_poaDiffuseFront; 
+	std::vector<output_column> p_poaFront; 
+	std::vector<output_column> p_poaTotal; 
+	std::vector<output_column> p_poaRear; 
+	std::vector<output_column> p_derateSoiling; 
+	std::vector<output_column> p_beamShadingFactor; 
+	std::vector<output_column> p_temperatureCell; 
+	std::vector<output_column> p_moduleEfficiency; 
+	std::vector<output_column> p_dcStringVoltage; /// An output vector containing dc string voltage for each subarray [V]
+	std::vector<output_column> p_voltageOpenCircuit; /// Open circuit voltage of a string in the subarray [V]
+	std::vector<output_column> p_currentShortCircuit; 
+	std::vector<output_column> p_dcPowerGross; 
+	std::vector<output_column> p_derateLinear; 
+	std::vector<output_column> p_derateSelfShading; 
+	std::vector<output_column> p_derateSelfShadingDiffuse;
+	std::vector<output_column> p_derateSelfShadingReflected; 
+	std::vector<output_column> p_shadeDBShadeFraction; 
 
 	// MPPT level outputs
 	std::vector<ssc_number_t *> p_mpptVoltage; /// An output vector containing input DC voltage in V to each mppt input
 	std::vector<ssc_number_t *> p_dcPowerNetPerMppt; /// An output vector containing Net DC Power in W for each mppt input 
 
 	// Snow Model outputs
-	std::vector<ssc_number_t *> p_snowLoss; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_snowCoverage; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_snowLoss; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_snowCoverage; /// The angle of incidence of the subarray [degrees]
 
 	// Shade Database Validation
-	std::vector<ssc_number_t *> p_shadeDB_GPOA; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_shadeDB_DPOA; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_shadeDB_temperatureCell; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_shadeDB_modulesPerString; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_shadeDB_voltageMaxPowerSTC; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_shadeDB_voltageMPPTLow; /// The angle of incidence of the subarray [degrees]
-	std::vector<ssc_number_t *> p_shadeDB_voltageMPPTHigh; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_GPOA; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_DPOA; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_temperatureCell; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_modulesPerString; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_voltageMaxPowerSTC; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_voltageMPPTLow; /// The angle of incidence of the subarray [degrees]
+	std::vector<output_column> p_shadeDB_voltageMPPTHigh; /// The angle of incidence of the subarray [degrees]
 
 	// Degradation
 	ssc_number_t *p_dcDegradationFactor;
@@ -325,43 +390,58 @@ struct PVSystem_IO
 	ssc_number_t *p_acLifetimeLosses;
 
 	// transformer loss outputs (single array)
-	ssc_number_t *p_transformerNoLoadLoss;
-	ssc_number_t *p_transformerLoadLoss;
-	ssc_number_t *p_transformerLoss;
+	output_column p_transformerNoLoadLoss;
+	output_column p_transformerLoadLoss;
+	output_column p_transformerLoss;
 
 	// outputs summed across all subarrays (some could be moved to other structures)
-	ssc_number_t *p_poaFrontNominalTotal;
-	ssc_number_t *p_poaFrontBeamNominalTotal;
-	ssc_number_t *p_poaFrontBeamTotal;
-	ssc_number_t *p_poaFrontShadedTotal;
-	ssc_number_t *p_poaFrontShadedSoiledTotal;
-	ssc_number_t *p_poaRearTotal;
-	ssc_number_t *p_poaFrontTotal;
-	ssc_number_t *p_poaTotalAllSubarrays;
+	output_column p_poaFrontNominalTotal;
+	output_column p_poaFrontBeamNominalTotal;
+	output_column p_poaFrontBeamTotal;
+	output_column p_poaFrontShadedTotal;
+	output_column p_poaFrontShadedSoiledTotal;
+	output_column p_poaRearTotal;
+	output_column p_poaFrontTotal;
+	output_column p_poaTotalAllSubarrays;
 
 
-	ssc_number_t *p_snowLossTotal;
-	ssc_number_t *p_inverterEfficiency;
-	ssc_number_t *p_inverterClipLoss;
-	ssc_number_t *p_inverterMPPTLoss;
+	output_column p_snowLossTotal;
+	output_column p_inverterEfficiency;
+	output_column p_inverterClipLoss;
+	output_column p_inverterMPPTLoss;
 
-	ssc_number_t *p_inverterPowerConsumptionLoss;
-	ssc_number_t *p_inverterNightTimeLoss;
-	ssc_number_t *p_inverterThermalLoss;
-	ssc_number_t *p_inverterTotalLoss;
+	output_column p_inverterPowerConsumptionLoss;
+	output_column p_inverterNightTimeLoss;
+	output_column p_inverterThermalLoss;
+	output_column p_inverterTotalLoss;
 
-	ssc_number_t *p_acWiringLoss;
-	ssc_number_t *p_transmissionLoss;
+	output_column p_acWiringLoss;
+	output_column p_transmissionLoss;
 
 	ssc_number_t *p_systemDCPower;
 	ssc_number_t *p_systemACPower;
+
+	// Storage for the timeseries outputs of each stage, lifetime outputs are allocated in the compute module directly
+	std::vector<output_block> subarrayOutputs;	///< Per subarray outputs, one block for each subarray
+	output_block dcOutputs;						///< Outputs summed over the subarrays in the DC loop
+	output_block acOutputs;						///< Inverter, wiring and transformer outputs in the AC loop
 };
 
 
+// decomposition of one time step, shared by subarrays that decompose the same POA input onto the same surface
+struct poaDecompResult {
+	std::atomic<size_t> stored; // pass + 1 of the simulation year the result was stored for, 0 if never stored
+	double dn, df, gh;
+	double poa[3];
+	double diffc[3];
+};
+
 // allow for the poa decomp model to take all daily POA measurements into consideration
 struct poaDecompReq {
-	poaDecompReq() : i(0), dayStart(0), stepSize(1), stepScale('h'), doy(-1) {}
+	poaDecompReq() : i(0), pass(0), dayStart(0), stepSize(1), stepScale('h'), doy(-1), results(0), nResults(0), storeResults(false),
+		ktpStart(0), ktpStop(0), ktpDoy(-1), ktpTDew(0), ktpAlb(0), ktpAvg(0) {}
 	size_t i; // Current time index
+	size_t pass; // Simulation year of the current time index
 	size_t dayStart; // time index corresponding to the start of the current day
 	double stepSize;
 	char stepScale; // indicates whether time steps are hours (h) or minutes (m)
@@ -373,6 +453,18 @@ struct poaDecompReq {
 	double tDew;
 	int doy;
 	double elev;
+
+	// Results for each time index shared with other subarrays of the same orientation, null if not shared.
+	// Only the subarray with storeResults writes them, the others use a result once it is stored for the current index and pass,
+	// since every pass over the years of a lifetime simulation reuses the same indices.
+	poaDecompResult* results;
+	size_t nResults;
+	bool storeResults;
+
+	// The average Kt' over the last half day decomposed with the sun behind the surface, and what it depends on
+	size_t ktpStart, ktpStop;
+	int ktpDoy;
+	double ktpTDew, ktpAlb, ktpAvg;
 };
 
 /**
@@ -440,6 +532,7 @@ public:
 	flag usePOAFromWeatherFile;			// Flag for whether or not a shading model has been selected that means POA can't be used directly for that subarray
 	ssinputs selfShadingInputs;			// Inputs and calculation methods for self-shading of the subarray
 	ssoutputs selfShadingOutputs;		// Outputs for the self-shading of the subarray
+	ss_table selfShadingTable;			// Optional precomputed self-shading geometry of the subarray
 	shading_factor_calculator shadeCalculator; // The shading calculator model for self-shading
 	flag subarrayEnableSnow;            //a copy of the enableSnowModel flag has to exist in each subarray for setting up snow model inputs specific to each subarray
 	pvsnowmodel snowModel;				// A structure to store the geometry inputs for the snow model for this subarray- even though the snow model is system wide, its effect is subarray-dependent
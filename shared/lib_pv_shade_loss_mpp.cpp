@@ -65,7 +65,51 @@ typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int uint;
 
-short ShadeDB8_mpp::get_vmpp(size_t i)
+// database offsets and binomial coefficients, which only depend on the layout of the database
+struct ShadeDB8_tables
+{
+	size_t binomial[19][9];		// binomial[n][k] = n choose k
+	size_t offset[9][11][11];	// first row for N strings, diffuse fraction d and maximum string shade t
+
+	ShadeDB8_tables()
+	{
+		for (size_t n = 0; n < 19; n++)
+		{
+			for (size_t k = 0; k < 9; k++)
+			{
+				if (k == 0)
+					binomial[n][k] = 1;
+				else if (n == 0)
+					binomial[n][k] = 0;
+				else
+					binomial[n][k] = binomial[n - 1][k - 1] + binomial[n - 1][k];
+			}
+		}
+
+		// rows are stored by N, then d, then t, with one row of length 8 for each string shade pattern
+		size_t ndx = 0;
+		memset(offset, 0, sizeof(offset));
+		for (size_t N = 1; N <= 8; N++)
+		{
+			for (size_t d = 1; d <= 10; d++)
+			{
+				for (size_t t = 1; t <= 10; t++)
+				{
+					offset[N][d][t] = ndx;
+					ndx += binomial[t + N - 1][N - 1] * 8;
+				}
+			}
+		}
+	}
+};
+
+static const ShadeDB8_tables &shade_db8_tables()
+{
+	static const ShadeDB8_tables tables;
+	return tables;
+}
+
+short ShadeDB8_mpp::get_vmpp(size_t i) const
 {
 	if (i < 6045840) // uint16 check
 		return (short)((p_vmpp[2 * i + 1] << 8) | p_vmpp[2 * i]); 
@@ -73,7 +117,7 @@ short ShadeDB8_mpp::get_vmpp(size_t i)
 		return -1;
 };
 
-short ShadeDB8_mpp::get_impp(size_t i)
+short ShadeDB8_mpp::get_impp(size_t i) const
 { 
 	if (i < 6045840) // uint16 check
 		return (short)((p_impp[2 * i + 1] << 8) | p_impp[2 * i]); 
@@ -82,64 +126,25 @@ short ShadeDB8_mpp::get_impp(size_t i)
 };
 
 
-bool ShadeDB8_mpp::get_index(const size_t &N, const size_t &d, const  size_t &t, const size_t &S, const  db_type &DB_TYPE, size_t* ret_ndx)
+bool ShadeDB8_mpp::get_index(const size_t &N, const size_t &d, const  size_t &t, const size_t &S, const  db_type &DB_TYPE, size_t* ret_ndx) const
 {
-	bool ret_val = false;
-	//size_t ret_ndx=-1;
-	size_t length=0;
-//	size_t length_t =10, length_d=10;
-	size_t iN = 0, id = 0, it = 0;
-
-	// ret_ndx==0 is an error condition.
 	// check N
-	if ((N < 1) || (N>8)) return ret_val;
+	if ((N < 1) || (N>8)) return false;
 	// check d
-	if ((d < 1) || (d>10)) return ret_val;
+	if ((d < 1) || (d>10)) return false;
 	// check t
-	if ((t < 1) || (t>10)) return ret_val;
+	if ((t < 1) || (t>10)) return false;
 
 	// check S value for validity
 	// find number of s vectors
-	size_t size_s = n_choose_k(t + N - 1, t);
-	if ((S < 1) || (S>size_s)) return ret_val;
-
-
-
-	switch (DB_TYPE)
-	{
-		case VMPP:
-			length = 8;
-			break;
-		case IMPP:
-			length = 8;
-			break;
-	}
-	if (length == 0) return ret_val;
-	*ret_ndx = 0; // independent vectors for vmpp,impp,vs and is so offset=0
+	const ShadeDB8_tables &tables = shade_db8_tables();
+	size_t size_s = tables.binomial[t + N - 1][N - 1];
+	if ((S < 1) || (S>size_s)) return false;
 
-	size_t t_ub = 11; // upper bound of t index for iteration
-	size_t d_ub = 10; // upper bound of d index for iteration
-	do
-	{
-		iN++;
-		d_ub = ((iN == N) ? d : 10);
-		id = 0;
-		do
-		{
-			id++;
-			t_ub = (((iN==N) && (id==d)) ? t : 11);
-			for (it = 1; it < t_ub; it++)
-			{
-				// find number of s vectors
-				size_s = n_choose_k(it + iN - 1, it);
-				// multiply by length of each S vector
-				*ret_ndx += size_s*length;
-			}
-		} while (id < d_ub);
-	} while (iN < N);
-	*ret_ndx += (S - 1)*length;
-	ret_val = true;
-	return ret_val;
+	// independent vectors for vmpp,impp,vs and is so offset=0, each of length 8
+	size_t length = 8;
+	*ret_ndx = tables.offset[N][d][t] + (S - 1)*length;
+	return true;
 }
 
 size_t ShadeDB8_mpp::n_choose_k(size_t n, size_t k)
@@ -234,280 +239,208 @@ bool ShadeDB8_mpp::decompress_file_to_uint8()
 };
 
 double ShadeDB8_mpp::get_shade_loss(double &gpoa, double &dpoa, std::vector<double> &shade_frac, bool use_pv_cell_temp, double pv_cell_temp, int mods_per_str, double str_vmp_stc, double mppt_lo, double mppt_hi)
+{
+	// check for valid DB values
+	if (dpoa > gpoa)
+		dpoa = gpoa;
+	return get_shade_loss(gpoa, dpoa, shade_frac.empty() ? 0 : &shade_frac[0], shade_frac.size(), use_pv_cell_temp, pv_cell_temp, mods_per_str, str_vmp_stc, mppt_lo, mppt_hi);
+}
+
+double ShadeDB8_mpp::get_shade_loss(double gpoa, double dpoa, const double *shade_frac, size_t num_strings, bool use_pv_cell_temp, double pv_cell_temp, int mods_per_str, double str_vmp_stc, double mppt_lo, double mppt_hi) const
+{
+	return get_shade_loss(gpoa, dpoa, get_shade_pattern(shade_frac, num_strings), use_pv_cell_temp, pv_cell_temp, mods_per_str, str_vmp_stc, mppt_lo, mppt_hi);
+}
+
+ShadeDB8_mpp::shade_pattern ShadeDB8_mpp::get_shade_pattern(const double *shade_frac, size_t num_strings)
+{
+	shade_pattern pattern;
+	pattern.type = shade_pattern::NO_LOSS;
+	pattern.num_strings = num_strings;
+	pattern.s_max = -1;
+	pattern.counter = 1;
+	if (num_strings == 0)
+		return pattern;
+
+	//Need to round them to 10s (note should be integer)
+	int s_max = -1; // = str_shade[0]
+	int s_sum = 0; // = str_shade[0] that is if first element zero then sum should be zero
+	bool valid_pattern = true;
+	for (size_t i = 0; i < num_strings; i++)
+	{
+		int shade = (int)round(shade_frac[i] / 10.0);
+		if (shade > s_max) s_max = shade;
+		if (shade < 0) valid_pattern = false;
+		s_sum += shade;
+	}
+
+	if (s_sum <= 0) // shade frac sum = 0
+		return pattern;
+	if (num_strings > 8) // not in the database, so no power is found for a shaded step
+	{
+		pattern.type = shade_pattern::FULL_LOSS;
+		return pattern;
+	}
+
+	//Sort in descending order of shading
+	double sorted_frac[8];
+	std::copy(shade_frac, shade_frac + num_strings, sorted_frac);
+	std::sort(sorted_frac, sorted_frac + num_strings, std::greater<double>());
+	int str_shade[8];
+	for (size_t i = 0; i < num_strings; i++)
+		str_shade[i] = (int)round(sorted_frac[i] / 10.0);
+
+	// the database stores the string shade patterns for each maximum shade s_max in the order
+	// { s_max, i2, i3, ... } with s_max >= i2 >= i3 >= ..., counting up from the last string.
+	// the pattern's position in that order is found by counting the patterns that come before it.
+	// the original enumeration ran the loop over the last string to its end before stopping, so
+	// with three or more strings the last string is looked up with the shade of the one before it.
+	const ShadeDB8_tables &tables = shade_db8_tables();
+	size_t counter = 1;
+	if (!valid_pattern || s_max > 10)
+		counter = tables.binomial[(s_max > 10 ? 10 : s_max) + num_strings - 1][num_strings - 1]; // as if no pattern matched
+	else
+	{
+		for (size_t i = 1; i < num_strings; i++)
+		{
+			// patterns with a smaller shade for string i and any shades for the remaining strings
+			size_t remaining = num_strings - i;
+			int shade = (i > 1 && remaining == 1) ? str_shade[i - 1] : str_shade[i];
+			counter += tables.binomial[shade + remaining - 1][remaining];
+		}
+	}
+
+	pattern.type = shade_pattern::LOOKUP;
+	pattern.s_max = s_max;
+	pattern.counter = counter;
+	return pattern;
+}
+
+double ShadeDB8_mpp::get_shade_loss(double gpoa, double dpoa, const shade_pattern &pattern, bool use_pv_cell_temp, double pv_cell_temp, int mods_per_str, double str_vmp_stc, double mppt_lo, double mppt_hi) const
 {
 	double shade_loss = 0;
-	// shading fractions for each string
-	size_t num_strings = shade_frac.size();
 	// check for valid DB values
 	if (dpoa > gpoa)
 		dpoa = gpoa;
-	if (num_strings > 0)
+
+	if ((pattern.type == shade_pattern::NO_LOSS) || (gpoa <= 0)) // either shade frac sum = 0 or global = 0
+	{
+#ifdef SHADE_DB_DEBUG
+		std::stringstream outm;
+		outm << "\nglobal = " << gpoa << " and shade loss = " << shade_loss << "\n";
+		p_warning_msg = outm.str();
+#endif
+		return shade_loss;
+	}
+	if (pattern.type == shade_pattern::FULL_LOSS)
+		return 1.0;
+
+	//Now get the indices for the DB
+	int diffuse_frac = (int)round(dpoa * 10.0 / gpoa);
+	if (diffuse_frac < 1) diffuse_frac = 1;
+
+	const size_t num_strings = pattern.num_strings;
+	const int s_max = pattern.s_max;
+	const size_t counter = pattern.counter;
+
+	double vmpp[8], impp[8];
+	size_t length = 0;
+	size_t ndx;
+	if (get_index(num_strings, (size_t)diffuse_frac, (size_t)s_max, counter, ShadeDB8_mpp::VMPP, &ndx))
 	{
-		//Sort in descending order of shading
-		std::sort(shade_frac.begin(), shade_frac.end(), std::greater<double>());
-		//Need to round them to 10s (note should be integer)
-		for (size_t i = 0; i < num_strings; i++)
-			shade_frac[i] /= 10.0;
-		std::vector<int> str_shade;
-		for (size_t i = 0; i < num_strings; i++)
-			str_shade.push_back((int)round(shade_frac[i]));
-		int s_max = -1; // = str_shade[0]
-		int s_sum = 0; // = str_shade[0] that is if first element zero then sum should be zero
-		for (size_t i = 0; i < num_strings; i++)
+		length = 8;
+		for (size_t i = 0; i < length; i++)
 		{
-			if (str_shade[i] > s_max) s_max = str_shade[i];
-			s_sum += str_shade[i];
+			vmpp[i] = (double)get_vmpp(ndx + i) / 1000.0;
+			impp[i] = (double)get_impp(ndx + i) / 1000.0;
 		}
-		//Now get the indices for the DB
-		if ((s_sum > 0) && (gpoa > 0))
+	}
+	double p_max_frac = 0;
+
+	// temp correction and out of global MPP
+	size_t p_max_ind = 0;
+	double pmp_fracs[8];
+
+	for (size_t i = 0; i < length; i++)
+	{
+		double pmp = vmpp[i] * impp[i];
+		pmp_fracs[i] = pmp;
+		if (pmp > p_max_frac)
 		{
-			int diffuse_frac = (int)round(dpoa * 10.0 / gpoa);
-			if (diffuse_frac < 1) diffuse_frac = 1;
-			int counter = 1;
-			bool found = false;
-			if (num_strings > 1)
-			{
-				counter = 0;
-				for (int i2 = 0; i2 <= s_max; i2++)
-				{
-					if (num_strings == 2)
-					{
-						counter++;
-						std::vector<int> cur_case; // not on OS X { s_max, i2 };
-						cur_case.push_back(s_max);
-						cur_case.push_back(i2);
-						if (str_shade == cur_case)
-							found = true;
-					}
-					else
-					{
-						for (int i3 = 0; i3 <= i2; i3++)
-						{
-							if (num_strings == 3)
-							{
-								counter++;
-								std::vector<int> cur_case; //{ s_max, i2, i3 };
-								cur_case.push_back(s_max);
-								cur_case.push_back(i2);
-								cur_case.push_back(i3);
-								if (str_shade == cur_case)
-									found = true;
-							}
-							else
-							{
-								for (int i4 = 0; i4 <= i3; i4++)
-								{
-									if (num_strings == 4)
-									{
-										counter++;
-										std::vector<int> cur_case;// { s_max, i2, i3, i4 };
-										cur_case.push_back(s_max);
-										cur_case.push_back(i2);
-										cur_case.push_back(i3);
-										cur_case.push_back(i4);
-										if (str_shade == cur_case)
-											found = true;
-									}
-									else
-									{
-										for (int i5 = 0; i5 <= i4; i5++)
-										{
-											if (num_strings == 5)
-											{
-												counter++;
-												std::vector<int> cur_case;// { s_max, i2, i3, i4, i5 };
-												cur_case.push_back(s_max);
-												cur_case.push_back(i2);
-												cur_case.push_back(i3);
-												cur_case.push_back(i4);
-												cur_case.push_back(i5);
-												if (str_shade == cur_case)
-													found = true;
-											}
-											else
-											{
-												for (int i6 = 0; i6 <= i5; i6++)
-												{
-													if (num_strings == 6)
-													{
-														counter++;
-														std::vector<int> cur_case;// { s_max, i2, i3, i4, i5, i6 };
-														cur_case.push_back(s_max);
-														cur_case.push_back(i2);
-														cur_case.push_back(i3);
-														cur_case.push_back(i4);
-														cur_case.push_back(i5);
-														cur_case.push_back(i6);
-														if (str_shade == cur_case)
-															found = true;
-													}
-													else
-													{
-														for (int i7 = 0; i7 <= i6; i7++)
-														{
-															if (num_strings == 7)
-															{
-																counter++;
-																std::vector<int> cur_case;// { s_max, i2, i3, i4, i5, i6, i7 };
-																cur_case.push_back(s_max);
-																cur_case.push_back(i2);
-																cur_case.push_back(i3);
-																cur_case.push_back(i4);
-																cur_case.push_back(i5);
-																cur_case.push_back(i6);
-																cur_case.push_back(i7);
-																if (str_shade == cur_case)
-																	found = true;
-															}
-															else
-															{
-																for (int i8 = 0; i8 <= i7; i8++)
-																{
-																	if (num_strings == 8)
-																	{
-																		counter++;
-																		std::vector<int> cur_case; // { s_max, i2, i3, i4, i5, i6, i7, i8 };
-																		cur_case.push_back(s_max);
-																		cur_case.push_back(i2);
-																		cur_case.push_back(i3);
-																		cur_case.push_back(i4);
-																		cur_case.push_back(i5);
-																		cur_case.push_back(i6);
-																		cur_case.push_back(i7);
-																		cur_case.push_back(i8);
-																		if (str_shade == cur_case)
-																			found = true;
-																	}
-																	else
-																	{
-																		// error message or throw error
-																		counter = 0;
-																	}
-																} // for i7
-																if (found) break;
-
-															}
-														} // for i7
-														if (found) break;
-													}
-												} // for i6
-												if (found) break;
-											}
-										} // for i5
-										if (found) break;
-									}
-								} // for i4
-								if (found) break;
-							}
-						} // for i3
-						if (found) break;
-					}
-					if (found) break;
-				} // for i2
-			} // (num_strings > 1)
-
-
-
-			std::vector<double>vmpp = get_vector(num_strings, diffuse_frac, s_max, counter, ShadeDB8_mpp::VMPP);
-			std::vector<double>impp = get_vector(num_strings, diffuse_frac, s_max, counter, ShadeDB8_mpp::IMPP);
-			double p_max_frac = 0;
-
-			// temp correction and out of global MPP
-			int p_max_ind = 0;
-			std::vector<double> pmp_fracs;
-
-			for (size_t i = 0; i < vmpp.size() && i < impp.size(); i++)
+			p_max_frac = pmp;
+			p_max_ind = i;
+		}
+	}
+
+	if (use_pv_cell_temp && length > 0)
+	{
+		/*
+		%Try scaling the voltages using the Sandia model.Taking numbers from
+		%their database for the Yingli YL230.It's a similar module (mc-si,60 cell, etc)to the
+		%Trina 250 PA05 which the database was build from.But user may need more
+		%input into this!!!
+		*/
+		double n = 1.263;
+		double BetaVmp = -0.137*mods_per_str; //mult by ModsPerString because it's in V
+		double Ns = 60 * mods_per_str; //X modules, each with 60 cells
+		double C2 = -0.05871;
+		double C3 = 8.35334;
+		double k = 1.38066E-23; //J / K, Boltzmann's constant
+		double q = 1.60218E-19;  // Coulomb, elementary charge
+		double Tc = pv_cell_temp;
+		double deltaTc = n*k*(Tc + 273.15) / q; //Thermal voltage
+		double VMaxSTCStrUnshaded = str_vmp_stc;
+		double scale_g = gpoa / 1000.0;
+
+		// the irradiance and temperature terms are the same for every max power point
+		double log_g = ::log(scale_g);
+		double dV_g = C2*Ns*deltaTc*log_g;
+		double dV_g2 = C3*Ns*pow((deltaTc*log_g), 2);
+		double dV_t = BetaVmp*(Tc - 25);
+
+		double TcVmps[8];
+		for (size_t i = 0; i < length; i++)
+			TcVmps[i] = vmpp[i] * VMaxSTCStrUnshaded + dV_g + dV_g2 + dV_t;
+		/*
+		%Now want to choose the point with a V in range and highest power
+		%First, figure out which max power point gives lowest loss
+		*/
+		double Veemax = TcVmps[p_max_ind];
+		if ((Veemax >= mppt_lo) && (Veemax <= mppt_hi))
+			// The global max power point is in range!
+			shade_loss = 1.0 - p_max_frac;
+		else
+		{
+			//	The global max power point is NOT in range
+			double p_frac = 0;
+			for (size_t i = 0; i < length; i++)
 			{
-				double pmp = vmpp[i] * impp[i];
-				if (use_pv_cell_temp) pmp_fracs.push_back(pmp);
-				if (pmp > p_max_frac)
+				if ((TcVmps[i] >= mppt_lo) && (TcVmps[i] <= mppt_hi))
 				{
-					p_max_frac = pmp;
-					if (use_pv_cell_temp) p_max_ind = (int)i;
+					if (pmp_fracs[i] > p_frac)
+						p_frac = pmp_fracs[i];
 				}
 			}
 
-			if (use_pv_cell_temp)
-			{
-				/*
-				%Try scaling the voltages using the Sandia model.Taking numbers from
-				%their database for the Yingli YL230.It's a similar module (mc-si,60 cell, etc)to the
-				%Trina 250 PA05 which the database was build from.But user may need more
-				%input into this!!!
-				*/
-				double n = 1.263;
-				double BetaVmp = -0.137*mods_per_str; //mult by ModsPerString because it's in V
-				double Ns = 60 * mods_per_str; //X modules, each with 60 cells
-				double C2 = -0.05871;
-				double C3 = 8.35334;
-				double k = 1.38066E-23; //J / K, Boltzmann's constant
-				double q = 1.60218E-19;  // Coulomb, elementary charge
-				double Tc = pv_cell_temp;
-				double deltaTc = n*k*(Tc + 273.15) / q; //Thermal voltage
-				double VMaxSTCStrUnshaded = str_vmp_stc;
-				double scale_g = gpoa / 1000.0;
-//				double TcVmpMax = vmpp[p_max_ind] * VMaxSTCStrUnshaded + C2*Ns*deltaTc*::log(scale_g) + C3*Ns*pow((deltaTc*::log(scale_g)), 2) + BetaVmp*(Tc - 25);
-//				double TcVmpScale = TcVmpMax / vmpp[p_max_ind] / VMaxSTCStrUnshaded;
-
-				std::vector<double> TcVmps;
-
-				for (size_t i = 0; i < vmpp.size(); i++)
-					TcVmps.push_back(vmpp[i] * VMaxSTCStrUnshaded + C2*Ns*deltaTc*::log(scale_g) + C3*Ns*pow((deltaTc*::log(scale_g)), 2) + BetaVmp*(Tc - 25));
-				/*
-				%Now want to choose the point with a V in range and highest power
-				%First, figure out which max power point gives lowest loss
-				*/
-				double Veemax = TcVmps[p_max_ind];
-				if ((Veemax >= mppt_lo) && (Veemax <= mppt_hi))
-					// The global max power point is in range!
-					shade_loss = 1.0 - p_max_frac;
-				else
-				{
-					//	The global max power point is NOT in range
-					double p_frac = 0;
-					for (size_t i = 0; i < TcVmps.size() && i < pmp_fracs.size(); i++)
-					{
-						if ((TcVmps[i] >= mppt_lo) && (TcVmps[i] <= mppt_hi))
-						{
-							if (pmp_fracs[i] > p_frac)
-								p_frac = pmp_fracs[i];
-						}
-					}
-
-					shade_loss = 1.0 - p_frac;
-				}
+			shade_loss = 1.0 - p_frac;
+		}
 
 
 #ifdef SHADE_DB_DEBUG
-				std::stringstream outm;
-				outm << "\ni,Vmpp,Impp,pmp_fracs,TcVmps\n";
-				for (size_t i = 0; i < TcVmps.size() && i < pmp_fracs.size(); i++)
-				{
-					outm << i << "," << vmpp[i] << "," << impp[i] << "," << pmp_fracs[i] << "," << TcVmps[i] << "\n";
-				}
-				outm << "\nshade loss = " << shade_loss << "\n";
-				p_warning_msg = outm.str();
-#endif
-
-			}
-			else // assume global max power point
-			{
-				shade_loss = 1.0 - p_max_frac;
-			}
-
-		} //(sum >0)
-		else // either shade frac sum = 0 or global = 0
+		std::stringstream outm;
+		outm << "\ni,Vmpp,Impp,pmp_fracs,TcVmps\n";
+		for (size_t i = 0; i < length; i++)
 		{
-			if (s_sum <= 0) // to match with Matlab results
-				shade_loss = 0.0;
-			else
-				shade_loss = 0.0;
-#ifdef SHADE_DB_DEBUG
-			std::stringstream outm;
-			outm << "\nglobal = " << gpoa << " and shade fraction = " << s_sum << " and shade loss = " << shade_loss << "\n";
-			p_warning_msg = outm.str();
-#endif
+			outm << i << "," << vmpp[i] << "," << impp[i] << "," << pmp_fracs[i] << "," << TcVmps[i] << "\n";
 		}
+		outm << "\nshade loss = " << shade_loss << "\n";
+		p_warning_msg = outm.str();
+#endif
+
 	}
+	else // assume global max power point
+	{
+		shade_loss = 1.0 - p_max_frac;
+	}
+
 	return shade_loss;
 }
@@ -77,9 +77,24 @@ public:
 	};
 	std::vector<double> get_vector(const size_t &N, const size_t &d, const size_t &t, const size_t &S, const db_type &DB_TYPE);
 	size_t n_choose_k(size_t n, size_t k);
-	bool get_index(const size_t &N, const size_t &d, const size_t &t, const size_t &S, const db_type &DB_TYPE, size_t* ret_ndx);
+	bool get_index(const size_t &N, const size_t &d, const size_t &t, const size_t &S, const db_type &DB_TYPE, size_t* ret_ndx) const;
 
 	double get_shade_loss(double &gpoa, double &dpoa, std::vector<double> &shade_frac, bool use_pv_cell_temp = false, double pv_cell_temp = 0, int mods_per_str = 0, double str_vmp_stc = 0, double mppt_lo = 0, double mppt_hi = 0);
+	// same as above for up to 8 string shade fractions (%), does not allocate or modify the database, so it may be called concurrently
+	double get_shade_loss(double gpoa, double dpoa, const double *shade_frac, size_t num_strings, bool use_pv_cell_temp = false, double pv_cell_temp = 0, int mods_per_str = 0, double str_vmp_stc = 0, double mppt_lo = 0, double mppt_hi = 0) const;
+
+	// database entry for a set of string shade fractions, which does not depend on the irradiance or temperature,
+	// so a shading schedule can be looked up once and the loss found for each time step from the stored pattern
+	struct shade_pattern
+	{
+		enum { NO_LOSS, FULL_LOSS, LOOKUP };
+		int type;
+		size_t num_strings;
+		int s_max;
+		size_t counter;
+	};
+	static shade_pattern get_shade_pattern(const double *shade_frac, size_t num_strings);
+	double get_shade_loss(double gpoa, double dpoa, const shade_pattern &pattern, bool use_pv_cell_temp = false, double pv_cell_temp = 0, int mods_per_str = 0, double str_vmp_stc = 0, double mppt_lo = 0, double mppt_hi = 0) const;
 	std::string get_warning() { return p_warning_msg; }
 	std::string get_error() { return p_error_msg; }
 
@@ -87,13 +102,13 @@ public:
 private:
 	unsigned char *p_vmpp;
 	unsigned char *p_impp;
-	short get_vmpp(size_t i);
-	short get_impp(size_t i);
+	short get_vmpp(size_t i) const;
+	short get_impp(size_t i) const;
 	bool decompress_file_to_uint8();
 	size_t p_vmpp_uint8_size;
 	size_t p_impp_uint8_size;
 	size_t p_compressed_size;
-	std::string p_warning_msg;
+	mutable std::string p_warning_msg;
 	std::string p_error_msg;
 };
 
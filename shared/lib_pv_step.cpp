@@ -0,0 +1,212 @@
+#include "lib_pv_step.h"
+#include "lib_cec6par.h"
+#include "lib_irradproc.h"
+#include "lib_weatherfile.h"
+#include "lib_util.h"
+#include <cmath>
+
+PVStepModel::PVStepModel(SharedInverter * sharedInverter, size_t numberOfMpptInputs, double mpptLowVoltage, double mpptHiVoltage)
+{
+	m_sharedInverter = sharedInverter;
+	m_numberOfMpptInputs = numberOfMpptInputs < 1 ? 1 : numberOfMpptInputs;
+	m_mpptLowVoltage = mpptLowVoltage;
+	m_mpptHiVoltage = mpptHiVoltage;
+
+	m_mpptPower_kW.resize(m_numberOfMpptInputs, 0);
+	m_mpptVoltage.resize(m_numberOfMpptInputs, 0);
+	m_mpptStrings.resize(m_numberOfMpptInputs, 0);
+
+	dcPower_kW = acPower_kW = 0;
+
+	setSite(0, 0, 0, 0, 1, false);
+}
+
+PVStepModel::~PVStepModel()
+{
+	// defined here, where daylight_mask is a complete type
+}
+
+void PVStepModel::setSite(double lat, double lon, double tz, double elev, double ts_hour, bool interpolate,
+	int radmode, int skyModel, double albedo)
+{
+	m_lat = lat;
+	m_lon = lon;
+	m_tz = tz;
+	m_elev = elev;
+	m_delt = interpolate ? ts_hour : IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET;
+	m_radmode = radmode;
+	m_skyModel = skyModel;
+	m_albedo = albedo;
+	m_daylight.reset(new daylight_mask(lat, lon, tz, m_delt));
+}
+
+void PVStepModel::setSurface(size_t index, int trackMode, double tilt, double azimuth, double rotationLimit, bool backtrack, double gcr)
+{
+	Subarray & sa = m_subarrays[index];
+	sa.trackMode = trackMode;
+	sa.tilt = tilt;
+	sa.azimuth = azimuth;
+	sa.rotationLimit = rotationLimit;
+	sa.backtrack = backtrack;
+	sa.gcr = gcr;
+}
+
+size_t PVStepModel::addSubarray(pvmodule_t * moduleModel, pvcelltemp_t * cellTempModel, int nModulesPerString, int nStrings,
+	double dcLoss, size_t mpptInput)
+{
+	// each subarray's models are only stepped here, in time order, so the MCSP energy balance can start from the last step
+	mcsp_celltemp_t * mcsp = dynamic_cast<mcsp_celltemp_t*>(cellTempModel);
+	if (mcsp)
+		mcsp->WarmStart = true;
+
+	Subarray sa;
+	sa.moduleModel = moduleModel;
+	sa.cellTempModel = cellTempModel;
+	sa.nModulesPerString = nModulesPerString;
+	sa.nStrings = nStrings;
+	sa.dcLoss = dcLoss;
+	sa.mpptInput = mpptInput < m_numberOfMpptInputs ? mpptInput : m_numberOfMpptInputs - 1;
+	sa.trackMode = 0;
+	sa.tilt = 0;
+	sa.azimuth = 180;
+	sa.rotationLimit = 45;
+	sa.backtrack = false;
+	sa.gcr = 0.3;
+	m_subarrays.push_back(sa);
+
+	SubarrayOutput zero = { 0, 0, 0, 0, 0, 0, 0 };
+	m_outputs.push_back(zero);
+	m_inputs.push_back(pvinput_t());
+
+	return m_subarrays.size() - 1;
+}
+
+void PVStepModel::moduleOutput(Subarray & sa, pvinput_t & in, double moduleVoltage, double & tcell, pvoutput_t & out)
+{
+	(*sa.cellTempModel)(in, *sa.moduleModel, moduleVoltage, tcell);
+	(*sa.moduleModel)(in, tcell, moduleVoltage, out);
+}
+
+void PVStepModel::step(std::vector<pvinput_t> & inputs, bool sunUp, double ambientT)
+{
+	for (size_t m = 0; m < m_numberOfMpptInputs; m++)
+	{
+		m_mpptPower_kW[m] = 0;
+		m_mpptVoltage[m] = 0;
+		m_mpptStrings[m] = 0;
+	}
+	dcPower_kW = 0;
+
+	bool clipMpptWindow = m_mpptHiVoltage > m_mpptLowVoltage && m_mpptLowVoltage >= 0;
+
+	for (size_t nn = 0; nn < m_subarrays.size(); nn++)
+	{
+		Subarray & sa = m_subarrays[nn];
+		pvinput_t & in = inputs[nn];
+		pvoutput_t out(0, 0, 0, 0, 0, 0, 0, 0);
+
+		double tcell = in.Tdry;
+		if (sunUp)
+		{
+			// calculate at the module max power point, then move to the edge of the inverter MPPT window if outside it
+			moduleOutput(sa, in, -1, tcell, out);
+			if (clipMpptWindow)
+			{
+				double voltageMpptLow1Module = m_mpptLowVoltage / sa.nModulesPerString;
+				double voltageMpptHi1Module = m_mpptHiVoltage / sa.nModulesPerString;
+				if (out.Voltage < voltageMpptLow1Module)
+					moduleOutput(sa, in, voltageMpptLow1Module, tcell, out);
+				else if (out.Voltage > voltageMpptHi1Module)
+					moduleOutput(sa, in, voltageMpptHi1Module, tcell, out);
+			}
+		}
+
+		if (!std::isfinite(out.Power))
+		{
+			out.Power = 0;
+			out.Voltage = 0;
+			out.Efficiency = 0;
+		}
+
+		SubarrayOutput & so = m_outputs[nn];
+		so.cellTemperature = tcell;
+		so.moduleVoltage = out.Voltage;
+		so.modulePowerW = out.Power;
+		so.efficiency = out.Efficiency;
+		so.dcPowerGross_kW = out.Power * sa.nModulesPerString * sa.nStrings * util::watt_to_kilowatt;
+		so.dcPowerNet_kW = so.dcPowerGross_kW * (1 - sa.dcLoss);
+
+		// MPPT input voltage is the string weighted average of the subarray string voltages
+		m_mpptPower_kW[sa.mpptInput] += so.dcPowerNet_kW;
+		m_mpptVoltage[sa.mpptInput] += out.Voltage * sa.nModulesPerString * sa.nStrings;
+		m_mpptStrings[sa.mpptInput] += sa.nStrings;
+		dcPower_kW += so.dcPowerNet_kW;
+	}
+
+	for (size_t m = 0; m < m_numberOfMpptInputs; m++)
+		if (m_mpptStrings[m] > 0)
+			m_mpptVoltage[m] /= m_mpptStrings[m];
+
+	if (m_numberOfMpptInputs == 1)
+		m_sharedInverter->calculateACPower(m_mpptPower_kW[0], m_mpptVoltage[0], ambientT);
+	else
+		m_sharedInverter->calculateACPower(m_mpptPower_kW, m_mpptVoltage, ambientT);
+
+	acPower_kW = m_sharedInverter->powerAC_kW;
+}
+
+int PVStepModel::step(const weather_record & wf)
+{
+	double alb = m_albedo;
+	if (std::isfinite(wf.alb) && wf.alb > 0 && wf.alb < 1)
+		alb = wf.alb;
+	double hourOfDay = ((double)wf.hour) + wf.minute / 60.0;
+
+	// sun is down for the whole step: no sun position or irradiance, as irrad::calc() reports at night
+	bool night = m_daylight->night(wf.year, wf.month, wf.day, wf.hour, wf.minute);
+	int sunup = 0;
+
+	for (size_t nn = 0; nn < m_subarrays.size(); nn++)
+	{
+		Subarray & sa = m_subarrays[nn];
+		double solazi = 0, solzen = 0, solalt = 0;
+		double aoi = 0, stilt = sa.tilt, sazi = sa.azimuth, rot = 0, btd = 0;
+		double ibeam = 0, iskydiff = 0, ignddiff = 0;
+
+		if (!night)
+		{
+			irrad irr;
+			irr.set_time(wf.year, wf.month, wf.day, wf.hour, wf.minute, m_delt);
+			irr.set_location(m_lat, m_lon, m_tz);
+			irr.set_sky_model(m_skyModel, alb);
+			if (m_radmode == 1)
+				irr.set_global_beam(wf.gh, wf.dn);
+			else if (m_radmode == 2)
+				irr.set_global_diffuse(wf.gh, wf.df);
+			else
+				irr.set_beam_diffuse(wf.dn, wf.df);
+			irr.set_surface(sa.trackMode, sa.tilt, sa.azimuth, sa.rotationLimit, sa.backtrack, sa.gcr);
+			irr.set_noon_sun(m_daylight->noon());
+
+			int code = irr.calc();
+			if (code != 0)
+				return code;
+
+			irr.get_sun(&solazi, &solzen, &solalt, 0, 0, 0, &sunup, 0, 0, 0);
+			irr.get_angles(&aoi, &stilt, &sazi, &rot, &btd);
+			irr.get_poa(&ibeam, &iskydiff, &ignddiff, 0, 0, 0);
+		}
+
+		m_inputs[nn] = pvinput_t(ibeam, iskydiff, ignddiff, 0, 0,
+			wf.tdry, wf.tdew, wf.wspd, wf.wdir, wf.pres,
+			solzen, aoi, m_elev, stilt, sazi,
+			hourOfDay, m_radmode, false);
+	}
+
+	step(m_inputs, sunup > 0, wf.tdry);
+
+	for (size_t nn = 0; nn < m_subarrays.size(); nn++)
+		m_outputs[nn].poaFront = m_inputs[nn].Ibeam + m_inputs[nn].Idiff + m_inputs[nn].Ignd;
+
+	return 0;
+}
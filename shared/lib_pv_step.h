@@ -0,0 +1,127 @@
+#ifndef __LIB_PV_STEP_H__
+#define __LIB_PV_STEP_H__
+
+#include "lib_pvmodel.h"
+#include "lib_shared_inverter.h"
+#include <vector>
+#include <memory>
+
+struct weather_record;
+class daylight_mask;
+
+/**
+*
+* \class PVStepModel
+*
+*  A PVStepModel chains the module, cell temperature and inverter models of the detailed PV model so that
+*  a system can be driven one time step at a time.  The models are built once by the caller and registered
+*  here, and any state they carry between time steps (such as transient cell temperature) is kept across
+*  calls to step().  Working storage is allocated when subarrays are added, so a time step does not allocate.
+*
+*  Once the site and the orientation of each subarray are set, step() takes a weather record and runs the sun
+*  position and irradiance models for each subarray as pvsamv1 does, without shading, soiling or snow losses.
+*  Otherwise the caller supplies the module inputs of each subarray.
+*/
+class PVStepModel
+{
+public:
+
+	/// Construct the step model around a previously constructed shared inverter with the given number of MPPT inputs.
+	/// If mpptHiVoltage > mpptLowVoltage, module voltages are clipped to the inverter MPPT window
+	PVStepModel(SharedInverter * sharedInverter, size_t numberOfMpptInputs = 1, double mpptLowVoltage = 0, double mpptHiVoltage = 0);
+	~PVStepModel();
+
+	/// Register a subarray, returns the subarray index.  mpptInput is 0-indexed, dcLoss is a fraction (0..1).
+	/// An MCSP cell temperature model is switched to warm start, so it must not be stepped elsewhere
+	size_t addSubarray(pvmodule_t * moduleModel, pvcelltemp_t * cellTempModel, int nModulesPerString, int nStrings,
+		double dcLoss, size_t mpptInput = 0);
+
+	/// Number of registered subarrays
+	size_t numberOfSubarrays() const { return m_subarrays.size(); }
+
+	/// Set the site for stepping on weather records.  ts_hour is the weather time step; if interpolate is set, sun position in
+	/// sunrise and sunset steps is taken at the midpoint of the up period.  radmode is DN_DF, DN_GH or GH_DF and skyModel is
+	/// ISOTROPIC, HDKR or PEREZ as in Irradiance_IO.  albedo is used when the weather record has none
+	void setSite(double lat, double lon, double tz, double elev, double ts_hour, bool interpolate,
+		int radmode = 0, int skyModel = 2, double albedo = 0.2);
+
+	/// Set the orientation of a subarray for stepping on weather records, trackMode as in irrad::set_surface()
+	void setSurface(size_t index, int trackMode, double tilt, double azimuth, double rotationLimit = 45, bool backtrack = false, double gcr = 0.3);
+
+	/// Calculate DC and AC power for one time step, given one module input per subarray and the ambient temperature (C)
+	void step(std::vector<pvinput_t> & inputs, bool sunUp, double ambientT);
+
+	/// Calculate the sun position and irradiance incident on each subarray for one weather record, then DC and AC power.
+	/// Returns 0, or the irrad::calc() code of the first subarray that failed, in which case no power is calculated
+	int step(const weather_record & wf);
+
+	/// Calculated values for the current timestep, per subarray
+	struct SubarrayOutput
+	{
+		double poaFront;			///< front side plane-of-array irradiance (W/m2), set only when stepping on weather records
+		double cellTemperature;		///< cell temperature ('C)
+		double moduleVoltage;		///< operating voltage of one module (V)
+		double modulePowerW;		///< DC power of one module (W)
+		double efficiency;			///< module efficiency (0..1)
+		double dcPowerGross_kW;		///< subarray DC power before DC losses (kW)
+		double dcPowerNet_kW;		///< subarray DC power after DC losses (kW)
+	};
+
+	const SubarrayOutput & subarrayOutput(size_t index) const { return m_outputs[index]; }
+
+	/// Net DC power (kW) and voltage (V) at an MPPT input for the current timestep
+	double mpptPower_kW(size_t mpptInput) const { return m_mpptPower_kW[mpptInput]; }
+	double mpptVoltage(size_t mpptInput) const { return m_mpptVoltage[mpptInput]; }
+
+	/// The shared inverter holds the AC results of the current timestep
+	const SharedInverter * inverter() const { return m_sharedInverter; }
+
+public:
+
+	// calculated values for the current timestep
+	double dcPower_kW;
+	double acPower_kW;
+
+protected:
+
+	struct Subarray
+	{
+		pvmodule_t * moduleModel;
+		pvcelltemp_t * cellTempModel;
+		int nModulesPerString;
+		int nStrings;
+		double dcLoss;
+		size_t mpptInput;
+
+		// orientation, for stepping on weather records
+		int trackMode;
+		double tilt, azimuth, rotationLimit, gcr;
+		bool backtrack;
+	};
+
+	/// Run the cell temperature and module models at a module voltage, -1 for the max power point
+	void moduleOutput(Subarray & sa, pvinput_t & in, double moduleVoltage, double & tcell, pvoutput_t & out);
+
+	// Memory managed elsewhere
+	SharedInverter * m_sharedInverter;
+
+	size_t m_numberOfMpptInputs;
+	double m_mpptLowVoltage;
+	double m_mpptHiVoltage;
+
+	std::vector<Subarray> m_subarrays;
+	std::vector<SubarrayOutput> m_outputs;
+	std::vector<double> m_mpptPower_kW;
+	std::vector<double> m_mpptVoltage;
+	std::vector<double> m_mpptStrings;
+
+	// site, for stepping on weather records
+	double m_lat, m_lon, m_tz, m_elev;
+	double m_delt;
+	int m_radmode, m_skyModel;
+	double m_albedo;
+	std::unique_ptr<daylight_mask> m_daylight;
+	std::vector<pvinput_t> m_inputs;
+};
+
+#endif
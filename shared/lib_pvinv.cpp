@@ -74,9 +74,7 @@ bool partload_inverter_t::acpower(
 )
 {
 	//pass through inputs to the multiple MPPT function as an array with only one entry
-	std::vector<double> Pdc_vec;
-	Pdc_vec.push_back(Pdc);
-	if (!acpower(Pdc_vec, Pac, Ppar, Plr, Eff, Pcliploss, Pntloss))
+	if (!acpower(&Pdc, 1, Pac, Ppar, Plr, Eff, Pcliploss, Pntloss))
 		return false;
 
 	return true;
@@ -84,7 +82,24 @@ bool partload_inverter_t::acpower(
 
 bool partload_inverter_t::acpower(
 	/* inputs */
-	std::vector<double> Pdc,     /* Vector of Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+	const std::vector<double> &Pdc,     /* Vector of Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+
+	/* outputs */
+	double *Pac,    /* AC output power (Wac) */
+	double *Ppar,   /* AC parasitic power consumption (Wac) */
+	double *Plr,    /* Part load ratio (Pdc_in/Pdc_rated, 0..1) */
+	double *Eff,	    /* Conversion efficiency (0..1) */
+	double *Pcliploss, /* Power loss due to clipping loss (Wac) */
+	double *Pntloss /* Power loss due to night time tare loss (Wac) */
+	)
+{
+	return acpower(Pdc.empty() ? 0 : &Pdc[0], Pdc.size(), Pac, Ppar, Plr, Eff, Pcliploss, Pntloss);
+}
+
+bool partload_inverter_t::acpower(
+	/* inputs */
+	const double *Pdc,     /* Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+	size_t nMppt,          /* Number of MPPT inputs */
 
 	/* outputs */
 	double *Pac,    /* AC output power (Wac) */
@@ -96,7 +111,7 @@ bool partload_inverter_t::acpower(
 	)
 {
 	double Pdc_total = 0;
-	for (size_t m = 0; m < Pdc.size(); m++)
+	for (size_t m = 0; m < nMppt; m++)
 		Pdc_total += Pdc[m];
 	if ( Pdco <= 0 ) return false;
 
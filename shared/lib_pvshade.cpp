@@ -48,6 +48,7 @@
 *******************************************************************************************************/
 
 #include "lib_pvshade.h"
+#include "lib_irradproc.h"
 #include "lib_util.h"
 
 #include <math.h>
@@ -94,10 +95,9 @@ double mask_angle_func(double x, double R, double B, double tilt_eff)
 #define K 5
 #define FUNC(x,R,B,tilt) ((*func)(x,R,B,tilt))
 
-double trapzd(double (*func)(double,double,double,double), double a, double b, double R, double B, double tilt, int n)
+double trapzd(double (*func)(double,double,double,double), double a, double b, double R, double B, double tilt, int n, double &s)
 {
 	double x,tnm,sum,del;
-	static double s;
 	int it,j;
 	if (n == 1) 
 	{
@@ -160,15 +160,15 @@ void polint(double xa[], double ya[], int n, double x, double *y, double *dy)
 double qromb(double (*func)(double,double,double,double), double a, double b, double R, double B, double tilt)
 {
 	void polint(double xa[], double ya[], int n, double x, double *y, double *dy);
-	double trapzd(double (*func)(double,double,double,double), double a, double b, double R, double B, double tilt, int n);
+	double trapzd(double (*func)(double,double,double,double), double a, double b, double R, double B, double tilt, int n, double &s);
 	void nrerror(char error_text[]);
-	double ss,dss;
+	double ss,dss,st=0;
 	double s[JMAXP],h[JMAXP+1];
 	int j;
 	h[1]=1.0;
 	for (j=1;j<=JMAX;j++) 
 	{
-		s[j]=trapzd(func,a,b,R,B,tilt,j);
+		s[j]=trapzd(func,a,b,R,B,tilt,j,st); // trapzd state is kept here, not in a static, so this is thread safe
 		if (j >= K) 
 		{
 			polint(&h[j-K],&s[j-K],K,0.0,&ss,&dss);
@@ -330,82 +330,38 @@ R: inter-row spacing
 phi_bar: average masking angle
 
 */
-bool ss_exec(
-	
-	const ssinputs &inputs,
-
-	double tilt,		// module tilt (constant for fixed tilt, varies for one-axis)
-	double azimuth,		// module azimuth (constant for fixed tilt, varies for one-axis)
-	double solzen,		// solar zenith (deg)
-	double solazi,		// solar azimuth (deg)
-	double Gb_nor,		// beam normal irradiance (W/m2)
-	double Gb_poa,		// POA beam irradiance (W/m2)
-	double Gd_poa,		// POA diffuse, sky+gnd (W/m2)
-	double albedo,		// used to calculate reduced relected irradiance
-	bool trackmode,		// 0 for fixed tilt, 1 for one-axis tracking
-	bool linear,		// 0 for non-linear shading (C. Deline's full algorithm), 1 to stop at linear shading
-	double shade_frac_1x,	// geometric calculation of the fraction of one-axis row that is shaded (0-1), not used if fixed tilt 
-
-	ssoutputs &outputs)
+// row dimensions per Chris Deline's paper: B is the length of the side of a row (Appelbaum A), and the row length
+static void ss_row_dimensions( const ssinputs &inputs, double &B, double &row_length )
 {
+	if (inputs.mod_orient == 0) // Portrait Mode
+	{
+		B = inputs.length * inputs.nmody;
+		row_length = inputs.nmodx * inputs.width;
+	}
+	else // Landscape Mode
+	{
+		B = inputs.width * inputs.nmody;
+		row_length = inputs.nmodx * inputs.length;
+	}
+}
 
-	// ***********************************
-	// VARIABLE ASSIGNMENTS
-	// ***********************************
-
-	// translate inputs to variable names consistent with C. Deline's self-shading paper for clarity
-	double m_m = inputs.nmody;
-	double m_n = inputs.nmodx;
-	double m_d = inputs.ndiode;
-	double m_W = inputs.width;
-	double m_L = inputs.length;
-	double m_r = inputs.nrows;
+// shadow height (Hs) and distance from the row edge (g) on a fixed row
+// Reference Appelbaum and Bany "Shadow effect of adjacent solar collectors in large scale systems" Solar Energy 1979 Vol 23. No. 6
+static void ss_shadow( const ssinputs &inputs, double tilt, double azimuth, double solzen, double solazi, double &Hs, double &g )
+{
 	double m_R = inputs.row_space;
 
 	// check for divide by zero issues with Row spacing per email from Chris 5/2/12
 	if (m_R < M_EPS) m_R = M_EPS;
 
-	// calculate the mask angle
-	// NOTE THAT B HERE IS PER CHRIS DELINE'S PAPER: B IS THE LENGTH OF THE SIDE OF A ROW
-	double m_B;
-	if (inputs.mod_orient == 0) m_B = m_L * m_m;	// Portrait Mode
-	else m_B = m_W * m_m;	// Landscape Mode
-
-	// calculate the length of the row also
-	double m_row_length;
-	if (inputs.mod_orient == 0) m_row_length = m_n * m_W; //Portrait Mode
-	else m_row_length = m_n * m_L; //Landscape Mode
-
-	double a = 0.0, b = m_B;
-	
-	double mask_angle;
-	if (inputs.mask_angle_calc_method == 1)
-	{
-	// average over entire array
-		mask_angle = qromb( mask_angle_func, a, b, m_R, m_B, tilt) / m_B;
-	}
-	else
-	{
-	// worst case (default)
-	// updated to phi(0) per email from Chris Deline 5/2/12
-		mask_angle = atan2( ( m_B * sind( tilt ) ), ( m_R - m_B * cosd( tilt ) ) );
-	}
-	mask_angle *= 180.0/M_PI; // change to degrees to pass into functions later
-
-	// ***********************************
-	// SHADOW DIMENSION CALCULATIONS
-	// ***********************************
-	// Reference Appelbaum and Bany "Shadow effect of adjacent solar collectors in large scale systems" Solar Energy 1979 Vol 23. No. 6
+	double m_B, m_row_length;
+	ss_row_dimensions( inputs, m_B, m_row_length );
 
 	double m_A; //NOTE THAT THIS IS APPLEBAUM A, WHICH IS THE ROW SIDE WIDTH, NOT DELINE A, WHICH IS THE ROW LENGTH
 	// APPLEBAUM A IS EQUAL TO DELINE B
 	m_A = m_B;
 
 	double px, py;
-	double S,X;
-
-	// AppelBaum Appendix A
-	double g, Hs;
 
 	/* two assumptions in Applebaum paper:
 		1. Azimuth = 0 is facing toward sun (south in northern hemisphere)
@@ -450,26 +406,18 @@ bool ss_exec(
 		Hs = 0;
 	else
 		Hs = m_A * (1.0 - m_R / py);
+}
 
-	//overwrite Hs using geometrically calculated shade fraction for one-axis trackers
-	if (trackmode == 1)
-	{
-		Hs = shade_frac_1x * m_B;
-	}
-
-	// Additional constraints from Chris 4/11/12
-	Hs = fmax( Hs, 0.0);	// Hs must be positive
-	Hs = fmin( Hs, m_B);	// Hs cannot be greater than the height of the row
-
-	if (linear)
-	{
-		//relative shaded area, Applebaum equation A15
-		double relative_shaded_area = Hs * (m_row_length - g) / (m_A * m_row_length); //numerator is shadow area, denom is row area
-		outputs.m_shade_frac_fixed = relative_shaded_area;
-		return true;
-	}
+// fraction of parallel strings shaded (X) and fraction of submodules shaded in a string (S) from Chris Deline 4/23/12
+static void ss_xs( const ssinputs &inputs, double Hs, double g, double &X, double &S )
+{
+	double m_m = inputs.nmody;
+	double m_n = inputs.nmodx;
+	double m_d = inputs.ndiode;
+	double m_W = inputs.width;
+	double m_L = inputs.length;
+	double m_r = inputs.nrows;
 
-	// X and S from Chris Deline 4/23/12
 	if ( inputs.str_orient == 1 ) // Horizontal wiring
 	{
 		if ( inputs.mod_orient == 1 ) // Landscape mode
@@ -508,6 +456,99 @@ bool ss_exec(
 			S = ( ceil( Hs * m_d / m_W ) / (m_d * m_m * m_r) ) * (m_r - 1.0);
 		}
 	}
+}
+
+bool ss_exec(
+	
+	const ssinputs &inputs,
+
+	double tilt,		// module tilt (constant for fixed tilt, varies for one-axis)
+	double azimuth,		// module azimuth (constant for fixed tilt, varies for one-axis)
+	double solzen,		// solar zenith (deg)
+	double solazi,		// solar azimuth (deg)
+	double Gb_nor,		// beam normal irradiance (W/m2)
+	double Gb_poa,		// POA beam irradiance (W/m2)
+	double Gd_poa,		// POA diffuse, sky+gnd (W/m2)
+	double albedo,		// used to calculate reduced relected irradiance
+	bool trackmode,		// 0 for fixed tilt, 1 for one-axis tracking
+	bool linear,		// 0 for non-linear shading (C. Deline's full algorithm), 1 to stop at linear shading
+	double shade_frac_1x,	// geometric calculation of the fraction of one-axis row that is shaded (0-1), not used if fixed tilt 
+
+	ssoutputs &outputs,
+	const ss_table *table)	// precomputed fixed tilt geometry (optional)
+{
+
+	// ***********************************
+	// VARIABLE ASSIGNMENTS
+	// ***********************************
+
+	// translate inputs to variable names consistent with C. Deline's self-shading paper for clarity
+	double m_d = inputs.ndiode;
+	double m_r = inputs.nrows;
+	double m_R = inputs.row_space;
+
+	// check for divide by zero issues with Row spacing per email from Chris 5/2/12
+	if (m_R < M_EPS) m_R = M_EPS;
+
+	// calculate the mask angle
+	// NOTE THAT B HERE IS PER CHRIS DELINE'S PAPER: B IS THE LENGTH OF THE SIDE OF A ROW
+	// calculate the length of the row also
+	double m_B, m_row_length;
+	ss_row_dimensions( inputs, m_B, m_row_length );
+
+	double a = 0.0, b = m_B;
+	
+	double mask_angle;
+	if (inputs.mask_angle_calc_method == 1)
+	{
+	// average over entire array
+		mask_angle = qromb( mask_angle_func, a, b, m_R, m_B, tilt) / m_B;
+	}
+	else
+	{
+	// worst case (default)
+	// updated to phi(0) per email from Chris Deline 5/2/12
+		mask_angle = atan2( ( m_B * sind( tilt ) ), ( m_R - m_B * cosd( tilt ) ) );
+	}
+	mask_angle *= 180.0/M_PI; // change to degrees to pass into functions later
+
+	// ***********************************
+	// SHADOW DIMENSION CALCULATIONS
+	// ***********************************
+
+	double m_A = m_B;
+	double S,X;
+	double g, Hs;
+
+	double tabulated[2];
+	if (!trackmode && table != 0 && table->mode() == ss_table::FIXED && table->lookup( solazi, solzen, tabulated ))
+	{
+		Hs = tabulated[0] * m_B;
+		g = tabulated[1] * m_row_length;
+	}
+	else
+		ss_shadow( inputs, tilt, azimuth, solzen, solazi, Hs, g );
+
+	//overwrite Hs using geometrically calculated shade fraction for one-axis trackers
+	if (trackmode == 1)
+	{
+		Hs = shade_frac_1x * m_B;
+	}
+
+	// Additional constraints from Chris 4/11/12
+	Hs = fmax( Hs, 0.0);	// Hs must be positive
+	Hs = fmin( Hs, m_B);	// Hs cannot be greater than the height of the row
+
+	if (linear)
+	{
+		//relative shaded area, Applebaum equation A15
+		double relative_shaded_area = Hs * (m_row_length - g) / (m_A * m_row_length); //numerator is shadow area, denom is row area
+		outputs.m_shade_frac_fixed = relative_shaded_area;
+		return true;
+	}
+
+	// X and S from Chris Deline 4/23/12
+	ss_xs( inputs, Hs, g, X, S );
 
 	// overwrite S to be 1 for one-axis trackers- assume entire row is shaded
 	if (trackmode == 1)
@@ -534,3 +575,158 @@ bool ss_exec(
 
 	return true;
 }
+
+// PRECOMPUTED SELF-SHADING GEOMETRY
+
+#define SS_TABLE_NAZ 361	// solar azimuth 0..360 deg
+#define SS_TABLE_NZEN 91	// solar zenith 0..90 deg
+
+ss_table::ss_table()
+	: m_mode(NONE), m_tilt(0), m_azimuth(0), m_rotlim(0), m_gcr(0)
+{
+}
+
+void ss_table::init_fixed( const ssinputs &inputs, double tilt, double azimuth, double tolerance )
+{
+	m_mode = FIXED;
+	m_tilt = tilt;
+	m_azimuth = azimuth;
+	build( inputs, tolerance );
+}
+
+void ss_table::init_1x( const ssinputs &inputs, double axis_tilt, double axis_azimuth, double rotlim, double gcr, double tolerance )
+{
+	m_mode = ONE_AXIS;
+	m_tilt = axis_tilt;
+	m_azimuth = axis_azimuth;
+	m_rotlim = rotlim;
+	m_gcr = gcr;
+	build( inputs, tolerance );
+}
+
+void ss_table::exact( double solazi, double solzen, double values[2] ) const
+{
+	if (m_mode == FIXED)
+	{
+		double B, row_length, Hs, g;
+		ss_row_dimensions( m_inputs, B, row_length );
+		ss_shadow( m_inputs, m_tilt, m_azimuth, solzen, solazi, Hs, g );
+		values[0] = fmin( fmax( Hs, 0.0 ), B ) / B;
+		values[1] = (row_length > 0) ? g / row_length : 0;
+	}
+	else
+	{
+		double angle[5];
+		incidence( 1, m_tilt, m_azimuth, m_rotlim, solzen * M_PI / 180, solazi * M_PI / 180, false, m_gcr, angle );
+		values[0] = shadeFraction1x( solazi, solzen, m_tilt, m_azimuth, m_gcr, angle[3] * 180 / M_PI );
+		values[1] = angle[3] / M_PI; // tracker rotation, checked so that cells where the tracker flips over are calculated exactly
+	}
+}
+
+// the number of shaded strings and submodules, which change in steps that cannot be interpolated
+void ss_table::classify( const ssinputs &inputs, const double values[2], double xs[2] ) const
+{
+	double B, row_length;
+	ss_row_dimensions( inputs, B, row_length );
+	if (m_mode == FIXED)
+		ss_xs( inputs, values[0] * B, values[1] * row_length, xs[0], xs[1] );
+	else
+	{
+		ss_xs( inputs, values[0] * B, 0, xs[0], xs[1] );
+		xs[1] = 1;
+	}
+}
+
+void ss_table::build( const ssinputs &inputs, double tolerance )
+{
+	m_inputs = inputs;
+	m_values.assign( 2 * SS_TABLE_NAZ * SS_TABLE_NZEN, 0.0 );
+	m_exact.assign( (SS_TABLE_NAZ - 1) * (SS_TABLE_NZEN - 1), 0 );
+
+	// exact values on a half degree grid: the nodes, plus the cell centers and edge midpoints used for checking
+	const int naz2 = 2 * SS_TABLE_NAZ - 1, nzen2 = 2 * SS_TABLE_NZEN - 1;
+	std::vector<double> fine( 2 * naz2 * nzen2 ), xs( 2 * naz2 * nzen2 );
+	for (int j = 0; j < nzen2; j++)
+	{
+		for (int i = 0; i < naz2; i++)
+		{
+			size_t n = 2 * (j * naz2 + i);
+			exact( 0.5 * i, 0.5 * j, &fine[n] );
+			classify( inputs, &fine[n], &xs[n] );
+			if (i % 2 == 0 && j % 2 == 0)
+			{
+				size_t node = 2 * ((j / 2) * SS_TABLE_NAZ + i / 2);
+				m_values[node] = fine[n];
+				m_values[node + 1] = fine[n + 1];
+			}
+		}
+	}
+
+	for (int j = 0; j < SS_TABLE_NZEN - 1; j++)
+	{
+		for (int i = 0; i < SS_TABLE_NAZ - 1; i++)
+		{
+			// the shadow grows without bound as the sun approaches the horizon
+			bool use_exact = (j == SS_TABLE_NZEN - 2);
+
+			const double *v00 = &m_values[2 * (j * SS_TABLE_NAZ + i)];
+			const double *v01 = v00 + 2;
+			const double *v10 = v00 + 2 * SS_TABLE_NAZ;
+			const double *v11 = v10 + 2;
+
+			size_t c = 2 * (2 * j * naz2 + 2 * i);
+			for (int b = 0; b <= 2 && !use_exact; b++)
+			{
+				for (int a = 0; a <= 2 && !use_exact; a++)
+				{
+					size_t n = c + 2 * (b * naz2 + a);
+
+					// shading onset, or a change in the number of shaded strings or submodules
+					if (xs[n] != xs[c] || xs[n + 1] != xs[c + 1] || (fine[n] > 0) != (fine[c] > 0))
+						use_exact = true;
+
+					// interpolation error at the cell center and edge midpoints
+					double fa = 0.5 * a, fz = 0.5 * b;
+					for (int k = 0; k < 2; k++)
+					{
+						double interp = (1 - fz) * ((1 - fa) * v00[k] + fa * v01[k]) + fz * ((1 - fa) * v10[k] + fa * v11[k]);
+						if (fabs( interp - fine[n + k] ) > tolerance)
+							use_exact = true;
+					}
+				}
+			}
+			m_exact[j * (SS_TABLE_NAZ - 1) + i] = use_exact ? 1 : 0;
+		}
+	}
+}
+
+bool ss_table::lookup( double solazi, double solzen, double values[2] ) const
+{
+	if (m_mode == NONE || !(solzen >= 0 && solzen < SS_TABLE_NZEN - 1) || !(solazi >= 0 && solazi < SS_TABLE_NAZ - 1))
+		return false;
+
+	int i = (int)solazi;
+	int j = (int)solzen;
+	if (m_exact[j * (SS_TABLE_NAZ - 1) + i])
+		return false;
+
+	double fa = solazi - i;
+	double fz = solzen - j;
+	const double *v00 = &m_values[2 * (j * SS_TABLE_NAZ + i)];
+	const double *v01 = v00 + 2;
+	const double *v10 = v00 + 2 * SS_TABLE_NAZ;
+	const double *v11 = v10 + 2;
+	for (int k = 0; k < 2; k++)
+		values[k] = (1 - fz) * ((1 - fa) * v00[k] + fa * v01[k]) + fz * ((1 - fa) * v10[k] + fa * v11[k]);
+	return true;
+}
+
+double ss_table::exact_fraction() const
+{
+	if (m_exact.empty())
+		return 1.0;
+	size_t n = 0;
+	for (size_t i = 0; i < m_exact.size(); i++)
+		n += m_exact[i];
+	return (double)n / (double)m_exact.size();
+}
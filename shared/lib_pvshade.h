@@ -51,6 +51,7 @@
 #define __pvshade_h
 
 #include <string>
+#include <vector>
 
 #include "lib_util.h"
 
@@ -147,6 +148,44 @@ struct ssoutputs	// self-shading outputs
 	double m_shade_frac_fixed;
 };
 
+// precomputed self-shading geometry for a subarray whose layout does not change with time.
+// the geometry is tabulated on a one degree grid of solar azimuth and zenith and interpolated
+// bilinearly. when the table is built, each grid cell is compared with the exact calculation at its
+// center and edge midpoints: cells that miss by more than the tolerance, or where the number of shaded
+// strings and submodules changes (including the onset of shading), are left to the exact calculation.
+class ss_table
+{
+public:
+	enum { NONE, FIXED, ONE_AXIS };
+
+	ss_table();
+
+	// tabulate the fraction of the row height (Hs) and length (g) shaded for a fixed tilt array
+	void init_fixed( const ssinputs &inputs, double tilt, double azimuth, double tolerance );
+
+	// tabulate shadeFraction1x for a one-axis tracker at its ideal (not backtracked) rotation
+	void init_1x( const ssinputs &inputs, double axis_tilt, double axis_azimuth, double rotlim, double gcr, double tolerance );
+
+	int mode() const { return m_mode; }
+
+	// interpolated values at the sun position (deg), returns false if it must be calculated exactly
+	bool lookup( double solazi, double solzen, double values[2] ) const;
+
+	// fraction of the grid cells that are calculated exactly
+	double exact_fraction() const;
+
+private:
+	void build( const ssinputs &inputs, double tolerance );
+	void exact( double solazi, double solzen, double values[2] ) const;
+	void classify( const ssinputs &inputs, const double values[2], double xs[2] ) const;
+
+	int m_mode;
+	double m_tilt, m_azimuth, m_rotlim, m_gcr;
+	ssinputs m_inputs;
+	std::vector<double> m_values;	// two values per grid node
+	std::vector<unsigned char> m_exact;	// one flag per grid cell
+};
+
 //performs shading calculation and returns outputs
 bool ss_exec(
 	const ssinputs &inputs,
@@ -163,6 +202,7 @@ bool ss_exec(
 	bool linear,		// 0 for non-linear shading (C. Deline's full algorithm), 1 to stop at linear shading
 	double shade_frac_1x,	// geometric calculation of the fraction of one-axis row that is shaded (0-1), not used if fixed tilt 
 	
-	ssoutputs &outputs);
+	ssoutputs &outputs,
+	const ss_table *table = 0);	// precomputed fixed tilt geometry (optional)
 
 #endif
\ No newline at end of file
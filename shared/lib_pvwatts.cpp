@@ -98,8 +98,14 @@
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits>
+#include <thread>
 
 #include "lib_pvwatts.h"
+#include "lib_irradproc.h"
+#include "lib_pvshade.h"
+#include "lib_pv_incidence_modifier.h"
+#include "lib_util.h"
 
 #ifndef M_PI
 #define M_PI 3.1415926535
@@ -387,3 +393,457 @@ double dctoac(double pcrate,double efffp,double dc)
 
 	return(ac);
 }
+
+pvwatts5_system::pvwatts5_system()
+{
+	dc_nameplate = ac_nameplate = inv_eff_percent = loss_percent = std::numeric_limits<double>::quiet_NaN();
+	tilt = azimuth = gcr = gamma = inoct = std::numeric_limits<double>::quiet_NaN();
+	module_type = array_type = track_mode = shade_mode_1x = -999;
+	use_ar_glass = false;
+}
+
+void pvwatts5_system::setup( double system_capacity_kw, double dc_ac_ratio, double inv_eff, double losses,
+	double _tilt, double _azimuth, int _module_type, int _array_type, double _gcr )
+{
+	dc_nameplate = system_capacity_kw*1000;
+	ac_nameplate = dc_nameplate / dc_ac_ratio;
+	inv_eff_percent = inv_eff;
+	loss_percent = losses;
+	tilt = _tilt;
+	azimuth = _azimuth;
+	gcr = _gcr;
+
+	gamma = 0;
+	use_ar_glass = false;
+
+	module_type = _module_type;
+	switch( module_type )
+	{
+	case 0: // standard module
+		gamma = -0.0047; use_ar_glass = false; break;
+	case 1: // premium module
+		gamma = -0.0035; use_ar_glass = true; break;
+	case 2: // thin film module
+		gamma = -0.0020; use_ar_glass = false; break;
+	}
+
+	track_mode =  0;
+	inoct = 45;
+	shade_mode_1x = 0; // self shaded
+
+	array_type = _array_type;
+	switch( array_type )
+	{
+	case 0: // fixed open rack
+		track_mode = 0; inoct = 45; shade_mode_1x = 0; break;
+	case 1: // fixed roof mount
+		track_mode = 0; inoct = 49; shade_mode_1x = 0; break;
+	case 2: // 1 axis self-shaded
+		track_mode = 1; inoct = 45; shade_mode_1x = 0; break;
+	case 3: // 1 axis backtracked
+		track_mode = 1; inoct = 45; shade_mode_1x = 1; break;
+	case 4: // 2 axis
+		track_mode = 2; inoct = 45; shade_mode_1x = 0; break;
+	case 5: // azimuth axis
+		track_mode = 3; inoct = 45; shade_mode_1x = 0; break;
+	}
+}
+
+void pvwatts5_system::selfshade_1x( double solazi, double solzen, double stilt, double rot, double dni, double alb,
+	double &shad_beam, double &iskydiff, double &ignddiff, double &Fskydiff, double &Fgnddiff ) const
+{
+	Fskydiff = 1.0;
+	Fgnddiff = 1.0;
+
+	if ( track_mode != 1 || shade_mode_1x != 0 ) // only self-shaded 1 axis trackers
+		return;
+
+	double shad1xf = shadeFraction1x( solazi, solzen, tilt, azimuth, gcr, rot );
+	shad_beam *= (float)(1-shad1xf); // single precision, consistent with the reported shading factor
+
+	if ( iskydiff > 0 )
+	{
+		double reduced_skydiff = iskydiff;
+		double reduced_gnddiff = ignddiff;
+
+		// worst-case mask angle using calculated surface tilt
+		double phi0 = 180/3.1415926*atan2( sind( stilt ), 1/gcr - cosd( stilt ) );
+
+		// calculate sky and gnd diffuse derate factors
+		// based on view factor reductions from self-shading
+		diffuse_reduce( solzen, stilt,
+			dni, iskydiff+ignddiff,
+			gcr, phi0, alb, 1000,
+
+			// outputs (pass by reference)
+			reduced_skydiff, Fskydiff,
+			reduced_gnddiff, Fgnddiff );
+
+		// invalid factors are not applied, the caller may report them
+		if ( Fskydiff >= 0 && Fskydiff <= 1 ) iskydiff *= Fskydiff;
+		if ( Fgnddiff >= 0 && Fgnddiff <= 1 ) ignddiff *= Fgnddiff;
+	}
+}
+
+double pvwatts5_system::transmitted_poa( double poa, double dni, double aoi ) const
+{
+	double tpoa = poa;
+	if ( aoi > AOI_MIN && aoi < AOI_MAX )
+	{
+		double mod = iam( aoi, use_ar_glass );
+		tpoa = poa - ( 1.0 - mod )*dni*cosd(aoi);
+		if( tpoa < 0.0 ) tpoa = 0.0;
+		if( tpoa > poa ) tpoa = poa;
+	}
+	return tpoa;
+}
+
+double pvwatts5_system::dcpower( double tpoa, double pvt ) const
+{
+	// dc power output (Watts)
+	double dc = dc_nameplate*(1.0+gamma*(pvt-25.0))*tpoa/1000.0;
+
+	// dc losses
+	return dc*(1-loss_percent/100);
+}
+
+double pvwatts5_system::acpower( double dc ) const
+{
+	// inverter efficiency
+	double etanom = inv_eff_percent/100.0;
+	double etaref = 0.9637;
+	double A =  -0.0162;
+	double B = -0.0059;
+	double C =  0.9858;
+	double pdc0 = ac_nameplate/etanom;
+	double plr = dc / pdc0;
+	double ac = 0;
+
+	if ( plr > 0 )
+	{ // normal operation
+		double eta = (A*plr + B/plr + C)*etanom/etaref;
+		ac = dc*eta;
+	}
+
+	if ( ac > ac_nameplate ) // clipping
+		ac = ac_nameplate;
+
+	// make sure no negative AC values (no parasitic nighttime losses calculated)
+	if ( ac < 0 ) ac = 0;
+
+	return ac;
+}
+
+pvwatts5_step::pvwatts5_step( const pvwatts5_system &sys, double lat, double lon, double tz, double ts_hour, bool interpolate )
+	: m_sys( sys ), m_lat( lat ), m_lon( lon ), m_tz( tz ),
+	m_delt( interpolate ? ts_hour : IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET ),
+	m_tccalc( sys.inoct+273.15, PVWATTS_HEIGHT, ts_hour ),
+	m_daylight( new daylight_mask( lat, lon, tz, m_delt ) )
+{
+	double nan = std::numeric_limits<double>::quiet_NaN();
+	solazi = solzen = solalt = aoi = stilt = sazi = rot = btd = nan;
+	sunup = 0;
+	ibeam = iskydiff = ignddiff = nan;
+	Fskydiff = Fgnddiff = 1.0;
+	poa = tpoa = pvt = dc = ac = nan;
+}
+
+pvwatts5_step::~pvwatts5_step()
+{
+	// defined here, where daylight_mask is a complete type
+}
+
+void pvwatts5_step::set_last_values( double tcell, double last_poa )
+{
+	if ( tcell > -99 && last_poa >= 0 )
+		m_tccalc.set_last_values( tcell, last_poa );
+}
+
+int pvwatts5_step::process_irradiance( int year, int month, int day, int hour, double minute, double dn, double df, double alb )
+{
+	// sun is down for the whole step: the values irrad::calc() reports at night, without running it
+	if ( m_daylight->night( year, month, day, hour, minute ) )
+	{
+		solazi = solzen = solalt = (-999*DTOR) * (180/M_PI);
+		aoi = stilt = sazi = rot = btd = 0;
+		sunup = 0;
+		ibeam = iskydiff = ignddiff = 0;
+		return 0;
+	}
+
+	irrad irr;
+	irr.set_time( year, month, day, hour, minute, m_delt );
+	irr.set_location( m_lat, m_lon, m_tz );
+	irr.set_sky_model( 2, alb );
+	irr.set_beam_diffuse( dn, df );
+	irr.set_surface( m_sys.track_mode, m_sys.tilt, m_sys.azimuth, PVWATTS_ROTLIM,
+		m_sys.shade_mode_1x == 1, // backtracking mode
+		m_sys.gcr );
+
+	irr.set_noon_sun( m_daylight->noon() );
+
+	int code = irr.calc();
+
+	irr.get_sun( &solazi, &solzen, &solalt, 0, 0, 0, &sunup, 0, 0, 0 );
+	irr.get_angles( &aoi, &stilt, &sazi, &rot, &btd );
+	irr.get_poa( &ibeam, &iskydiff, &ignddiff, 0, 0, 0 );
+
+	return code;
+}
+
+void pvwatts5_step::powerout( double &shad_beam, double shad_diff, double dni, double alb, double wspd, double tdry )
+{
+	Fskydiff = Fgnddiff = 1.0;
+
+	if ( sunup > 0 )
+	{
+		m_sys.selfshade_1x( solazi, solzen, stilt, rot, dni, alb,
+			shad_beam, iskydiff, ignddiff, Fskydiff, Fgnddiff );
+
+		// apply hourly shading factors to beam (if none enabled, factors are 1.0)
+		ibeam *= shad_beam;
+
+		// apply sky diffuse shading factor (specified as constant, nominally 1.0 if disabled in UI)
+		iskydiff *= shad_diff;
+
+		poa = ibeam + iskydiff + ignddiff;
+
+		double wspd_corr = wspd < 0 ? 0 : wspd;
+
+		tpoa = m_sys.transmitted_poa( poa, dni, aoi );
+		pvt = m_tccalc( poa, wspd_corr, tdry );
+		dc = m_sys.dcpower( tpoa, pvt );
+		ac = m_sys.acpower( dc );
+	}
+	else
+	{
+		poa = 0;
+		tpoa = 0;
+		pvt = tdry;
+		dc = 0;
+		ac = 0;
+	}
+}
+
+int pvwatts5_step::step( const weather_record &wf )
+{
+	double alb = PVWATTS_ALBEDO; // do not increase albedo if snow exists in TMY2
+	if ( std::isfinite( wf.alb ) && wf.alb > 0 && wf.alb < 1 )
+		alb = wf.alb;
+
+	int code = process_irradiance( wf.year, wf.month, wf.day, wf.hour, wf.minute, wf.dn, wf.df, alb );
+	if ( code == 0 || code == -1 )
+	{
+		double shad_beam = 1.0;
+		powerout( shad_beam, 1.0, wf.dn, alb, wf.wspd, wf.tdry );
+	}
+	return code;
+}
+
+pvwatts5_fleet::pvwatts5_fleet()
+{
+	m_wf = 0;
+	m_sun = 0;
+	m_nbeam_exceeded = 0;
+	m_ts_hour = 1.0;
+	m_keep_timeseries = false;
+}
+
+size_t pvwatts5_fleet::add_system( const pvwatts5_system &sys )
+{
+	m_systems.push_back( sys );
+	m_dc_nameplate.push_back( sys.dc_nameplate );
+	m_gamma.push_back( sys.gamma );
+	m_loss_factor.push_back( 1-sys.loss_percent/100 );
+	m_etanom.push_back( sys.inv_eff_percent/100.0 );
+	m_pdc0.push_back( sys.ac_nameplate/m_etanom.back() );
+	m_ac_nameplate.push_back( sys.ac_nameplate );
+	return m_systems.size()-1;
+}
+
+double pvwatts5_fleet::annual_energy( size_t isys ) const
+{
+	double sum = 0;
+	for ( int m=0;m<12;m++ )
+		sum += m_monthly[isys*12 + m];
+	return sum;
+}
+
+const float *pvwatts5_fleet::ac( size_t isys ) const
+{
+	if ( !m_keep_timeseries || m_wf == 0 ) return 0;
+	return &m_ac[isys*m_wf->size()];
+}
+
+void pvwatts5_fleet::run( const std::vector<weather_record> &wf, const sunpos_cache &sun, double ts_hour,
+	int nthreads, bool keep_timeseries )
+{
+	size_t nsys = m_systems.size();
+	size_t nrec = wf.size();
+
+	m_wf = &wf;
+	m_sun = &sun;
+	m_ts_hour = ts_hour;
+	m_keep_timeseries = keep_timeseries;
+
+	m_monthly.assign( nsys*12, 0.0 );
+	m_ac.assign( keep_timeseries ? nsys*nrec : 0, 0.0f );
+
+	// albedo and the beam irradiance check only depend on the weather record, not on the system
+	m_alb.resize( nrec );
+	m_beam_ok.resize( nrec );
+	m_nbeam_exceeded = 0;
+	for ( size_t r=0;r<nrec;r++ )
+	{
+		double alb = PVWATTS_ALBEDO; // do not increase albedo if snow exists in TMY2
+		if ( std::isfinite( wf[r].alb ) && wf[r].alb > 0 && wf[r].alb < 1 )
+			alb = wf[r].alb;
+		m_alb[r] = alb;
+
+		m_beam_ok[r] = !( sun[r].sunup > 0 && wf[r].dn*cos( sun[r].zenith ) > sun[r].hextra );
+		if ( !m_beam_ok[r] ) m_nbeam_exceeded++;
+	}
+
+	if ( nthreads < 1 ) nthreads = (int)std::thread::hardware_concurrency();
+	if ( nthreads < 1 ) nthreads = 1;
+	if ( (size_t)nthreads > nsys ) nthreads = (int)nsys;
+
+	if ( nthreads <= 1 )
+	{
+		run_block( 0, nsys );
+		return;
+	}
+
+	size_t nper = (nsys + nthreads - 1) / nthreads;
+	std::vector<std::thread> threads;
+	for ( size_t i0=0;i0<nsys;i0+=nper )
+		threads.push_back( std::thread( &pvwatts5_fleet::run_block, this, i0, std::min( i0+nper, nsys ) ) );
+
+	for ( size_t i=0;i<threads.size();i++ )
+		threads[i].join();
+}
+
+void pvwatts5_fleet::run_block( size_t i0, size_t i1 )
+{
+	const std::vector<weather_record> &wf = *m_wf;
+	const sunpos_cache &sun = *m_sun;
+	size_t nrec = wf.size();
+	size_t n = i1-i0;
+
+	std::vector<pvwatts_celltemp> tccalc;
+	tccalc.reserve( n );
+	for ( size_t i=i0;i<i1;i++ )
+		tccalc.push_back( pvwatts_celltemp( m_systems[i].inoct+273.15, PVWATTS_HEIGHT, m_ts_hour ) );
+
+	std::vector<double> tpoa( n ), pvt( n ), ac_step( n );
+
+	// outputs of the block are laid out by record or month, then by system, so each step stores contiguously.
+	// they are transposed into the per-system outputs once a chunk of records is full and at the end of the block
+	const size_t nchunk = 64;
+	std::vector<double> month_kwh( 12*n, 0.0 );
+	std::vector<float> ac_chunk( m_keep_timeseries ? nchunk*n : 0 );
+	std::vector<size_t> chunk_rec( nchunk );
+	size_t nstored = 0;
+
+	auto flush_chunk = [&]()
+	{
+		for ( size_t k=0;k<n;k++ )
+		{
+			float *ac_out = &m_ac[(i0+k)*nrec];
+			for ( size_t j=0;j<nstored;j++ )
+				ac_out[chunk_rec[j]] = ac_chunk[j*n + k];
+		}
+		nstored = 0;
+	};
+
+	const double *dc_nameplate = &m_dc_nameplate[i0];
+	const double *gamma = &m_gamma[i0];
+	const double *loss_factor = &m_loss_factor[i0];
+	const double *pdc0 = &m_pdc0[i0];
+	const double *etanom = &m_etanom[i0];
+	const double *ac_nameplate = &m_ac_nameplate[i0];
+	double to_kwh = 0.001*m_ts_hour;
+
+	for ( size_t r=0;r<nrec;r++ )
+	{
+		const sunpos_cache::record &s = sun[r];
+		if ( s.sunup <= 0 )
+			continue; // no output, cell temperature state is only updated with the sun up
+
+		const weather_record &w = wf[r];
+		double alb = m_alb[r];
+		double solazi = s.azimuth * (180/M_PI);
+		double solzen = s.zenith * (180/M_PI);
+		double wspd_corr = w.wspd < 0 ? 0 : w.wspd;
+
+		// irradiance, self-shading, cover and cell temperature: one system at a time
+		for ( size_t k=0;k<n;k++ )
+		{
+			const pvwatts5_system &sys = m_systems[i0+k];
+
+			double angle[5] = { 0, 0, 0, 0, 0 };
+			double poa3[3] = { 0, 0, 0 };
+			incidence( sys.track_mode, sys.tilt, sys.azimuth, 45.0, s.zenith, s.azimuth,
+				sys.shade_mode_1x == 1, sys.gcr, angle );
+			if ( m_beam_ok[r] )
+				perez( s.hextra, w.dn, w.df, alb, angle[0], angle[1], s.zenith, poa3, 0 );
+
+			double aoi = angle[0] * (180/M_PI);
+			double stilt = angle[1] * (180/M_PI);
+			double rot = angle[3] * (180/M_PI);
+			double ibeam = poa3[0], iskydiff = poa3[1], ignddiff = poa3[2];
+
+			double shad_beam = 1.0, Fskydiff, Fgnddiff;
+			sys.selfshade_1x( solazi, solzen, stilt, rot, w.dn, alb, shad_beam, iskydiff, ignddiff, Fskydiff, Fgnddiff );
+			ibeam *= shad_beam;
+
+			double poa = ibeam + iskydiff + ignddiff;
+			tpoa[k] = sys.transmitted_poa( poa, w.dn, aoi );
+			pvt[k] = tccalc[k]( poa, wspd_corr, w.tdry );
+		}
+
+		// dc and ac stage: straight-line arithmetic over contiguous arrays
+		const double A = -0.0162, B = -0.0059, C = 0.9858, etaref = 0.9637;
+		double *month = &month_kwh[(w.month-1)*n];
+		float *ac_out = 0;
+		if ( m_keep_timeseries )
+		{
+			chunk_rec[nstored] = r;
+			ac_out = &ac_chunk[nstored*n];
+			nstored++;
+		}
+		for ( size_t k=0;k<n;k++ )
+		{
+			double dc = dc_nameplate[k]*(1.0+gamma[k]*(pvt[k]-25.0))*tpoa[k]/1000.0;
+			dc = dc*loss_factor[k];
+
+			// dc*(A*plr + B/plr + C) with the division by plr multiplied out, so the ac power is calculated for every
+			// system and the limits are selects rather than branches
+			double plr = dc / pdc0[k];
+			double ac = (A*plr*dc + B*pdc0[k] + C*dc)*etanom[k]/etaref;
+			double ac_max = ac_nameplate[k];
+			ac = ac > ac_max ? ac_max : ac;
+			ac = ac < 0 ? 0.0 : ac;
+			ac_step[k] = plr > 0 ? ac : 0.0;
+		}
+
+		// monthly energy and time series of the step, also contiguous by system
+		for ( size_t k=0;k<n;k++ )
+			month[k] += ac_step[k]*to_kwh;
+		if ( ac_out )
+		{
+			for ( size_t k=0;k<n;k++ )
+				ac_out[k] = (float)ac_step[k];
+			if ( nstored == nchunk )
+				flush_chunk();
+		}
+	}
+
+	if ( nstored > 0 )
+		flush_chunk();
+
+	double *monthly = &m_monthly[i0*12];
+	for ( size_t k=0;k<n;k++ )
+		for ( int m=0;m<12;m++ )
+			monthly[k*12 + m] = month_kwh[m*n + k];
+}
@@ -50,6 +50,13 @@
 #ifndef __lib_pvwatts_h
 #define __lib_pvwatts_h
 
+#include <vector>
+#include <memory>
+
+struct weather_record;
+class sunpos_cache;
+class daylight_mask;
+
 #define PVWATTS_INOCT (45.0+273.15)
 #define PVWATTS_HEIGHT 5.0
 #define PVWATTS_REFTEM 25.0
@@ -135,4 +142,152 @@ public:
 	void set_last_values( double Tc, double poa );
 };
 
+/**
+* \struct pvwatts5_system
+*
+* System specification for the PVWatts V5 model.  setup() resolves the module type and array type
+* selections into the temperature coefficient, cover, tracking mode, INOCT and self-shading mode.
+*/
+struct pvwatts5_system
+{
+	double dc_nameplate;		///< DC nameplate capacity (W)
+	double ac_nameplate;		///< AC nameplate capacity (W)
+	double inv_eff_percent;		///< Inverter efficiency at rated power (%)
+	double loss_percent;		///< Total system losses (%)
+	double tilt;				///< Tilt angle (deg)
+	double azimuth;				///< Azimuth angle (deg)
+	double gcr;					///< Ground coverage ratio
+	int module_type;			///< 0=standard, 1=premium, 2=thin film
+	int array_type;				///< 0=fixed open rack, 1=fixed roof mount, 2=1-axis, 3=1-axis backtracked, 4=2-axis, 5=azimuth axis
+
+	double gamma;				///< Temperature coefficient of power (1/C)
+	bool use_ar_glass;			///< Module has an anti-reflective glass cover
+	int track_mode;				///< Tracking mode as used by incidence()
+	double inoct;				///< Installed nominal operating cell temperature (C)
+	int shade_mode_1x;			///< 0=self-shaded, 1=backtracked
+
+	pvwatts5_system();
+
+	/// Set the system specification and resolve the module and array types
+	void setup( double system_capacity_kw, double dc_ac_ratio, double inv_eff, double losses,
+		double tilt, double azimuth, int module_type, int array_type, double gcr );
+
+	/// Apply 1-axis self-shading to the beam shading factor and the sky and ground diffuse irradiance, angles in degrees
+	void selfshade_1x( double solazi, double solzen, double stilt, double rot, double dni, double alb,
+		double &shad_beam, double &iskydiff, double &ignddiff, double &Fskydiff, double &Fgnddiff ) const;
+
+	/// Plane-of-array irradiance transmitted through the module cover (W/m2)
+	double transmitted_poa( double poa, double dni, double aoi ) const;
+
+	/// DC power after system losses (W)
+	double dcpower( double tpoa, double pvt ) const;
+
+	/// AC power after inverter efficiency and clipping (W)
+	double acpower( double dc ) const;
+};
+
+/**
+* \class pvwatts5_step
+*
+* Stateful PVWatts V5 model for driving one system a time step at a time.  The system, site and
+* time step are fixed at construction, and the cell temperature is carried from one step to the
+* next, so no inputs need to be set up again between calls.  Sunrise and sunset are calculated
+* once per day, and night time steps skip the sun position and irradiance models.
+*/
+class pvwatts5_step
+{
+public:
+	/// ts_hour is the weather time step; if interpolate is set, sun position in sunrise and sunset steps is taken at the midpoint of the up period
+	pvwatts5_step( const pvwatts5_system &sys, double lat, double lon, double tz, double ts_hour, bool interpolate );
+	~pvwatts5_step();
+
+	/// Set the cell temperature (C) and POA irradiance (W/m2) of the previous time step
+	void set_last_values( double tcell, double poa );
+
+	/// Calculate the sun position and POA irradiance components, returns the irrad::calc() code
+	int process_irradiance( int year, int month, int day, int hour, double minute, double dn, double df, double alb );
+
+	/// Calculate the cell temperature and the DC and AC power from the last process_irradiance() call
+	void powerout( double &shad_beam, double shad_diff, double dni, double alb, double wspd, double tdry );
+
+	/// Run a complete time step for an unshaded system, returns the irrad::calc() code
+	int step( const weather_record &wf );
+
+	const pvwatts5_system &system() const { return m_sys; }
+
+	// sun position and surface angles, degrees
+	double solazi, solzen, solalt, aoi, stilt, sazi, rot, btd;
+	int sunup;
+
+	// POA irradiance components (W/m2) and 1-axis self-shading diffuse reduction factors
+	double ibeam, iskydiff, ignddiff;
+	double Fskydiff, Fgnddiff;
+
+	// results: POA and transmitted POA (W/m2), cell temperature (C), DC and AC power (W)
+	double poa, tpoa, pvt, dc, ac;
+
+private:
+	pvwatts5_system m_sys;
+	double m_lat, m_lon, m_tz;
+	double m_delt;
+	pvwatts_celltemp m_tccalc;
+	std::unique_ptr<daylight_mask> m_daylight;
+};
+
+/**
+* \class pvwatts5_fleet
+*
+* Simulates many PVWatts V5 systems against one shared weather time series.  The sun position
+* is calculated once per weather record by a sunpos_cache and shared by all systems.  Per-system
+* parameters and results are stored in contiguous arrays, and the systems are divided into blocks
+* that are simulated on separate threads.
+*/
+class pvwatts5_fleet
+{
+public:
+	pvwatts5_fleet();
+
+	/// Add a system to the fleet, returns the index of the system
+	size_t add_system( const pvwatts5_system &sys );
+
+	/// Number of systems in the fleet
+	size_t nsystems() const { return m_systems.size(); }
+
+	/// Simulate all systems, nthreads < 1 uses all available hardware threads
+	void run( const std::vector<weather_record> &wf, const sunpos_cache &sun, double ts_hour,
+		int nthreads, bool keep_timeseries );
+
+	/// Annual AC energy of a system (kWh)
+	double annual_energy( size_t isys ) const;
+
+	/// Monthly AC energy of a system (kWh), month 0-11
+	double monthly_energy( size_t isys, int month ) const { return m_monthly[isys*12 + month]; }
+
+	/// AC power time series of a system (W), only available if run() was called with keep_timeseries
+	const float *ac( size_t isys ) const;
+
+	/// Number of records in the last run where beam irradiance exceeded the extraterrestrial value
+	size_t nbeam_exceeded() const { return m_nbeam_exceeded; }
+
+private:
+	void run_block( size_t i0, size_t i1 );
+
+	std::vector<pvwatts5_system> m_systems;
+
+	// per-system coefficients of the dc and ac stage, laid out contiguously so the stage vectorizes
+	std::vector<double> m_dc_nameplate, m_gamma, m_loss_factor, m_pdc0, m_etanom, m_ac_nameplate;
+
+	std::vector<double> m_monthly;	// nsystems x 12
+	std::vector<float> m_ac;		// nsystems x nrecords
+
+	// shared inputs for the current run
+	const std::vector<weather_record> *m_wf;
+	const sunpos_cache *m_sun;
+	std::vector<double> m_alb;
+	std::vector<bool> m_beam_ok;
+	size_t m_nbeam_exceeded;
+	double m_ts_hour;
+	bool m_keep_timeseries;
+};
+
 #endif
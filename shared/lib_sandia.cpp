@@ -394,10 +394,7 @@ bool sandia_inverter_t::acpower(
 )
 {
 	//pass through inputs to the multiple MPPT function as an array with only one entry
-	std::vector<double> Pdc_vec, Vdc_vec;
-	Pdc_vec.push_back(Pdc);
-	Vdc_vec.push_back(Vdc);
-	if (!acpower(Pdc_vec, Vdc_vec, Pac, Ppar, Plr, Eff, Pcliploss, Psoloss, Pntloss))
+	if (!acpower(&Pdc, &Vdc, 1, Pac, Ppar, Plr, Eff, Pcliploss, Psoloss, Pntloss))
 		return false;
 
 	return true;
@@ -405,8 +402,27 @@ bool sandia_inverter_t::acpower(
 
 bool sandia_inverter_t::acpower(
 	/* inputs */
-	std::vector<double> Pdc,     /* Input power to inverter (Wdc) */
-	std::vector<double> Vdc,     /* Vector of Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+	const std::vector<double> &Pdc,     /* Vector of Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+	const std::vector<double> &Vdc,     /* Vector of voltage inputs to inverter (Vdc), one per MPPT input on the inverter */
+
+	/* outputs */
+	double *Pac,    /* AC output power (Wac) */
+	double *Ppar,   /* AC parasitic power consumption (Wac) */
+	double *Plr,    /* Part load ratio (Pdc_in/Pdc_rated, 0..1) */
+	double *Eff,	    /* Conversion efficiency (0..1) */
+	double *Pcliploss, /* Power loss due to clipping loss (Wac) */
+	double *Psoloss, /* Power loss due to operating power consumption (Wdc) */
+	double *Pntloss /* Power loss due to night time tare loss (Wac) */
+	)
+{
+	return acpower(Pdc.empty() ? 0 : &Pdc[0], Vdc.empty() ? 0 : &Vdc[0], Pdc.size(), Pac, Ppar, Plr, Eff, Pcliploss, Psoloss, Pntloss);
+}
+
+bool sandia_inverter_t::acpower(
+	/* inputs */
+	const double *Pdc,     /* Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+	const double *Vdc,     /* Voltage inputs to inverter (Vdc), one per MPPT input on the inverter */
+	size_t nMppt,          /* Number of MPPT inputs */
 
 	/* outputs */
 	double *Pac,    /* AC output power (Wac) */
@@ -425,29 +441,8 @@ bool sandia_inverter_t::acpower(
 	*Pntloss = 0.0;
 	*Pcliploss = 0.0;
 	double Pdc_total = 0;
-	std::vector<double> Pac_each;
-	std::vector<double> PacNoPso_each;
-
-	//loop through each MPPT input
-	for (size_t m = 0; m < Pdc.size(); m++) 
-	{
-		Pac_each.push_back(0);
-		PacNoPso_each.push_back(0);
-
-		double A = Pdco * (1.0 + C1 * (Vdc[m] - Vdco));
-		double B = Pso * (1.0 + C2 * (Vdc[m] - Vdco));
-		double C = C0 * (1.0 + C3 * (Vdc[m] - Vdco));
-
-		// crummy kludge to make sure B parameter has a resonable value (not negative!!)
-		// even for inverters with weird input ranges and power levels, i.e. LeadSolar LS700
-		// assumption is that Pso can't be less than half or more than double its nominal value
-		if (B < 0.5 * Pso) B = 0.5 * Pso;
-		if (B > 2.0 * Pso) B = 2.0 * Pso;
-
-		Pac_each[m] = ((Paco / (A - B)) - C * (A - B)) * (Pdc[m] - B) + C0 * (Pdc[m] - B) * (Pdc[m] - B); //calculate Pac for this MPPT input and save it
-		PacNoPso_each[m] = ((Paco / A) - C * A) * Pdc[m] + C0 * Pdc[m] * Pdc[m]; //calculate Pac without operating losses (Pso = 0) for each MPPT input to store as Pso losses later
+	for (size_t m = 0; m < nMppt; m++)
 		Pdc_total += Pdc[m];
-	}
 
 	// night time: power is equal to nighttime power loss (note that if PacNoPso > Pso and Pac < Pso then the night time loss could be considered an operating power loss)
 	if (Pdc_total <= Pso)
@@ -456,14 +451,29 @@ bool sandia_inverter_t::acpower(
 		*Ppar = Pntare;
 		*Pntloss = Pntare;
 	}
-	// day time: calculate total Pac; power loss is the Pso loss, use values calculated above
+	// day time: calculate total Pac; power loss is the Pso loss
 	else
-		for (size_t m = 0; m < Vdc.size(); m++)
+	{
+		//loop through each MPPT input
+		for (size_t m = 0; m < nMppt; m++)
 		{
-			*Psoloss += PacNoPso_each[m] - Pac_each[m];
-			*Pac += Pac_each[m];
+			double A = Pdco * (1.0 + C1 * (Vdc[m] - Vdco));
+			double B = Pso * (1.0 + C2 * (Vdc[m] - Vdco));
+			double C = C0 * (1.0 + C3 * (Vdc[m] - Vdco));
+
+			// crummy kludge to make sure B parameter has a resonable value (not negative!!)
+			// even for inverters with weird input ranges and power levels, i.e. LeadSolar LS700
+			// assumption is that Pso can't be less than half or more than double its nominal value
+			if (B < 0.5 * Pso) B = 0.5 * Pso;
+			if (B > 2.0 * Pso) B = 2.0 * Pso;
+
+			double Pac_each = ((Paco / (A - B)) - C * (A - B)) * (Pdc[m] - B) + C0 * (Pdc[m] - B) * (Pdc[m] - B); //calculate Pac for this MPPT input
+			double PacNoPso_each = ((Paco / A) - C * A) * Pdc[m] + C0 * Pdc[m] * Pdc[m]; //calculate Pac without operating losses (Pso = 0) for this MPPT input to store as Pso losses
+			*Psoloss += PacNoPso_each - Pac_each;
+			*Pac += Pac_each;
 		}
-	
+	}
+
 	// clipping loss Wac (note that the Pso=0 may have no clipping)
 	double PacNoClip = *Pac;
 	if ( *Pac > Paco )
@@ -143,8 +143,25 @@ public:
 	//function that calculates AC power and inverter losses for a single inverter with multiple MPPT inputs
 	bool acpower(
 		/* inputs */
-		std::vector<double> Pdc,     /* Vector of Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
-		std::vector<double> Vdc,     /* Vector of voltage inputs to inverter (Vdc), one per MPPT input on the inverter */
+		const std::vector<double> &Pdc,     /* Vector of Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+		const std::vector<double> &Vdc,     /* Vector of voltage inputs to inverter (Vdc), one per MPPT input on the inverter */
+
+		/* outputs */
+		double *Pac,    /* AC output power (Wac) */
+		double *Ppar,   /* AC parasitic power consumption (Wac) */
+		double *Plr,    /* Part load ratio (Pdc_in/Pdc_rated, 0..1) */
+		double *Eff,	    /* Conversion efficiency (0..1) */
+		double *Pcliploss, /* Power loss due to clipping loss (Wac) */
+		double *Psoloss, /* Power loss due to operating power consumption (Wdc) */
+		double *Pntloss /* Power loss due to night time tare loss (Wac) */
+	);
+
+	//same as above for arrays of nMppt inputs, does not allocate so it may be called every time step
+	bool acpower(
+		/* inputs */
+		const double *Pdc,     /* Input power to inverter (Wdc), one per MPPT input on the inverter. Note that with several inverters, this is the power to ONE inverter.*/
+		const double *Vdc,     /* Voltage inputs to inverter (Vdc), one per MPPT input on the inverter */
+		size_t nMppt,          /* Number of MPPT inputs */
 
 		/* outputs */
 		double *Pac,    /* AC output power (Wac) */
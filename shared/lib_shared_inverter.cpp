@@ -179,14 +179,15 @@ void SharedInverter::calculateACPower(const double powerDC_kW_in, const double D
 }
 
 /* This function takes input inverter DC power (kW) per MPPT input for a SINGLE multi-mppt inverter, DC voltage (V) per input, and ambient temperature (deg C), and calculates output for the total number of inverters in the system */
-void SharedInverter::calculateACPower(const std::vector<double> powerDC_kW_in, const std::vector<double> DCStringVoltage, double T)
+void SharedInverter::calculateACPower(const std::vector<double> &powerDC_kW_in, const std::vector<double> &DCStringVoltage, double T)
 {
 	double P_par, P_lr;
 
 	//need to convert to watts and divide power by m_num_inverters
-	std::vector<double> powerDC_Watts_one_inv;
+	std::vector<double> &powerDC_Watts_one_inv = m_powerDC_Watts_one_inv;
+	powerDC_Watts_one_inv.resize(powerDC_kW_in.size());
 	for (size_t i = 0; i < powerDC_kW_in.size(); i++)
-		powerDC_Watts_one_inv.push_back(powerDC_kW_in[i] * util::kilowatt_to_watt/ m_numInverters);
+		powerDC_Watts_one_inv[i] = powerDC_kW_in[i] * util::kilowatt_to_watt/ m_numInverters;
 
 	// Power quantities go in and come out in units of W
 	double powerAC_Watts = 0;
@@ -215,6 +216,66 @@ void SharedInverter::calculateACPower(const std::vector<double> powerDC_kW_in, c
 	convertOutputsToKWandScale(tempLoss, powerAC_Watts);
 }
 
+void SharedInverter::calculateACPower(const std::vector<double> &powerDC_kW_in, const std::vector<double> &DCStringVoltage, const std::vector<double> &T, Series &out)
+{
+	size_t nsteps = powerDC_kW_in.size();
+	out.resize(nsteps);
+
+	for (size_t i = 0; i < nsteps; i++)
+	{
+		calculateACPower(powerDC_kW_in[i], DCStringVoltage[i], T[i]);
+		saveToSeries(out, i);
+	}
+}
+
+void SharedInverter::calculateACPower(const std::vector<std::vector<double>> &powerDC_kW_in, const std::vector<std::vector<double>> &DCStringVoltage, const std::vector<double> &T, Series &out)
+{
+	size_t nMppt = powerDC_kW_in.size();
+	size_t nsteps = T.size();
+	out.resize(nsteps);
+
+	m_powerDC_kW_step.resize(nMppt);
+	m_DCStringVoltage_step.resize(nMppt);
+	for (size_t i = 0; i < nsteps; i++)
+	{
+		for (size_t m = 0; m < nMppt; m++)
+		{
+			m_powerDC_kW_step[m] = powerDC_kW_in[m][i];
+			m_DCStringVoltage_step[m] = DCStringVoltage[m][i];
+		}
+		calculateACPower(m_powerDC_kW_step, m_DCStringVoltage_step, T[i]);
+		saveToSeries(out, i);
+	}
+}
+
+void SharedInverter::Series::resize(size_t nsteps)
+{
+	powerDC_kW.resize(nsteps);
+	powerAC_kW.resize(nsteps);
+	efficiencyAC.resize(nsteps);
+	powerClipLoss_kW.resize(nsteps);
+	powerConsumptionLoss_kW.resize(nsteps);
+	powerNightLoss_kW.resize(nsteps);
+	powerTempLoss_kW.resize(nsteps);
+	powerLossTotal_kW.resize(nsteps);
+	dcWiringLoss_ond_kW.resize(nsteps);
+	acWiringLoss_ond_kW.resize(nsteps);
+}
+
+void SharedInverter::saveToSeries(Series &out, size_t i)
+{
+	out.powerDC_kW[i] = powerDC_kW;
+	out.powerAC_kW[i] = powerAC_kW;
+	out.efficiencyAC[i] = efficiencyAC;
+	out.powerClipLoss_kW[i] = powerClipLoss_kW;
+	out.powerConsumptionLoss_kW[i] = powerConsumptionLoss_kW;
+	out.powerNightLoss_kW[i] = powerNightLoss_kW;
+	out.powerTempLoss_kW[i] = powerTempLoss_kW;
+	out.powerLossTotal_kW[i] = powerLossTotal_kW;
+	out.dcWiringLoss_ond_kW[i] = dcWiringLoss_ond_kW;
+	out.acWiringLoss_ond_kW[i] = acWiringLoss_ond_kW;
+}
+
 double SharedInverter::getInverterDCNominalVoltage()
 {
 	if (m_inverterType == SANDIA_INVERTER || m_inverterType == DATASHEET_INVERTER || m_inverterType == COEFFICIENT_GENERATOR)
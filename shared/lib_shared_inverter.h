@@ -33,7 +33,33 @@ public:
 	void calculateACPower(const double powerDC_kW, const double DCStringVoltage, double ambientT);
 	
 	/// Given the combined PV plus battery DC power (kW), voltage and ambient T, compute the AC power (kW) for a single inverter with multiple MPPT inputs
-	void calculateACPower(const std::vector<double> powerDC_kW, const std::vector<double> DCStringVoltage, double ambientT);
+	void calculateACPower(const std::vector<double> &powerDC_kW, const std::vector<double> &DCStringVoltage, double ambientT);
+
+	/// The calculated values for a series of time steps
+	struct Series
+	{
+		std::vector<double> powerDC_kW;
+		std::vector<double> powerAC_kW;
+		std::vector<double> efficiencyAC;
+		std::vector<double> powerClipLoss_kW;
+		std::vector<double> powerConsumptionLoss_kW;
+		std::vector<double> powerNightLoss_kW;
+		std::vector<double> powerTempLoss_kW;
+		std::vector<double> powerLossTotal_kW;
+		std::vector<double> dcWiringLoss_ond_kW;
+		std::vector<double> acWiringLoss_ond_kW;
+
+		void resize(size_t nsteps);
+	};
+
+	/// Given series of DC power (kW), voltage and ambient T, compute the AC power (kW) for a single inverter with one MPPT input at each time step
+	void calculateACPower(const std::vector<double> &powerDC_kW, const std::vector<double> &DCStringVoltage, const std::vector<double> &ambientT, Series &out);
+
+	/// Given series of DC power (kW) and voltage for each MPPT input and of ambient T, compute the AC power (kW) for a single inverter with multiple MPPT inputs at each time step
+	void calculateACPower(const std::vector<std::vector<double>> &powerDC_kW, const std::vector<std::vector<double>> &DCStringVoltage, const std::vector<double> &ambientT, Series &out);
+
+	/// Store the values calculated for the current timestep at step i of a series
+	void saveToSeries(Series &out, size_t i);
 
 	/// Return the nominal DC voltage input
 	double getInverterDCNominalVoltage();
@@ -81,6 +107,11 @@ private:
 
 	void convertOutputsToKWandScale(double tempLoss, double powerAC_watts);
 
+	/// Scratch space for the multiple MPPT calculation, so that it doesn't allocate every timestep
+	std::vector<double> m_powerDC_Watts_one_inv;
+	std::vector<double> m_powerDC_kW_step;
+	std::vector<double> m_DCStringVoltage_step;
+
 };
 
 
@@ -91,6 +91,14 @@ pvsnowmodel::pvsnowmodel()
 	good = true;
 	msg = "";
 
+	slideRate = 0.1 * sSlope;
+	sinBaseTilt = 0;
+	lastTilt = 0;
+	sinLastTilt = 0;
+	recordDepth = recordCvg = 0;
+	recording = replaying = false;
+	yearIndex = 0;
+
 }
 
 bool pvsnowmodel::setup(int nmody_in, float baseTilt_in, bool limitTilt){
@@ -98,6 +106,12 @@ bool pvsnowmodel::setup(int nmody_in, float baseTilt_in, bool limitTilt){
 	nmody = nmody_in;
 	baseTilt = baseTilt_in;
 
+	// sliding factors that only depend on the geometry
+	slideRate = 0.1 * sSlope;
+	sinBaseTilt = sin(baseTilt * M_PI / 180);
+	lastTilt = baseTilt;
+	sinLastTilt = sinBaseTilt;
+
 	if(limitTilt && (baseTilt>45 || baseTilt < 10)){
 		good = true;
 		msg = util::format("The snow model is designed to work for PV arrays with a tilt angle between 10 and 45 degrees, but will generate results for tilt angles outside this range. The system you are modeling includes a subarray tilt angle of %f degrees.", baseTilt);
@@ -109,8 +123,41 @@ bool pvsnowmodel::setup(int nmody_in, float baseTilt_in, bool limitTilt){
 }
 
 
+void pvsnowmodel::startYear()
+{
+	replaying = recording && yearIndex == yearRecord.size() && previousDepth == recordDepth && pCvg == recordCvg;
+	if (!replaying){
+		yearRecord.clear();
+		recordDepth = previousDepth;
+		recordCvg = pCvg;
+		recording = true;
+	}
+	yearIndex = 0;
+}
+
 bool pvsnowmodel::getLoss(float poa, float tilt, float , float tdry, float snowDepth, int sunup, float dt, float &returnLoss){
 
+	// the weather repeats, so a year starting from the recorded state repeats the recorded year
+	if (replaying && yearIndex < yearRecord.size()){
+		const yearStep &s = yearRecord[yearIndex++];
+		if (s.bad){
+			badValues++;
+			if (badValues == maxBadValues){
+				good = false;
+				msg = util::format("The weather file contains no snow depth data or the data is not valid. Found (%d) bad snow depth values.", maxBadValues);
+				return false;
+			}
+		}
+		coverage = pCvg = s.coverage;
+		previousDepth = s.depth;
+		returnLoss = s.loss;
+		return !s.bad;
+	}
+	if (replaying){
+		// the year is longer than the record, stop using it
+		replaying = recording = false;
+	}
+
 	bool isGood = true;
 
 	// Check if snow depth value is valid
@@ -161,13 +208,18 @@ bool pvsnowmodel::getLoss(float poa, float tilt, float , float tdry, float snowD
 	// If the day-time flag is not set, assume the tilt value should be equal to the system's base tilt
 	//   This will fix the issue in sam where system tilt values during nightime hours is zero (even 
 	//   for static systems). This may need to be altered for 1-axis tracking and 2-axis tracking systems
-	if (sunup == 0){
-		tilt = baseTilt;
+	double sinTilt = sinBaseTilt;
+	if (sunup != 0){
+		if (tilt != lastTilt){
+			lastTilt = tilt;
+			sinLastTilt = sin(tilt * M_PI / 180);
+		}
+		sinTilt = sinLastTilt;
 	}
 
 	// check if conditions are right for sliding
 	if (tdry - poa / mSlope > 0){
-		coverage -= (float)(0.1 * sSlope * sin(tilt * M_PI / 180) * dt);
+		coverage -= (float)(slideRate * sinTilt * dt);
 	}
 
 	// Coverage Override #2
@@ -185,6 +237,12 @@ bool pvsnowmodel::getLoss(float poa, float tilt, float , float tdry, float snowD
 	previousDepth = snowDepth;
 	pCvg = coverage;
 
+	if (recording){
+		yearStep s = { returnLoss, coverage, snowDepth, !isGood };
+		yearRecord.push_back(s);
+		yearIndex++;
+	}
+
 	if (isGood) return true;
 	else return false;
 }
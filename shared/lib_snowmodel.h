@@ -51,6 +51,7 @@
 #define __lib_snowmodel_h
 
 #include <string>
+#include <vector>
 
 class pvsnowmodel
 {
@@ -62,6 +63,11 @@ public:
 
 	bool getLoss(float poa, float tilt, float wspd, float tdry, float snowDepth, int sunup, float dt, float &returnLoss);
 
+	// Call at the first time step of each year of a simulation that repeats the same weather year.
+	// The first year is recorded; a later year that starts from the same snow state as the
+	// recorded one is replayed from the record instead of being stepped through again.
+	void startYear();
+
 	float	tilt,		// Surface tilt, degrees
 		baseTilt,		// The default tilt for 1-axis tracking systems
 		mSlope,			// This is a value given by fig. 4 in [1]
@@ -79,6 +85,21 @@ public:
 	std::string msg;		// This is a string used to return error messages
 	bool good;				// This an error flag that will be set to false
 							//  if an error has occured
+
+private:
+	double slideRate,		// 0.1 * sSlope, the sliding rate per unit sin(tilt) and hour
+		sinBaseTilt,		// sin(baseTilt), the sliding factor used at night
+		lastTilt,			// The tilt of the last sliding factor calculated during the day
+		sinLastTilt;		// sin(lastTilt)
+
+	struct yearStep {
+		float loss, coverage, depth;
+		bool bad;
+	};
+	std::vector<yearStep> yearRecord;	// Results of each time step of the recorded year
+	float recordDepth, recordCvg;		// Snow state at the start of the recorded year
+	bool recording, replaying;
+	size_t yearIndex;					// Time step within the current year
 };
 
 #endif
\ No newline at end of file
@@ -1,12 +1,56 @@
+#include <algorithm>
 #include <cmath>
 #include "lib_utility_rate.h"
 
+/// Look up the period for the hour of year in a pair of 12 x 24 weekday and weekend schedules, or a single value
+static size_t schedulePeriod(const util::matrix_t<size_t> & weekday, const util::matrix_t<size_t> & weekend, size_t hourOfYear)
+{
+	size_t month, hour;
+	util::month_hour(hourOfYear, month, hour);
+
+	const util::matrix_t<size_t> & schedule = util::weekday(hourOfYear) ? weekday : weekend;
+	if (schedule.nrows() == 1 && schedule.ncols() == 1) {
+		return schedule.at(0, 0);
+	}
+	return schedule.at(month - 1, hour - 1);
+}
+
+/// Collect the tier peaks and charges for rows whose first column matches key, sorted by tier
+static void tiersFor(const util::matrix_t<double> & rates, size_t key, std::vector<double> & peaks, std::vector<double> & charges)
+{
+	std::vector<std::pair<size_t, size_t>> tierRow;
+	for (size_t r = 0; r != rates.nrows(); r++)
+	{
+		if (static_cast<size_t>(rates(r, 0)) == key)
+			tierRow.push_back(std::make_pair(static_cast<size_t>(rates(r, 1)), r));
+	}
+	std::sort(tierRow.begin(), tierRow.end());
+
+	for (size_t t = 0; t != tierRow.size(); t++)
+	{
+		peaks.push_back(rates(tierRow[t].second, 2));
+		charges.push_back(rates(tierRow[t].second, 3));
+	}
+}
+
 
 UtilityRate::UtilityRate(util::matrix_t<size_t> ecWeekday, util::matrix_t<size_t> ecWeekend, util::matrix_t<double> ecRatesMatrix)
 {
 	m_ecWeekday = ecWeekday;
 	m_ecWeekend = ecWeekend;
 	m_ecRatesMatrix = ecRatesMatrix;
+	m_demandCharges = false;
+}
+
+UtilityRate::UtilityRate(util::matrix_t<size_t> ecWeekday, util::matrix_t<size_t> ecWeekend, util::matrix_t<double> ecRatesMatrix,
+	util::matrix_t<size_t> dcWeekday, util::matrix_t<size_t> dcWeekend, util::matrix_t<double> dcRatesMatrix, util::matrix_t<double> dcFlatMatrix) :
+	UtilityRate(ecWeekday, ecWeekend, ecRatesMatrix)
+{
+	m_dcWeekday = dcWeekday;
+	m_dcWeekend = dcWeekend;
+	m_dcRatesMatrix = dcRatesMatrix;
+	m_dcFlatMatrix = dcFlatMatrix;
+	m_demandCharges = true;
 }
 
 UtilityRateCalculator::UtilityRateCalculator(UtilityRate * rate, size_t stepsPerHour) :
@@ -68,24 +112,43 @@ double UtilityRateCalculator::getEnergyRate(size_t hourOfYear)
 }
 size_t UtilityRateCalculator::getEnergyPeriod(size_t hourOfYear)
 {
-	size_t period, month, hour;
-	util::month_hour(hourOfYear, month, hour);
+	return schedulePeriod(m_ecWeekday, m_ecWeekend, hourOfYear);
+}
+double UtilityRateCalculator::getEnergySellRate(size_t hourOfYear)
+{
+	if (m_ecRatesMatrix.ncols() < 6)
+		return 0;
 
-	if (util::weekday(hourOfYear)) {
-		if (m_ecWeekday.nrows() == 1 && m_ecWeekday.ncols() == 1) {
-			period = m_ecWeekday.at(0, 0);
-		}
-		else {
-			period = m_ecWeekday.at(month - 1, hour - 1);
-		}
-	}
-	else {
-		if (m_ecWeekend.nrows() == 1 && m_ecWeekend.ncols() == 1) {
-			period = m_ecWeekend.at(0, 0);
-		}
-		else {
-			period = m_ecWeekend.at(month - 1, hour - 1);
-		}
-	}
-	return period;
+	return m_ecRatesMatrix(getEnergyPeriod(hourOfYear) - 1, 5);
+}
+size_t UtilityRateCalculator::getDemandPeriod(size_t hourOfYear)
+{
+	if (!m_demandCharges)
+		return 0;
+
+	return schedulePeriod(m_dcWeekday, m_dcWeekend, hourOfYear);
+}
+size_t UtilityRateCalculator::getNumberOfDemandPeriods()
+{
+	size_t periods = 0;
+	if (!m_demandCharges)
+		return periods;
+
+	for (size_t r = 0; r != m_dcRatesMatrix.nrows(); r++)
+		periods = std::max(periods, static_cast<size_t>(m_dcRatesMatrix(r, 0)));
+	return periods;
+}
+void UtilityRateCalculator::getDemandTiers(size_t period, std::vector<double> & peaks, std::vector<double> & charges)
+{
+	peaks.clear();
+	charges.clear();
+	if (m_demandCharges)
+		tiersFor(m_dcRatesMatrix, period, peaks, charges);
+}
+void UtilityRateCalculator::getFlatDemandTiers(size_t month, std::vector<double> & peaks, std::vector<double> & charges)
+{
+	peaks.clear();
+	charges.clear();
+	if (m_demandCharges)
+		tiersFor(m_dcFlatMatrix, month, peaks, charges);
 }
@@ -8,10 +8,14 @@ class UtilityRate
 {
 public:
 	
-	UtilityRate(){};
+	UtilityRate() : m_demandCharges(false) {};
 
 	UtilityRate(util::matrix_t<size_t> ecWeekday, util::matrix_t<size_t> ecWeekend, util::matrix_t<double> ecRatesMatrix);
 
+	/// Constructor for a rate with both energy and demand charges
+	UtilityRate(util::matrix_t<size_t> ecWeekday, util::matrix_t<size_t> ecWeekend, util::matrix_t<double> ecRatesMatrix,
+		util::matrix_t<size_t> dcWeekday, util::matrix_t<size_t> dcWeekend, util::matrix_t<double> dcRatesMatrix, util::matrix_t<double> dcFlatMatrix);
+
 	virtual ~UtilityRate() {/* nothing to do */ };
 
 protected:
@@ -26,6 +30,21 @@ protected:
 
 	/// Energy Tiers per period
 	std::map<size_t, size_t> m_energyTiersPerPeriod;
+
+	/// Demand charge schedule for weekdays
+	util::matrix_t<size_t> m_dcWeekday;
+
+	/// Demand charge schedule for weekends
+	util::matrix_t<size_t> m_dcWeekend;
+
+	/// Demand charge periods, tiers, peak demand (kW), charge ($/kW)
+	util::matrix_t<double> m_dcRatesMatrix;
+
+	/// Flat demand charge months (0-11), tiers, peak demand (kW), charge ($/kW)
+	util::matrix_t<double> m_dcFlatMatrix;
+
+	/// Whether the demand charge schedules and tables are defined
+	bool m_demandCharges;
 };
 
 class UtilityRateCalculator : protected UtilityRate
@@ -52,6 +71,21 @@ public:
 	/// Get the period for a given hour of year
 	size_t getEnergyPeriod(size_t hourOfYear);
 
+	/// Get the energy sell rate at the given hour of year, zero if the table has no sell rates
+	double getEnergySellRate(size_t hourOfYear);
+
+	/// Get the demand charge period (1-based) for a given hour of year, zero if there are no demand charges by period
+	size_t getDemandPeriod(size_t hourOfYear);
+
+	/// Get the largest demand charge period in the rate table
+	size_t getNumberOfDemandPeriods();
+
+	/// Get the tier peak demands (kW) and charges ($/kW) for the demand charge period, in tier order
+	void getDemandTiers(size_t period, std::vector<double> & peaks, std::vector<double> & charges);
+
+	/// Get the flat tier peak demands (kW) and charges ($/kW) for the month (0-11), in tier order
+	void getFlatDemandTiers(size_t month, std::vector<double> & peaks, std::vector<double> & charges);
+
 	virtual ~UtilityRateCalculator() {/* nothing to do*/ };
 
 protected:
@@ -58,6 +58,7 @@
 #include "6par_newton.h"
 #include "6par_gamma.h"
 #include "6par_solve.h"
+#include "lib_6par_batch.h"
 
 
 
@@ -135,3 +136,112 @@ public:
 };
 
 DEFINE_MODULE_ENTRY( 6parsolve, "Solver for CEC/6 parameter PV module coefficients", 1 )
+
+static var_info _cm_vtab_6parsolve_batch[] = {
+/*   VARTYPE           DATATYPE         NAME                           LABEL                                UNITS     META                      GROUP                      REQUIRED_IF                 CONSTRAINTS                      UI_HINTS*/
+	{ SSC_INPUT,         SSC_ARRAY,       "celltype",               "Cell technology type",           "",        "0=monoSi,1=multiSi,2=cdte,3=cis,4=cigs,5=amorphous", "6 Parameter Solver", "*", "",            "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "Vmp",                    "Maximum power point voltage",    "V",       "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "Imp",                    "Maximum power point current",    "A",       "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "Voc",                    "Open circuit voltage",           "V",       "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "Isc",                    "Short circuit current",          "A",       "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "alpha_isc",              "Temp coeff of current at SC",    "A/'C",    "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "beta_voc",               "Temp coeff of voltage at OC",    "V/'C",    "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "gamma_pmp",              "Temp coeff of power at MP",      "%/'C",    "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "Nser",                   "Number of cells in series",      "",        "",                      "6 Parameter Solver",      "*",                       "LENGTH_EQUAL=celltype", "" },
+	{ SSC_INPUT,         SSC_ARRAY,       "Tref",                   "Reference cell temperature",     "'C",      "",                      "6 Parameter Solver",      "?",                       "",      "" },
+	{ SSC_INPUT,         SSC_NUMBER,      "nthreads",               "Number of solver threads",       "",        "0=all available",       "6 Parameter Solver",      "?=0",                     "INTEGER,MIN=0",         "" },
+	{ SSC_INPUT,         SSC_NUMBER,      "warm_start",             "Start from similar solved modules", "0/1",  "",                      "6 Parameter Solver",      "?=1",                     "BOOLEAN",               "" },
+
+// outputs
+	{ SSC_OUTPUT,        SSC_ARRAY,       "a",                      "Modified nonideality factor",    "1/V",    "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "Il",                     "Light current",                  "A",      "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "Io",                     "Saturation current",             "A",      "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "Rs",                     "Series resistance",              "ohm",    "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "Rsh",                    "Shunt resistance",               "ohm",    "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "Adj",                    "OC SC temp coeff adjustment",    "%",      "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "err",                    "Solver status",                  "",       "0=solved, <0 failed sanity check or did not converge", "6 Parameter Solver", "*", "",                 "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "iterations",             "Newton iterations",              "",       "",                      "6 Parameter Solver",      "*",                        "",                      "" },
+	{ SSC_OUTPUT,        SSC_ARRAY,       "warm_source",            "Module used as starting point",  "",       "0-based index, -1=heuristic guess", "6 Parameter Solver", "*",          "",                      "" },
+
+var_info_invalid };
+
+class cm_6parsolve_batch : public compute_module
+{
+public:
+
+	cm_6parsolve_batch()
+	{
+		add_var_info( _cm_vtab_6parsolve_batch );
+	}
+
+	void exec( ) throw( general_error )
+	{
+		size_t n = 0;
+		ssc_number_t *celltype = as_array("celltype", &n);
+		ssc_number_t *Vmp = as_array("Vmp", 0);
+		ssc_number_t *Imp = as_array("Imp", 0);
+		ssc_number_t *Voc = as_array("Voc", 0);
+		ssc_number_t *Isc = as_array("Isc", 0);
+		ssc_number_t *bVoc = as_array("beta_voc", 0);
+		ssc_number_t *aIsc = as_array("alpha_isc", 0);
+		ssc_number_t *gPmp = as_array("gamma_pmp", 0);
+		ssc_number_t *nser = as_array("Nser", 0);
+
+		std::vector<double> Tref(n, 25.0);
+		if (is_assigned("Tref"))
+		{
+			size_t nt = 0;
+			ssc_number_t *t = as_array("Tref", &nt);
+			if (nt != 1 && nt != n)
+				throw exec_error("6parsolve_batch", "Tref must have one value or one value per module");
+			for (size_t i = 0; i < n; i++)
+				Tref[i] = t[nt == 1 ? 0 : i];
+		}
+
+		std::vector<module6par> modules(n);
+		for (size_t i = 0; i < n; i++)
+		{
+			int tech_id = (int)celltype[i];
+			if (tech_id < module6par::monoSi || tech_id > module6par::Amorphous)
+				throw exec_error("6parsolve_batch", util::format("invalid cell type %d for module %d", tech_id, (int)i));
+			modules[i] = module6par(tech_id, Vmp[i], Imp[i], Voc[i], Isc[i], bVoc[i], aIsc[i], gPmp[i], (int)nser[i], Tref[i] + 273.15);
+		}
+
+		std::vector<module6par_batch::status> status;
+		module6par_batch batch(300, 1e-7);
+		batch.solve(modules, status, (size_t)as_integer("nthreads"), as_boolean("warm_start"));
+
+		ssc_number_t *a = allocate("a", n);
+		ssc_number_t *Il = allocate("Il", n);
+		ssc_number_t *Io = allocate("Io", n);
+		ssc_number_t *Rs = allocate("Rs", n);
+		ssc_number_t *Rsh = allocate("Rsh", n);
+		ssc_number_t *Adj = allocate("Adj", n);
+		ssc_number_t *err = allocate("err", n);
+		ssc_number_t *iterations = allocate("iterations", n);
+		ssc_number_t *warm_source = allocate("warm_source", n);
+
+		const ssc_number_t nan = std::numeric_limits<ssc_number_t>::quiet_NaN();
+		int nfailed = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const module6par &m = modules[i];
+			bool ok = status[i].err == 0;
+			a[i] = ok ? (ssc_number_t)m.a : nan;
+			Il[i] = ok ? (ssc_number_t)m.Il : nan;
+			Io[i] = ok ? (ssc_number_t)m.Io : nan;
+			Rs[i] = ok ? (ssc_number_t)m.Rs : nan;
+			Rsh[i] = ok ? (ssc_number_t)m.Rsh : nan;
+			Adj[i] = ok ? (ssc_number_t)m.Adj : nan;
+			err[i] = (ssc_number_t)status[i].err;
+			iterations[i] = (ssc_number_t)status[i].iterations;
+			warm_source[i] = (ssc_number_t)status[i].warm_source;
+			if (!ok) nfailed++;
+		}
+
+		if (nfailed > 0)
+			log(util::format("%d of %d modules could not be solved, check inputs", nfailed, (int)n), SSC_WARNING);
+	}
+};
+
+DEFINE_MODULE_ENTRY( 6parsolve_batch, "Batch solver for CEC/6 parameter PV module coefficients", 1 )
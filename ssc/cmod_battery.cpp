@@ -48,6 +48,9 @@
 *******************************************************************************************************/
 
 #include <math.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 
 #include "common.h"
 #include "core.h"
@@ -159,7 +162,7 @@ var_info vtab_battery_inputs[] = {
 	{ SSC_INPUT,        SSC_ARRAY,      "batt_target_power_monthly",                   "Grid target power on monthly basis",                     "kW",       "",                     "Battery",       "?=0",                        "",                             "" },
 	{ SSC_INPUT,        SSC_NUMBER,     "batt_target_choice",                          "Target power input option",                              "0/1",      "",                     "Battery",       "?=0",                        "",                             "" },
 	{ SSC_INPUT,        SSC_ARRAY,      "batt_custom_dispatch",                        "Custom battery power for every time step",               "kW",       "",                     "Battery",       "?=0",                        "",                             "" },
-	{ SSC_INPUT,        SSC_NUMBER,     "batt_dispatch_choice",                        "Battery dispatch algorithm",                             "0/1/2/3/4", "",                    "Battery",       "?=0",                        "",                             "" },
+	{ SSC_INPUT,        SSC_NUMBER,     "batt_dispatch_choice",                        "Battery dispatch algorithm",                             "0/1/2/3/4/5", "",                    "Battery",       "?=0",                        "",                             "" },
 	{ SSC_INPUT,        SSC_NUMBER,     "batt_pv_choice",                              "Prioritize PV usage for load or battery",                "0/1",      "",                     "Battery",       "?=0",                        "",                             "" },
 	{ SSC_INPUT,        SSC_ARRAY,      "batt_pv_clipping_forecast",                   "PV clipping forecast",                                   "kW",       "",                     "Battery",       "en_batt=1&batt_meter_position=1&batt_dispatch_choice=2",  "",          "" },
 	{ SSC_INPUT,        SSC_ARRAY,      "batt_pv_dc_forecast",                         "PV dc power forecast",                                   "kW",       "",                     "Battery",       "en_batt=1&batt_meter_position=1&batt_dispatch_choice=2",  "",          "" },
@@ -169,6 +172,7 @@ var_info vtab_battery_inputs[] = {
 	{ SSC_INPUT,        SSC_NUMBER,     "batt_auto_gridcharge_max_daily",              "Allowed grid charging percent per day for automated dispatch","kW",  "",                     "Battery",       "",                           "",                             "" },
 	{ SSC_INPUT,        SSC_NUMBER,     "batt_look_ahead_hours",                       "Hours to look ahead in automated dispatch",              "hours",    "",                     "Battery",       "",                           "",                             "" },
 	{ SSC_INPUT,        SSC_NUMBER,     "batt_dispatch_update_frequency_hours",        "Frequency to update the look-ahead dispatch",            "hours",    "",                     "Battery",       "",                           "",                             "" },
+	{ SSC_INPUT,        SSC_NUMBER,     "batt_dispatch_opt_time_limit",                "Solve time limit per day for optimized dispatch",        "s",        "Rounded up to whole seconds, at least 1",                     "Battery",       "?=1",                        "",                             "" },
 
 	//  cycle cost inputs
 	{ SSC_INPUT,        SSC_NUMBER,     "batt_cycle_cost_choice",                      "Use SAM model for cycle costs or input custom",           "0/1",     "",                     "Battery",       "",                           "",                             "" },
@@ -179,6 +183,11 @@ var_info vtab_battery_inputs[] = {
 	{ SSC_INPUT,        SSC_MATRIX,     "ur_ec_sched_weekday",                         "Energy charge weekday schedule",                          "",        "12 x 24 matrix",         "",              "en_batt=1&batt_meter_position=1&batt_dispatch_choice=2",  "",          "" },
 	{ SSC_INPUT,        SSC_MATRIX,     "ur_ec_sched_weekend",                         "Energy charge weekend schedule",                          "",        "12 x 24 matrix",         "",              "en_batt=1&batt_meter_position=1&batt_dispatch_choice=2",  "",          "" },
 	{ SSC_INPUT,        SSC_MATRIX,     "ur_ec_tou_mat",                               "Energy rates table",                                      "",        "",                       "",              "en_batt=1&batt_meter_position=1&batt_dispatch_choice=2",  "",          "" },
+	{ SSC_INPUT,        SSC_NUMBER,     "ur_dc_enable",                                "Enable demand charge",                                    "0/1",     "",                       "",              "?=0",                      "BOOLEAN",                      "" },
+	{ SSC_INPUT,        SSC_MATRIX,     "ur_dc_sched_weekday",                         "Demand charge weekday schedule",                          "",        "12 x 24 matrix",         "",              "",                         "",                             "" },
+	{ SSC_INPUT,        SSC_MATRIX,     "ur_dc_sched_weekend",                         "Demand charge weekend schedule",                          "",        "12 x 24 matrix",         "",              "",                         "",                             "" },
+	{ SSC_INPUT,        SSC_MATRIX,     "ur_dc_tou_mat",                               "Demand rates (TOU) table",                                "",        "",                       "",              "",                         "",                             "" },
+	{ SSC_INPUT,        SSC_MATRIX,     "ur_dc_flat_mat",                              "Demand rates (flat) table",                               "",        "",                       "",              "",                         "",                             "" },
 
 	// PPA financial inputs
 	{ SSC_INPUT,        SSC_NUMBER,     "ppa_price_input",		                        "PPA Price Input",	                                        "",      "",                  "Time of Delivery", "en_batt=1&batt_meter_position=1&batt_dispatch_choice=2"   "",          "" },
@@ -258,16 +267,10 @@ var_info vtab_battery_outputs[] = {
 
 var_info_invalid };
 
-battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_hr, batt_variables *batt_vars_in)
+battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_hr, batt_variables *batt_vars_in) : battery_core(dt_hr)
 {
 	make_vars = false;
 
-	// time quantities
-	nyears = 1;
-	_dt_hour = dt_hr;
-	step_per_hour = static_cast<size_t>(1. / _dt_hour);
-	initialize_time(0, 0, 0);
-
 	// battery variables
 	if (batt_vars_in == 0)
 	{
@@ -441,6 +444,28 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 				{
 					batt_vars->batt_custom_dispatch = cm.as_vector_double("batt_custom_dispatch");
 				}
+				else if (batt_vars->batt_dispatch == dispatch_t::OPTIMIZED_LOOK_AHEAD)
+				{
+					if (!cm.as_boolean("en_electricity_rates"))
+						throw compute_module::exec_error("battery", "optimized look ahead dispatch requires electricity rates to be enabled");
+
+					batt_vars->ec_weekday_schedule = cm.as_matrix_unsigned_long("ur_ec_sched_weekday");
+					batt_vars->ec_weekend_schedule = cm.as_matrix_unsigned_long("ur_ec_sched_weekend");
+					batt_vars->ec_tou_matrix = cm.as_matrix("ur_ec_tou_mat");
+					batt_vars->ec_rate_defined = true;
+
+					batt_vars->dc_rate_defined = cm.as_boolean("ur_dc_enable");
+					if (batt_vars->dc_rate_defined)
+					{
+						batt_vars->dc_weekday_schedule = cm.as_matrix_unsigned_long("ur_dc_sched_weekday");
+						batt_vars->dc_weekend_schedule = cm.as_matrix_unsigned_long("ur_dc_sched_weekend");
+						batt_vars->dc_tou_matrix = cm.as_matrix("ur_dc_tou_mat");
+						batt_vars->dc_flat_matrix = cm.as_matrix("ur_dc_flat_mat");
+						if (batt_vars->dc_tou_matrix.ncols() != 4 || batt_vars->dc_flat_matrix.ncols() != 4)
+							throw compute_module::exec_error("battery", "demand rate tables must have 4 columns: period or month, tier, peak demand, charge");
+					}
+					batt_vars->batt_dispatch_opt_time_limit = cm.as_double("batt_dispatch_opt_time_limit");
+				}
 
 				batt_vars->batt_dispatch_auto_can_gridcharge = cm.as_boolean("batt_dispatch_auto_can_gridcharge");
 				batt_vars->batt_dispatch_auto_can_charge = cm.as_boolean("batt_dispatch_auto_can_charge");
@@ -539,19 +564,6 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 	else
 		batt_vars = batt_vars_in;
 
-	// component models
-	voltage_model = 0;
-	lifetime_model = 0;
-	lifetime_cycle_model = 0;
-	lifetime_calendar_model = 0;
-	thermal_model = 0;
-	battery_model = 0;
-	capacity_model = 0;
-	dispatch_model = 0;
-	losses_model = 0;
-	charge_control = 0;
-	battery_metrics = 0;
-
 	// outputs
 	outTotalCharge = 0;
 	outAvailableCharge = 0;
@@ -598,23 +610,8 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 		if (batt_vars->batt_replacement_option > 0)
 			cm.log("Replacements are enabled without running lifetime simulation, please run over lifetime to consider battery replacements", SSC_WARNING);
 	}
-	total_steps = nyears * 8760 * step_per_hour;
 	chem = batt_vars->batt_chem;
 
-	util::matrix_t<double>  batt_voltage_matrix = batt_vars->batt_voltage_matrix;
-	if (batt_vars->batt_voltage_choice == voltage_t::VOLTAGE_TABLE)
-	{
-		if (batt_voltage_matrix.nrows() < 2 || batt_voltage_matrix.ncols() != 2)
-			throw compute_module::exec_error("battery", "Battery lifetime matrix must have 2 columns and at least 2 rows");
-	}
-	util::matrix_t<double>  batt_lifetime_matrix = batt_vars->batt_lifetime_matrix;
-	if (batt_lifetime_matrix.nrows() < 3 || batt_lifetime_matrix.ncols() != 3)
-		throw compute_module::exec_error("battery", "Battery lifetime matrix must have three columns and at least three rows");
-
-	util::matrix_t<double>  batt_calendar_lifetime_matrix = batt_vars->batt_calendar_lifetime_matrix;
-	if (batt_vars->batt_calendar_choice == lifetime_calendar_t::CALENDAR_LOSS_TABLE && (batt_calendar_lifetime_matrix.nrows() < 2 || batt_calendar_lifetime_matrix.ncols() != 2))
-		throw compute_module::exec_error("battery", "Battery calendar lifetime matrix must have 2 columns and at least 2 rows");
-
 	/* **********************************************************************
 	Initialize outputs
 	********************************************************************** */
@@ -691,6 +688,77 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 	outAnnualGridExportEnergy[0] = 0;
 	outAnnualEnergyLoss[0] = 0;
 
+	initialize(batt_vars, nyears);
+}
+
+battery_core::battery_core(double dt_hr)
+{
+	// time quantities
+	nyears = 1;
+	total_steps = 0;
+	_dt_hour = dt_hr;
+	step_per_hour = static_cast<size_t>(1. / _dt_hour);
+	initialize_time(0, 0, 0);
+
+	batt_vars = 0;
+	prediction_index = 0;
+
+	// component models
+	voltage_model = 0;
+	lifetime_model = 0;
+	lifetime_cycle_model = 0;
+	lifetime_calendar_model = 0;
+	thermal_model = 0;
+	battery_model = 0;
+	capacity_model = 0;
+	dispatch_model = 0;
+	losses_model = 0;
+	charge_control = 0;
+	battery_metrics = 0;
+	utilityRate = 0;
+}
+
+battery_core::battery_core(batt_variables *batt_vars_in, size_t nyears_in, double dt_hr) : battery_core(dt_hr)
+{
+	initialize(batt_vars_in, nyears_in);
+}
+
+battery_core::~battery_core()
+{
+	if( voltage_model ) delete voltage_model;
+	if( lifetime_cycle_model ) delete lifetime_cycle_model;
+	if (lifetime_calendar_model) delete lifetime_calendar_model;
+	if( thermal_model ) delete thermal_model;
+	if( battery_model ) delete battery_model;
+	if (battery_metrics) delete battery_metrics;
+	if( capacity_model ) delete capacity_model;
+	if (losses_model) delete losses_model;
+	if( dispatch_model ) delete dispatch_model;
+	if (charge_control) delete charge_control;
+	if (utilityRate) delete utilityRate;
+}
+
+void battery_core::initialize(batt_variables *batt_vars_in, size_t nyears_in)
+{
+	batt_vars = batt_vars_in;
+	nyears = nyears_in;
+	total_steps = nyears * 8760 * step_per_hour;
+	int chem = batt_vars->batt_chem;
+
+	util::matrix_t<double>  batt_voltage_matrix = batt_vars->batt_voltage_matrix;
+	if (batt_vars->batt_voltage_choice == voltage_t::VOLTAGE_TABLE)
+	{
+		if (batt_voltage_matrix.nrows() < 2 || batt_voltage_matrix.ncols() != 2)
+			throw compute_module::exec_error("battery", "Battery lifetime matrix must have 2 columns and at least 2 rows");
+	}
+	util::matrix_t<double>  batt_lifetime_matrix = batt_vars->batt_lifetime_matrix;
+	if (batt_lifetime_matrix.nrows() < 3 || batt_lifetime_matrix.ncols() != 3)
+		throw compute_module::exec_error("battery", "Battery lifetime matrix must have three columns and at least three rows");
+
+	util::matrix_t<double>  batt_calendar_lifetime_matrix = batt_vars->batt_calendar_lifetime_matrix;
+	if (batt_vars->batt_calendar_choice == lifetime_calendar_t::CALENDAR_LOSS_TABLE && (batt_calendar_lifetime_matrix.nrows() < 2 || batt_calendar_lifetime_matrix.ncols() != 2))
+		throw compute_module::exec_error("battery", "Battery calendar lifetime matrix must have 2 columns and at least 2 rows");
+
 	// model initialization
 	if ((chem == battery_t::LEAD_ACID || chem == battery_t::LITHIUM_ION) &&  batt_vars->batt_voltage_choice == voltage_t::VOLTAGE_MODEL)
 		voltage_model = new voltage_dynamic_t(batt_vars->batt_computed_series, batt_vars->batt_computed_strings, batt_vars->batt_Vnom_default, batt_vars->batt_Vfull, batt_vars->batt_Vexp,
@@ -721,7 +789,7 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 
 
 	battery_model = new battery_t(
-		dt_hr,
+		_dt_hour,
 		chem);
 
 	if (chem == battery_t::LEAD_ACID)
@@ -800,7 +868,7 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 		batt_system_losses);
 
 	battery_model->initialize(capacity_model, voltage_model, lifetime_model, thermal_model, losses_model);
-	battery_metrics = new battery_metrics_t(dt_hr);
+	battery_metrics = new battery_metrics_t(_dt_hour);
 
 	/*! Process the dispatch options and create the appropriate model */
 	if ((batt_vars->batt_meter_position == dispatch_t::BEHIND && batt_vars->batt_dispatch == dispatch_t::MANUAL) ||
@@ -830,7 +898,7 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 		if ((batt_vars->batt_meter_position == dispatch_t::BEHIND && batt_vars->batt_dispatch == dispatch_t::MANUAL) || 
 			(batt_vars->batt_meter_position == dispatch_t::FRONT && batt_vars->batt_dispatch == dispatch_t::FOM_MANUAL))
 		{
-			dispatch_model = new dispatch_manual_t(battery_model, dt_hr, batt_vars->batt_minimum_SOC, batt_vars->batt_maximum_SOC,
+			dispatch_model = new dispatch_manual_t(battery_model, _dt_hour, batt_vars->batt_minimum_SOC, batt_vars->batt_maximum_SOC,
 				batt_vars->batt_current_choice,
 				batt_vars->batt_current_charge_max, batt_vars->batt_current_discharge_max,
 				batt_vars->batt_power_charge_max, batt_vars->batt_power_discharge_max,
@@ -850,7 +918,7 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 		if (batt_vars->ec_rate_defined) {
 			utilityRate = new UtilityRate(batt_vars->ec_weekday_schedule, batt_vars->ec_weekend_schedule, batt_vars->ec_tou_matrix);
 		}
-		dispatch_model = new dispatch_automatic_front_of_meter_t(battery_model, dt_hr, batt_vars->batt_minimum_SOC, batt_vars->batt_maximum_SOC,
+		dispatch_model = new dispatch_automatic_front_of_meter_t(battery_model, _dt_hour, batt_vars->batt_minimum_SOC, batt_vars->batt_maximum_SOC,
 			batt_vars->batt_current_choice, batt_vars->batt_current_charge_max, batt_vars->batt_current_discharge_max,
 			batt_vars->batt_power_charge_max, batt_vars->batt_power_discharge_max, batt_vars->batt_minimum_modetime,
 			batt_vars->batt_dispatch, batt_vars->batt_meter_position,
@@ -876,7 +944,7 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 	/*! Behind-the-meter automated dispatch for peak shaving */
 	else
 	{			
-		dispatch_model = new dispatch_automatic_behind_the_meter_t(battery_model, dt_hr, batt_vars->batt_minimum_SOC, batt_vars->batt_maximum_SOC,
+		dispatch_model = new dispatch_automatic_behind_the_meter_t(battery_model, _dt_hour, batt_vars->batt_minimum_SOC, batt_vars->batt_maximum_SOC,
 			batt_vars->batt_current_choice, batt_vars->batt_current_charge_max, batt_vars->batt_current_discharge_max,
 			batt_vars->batt_power_charge_max, batt_vars->batt_power_discharge_max, batt_vars->batt_minimum_modetime,
 			batt_vars->batt_dispatch, batt_vars->batt_meter_position, nyears,
@@ -893,6 +961,20 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 				dispatch_btm->set_custom_dispatch(batt_vars->batt_custom_dispatch);
 			}
 		}
+		else if (batt_vars->batt_dispatch == dispatch_t::OPTIMIZED_LOOK_AHEAD)
+		{
+			if (dispatch_automatic_behind_the_meter_t * dispatch_btm = dynamic_cast<dispatch_automatic_behind_the_meter_t*>(dispatch_model))
+			{
+				if (batt_vars->dc_rate_defined) {
+					utilityRate = new UtilityRate(batt_vars->ec_weekday_schedule, batt_vars->ec_weekend_schedule, batt_vars->ec_tou_matrix,
+						batt_vars->dc_weekday_schedule, batt_vars->dc_weekend_schedule, batt_vars->dc_tou_matrix, batt_vars->dc_flat_matrix);
+				}
+				else {
+					utilityRate = new UtilityRate(batt_vars->ec_weekday_schedule, batt_vars->ec_weekend_schedule, batt_vars->ec_tou_matrix);
+				}
+				dispatch_btm->setup_rate_optimization(utilityRate, batt_vars->batt_dispatch_opt_time_limit);
+			}
+		}
 	}
 
 	if (batt_vars->batt_topology == ChargeController::AC_CONNECTED) {
@@ -905,7 +987,7 @@ battstor::battstor(compute_module &cm, bool setup_model, size_t nrec, double dt_
 	parse_configuration();
 }
 
-void battstor::parse_configuration()
+void battery_core::parse_configuration()
 {
 	int batt_dispatch = batt_vars->batt_dispatch;
 	int batt_meter_position = batt_vars->batt_meter_position;
@@ -916,11 +998,16 @@ void battstor::parse_configuration()
 		prediction_index = 0;
 		if (batt_meter_position == dispatch_t::BEHIND)
 		{
-			if (batt_dispatch == dispatch_t::LOOK_AHEAD || batt_dispatch == dispatch_t::MAINTAIN_TARGET)
+			if (batt_dispatch == dispatch_t::LOOK_AHEAD || batt_dispatch == dispatch_t::MAINTAIN_TARGET || batt_dispatch == dispatch_t::OPTIMIZED_LOOK_AHEAD)
 			{
 				look_ahead = true;
 				if (batt_dispatch == dispatch_t::MAINTAIN_TARGET)
+				{
 					input_target = true;
+					// a core built from batt_variables alone takes the targets battstor read and extended over the analysis period
+					if (target_power.empty())
+						target_power = batt_vars->target_power;
+				}
 			}
 			else if (batt_dispatch == dispatch_t::CUSTOM_DISPATCH)
 			{
@@ -949,7 +1036,7 @@ void battstor::parse_configuration()
 		manual_dispatch = true;
 }
 
-void battstor::initialize_automated_dispatch(std::vector<ssc_number_t> pv, std::vector<ssc_number_t> load, std::vector<ssc_number_t> cliploss)
+void battery_core::initialize_automated_dispatch(std::vector<ssc_number_t> pv, std::vector<ssc_number_t> load, std::vector<ssc_number_t> cliploss)
 {
 	if (dynamic_cast<dispatch_automatic_t*>(dispatch_model))
 	{
@@ -1064,20 +1151,10 @@ void battstor::initialize_automated_dispatch(std::vector<ssc_number_t> pv, std::
 }
 battstor::~battstor()
 {
-	if( voltage_model ) delete voltage_model;
-	if( lifetime_cycle_model ) delete lifetime_cycle_model;
-	if (lifetime_calendar_model) delete lifetime_calendar_model;
-	if( thermal_model ) delete thermal_model;
-	if( battery_model ) delete battery_model;
-	if (battery_metrics) delete battery_metrics;
-	if( capacity_model ) delete capacity_model;
-	if (losses_model) delete losses_model;
-	if( dispatch_model ) delete dispatch_model;
-	if (charge_control) delete charge_control;
 	if (make_vars) delete batt_vars;
 }
 
-void battstor::check_replacement_schedule()
+void battery_core::check_replacement_schedule()
 {
 	if (batt_vars->batt_replacement_option == battery_t::REPLACE_BY_SCHEDULE)
 	{
@@ -1102,13 +1179,13 @@ void battstor::check_replacement_schedule()
 			force_replacement();
 	}
 }
-void battstor::force_replacement()
+void battery_core::force_replacement()
 {
 	lifetime_model->force_replacement();
 	battery_model->runLifetimeModel(0);
 }
 
-void battstor::initialize_time(size_t year_in, size_t hour_of_year, size_t step_of_hour)
+void battery_core::initialize_time(size_t year_in, size_t hour_of_year, size_t step_of_hour)
 {
 	step = step_of_hour;
 	hour = hour_of_year;
@@ -1117,6 +1194,84 @@ void battstor::initialize_time(size_t year_in, size_t hour_of_year, size_t step_
 	year_index = (hour * step_per_hour) + step; 
 	step_per_year = 8760 * step_per_hour;
 }
+
+void battery_core::run(const double *P_pv, const double *P_load, size_t nrec, battery_core_results &results)
+{
+	if (has_run)
+		throw std::logic_error("battery_core::run: the battery is not in its initial state, construct a new core for another simulation");
+
+	// a single year of PV and load repeats for every year of a lifetime simulation
+	size_t nrec_year = 8760 * step_per_hour;
+	if (nrec != nrec_year && nrec != total_steps)
+		throw std::invalid_argument(util::format("invalid number of data records (%u): must be one year or the full analysis period", (unsigned int)nrec));
+	has_run = true;
+
+	if (!manual_dispatch && pv_prediction.empty() && load_prediction.empty())
+	{
+		std::vector<ssc_number_t> pv(total_steps), load(total_steps);
+		for (size_t idx = 0; idx != total_steps; idx++)
+		{
+			pv[idx] = static_cast<ssc_number_t>(P_pv[idx % nrec]);
+			load[idx] = static_cast<ssc_number_t>(P_load[idx % nrec]);
+		}
+		initialize_automated_dispatch(pv, load);
+	}
+
+	results.P_battery.assign(total_steps, 0.);
+	results.P_grid.assign(total_steps, 0.);
+	results.P_gen.assign(total_steps, 0.);
+	results.P_pv_to_batt.assign(total_steps, 0.);
+	results.P_grid_to_batt.assign(total_steps, 0.);
+	results.P_pv_to_grid.assign(total_steps, 0.);
+	results.P_pv_to_load.assign(total_steps, 0.);
+	results.P_batt_to_load.assign(total_steps, 0.);
+	results.P_grid_to_load.assign(total_steps, 0.);
+	results.P_batt_to_grid.assign(total_steps, 0.);
+	results.SOC.assign(total_steps, 0.);
+	results.E_charge_annual.assign(nyears, 0.);
+	results.E_discharge_annual.assign(nyears, 0.);
+	results.E_grid_import_annual.assign(nyears, 0.);
+	results.E_grid_export_annual.assign(nyears, 0.);
+	results.E_loss_annual.assign(nyears, 0.);
+	results.replacements_annual.assign(nyears, 0.);
+
+	for (size_t y = 0; y != nyears; y++)
+	{
+		for (size_t h = 0; h != 8760; h++)
+		{
+			for (size_t s = 0; s != step_per_hour; s++)
+			{
+				initialize_time(y, h, s);
+				check_replacement_schedule();
+
+				size_t idx = index % nrec;
+				charge_control->run(year, hour, step, year_index, P_pv[idx], 0, P_load[idx], 0);
+
+				results.P_battery[index] = dispatch_model->power_tofrom_battery();
+				results.P_grid[index] = dispatch_model->power_tofrom_grid();
+				results.P_gen[index] = dispatch_model->power_gen();
+				results.P_pv_to_batt[index] = dispatch_model->power_pv_to_batt();
+				results.P_grid_to_batt[index] = dispatch_model->power_grid_to_batt();
+				results.P_pv_to_grid[index] = dispatch_model->power_pv_to_grid();
+				results.P_pv_to_load[index] = dispatch_model->power_pv_to_load();
+				results.P_batt_to_load[index] = dispatch_model->power_battery_to_load();
+				results.P_grid_to_load[index] = dispatch_model->power_grid_to_load();
+				results.P_batt_to_grid[index] = dispatch_model->power_battery_to_grid();
+				results.SOC[index] = capacity_model->SOC();
+			}
+		}
+
+		results.replacements_annual[y] = lifetime_model->replacements();
+		results.E_charge_annual[y] = battery_metrics->energy_charge_annual();
+		results.E_discharge_annual[y] = battery_metrics->energy_discharge_annual();
+		results.E_grid_import_annual[y] = battery_metrics->energy_grid_import_annual();
+		results.E_grid_export_annual[y] = battery_metrics->energy_grid_export_annual();
+		results.E_loss_annual[y] = battery_metrics->energy_loss_annual();
+		lifetime_model->reset_replacements();
+		battery_metrics->new_year();
+	}
+	results.average_roundtrip_efficiency = std::fmax(0, std::fmin(100, battery_metrics->average_battery_roundtrip_efficiency()));
+}
 void battstor::advance(compute_module &cm, double P_pv, double V_pv, double P_load, double P_pv_clipped )
 {
 	charge_control->run(year, hour, step, year_index, P_pv, V_pv, P_load, P_pv_clipped);
@@ -1388,3 +1543,222 @@ public:
 };
 
 DEFINE_MODULE_ENTRY(battery, "Battery storage standalone model .", 10)
+
+///////////////////////////////////////////////////
+static var_info _cm_vtab_battery_sizing[] = {
+	/*   VARTYPE           DATATYPE         NAME                                            LABEL                                                   UNITS      META                           GROUP                  REQUIRED_IF                 CONSTRAINTS                      UI_HINTS*/
+	{ SSC_INPUT,        SSC_NUMBER,      "en_batt",                                    "Enable battery storage model",                            "0/1",        "",                     "Battery",                      "?=1",                    "BOOLEAN",                        "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "gen",										   "System power generated",                                  "kW",         "",                     "",                             "*",                      "",                               "" },
+	{ SSC_INPUT,		SSC_ARRAY,	     "load",			                           "Electricity load (year 1)",                               "kW",	        "",				        "",                             "?",	                  "",	                            "" },
+	{ SSC_INPUT,        SSC_MATRIX,      "batt_sizing_candidates",                     "Battery bank sizes and dispatch options to evaluate",     "kWh,kW,",    "[KWH,KW,DISPATCH]",    "Battery Sizing",               "*",                      "",                               "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "nthreads",                                   "Number of threads",                                       "",           "0=all available",      "Battery Sizing",               "?=0",                    "INTEGER,MIN=0",                  "" },
+
+	{ SSC_OUTPUT,       SSC_MATRIX,      "batt_sizing_results",                        "Battery sizing results by candidate",                     "",           "[KWH,KW,DISPATCH,DISCHARGE,CAPACITY,CYCLES,REPLACEMENTS,SAVINGS,EFFICIENCY]", "Battery Sizing", "*", "",              "" },
+
+	var_info_invalid };
+
+/**
+* Resize a copy of the base bank to the candidate energy and power.  The cells stay in the same series and string
+* configuration and their capacity scales, so the bank voltage and the voltage curve shape are unchanged
+*/
+static void resize_battery_bank(batt_variables &vars, double kwh, double kw)
+{
+	double energy_scale = kwh / vars.batt_kwh;
+	double power_scale = kw / vars.batt_kw;
+
+	vars.batt_Qfull *= energy_scale;
+	vars.batt_Qexp *= energy_scale;
+	vars.batt_Qnom *= energy_scale;
+	vars.batt_Qfull_flow *= energy_scale;
+	vars.batt_resistance /= energy_scale;
+	vars.LeadAcid_q10_computed *= energy_scale;
+	vars.LeadAcid_q20_computed *= energy_scale;
+	vars.LeadAcid_qn_computed *= energy_scale;
+
+	vars.batt_current_charge_max *= power_scale;
+	vars.batt_current_discharge_max *= power_scale;
+	vars.batt_power_charge_max = kw;
+	vars.batt_power_discharge_max = kw;
+	if (vars.inverter_model == SharedInverter::NONE)
+		vars.inverter_paco = kw;
+
+	vars.batt_mass *= energy_scale;
+	double length_scale = std::pow(energy_scale, 1. / 3.);
+	vars.batt_length *= length_scale;
+	vars.batt_width *= length_scale;
+	vars.batt_height *= length_scale;
+
+	vars.batt_kwh = kwh;
+	vars.batt_kw = kw;
+}
+
+/**
+* Whether a candidate dispatch option can run on the inputs battstor read for the base dispatch option.  The look ahead
+* and look behind options need no inputs of their own, behind the meter, and share the look ahead horizon, in front of
+* the meter.  Target power, custom, manual, and optimized dispatch only have their inputs when they are the base option
+*/
+static bool dispatch_inputs_parsed(int meter_position, int base_dispatch, int dispatch)
+{
+	if (dispatch == base_dispatch)
+		return true;
+	if (meter_position == dispatch_t::BEHIND)
+		return (dispatch == dispatch_t::LOOK_AHEAD || dispatch == dispatch_t::LOOK_BEHIND);
+
+	bool base_automated = (base_dispatch == dispatch_t::FOM_LOOK_AHEAD || base_dispatch == dispatch_t::FOM_LOOK_BEHIND || base_dispatch == dispatch_t::FOM_FORECAST);
+	bool automated = (dispatch == dispatch_t::FOM_LOOK_AHEAD || dispatch == dispatch_t::FOM_LOOK_BEHIND || dispatch == dispatch_t::FOM_FORECAST);
+	return base_automated && automated;
+}
+
+class cm_battery_sizing : public compute_module
+{
+public:
+
+	enum { KWH, KW, DISPATCH, DISCHARGE, CAPACITY, CYCLES, REPLACEMENTS, SAVINGS, EFFICIENCY, RESULT_COLS };
+
+	cm_battery_sizing()
+	{
+		add_var_info(_cm_vtab_battery_sizing);
+		add_var_info(vtab_battery_inputs);
+	}
+
+	void exec() throw(general_error)
+	{
+		std::vector<double> P_gen = as_vector_double("gen");
+		size_t nrec = P_gen.size();
+		if (nrec == 0 || nrec % 8760 != 0)
+			throw exec_error("battery_sizing", util::format("invalid number of data records (%u): must be an integer multiple of 8760", (unsigned int)nrec));
+		double dt_hour = 8760. / nrec;
+
+		// the base configuration is parsed once, each candidate resizes a copy of it
+		battstor base(*this, false, nrec, dt_hour);
+		if (base.batt_vars->batt_topology == ChargeController::DC_CONNECTED)
+			throw exec_error("battery_sizing", "battery sizing must be AC connected");
+		if (base.batt_vars->batt_kwh <= 0 || base.batt_vars->batt_kw <= 0)
+			throw exec_error("battery_sizing", "the base battery bank must have a positive capacity and power");
+
+		std::vector<double> P_load(nrec, 0.);
+		if (base.batt_vars->batt_meter_position == dispatch_t::BEHIND)
+		{
+			P_load = as_vector_double("load");
+			if (P_load.size() != nrec)
+				throw exec_error("battery_sizing", "Load and PV power do not match weatherfile length");
+		}
+
+		util::matrix_t<double> candidates = as_matrix("batt_sizing_candidates");
+		if (candidates.ncols() != 3)
+			throw exec_error("battery_sizing", "three columns required for the candidate matrix: KWH,KW,DISPATCH");
+		size_t ncand = candidates.nrows();
+		for (size_t c = 0; c != ncand; c++)
+		{
+			if (candidates(c, KWH) <= 0 || candidates(c, KW) <= 0)
+				throw exec_error("battery_sizing", util::format("candidate %d must have a positive capacity and power", (int)c + 1));
+
+			// the candidates run on copies of the base inputs, so a dispatch option which needs other inputs can not be evaluated
+			double dispatch = candidates(c, DISPATCH);
+			if (dispatch != std::floor(dispatch) || !dispatch_inputs_parsed(base.batt_vars->batt_meter_position, base.batt_vars->batt_dispatch, (int)dispatch))
+				throw exec_error("battery_sizing", util::format("candidate %d: dispatch option %lg can not run on the inputs of base dispatch option %d",
+					(int)c + 1, dispatch, base.batt_vars->batt_dispatch));
+		}
+
+		// energy charges with and without the battery, looked up once for every candidate
+		std::vector<double> price_buy, price_sell;
+		if (is_assigned("en_electricity_rates") && as_boolean("en_electricity_rates"))
+		{
+			UtilityRate rate(as_matrix_unsigned_long("ur_ec_sched_weekday"), as_matrix_unsigned_long("ur_ec_sched_weekend"), as_matrix("ur_ec_tou_mat"));
+			UtilityRateCalculator calculator(&rate, base.step_per_hour);
+			for (size_t h = 0; h != 8760; h++)
+			{
+				price_buy.push_back(calculator.getEnergyRate(h));
+				price_sell.push_back(calculator.getEnergySellRate(h));
+			}
+		}
+
+		// candidates are independent, so they are handed out to whichever thread is free
+		util::matrix_t<double> results(ncand, RESULT_COLS, 0.);
+		std::vector<std::string> errors(ncand);
+		std::atomic<size_t> next(0);
+		auto run = [&]()
+		{
+			battery_core_results out;
+			size_t c;
+			while ((c = next++) < ncand)
+			{
+				try
+				{
+					batt_variables vars = *base.batt_vars;
+					resize_battery_bank(vars, candidates(c, KWH), candidates(c, KW));
+					vars.batt_dispatch = (int)candidates(c, DISPATCH);
+
+					battery_core core(&vars, base.nyears, dt_hour);
+					core.run(&P_gen[0], &P_load[0], nrec, out);
+
+					double savings = 0;
+					if (!price_buy.empty())
+					{
+						for (size_t idx = 0; idx != out.P_grid.size(); idx++)
+						{
+							size_t h = (idx % nrec) / base.step_per_hour;
+							double P_grid_base = P_gen[idx % nrec] - P_load[idx % nrec];
+							double P_grid = out.P_grid[idx];
+							savings += ((std::fmax(-P_grid_base, 0) - std::fmax(-P_grid, 0)) * price_buy[h]
+								- (std::fmax(P_grid_base, 0) - std::fmax(P_grid, 0)) * price_sell[h]) * dt_hour;
+						}
+					}
+
+					double E_discharge = 0, replacements = 0;
+					for (size_t y = 0; y != base.nyears; y++)
+					{
+						E_discharge += out.E_discharge_annual[y];
+						replacements += out.replacements_annual[y];
+					}
+
+					results(c, KWH) = candidates(c, KWH);
+					results(c, KW) = candidates(c, KW);
+					results(c, DISPATCH) = candidates(c, DISPATCH);
+					results(c, DISCHARGE) = E_discharge / base.nyears;
+					results(c, CAPACITY) = core.lifetime_model->capacity_percent();
+					results(c, CYCLES) = core.lifetime_cycle_model->cycles_elapsed();
+					results(c, REPLACEMENTS) = replacements;
+					results(c, SAVINGS) = savings / base.nyears;
+					results(c, EFFICIENCY) = out.average_roundtrip_efficiency;
+				}
+				catch (general_error &e)
+				{
+					errors[c] = e.err_text;
+				}
+				catch (std::exception &e)
+				{
+					errors[c] = e.what();
+				}
+			}
+		};
+
+		size_t nthreads = (size_t)as_integer("nthreads");
+		if (nthreads == 0)
+			nthreads = std::max(1u, std::thread::hardware_concurrency());
+		nthreads = std::min(nthreads, ncand);
+		if (nthreads > 1)
+		{
+			std::vector<std::thread> threads;
+			for (size_t i = 0; i < nthreads; i++)
+				threads.push_back(std::thread(run));
+			for (size_t i = 0; i < threads.size(); i++)
+				threads[i].join();
+		}
+		else
+			run();
+
+		for (size_t c = 0; c != ncand; c++)
+		{
+			if (!errors[c].empty())
+				throw exec_error("battery_sizing", util::format("candidate %d: %s", (int)c + 1, errors[c].c_str()));
+		}
+
+		ssc_number_t *p_results = allocate("batt_sizing_results", ncand, RESULT_COLS);
+		for (size_t c = 0; c != ncand; c++)
+			for (size_t j = 0; j != RESULT_COLS; j++)
+				p_results[c * RESULT_COLS + j] = static_cast<ssc_number_t>(results(c, j));
+	}
+};
+
+DEFINE_MODULE_ENTRY(battery_sizing, "Battery bank sizing over a set of capacities, powers and dispatch options", 1)
@@ -206,6 +206,16 @@ struct batt_variables
 	util::matrix_t<size_t> ec_weekend_schedule;
 	util::matrix_t<double> ec_tou_matrix;
 
+	/*! Demand rates */
+	bool dc_rate_defined;
+	util::matrix_t<size_t> dc_weekday_schedule;
+	util::matrix_t<size_t> dc_weekend_schedule;
+	util::matrix_t<double> dc_tou_matrix;
+	util::matrix_t<double> dc_flat_matrix;
+
+	/*! Solve-time budget per day for the optimized behind-the-meter dispatch, rounded up to whole seconds [s] */
+	double batt_dispatch_opt_time_limit;
+
 	/* Battery replacement options */
 	int batt_replacement_option;
 	std::vector<int> batt_replacement_schedule;
@@ -216,29 +226,62 @@ struct batt_variables
 };
 
 
-struct battstor
+/**
+* Results of a battery_core run.  Powers are one value per step of the analysis period (kW),
+* annual energies are one value per year (kWh)
+*/
+struct battery_core_results
 {
+	std::vector<double> P_battery;		///< Power to (<0) or from (>0) the battery
+	std::vector<double> P_grid;			///< Power to (>0) or from (<0) the grid
+	std::vector<double> P_gen;			///< Power from the PV and battery system
+	std::vector<double> P_pv_to_batt;
+	std::vector<double> P_grid_to_batt;
+	std::vector<double> P_pv_to_grid;
+	std::vector<double> P_pv_to_load;
+	std::vector<double> P_batt_to_load;
+	std::vector<double> P_grid_to_load;
+	std::vector<double> P_batt_to_grid;
+	std::vector<double> SOC;			///< State of charge at the end of the step (%)
+
+	std::vector<double> E_charge_annual;
+	std::vector<double> E_discharge_annual;
+	std::vector<double> E_grid_import_annual;
+	std::vector<double> E_grid_export_annual;
+	std::vector<double> E_loss_annual;
+	std::vector<double> replacements_annual;
+
+	double average_roundtrip_efficiency;	///< (%)
+};
+
+/**
+* The battery bank, its dispatch and power flow built from batt_variables, without a compute_module.
+* battstor derives from it to read inputs and write outputs through the compute_module, run() simulates
+* plain arrays so the battery can be embedded in other loops, such as sizing studies.
+*/
+struct battery_core
+{
+	/// Construct without models, to be built by initialize()
+	battery_core(double dt_hr);
+
+	/// Build the models from batt_vars for a simulation of nyears, batt_vars must outlive the core
+	battery_core(batt_variables *batt_vars, size_t nyears, double dt_hr);
+
+	virtual ~battery_core();
+
+	/// Build the component models, dispatch, and charge controller from batt_vars
+	void initialize(batt_variables *batt_vars, size_t nyears);
 
-	battstor( compute_module &cm, bool setup_model, size_t nrec, double dt_hr, batt_variables *batt_vars=0);
 	void parse_configuration();
 	void initialize_automated_dispatch(std::vector<ssc_number_t> pv= std::vector<ssc_number_t>(), 
 									   std::vector<ssc_number_t> load= std::vector<ssc_number_t>(), 
 									   std::vector<ssc_number_t> cliploss= std::vector<ssc_number_t>());
-	~battstor();
 
 	void initialize_time(size_t year, size_t hour_of_year, size_t step);
 
-	/// Run the battery for the current timestep, given the PV power, load, and clipped power
-	void advance(compute_module &cm, double P_pv, double V_pv=0, double P_load=0, double P_pv_clipped=0);
-
-	/// Given a DC connected battery, set the shared PV and battery invertr
-	void setSharedInverter(SharedInverter * sharedInverter);
-
-	void outputs_fixed(compute_module &cm);
-	void outputs_topology_dependent(compute_module &cm);
-	void metrics(compute_module &cm);
-	void update_grid_power(compute_module &cm, double P_gen_ac, double P_load_ac, size_t index);
-	void process_messages(compute_module &cm);
+	/// Simulate the analysis period from the initial state, given the PV power and load [kW] for one year or for every year.
+	/// The models are left in their final state, so a core runs once, and throws std::logic_error if run again
+	void run(const double *P_pv, const double *P_load, size_t nrec, battery_core_results &results);
 
 	/*! Manual dispatch*/
 	bool manual_dispatch = false;
@@ -261,7 +304,6 @@ struct battstor
 	// for user schedule
 	void force_replacement();
 	void check_replacement_schedule();
-	void calculate_monthly_and_annual_outputs( compute_module &cm );
 
 	// time quantities
 	size_t step_per_hour;
@@ -289,12 +331,8 @@ struct battstor
 	losses_t *losses_model;
 	ChargeController *charge_control;
 	UtilityRate * utilityRate;
-	
-	bool en;
-	int chem;
 
 	batt_variables * batt_vars;
-	bool make_vars;
 	
 	/*! Map of profile to discharge percent */
 	std::map<size_t, double> dm_percent_discharge; 
@@ -314,6 +352,34 @@ struct battstor
 	std::vector<double> cliploss_prediction;
 	int prediction_index;
 
+	/*! Whether run() has simulated the analysis period */
+	bool has_run = false;
+};
+
+struct battstor : public battery_core
+{
+
+	battstor( compute_module &cm, bool setup_model, size_t nrec, double dt_hr, batt_variables *batt_vars=0);
+	~battstor();
+
+	/// Run the battery for the current timestep, given the PV power, load, and clipped power
+	void advance(compute_module &cm, double P_pv, double V_pv=0, double P_load=0, double P_pv_clipped=0);
+
+	/// Given a DC connected battery, set the shared PV and battery invertr
+	void setSharedInverter(SharedInverter * sharedInverter);
+
+	void outputs_fixed(compute_module &cm);
+	void outputs_topology_dependent(compute_module &cm);
+	void metrics(compute_module &cm);
+	void update_grid_power(compute_module &cm, double P_gen_ac, double P_load_ac, size_t index);
+	void process_messages(compute_module &cm);
+	void calculate_monthly_and_annual_outputs( compute_module &cm );
+
+	bool en;
+	int chem;
+
+	bool make_vars;
+
 	// outputs
 	ssc_number_t
 		*outTotalCharge,
@@ -47,6 +47,9 @@
 *  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************************************/
 
+#include <atomic>
+#include <thread>
+
 #include "core.h"
 #include "lib_iec61853.h"
 
@@ -144,6 +147,163 @@ public:
 DEFINE_MODULE_ENTRY( iec61853par, "Calculate 11-parameter single diode model parameters from IEC-61853 PV module test data.", 1 )
 
 
+static var_info vtab_iec61853_batch[] = 
+{	
+/*   VARTYPE            DATATYPE         NAME                        LABEL                       UNITS     META                                             GROUP          REQUIRED_IF    CONSTRAINTS UI_HINTS*/
+	{ SSC_INPUT,        SSC_MATRIX,      "input",                  "IEC-61853 matrix test data for all modules", "various", "[MODULE,IRR,TC,PMP,VMP,VOC,ISC], MODULE is the 0-based module index", "IEC61853", "*", "",  "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "nser",                   "Number of cells in series",  "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "type",                   "Cell technology type",       "0..5",     "monoSi,multiSi/polySi,cdte,cis,cigs,amorphous", "IEC61853",    "*",           "LENGTH_EQUAL=nser", "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "nthreads",               "Number of solver threads",   "",         "0=all available",                               "IEC61853",    "?=0",         "INTEGER,MIN=0", "" },
+																								 											                			   
+	{ SSC_OUTPUT,       SSC_ARRAY,       "alphaIsc",               "SC temp coefficient @ STC",  "A/C",      "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "betaVoc",                "OC temp coefficient @ STC",  "V/C",      "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "gammaPmp",               "MP temp coefficient @ STC",  "%/C",      "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "n",                      "Diode factor",               "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "Il",                     "Light current",              "A",        "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "Io",                     "Saturation current",         "A",        "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "C1",                     "Rsh fitting C1",             "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "C2",                     "Rsh fitting C2",             "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "C3",                     "Rsh fitting C3",             "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "D1",                     "Rs fitting D1",              "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "D2",                     "Rs fitting D2",              "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "D3",                     "Rs fitting D3",              "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "Egref",                  "Bandgap voltage",            "eV",       "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "solved",                 "Parameters determined",      "0/1",      "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "nconditions",            "Number of test conditions",  "",         "",                                              "IEC61853",    "*",           "",         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "nconditions_solved",     "Number of test conditions with a single diode solution", "", "",                           "IEC61853",    "*",           "",         "" },
+
+var_info_invalid };
+
+class cm_iec61853par_batch : public compute_module
+{
+private:
+	/// Keeps the last solver message of one module so failures can be reported after the threads finish
+	class last_message : public Imessage_api
+	{
+	public:
+		std::string text;
+		virtual void Printf(const char *fmt, ...) {
+			char buf[1024];
+			va_list ap;
+			va_start(ap, fmt);
+#ifdef _MSC_VER
+			_vsnprintf(buf, 1024, fmt, ap);
+#else
+			vsnprintf(buf,1024,fmt,ap);
+#endif
+			va_end(ap);
+			text = buf;
+		}
+		virtual void Outln(const char *msg ) {
+			text = msg;
+		}
+	};
+
+public:
+	cm_iec61853par_batch()
+	{
+		add_var_info( vtab_iec61853_batch );
+	}
+
+	void exec( ) throw( general_error )
+	{
+		util::matrix_t<double> input = as_matrix("input");
+		if ( input.ncols() != iec61853_module_t::COL_MAX + 1 )
+			throw exec_error( "iec61853par_batch", "seven data columns required for input matrix: MODULE,IRR,TC,PMP,VMP,VOC,ISC");
+
+		size_t nmod = 0;
+		ssc_number_t *nser = as_array("nser", &nmod);
+		ssc_number_t *type = as_array("type", 0);
+
+		// split the stacked test data into one matrix per module
+		std::vector<size_t> nrows(nmod, 0);
+		for( size_t r=0;r<input.nrows();r++ )
+		{
+			int m = (int)input(r, 0);
+			if ( m < 0 || m >= (int)nmod )
+				throw exec_error( "iec61853par_batch", util::format("module index %d in row %d is out of range, %d modules specified", m, (int)r+1, (int)nmod) );
+			nrows[m]++;
+		}
+
+		std::vector< util::matrix_t<double> > data(nmod);
+		for( size_t m=0;m<nmod;m++ )
+		{
+			if ( nrows[m] == 0 )
+				throw exec_error( "iec61853par_batch", util::format("no test data for module %d", (int)m) );
+			data[m].resize( nrows[m], iec61853_module_t::COL_MAX );
+			nrows[m] = 0;
+		}
+		for( size_t r=0;r<input.nrows();r++ )
+		{
+			size_t m = (size_t)input(r, 0);
+			for( size_t j=0;j<iec61853_module_t::COL_MAX;j++ )
+				data[m](nrows[m], j) = input(r, j+1);
+			nrows[m]++;
+		}
+
+		// modules are independent, so they are handed out to whichever thread is free
+		std::vector<iec61853_module_t> solvers(nmod);
+		std::vector<last_message> msgs(nmod);
+		std::vector<int> solved(nmod, 0), nsolved(nmod, 0);
+		std::atomic<size_t> next(0);
+		auto run = [&]()
+		{
+			size_t m;
+			while( (m = next++) < nmod )
+			{
+				util::matrix_t<double> par;
+				solvers[m]._imsg = &msgs[m];
+				solved[m] = solvers[m].calculate( data[m], (int)nser[m], (int)type[m], par, false ) ? 1 : 0;
+				solvers[m]._imsg = 0;
+				for( size_t i=0;i<par.nrows();i++ )
+					if ( std::isfinite( par(i, iec61853_module_t::IL) ) )
+						nsolved[m]++;
+			}
+		};
+
+		size_t nthreads = (size_t)as_integer("nthreads");
+		if ( nthreads == 0 )
+			nthreads = std::max( 1u, std::thread::hardware_concurrency() );
+		nthreads = std::min( nthreads, nmod );
+		if ( nthreads > 1 )
+		{
+			std::vector<std::thread> threads;
+			for( size_t i=0;i<nthreads;i++ )
+				threads.push_back( std::thread( run ) );
+			for( size_t i=0;i<threads.size();i++ )
+				threads[i].join();
+		}
+		else
+			run();
+
+		ssc_number_t *out[13];
+		const char *names[13] = { "n", "alphaIsc", "betaVoc", "gammaPmp", "Il", "Io", "C1", "C2", "C3", "D1", "D2", "D3", "Egref" };
+		for( size_t k=0;k<13;k++ )
+			out[k] = allocate( names[k], nmod );
+		ssc_number_t *p_solved = allocate( "solved", nmod );
+		ssc_number_t *p_nconditions = allocate( "nconditions", nmod );
+		ssc_number_t *p_nsolved = allocate( "nconditions_solved", nmod );
+
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		for( size_t m=0;m<nmod;m++ )
+		{
+			const iec61853_module_t &s = solvers[m];
+			double vals[13] = { s.n, s.alphaIsc, s.betaVoc, s.gammaPmp, s.Il, s.Io, s.C1, s.C2, s.C3, s.D1, s.D2, s.D3, s.Egref };
+			for( size_t k=0;k<13;k++ )
+				out[k][m] = (ssc_number_t)( solved[m] ? vals[k] : nan );
+			p_solved[m] = (ssc_number_t)solved[m];
+			p_nconditions[m] = (ssc_number_t)data[m].nrows();
+			p_nsolved[m] = (ssc_number_t)nsolved[m];
+
+			if ( !solved[m] )
+				log( util::format("module %d: failed to solve for parameters: %s", (int)m, msgs[m].text.c_str()), SSC_WARNING );
+		}
+	}
+};
+
+DEFINE_MODULE_ENTRY( iec61853par_batch, "Calculate 11-parameter single diode model parameters for a set of modules from IEC-61853 PV module test data.", 1 )
+
+
 #include "../solarpilot/Toolbox.h"
 #include "../tcs/interpolation_routines.h"
 
@@ -50,6 +50,9 @@
 #include "cmod_pvsamv1.h"
 #include "lib_pv_io_manager.h"
 
+#include <exception>
+#include <thread>
+
 // comment following define if do not want shading database validation outputs
 //#define SHADE_DB_OUTPUTS
 
@@ -66,6 +69,7 @@ static var_info _cm_vtab_pvsamv1[] = {
 	{ SSC_INPUT,        SSC_NUMBER,      "system_use_lifetime_output",                  "PV lifetime simulation",                               "0/1",      "",                              "pvsamv1",             "?=0",                        "INTEGER,MIN=0,MAX=1",          "" },
 	{ SSC_INPUT,        SSC_NUMBER,      "analysis_period",                             "Lifetime analysis period",                             "years",    "",                              "pvsamv1",             "system_use_lifetime_output=1",   "",                             "" },
 	{ SSC_INPUT,        SSC_ARRAY,       "dc_degradation",                              "Annual module degradation",                            "%/year",   "",                              "pvsamv1",             "system_use_lifetime_output=1",   "",                             "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "system_lifetime_fast",                        "PV lifetime simulation from first year DC output",     "0/1",      "0=simulate every year,1=scale first year DC output", "pvsamv1", "?=0",                   "INTEGER,MIN=0,MAX=1",          "" },
 //	{ SSC_INPUT,        SSC_ARRAY,       "ac_degradation",                              "Annual AC degradation",                                "%/year",   "",                              "pvsamv1",             "system_use_lifetime_output=1",   "",                             "" },
 	{ SSC_OUTPUT,       SSC_ARRAY,       "dc_degrade_factor",                           "Annual module degrade factor",                         "",         "",                              "Annual",             "system_use_lifetime_output=1",   "",                             "" },
 //	{ SSC_OUTPUT,       SSC_ARRAY,       "ac_degrade_factor",                           "Annual AC degrade factor",                             "",         "",                              "pvsamv1",             "system_use_lifetime_output=1",   "",                             "" },
@@ -86,6 +90,8 @@ static var_info _cm_vtab_pvsamv1[] = {
 	{ SSC_INPUT,        SSC_NUMBER,      "inverter_count",                              "Number of inverters",                                   "",        "",                              "pvsamv1",              "*",                        "INTEGER,POSITIVE",              "" },
 
 	{ SSC_INPUT,        SSC_NUMBER,      "enable_mismatch_vmax_calc",                   "Enable mismatched subarray Vmax calculation",           "",        "",                              "pvsamv1",              "?=0",                      "BOOLEAN",                       "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "subarray_threads",                            "Number of threads for subarray calculations",           "",        "0=one per subarray",            "pvsamv1",              "?=0",                      "INTEGER,MIN=0",                 "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "selfshade_table_tolerance",                   "Tolerance for tabulated self-shading geometry",         "frac",    "0=calculate every time step",   "pvsamv1",              "?=0",                      "MIN=0,MAX=1",                   "" },
 
 	{ SSC_INPUT,        SSC_NUMBER,      "subarray1_nstrings",                          "Sub-array 1 Number of parallel strings",                "",        "",                              "pvsamv1",              "",						 "INTEGER",                       "" },
 	{ SSC_INPUT,        SSC_NUMBER,      "subarray1_modules_per_string",                "Sub-array 1 Modules per string",                        "",        "",                              "pvsamv1",              "*",                        "INTEGER,POSITIVE",              "" },
@@ -949,8 +955,38 @@ cm_pvsamv1::cm_pvsamv1()
 	add_var_info(vtab_technology_outputs);
 	add_var_info(vtab_battery_inputs);
 	add_var_info(vtab_battery_outputs);
+	add_var_info(vtab_component_library);
 }
 
+void cm_pvsamv1::prepare_inputs() throw (compute_module::general_error)
+{
+	assign_library_components(this);
+}
+
+/**
+* Irradiance and module results for one subarray at one time step, calculated ahead of the pass over the time steps
+* that combines the subarrays on each inverter MPPT input
+*/
+struct subarray_timestep
+{
+	double solazi, solzen, solalt, albedo;
+	int sunup;
+
+	// plane-of-array irradiance after shading and soiling (W/m2)
+	double poaBeamFront, poaDiffuseFront, poaGroundFront, poaTotal;
+	double ipoa, ipoaFront, ipoaRear, ipoaRearAfterLosses;
+	double angleOfIncidenceDegrees, surfaceTiltDegrees, surfaceAzimuthDegrees;
+	bool usePOAFromWF;
+	double nonlinearDCShadingDerate, dcShadeFactor;
+
+	// subarray contributions to the total incident radiation power (W)
+	double poaFrontNominal, poaFrontBeamNominal, poaFrontShaded, poaFrontShadedSoiled, poaRear, poaFrontBeamEffective;
+
+	// module output at the max power point and power lost to the inverter MPPT voltage limits (W), when not coupled by mismatch
+	pvoutput_t moduleOut;
+	double mpptVoltageClipping;
+};
+
 	
 void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 {
@@ -987,6 +1023,7 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 	
 	// SELF-SHADING MODULE INFORMATION
 	double width = sqrt((ref_area_m2 / aspect_ratio));
+	double selfShadeTableTolerance = as_double("selfshade_table_tolerance");
 	for (size_t nn = 0; nn < num_subarrays; nn++)
 	{
 		Subarrays[nn]->selfShadingInputs.width = width;
@@ -999,6 +1036,16 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 		else
 			b = Subarrays[nn]->selfShadingInputs.nmody * Subarrays[nn]->selfShadingInputs.width;
 		Subarrays[nn]->selfShadingInputs.row_space = b / Subarrays[nn]->groundCoverageRatio;
+
+		// tabulate the self-shading geometry over sun positions once, rather than at every time step
+		if (selfShadeTableTolerance > 0 && Subarrays[nn]->shadeMode != Subarray_IO::NO_SHADING && Subarrays[nn]->nStrings > 0)
+		{
+			if (Subarrays[nn]->trackMode == Subarray_IO::FIXED_TILT)
+				Subarrays[nn]->selfShadingTable.init_fixed(Subarrays[nn]->selfShadingInputs, Subarrays[nn]->tiltDegrees, Subarrays[nn]->azimuthDegrees, selfShadeTableTolerance);
+			else if (Subarrays[nn]->trackMode == Subarray_IO::SINGLE_AXIS && !Subarrays[nn]->backtrackingEnabled)
+				Subarrays[nn]->selfShadingTable.init_1x(Subarrays[nn]->selfShadingInputs, Subarrays[nn]->tiltDegrees, Subarrays[nn]->azimuthDegrees,
+					Subarrays[nn]->trackerRotationLimitDegrees, Subarrays[nn]->groundCoverageRatio, selfShadeTableTolerance);
+		}
 	}
 
 	double nameplate_kw = 0;
@@ -1080,7 +1127,24 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 	double annual_energy = 0, annual_ac_gross = 0, annual_ac_pre_avail = 0, dc_gross[4] = { 0, 0, 0, 0 }, annualMpptVoltageClipping = 0, annual_dc_adjust_loss = 0, annual_dc_lifetime_loss = 0, annual_ac_lifetime_loss = 0, annual_ac_battery_loss = 0, annual_xfmr_nll = 0, annual_xfmr_ll = 0, annual_xfmr_loss = 0;
 
 	// Check if a POA model is used, if so load all POA data into the poaData struct
+	std::vector<std::unique_ptr<poaDecompResult[]>> poaDecompResults;
 	if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P ){
+		// subarrays with the same orientation decompose the same POA input onto the same surface, so they share the POA data
+		// and the decomposition of each time step, which is stored by the first of them
+		auto sameOrientation = [&](size_t a, size_t b) {
+			Subarray_IO *sa = Subarrays[a], *sb = Subarrays[b];
+			return sa->trackMode == sb->trackMode && sa->tiltDegrees == sb->tiltDegrees && sa->azimuthDegrees == sb->azimuthDegrees
+				&& sa->monthlyTiltDegrees == sb->monthlyTiltDegrees && sa->trackerRotationLimitDegrees == sb->trackerRotationLimitDegrees
+				&& sa->backtrackingEnabled.value == sb->backtrackingEnabled.value && sa->groundCoverageRatio == sb->groundCoverageRatio;
+		};
+		std::vector<int> poaSource(num_subarrays, -1);
+		for (size_t nn = 0; nn < num_subarrays; nn++) {
+			if (!Subarrays[nn]->enable || Subarrays[nn]->nStrings < 1) continue;
+			for (size_t mm = 0; mm < nn && poaSource[nn] < 0; mm++)
+				if (Subarrays[mm]->enable && Subarrays[mm]->nStrings >= 1 && poaSource[mm] < 0 && sameOrientation(mm, nn))
+					poaSource[nn] = (int)mm;
+		}
+
 		for (int nn = 0; nn < num_subarrays; nn++){
 			if (!Subarrays[nn]->enable) continue;
 				
@@ -1091,12 +1155,32 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 				Subarrays[nn]->poa.poaAll.stepSize = 60.0 / step_per_hour;
 			}
 
+			if (poaSource[nn] >= 0) {
+				poaDecompReq &source = Subarrays[poaSource[nn]]->poa.poaAll;
+				if (!source.results) {
+					poaDecompResults.push_back(std::unique_ptr<poaDecompResult[]>(new poaDecompResult[8760 * step_per_hour]()));
+					source.results = poaDecompResults.back().get();
+					source.nResults = 8760 * step_per_hour;
+					source.storeResults = true;
+				}
+				poaDecompReq &poaAll = Subarrays[nn]->poa.poaAll;
+				poaAll.POA = source.POA;
+				poaAll.inc = source.inc;
+				poaAll.tilt = source.tilt;
+				poaAll.zen = source.zen;
+				poaAll.exTer = source.exTer;
+				poaAll.results = source.results;
+				poaAll.nResults = source.nResults;
+				continue;
+			}
+
 			Subarrays[nn]->poa.poaAll.POA = new double[ 8760*step_per_hour ];
 			Subarrays[nn]->poa.poaAll.inc = new double[ 8760*step_per_hour ];
 			Subarrays[nn]->poa.poaAll.tilt = new double[ 8760*step_per_hour ];
 			Subarrays[nn]->poa.poaAll.zen = new double[ 8760*step_per_hour ];
 			Subarrays[nn]->poa.poaAll.exTer = new double[ 8760*step_per_hour ];
 					
+			daylight_mask daylight(hdr.lat, hdr.lon, hdr.tz, ts_hour);
 			for (size_t h=0; h<8760; h++){
 				for	(size_t m=0; m < step_per_hour; m++){
 					size_t ii = h * step_per_hour + m;
@@ -1116,59 +1200,15 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 					else
 						Subarrays[nn]->poa.poaAll.POA[ii] = -999;
 						
-					// Calculate incident angle
-					double t_cur = wf.hour + wf.minute/60;
-
-					// Calculate sunrise and sunset hours in local standard time for the current day
+					// Calculate incident angle, with sunrise and sunset calculated once per day
 					double sun[9], angle[5];
 					int tms[3];
 
-					solarpos( wf.year, wf.month, wf.day, 12, 0.0, hdr.lat, hdr.lon, hdr.tz, sun );
-
-					double t_sunrise = sun[4];
-					double t_sunset = sun[5];
-
-					if ( t_cur >= t_sunrise - ts_hour/2.0
-						&& t_cur < t_sunrise + ts_hour/2.0 )
-					{
-						// time step encompasses the sunrise
-						double t_calc = (t_sunrise + (t_cur+ts_hour/2.0))/2.0; // midpoint of sunrise and end of timestep
-						int hr_calc = (int)t_calc;
-						double min_calc = (t_calc-hr_calc)*60.0;
-
-						tms[0] = hr_calc;
-						tms[1] = (int)min_calc;
-
-						solarpos( wf.year, wf.month, wf.day, hr_calc, min_calc, hdr.lat, hdr.lon, hdr.tz, sun );
-
-						tms[2] = 2;
-					}
-					else if (t_cur > t_sunset - ts_hour/2.0
-						&& t_cur <= t_sunset + ts_hour/2.0 )
-					{
-						// timestep encompasses the sunset
-						double t_calc = ( (t_cur-ts_hour/2.0) + t_sunset )/2.0; // midpoint of beginning of timestep and sunset
-						int hr_calc = (int)t_calc;
-						double min_calc = (t_calc-hr_calc)*60.0;
-
-						tms[0] = hr_calc;
-						tms[1] = (int)min_calc;
-
-						solarpos( wf.year, wf.month, wf.day, hr_calc, min_calc, hdr.lat, hdr.lon, hdr.tz, sun );
-
-						tms[2] = 3;
-					}
-					else if (t_cur >= t_sunrise && t_cur <= t_sunset)
-					{
-						// timestep is not sunrise nor sunset, but sun is up  (calculate position at provided t_cur)
-						tms[0] = wf.hour;
-						tms[1] = (int)wf.minute;
-						solarpos( wf.year, wf.month, wf.day, wf.hour, wf.minute, hdr.lat, hdr.lon, hdr.tz, sun );
-						tms[2] = 1;
-					}
-					else
+					if (daylight.night(wf.year, wf.month, wf.day, wf.hour, wf.minute))
 					{
 						// sun is down, assign sundown values
+						for (int i = 0; i < 9; i++)
+							sun[i] = daylight.noon()[i];
 						sun[0] = -999; //avoid returning a junk azimuth angle
 						sun[1] = -999; //avoid returning a junk zenith angle
 						sun[2] = -999; //avoid returning a junk elevation angle
@@ -1176,7 +1216,8 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 						tms[1] = -1;
 						tms[2] = 0;
 					}
-
+					else
+						solarpos_timestep(wf.year, wf.month, wf.day, wf.hour, wf.minute, ts_hour, hdr.lat, hdr.lon, hdr.tz, daylight.noon(), sun, tms);
 
 					if( tms[2] > 0){
 						incidence(Subarrays[nn]->trackMode, Subarrays[nn]->tiltDegrees, Subarrays[nn]->azimuthDegrees, Subarrays[nn]->trackerRotationLimitDegrees, sun[1], sun[0], Subarrays[nn]->backtrackingEnabled, Subarrays[nn]->groundCoverageRatio, angle );
@@ -1202,465 +1243,767 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 	/* *********************************************************************************************
 	PV DC calculation
 	*********************************************************************************************** */
-	std::vector<double> dcPowerNetPerMppt_kW; //Vector of Net DC power in kW for each MPPT input on the system for THIS TIMESTEP ONLY
 	std::vector<double> dcPowerNetPerSubarray; //Net DC power in W for each subarray for THIS TIMESTEP ONLY
-	std::vector<double> dcVoltagePerMppt; //Voltage in V at each MPPT input on the system for THIS TIMESTEP ONLY				
 	double dcPowerNetTotalSystem = 0; //Net DC power in W for the entire system (sum of all subarrays)
 
 	for (int mpptInput = 0; mpptInput < PVSystem->Inverter->nMpptInputs; mpptInput++)
 	{
-		dcPowerNetPerMppt_kW.push_back(0);
-		dcVoltagePerMppt.push_back(0);
 		PVSystem->p_dcPowerNetPerMppt[mpptInput][idx] = 0;		
 	}
 	for (int nn = 0; nn < PVSystem->numberOfSubarrays; nn++) {
 		dcPowerNetPerSubarray.push_back(0);
 	}
-	for (size_t iyear = 0; iyear < nyears; iyear++)
+	// Subarrays do not interact until their DC power reaches the inverter MPPT inputs, so the irradiance and module
+	// calculations for each subarray are run over a block of time steps on separate threads. A second pass over the block
+	// then combines the subarrays on each MPPT input and applies the system level DC losses.  Mismatch calculations couple
+	// the subarrays on an MPPT input, so in that case the module calculations are left to the second pass.
+	std::vector<int> activeSubarrays;
+	for (size_t nn = 0; nn < num_subarrays; nn++)
+		if (Subarrays[nn]->enable && Subarrays[nn]->nStrings >= 1)
+			activeSubarrays.push_back((int)nn);
+	int lastSubarray = activeSubarrays.size() > 0 ? activeSubarrays.back() : -1; // outputs common to all subarrays are saved from this one
+
+	bool precalculateModules = !PVSystem->enableMismatchVoltageCalc;
+
+	size_t nthreads = (size_t)as_integer("subarray_threads");
+	if (nthreads < 1) nthreads = std::thread::hardware_concurrency();
+	if (nthreads > activeSubarrays.size()) nthreads = activeSubarrays.size();
+	if (nthreads < 1) nthreads = 1;
+
+	size_t blockHours = 8760 / step_per_hour; // limit the stored time steps to a year of hourly data
+	if (blockHours < 1) blockHours = 1;
+	std::vector<weather_record> blockWeather(blockHours * step_per_hour);
+	std::vector< std::vector<subarray_timestep> > blockSubarrays(num_subarrays);
+	for (size_t i = 0; i < activeSubarrays.size(); i++)
+		blockSubarrays[activeSubarrays[i]].resize(blockHours * step_per_hour);
+
+	// messages and errors from each subarray are held until the subarray threads have finished
+	std::vector< std::vector<log_item> > subarrayMessages(num_subarrays);
+	std::vector<std::exception_ptr> subarrayErrors(num_subarrays);
+
+	auto flushMessages = [this](std::vector<log_item> &messages)
 	{
-		for (hour = 0; hour < 8760; hour++)
+		for (size_t i = 0; i < messages.size(); i++)
+			log(messages[i].text, messages[i].type, messages[i].time);
+		messages.clear();
+	};
+
+	// module output for one subarray at a string voltage, -1 for the max power point.  Returns the power lost to the inverter MPPT voltage limits (W)
+	auto moduleOutput = [&](int nn, const weather_record &wf, double solzen, double stringVoltage, pvoutput_t &out, std::vector<log_item> &messages)
+	{
+		//initalize pvinput and pvoutput structures for the model
+		pvinput_t in(Subarrays[nn]->poa.poaBeamFront, Subarrays[nn]->poa.poaDiffuseFront, Subarrays[nn]->poa.poaGroundFront, Subarrays[nn]->poa.poaRear, Subarrays[nn]->poa.poaTotal,
+			wf.tdry, wf.tdew, wf.wspd, wf.wdir, wf.pres,
+			solzen, Subarrays[nn]->poa.angleOfIncidenceDegrees, hdr.elev,
+			Subarrays[nn]->poa.surfaceTiltDegrees, Subarrays[nn]->poa.surfaceAzimuthDegrees,
+			((double)wf.hour) + wf.minute / 60.0,
+			radmode, Subarrays[nn]->poa.usePOAFromWF);
+		out = pvoutput_t(0, 0, 0, 0, 0, 0, 0, 0);
+
+		double mpptClipping = 0;
+		double tcell = wf.tdry;
+		if (Subarrays[nn]->poa.sunUp)
 		{
-			// report progress updates to the caller	
-			ireport++;
-			if (ireport - ireplast > irepfreq)
+			//module voltage value to be passed into module power function.
+			//if -1 is passed in, power will be calculated at max power point.
+			//if a voltage value is passed in, power will be calculated at the specified voltage for all single-diode module models
+			double module_voltage = -1;
+			if (stringVoltage != -1) module_voltage = stringVoltage / Subarrays[nn]->nModulesPerString;
+			// calculate cell temperature using selected temperature model
+			// calculate module power output using conversion model previously specified
+			(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, module_voltage, tcell);
+			(*Subarrays[nn]->Module->moduleModel)(in, tcell, module_voltage, out);
+
+			mpptClipping = out.Power; //initialize the voltage clipping loss with the power at module MPP, subtract from this later for the actual MPPT clipping loss
+
+			// if mismatch is enabled, the voltage already was clipped to the inverter MPPT range as needed
+			// if mismatch isn't enabled, need to check the voltage at the module's MPP against the inverter MPPT voltage range
+			// if the module voltage is outside the inverter range, recalculate module power using the inverter voltage limit
+			if (!PVSystem->enableMismatchVoltageCalc && PVSystem->clipMpptWindow)
 			{
-				percent_complete = percent_baseline + 100.0f *(float)(hour + iyear * 8760) / (float)(insteps);
-				if (!update("", percent_complete))
-					throw exec_error("pvsamv1", "simulation canceled at hour " + util::to_string(hour + 1.0) + " in year " + util::to_string((int)iyear + 1) + "in dc loop");
-				ireplast = ireport;
+				double voltageMpptLow1Module = PVSystem->Inverter->mpptLowVoltage / Subarrays[nn]->nModulesPerString;
+				double voltageMpptHi1Module = PVSystem->Inverter->mpptHiVoltage / Subarrays[nn]->nModulesPerString;
+				if (out.Voltage < voltageMpptLow1Module)
+				{
+					module_voltage = voltageMpptLow1Module;
+					(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, module_voltage, tcell);
+					(*Subarrays[nn]->Module->moduleModel)(in, tcell, module_voltage, out);
+				}
+				else if (out.Voltage > voltageMpptHi1Module)
+				{
+					module_voltage = voltageMpptHi1Module;
+					(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, module_voltage, tcell);
+					(*Subarrays[nn]->Module->moduleModel)(in, tcell, module_voltage, out);
+				}
 			}
+			mpptClipping -= out.Power; //subtract the power that remains after voltage clipping in order to get the total loss. if no power was lost, all the power will be subtracted away again.
+		}
 
-			// only hourly electric load, even
-			// if PV simulation is subhourly.  load is assumed constant over the hour.
-			// if no load profile supplied, load = 0
-			if (nload == 8760)
-				cur_load = p_load_in[hour];
+		//check for weird results
+		if (out.Voltage > Subarrays[nn]->Module->moduleModel->VocRef()*1.3)
+			messages.push_back(log_item(SSC_NOTICE, util::format("Module voltage is unrealistically high (exceeds 1.3*VocRef) at [mdhm: %d %d %d %lg]: %lg V\n", wf.month, wf.day, wf.hour, wf.minute, out.Voltage)));
+		if (!std::isfinite(out.Power))
+		{
+			out.Power = 0;
+			out.Voltage = 0;
+			out.Current = 0;
+			out.Efficiency = 0;
+			out.CellTemp = tcell;
+			messages.push_back(log_item(SSC_NOTICE, util::format("Non-finite power output calculated at [mdhm: %d %d %d %lg], set to zero.\n"
+				"could be due to anomolous equation behavior at very low irradiances (poa: %lg W/m2)",
+				wf.month, wf.day, wf.hour, wf.minute, Subarrays[nn]->poa.poaTotal)));
+		}
+		return mpptClipping;
+	};
 
-			for (size_t jj = 0; jj < step_per_hour; jj++)
-			{
-				// Reset dcPower calculation for new timestep
-				dcPowerNetTotalSystem = 0; 
+	// irradiance incident on one subarray, shading and soiling, and module output if not coupled by mismatch, for each time step in the block
+	auto calculateSubarray = [&](int nn, size_t iyear, size_t blockHour, size_t blockIdx, size_t nsteps)
+	{
+		std::vector<log_item> &messages = subarrayMessages[nn];
+		ssc_number_t dnTopOfHour = 0;
 
-				// electric load is subhourly
-				// if no load profile supplied, load = 0
-				if (nload == nrec)
-					cur_load = p_load_in[hour*step_per_hour + jj];
+		// sunrise and sunset are calculated once per day, night steps need no sun position
+		daylight_mask daylight(hdr.lat, hdr.lon, hdr.tz, Irradiance->instantaneous ? IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET : Irradiance->dtHour);
 
-				// log cur_load to check both hourly and sub hourly load data
-				// load data over entrie lifetime period not currently supported.
-				//					log(util::format("year=%d, hour=%d, step per hour=%d, load=%g",
-				//						iyear, hour, jj, cur_load), SSC_WARNING, (float)idx);
-				p_load_full.push_back((ssc_number_t)cur_load);
+		for (size_t k = 0; k < nsteps; k++)
+		{
+			const weather_record &wf = blockWeather[k];
+			subarray_timestep &ts = blockSubarrays[nn][k];
+			size_t hour = blockHour + k / step_per_hour;
+			size_t jj = k % step_per_hour;
+			size_t idx = blockIdx + k;
+
+			//update POA data structure indicies if radmode is POA model is enabled
+			if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
+				Subarrays[nn]->poa.poaAll.tDew = wf.tdew;
+				Subarrays[nn]->poa.poaAll.i = idx;
+				Subarrays[nn]->poa.poaAll.pass = iyear;
+				if (jj == 0 && wf.hour == 0) {
+					Subarrays[nn]->poa.poaAll.dayStart = idx;
+					Subarrays[nn]->poa.poaAll.doy += 1;
+				}
+			}
 
-				if (!wdprov->read(&Irradiance->weatherRecord))
-					throw exec_error("pvsamv1", "could not read data line " + util::to_string((int)(idx + 1)) + " in weather file");
+			// calculate incident irradiance on the subarray
+			double ipoa_rear, ipoa_rear_after_losses, ipoa_front, ipoa, alb;
+			ipoa_rear = ipoa_rear_after_losses = ipoa_front = ipoa = alb = 0;
+			double solazi = 0, solzen = 0, solalt = 0;
+			int sunup = 0;
+
+			irrad irr(Irradiance, Subarrays[nn], wf);
+			daylight.night(wf.year, wf.month, wf.day, wf.hour, wf.minute);
+			irr.set_noon_sun(daylight.noon());
+
+			int code = irr.calc();
+
+			if (code != 0)
+				throw exec_error("pvsamv1",
+				util::format("failed to calculate irradiance incident on surface (POA) %d (code: %d) [y:%d m:%d d:%d h:%d]",
+				nn + 1, code, wf.year, wf.month, wf.day, wf.hour));
+
+			// calculated direct normal irradiance, used by the self-shading model
+			ssc_number_t dnCalculated = 0;
+
+			// p_irrad_calc is only weather file records long...
+			if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P) {
+				double gh_temp, df_temp, dn_temp;
+				gh_temp = df_temp = dn_temp = 0;
+				irr.get_irrad(&gh_temp, &dn_temp, &df_temp);
+				dnCalculated = (ssc_number_t)dn_temp;
+				if (iyear == 0 && nn == lastSubarray) {
+					Irradiance->p_IrradianceCalculated[1][idx] = (ssc_number_t)df_temp;
+					Irradiance->p_IrradianceCalculated[2][idx] = (ssc_number_t)dn_temp;
+				}
+			}
+			// beam, skydiff, and grounddiff IN THE PLANE OF ARRAY (W/m2)
+			double ibeam, iskydiff, ignddiff;
+			double aoi, stilt, sazi, rot, btd;
+
+			// Ensure that the usePOAFromWF flag is false unless a reference cell has been used.
+			//  This will later get forced to false if any shading has been applied (in any scenario)
+			//  also this will also be forced to false if using the cec mcsp thermal model OR if using the spe module model with a diffuse util. factor < 1.0
+			Subarrays[nn]->poa.usePOAFromWF = false;
+			if (radmode == Irradiance_IO::POA_R){
+				ipoa = wf.poa;
+				Subarrays[nn]->poa.usePOAFromWF = true;
+			}
+			else if (radmode == Irradiance_IO::POA_P){
+				ipoa = wf.poa;
+			}
 
-				weather_record wf = Irradiance->weatherRecord;
+			if (Subarrays[nn]->Module->simpleEfficiencyForceNoPOA && (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P)){  // only will be true if using a poa model AND spe module model AND spe_fp is < 1
+				Subarrays[nn]->poa.usePOAFromWF = false;
+				if (idx == 0)
+					messages.push_back(log_item(SSC_WARNING, "The combination of POA irradiance as in input, single point efficiency module model, and module diffuse utilization factor less than one means that SAM must use a POA decomposition model to calculate the incident diffuse irradiance"));
+			}
 
-				//update POA data structure indicies if radmode is POA model is enabled
-				if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
-					for (size_t nn = 0; nn < num_subarrays; nn++){
-						if (!Subarrays[nn]->enable) continue;
-
-						Subarrays[nn]->poa.poaAll.tDew = wf.tdew;
-						Subarrays[nn]->poa.poaAll.i = idx;
-						if (jj == 0 && wf.hour == 0) {
-							Subarrays[nn]->poa.poaAll.dayStart = idx;
-							Subarrays[nn]->poa.poaAll.doy += 1;
-						}
+			if (Subarrays[nn]->Module->mountingSpecificCellTemperatureForceNoPOA && (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P)){
+				Subarrays[nn]->poa.usePOAFromWF = false;
+				if (idx == 0)
+					messages.push_back(log_item(SSC_WARNING, "The combination of POA irradiance as input and heat transfer method for cell temperature means that SAM must use a POA decomposition model to calculate the beam irradiance required by the cell temperature model"));
+			}
 
-					}
-				}
-				
-				double solazi = 0, solzen = 0, solalt = 0;
-				int sunup = 0;
 
-				// accumulators for radiation power (W) over this 
-				// timestep from each subarray
-				double ts_accum_poa_front_nom = 0.0;
-				double ts_accum_poa_front_beam_nom = 0.0;
-				double ts_accum_poa_front_shaded = 0.0;
-				double ts_accum_poa_front_shaded_soiled = 0.0;
-				double ts_accum_poa_front_total = 0.0;
-				double ts_accum_poa_rear = 0.0;
-				double ts_accum_poa_rear_after_losses = 0.0;
-				double ts_accum_poa_total_eff = 0.0;
-				double ts_accum_poa_front_beam_eff = 0.0;
+			// Get Incident angles and irradiances
+			irr.get_sun(&solazi, &solzen, &solalt, 0, 0, 0, &sunup, 0, 0, 0);
+			irr.get_angles(&aoi, &stilt, &sazi, &rot, &btd);
+			irr.get_poa(&ibeam, &iskydiff, &ignddiff, 0, 0, 0);
+			alb = irr.getAlbedo();
 
-				// calculate incident irradiance on each subarray
-				double ipoa_rear, ipoa_rear_after_losses, ipoa_front, ipoa, alb;
-				ipoa_rear = ipoa_rear_after_losses = ipoa_front = ipoa = alb = 0;
+			if (iyear == 0 && nn == lastSubarray)
+				Irradiance->p_sunPositionTime[idx] = (ssc_number_t)irr.get_sunpos_calc_hour();
 
-				for (int nn = 0; nn < num_subarrays; nn++)
+			// calculate beam if global & diffuse are selected as inputs
+			if (radmode == Irradiance_IO::GH_DF)
+			{
+				dnCalculated = (ssc_number_t)((wf.gh - wf.df) / cos(solzen*3.1415926 / 180));
+				if (dnCalculated < -1)
 				{
-					if (!Subarrays[nn]->enable
-						|| Subarrays[nn]->nStrings < 1)
-						continue; // skip disabled subarrays
-
-					irrad irr(Irradiance, Subarrays[nn]);
-					
-					int code = irr.calc();
+					if (iyear == 0 && nn == lastSubarray)
+						messages.push_back(log_item(SSC_WARNING, util::format("SAM calculated negative direct normal irradiance %lg W/m2 at time [y:%d m:%d d:%d h:%d], set to zero.",
+							dnCalculated, wf.year, wf.month, wf.day, wf.hour), (float)idx));
+					dnCalculated = 0;
+				}
+			}
+			if (jj == 0)
+				dnTopOfHour = dnCalculated;
+
+			// save weather file beam, diffuse, and global for output and for use later in pvsamv1- year 1 only
+			/*jmf 2016: these calculations are currently redundant with calculations in irrad.calc() because ibeam and idiff in that function are DNI and DHI, **NOT** in the plane of array
+			we'll have to fix this redundancy in the pvsamv1 rewrite. it will require allowing irradproc to report the errors below
+			and deciding what to do if the weather file DOES contain the third component but it's not being used in the calculations.*/
+			if (iyear == 0 && nn == lastSubarray)
+			{
+				// Apply all irradiance component data from weather file (if it exists)
+				Irradiance->p_weatherFilePOA[0][idx] = (ssc_number_t)wf.poa;
+				Irradiance->p_weatherFileDNI[idx] = (ssc_number_t)wf.dn;
+				Irradiance->p_weatherFileGHI[idx] = (ssc_number_t)(wf.gh);
+				Irradiance->p_weatherFileDHI[idx] = (ssc_number_t)(wf.df);
 
-					if (code != 0)
-						throw exec_error("pvsamv1",
-						util::format("failed to calculate irradiance incident on surface (POA) %d (code: %d) [y:%d m:%d d:%d h:%d]",
-						nn + 1, code, wf.year, wf.month, wf.day, wf.hour));
+				if (radmode == Irradiance_IO::GH_DF)
+					Irradiance->p_IrradianceCalculated[2][idx] = dnCalculated;
 
-					// p_irrad_calc is only weather file records long...
-					if (iyear == 0)
+				// calculate global if beam & diffuse are selected as inputs
+				if (radmode == Irradiance_IO::DN_DF)
+				{
+					Irradiance->p_IrradianceCalculated[0][idx] = (ssc_number_t)(wf.df + wf.dn * cos(solzen*3.1415926 / 180));
+					if (Irradiance->p_IrradianceCalculated[0][idx] < -1)
 					{
-						if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P) {
-							double gh_temp, df_temp, dn_temp;
-							gh_temp = df_temp = dn_temp = 0;
-							irr.get_irrad(&gh_temp, &dn_temp, &df_temp);
-							Irradiance->p_IrradianceCalculated[1][idx] = (ssc_number_t)df_temp;
-							Irradiance->p_IrradianceCalculated[2][idx] = (ssc_number_t)dn_temp;
-						}
+						messages.push_back(log_item(SSC_WARNING, util::format("SAM calculated negative global horizontal irradiance %lg W/m2 at time [y:%d m:%d d:%d h:%d], set to zero.",
+							Irradiance->p_IrradianceCalculated[0][idx], wf.year, wf.month, wf.day, wf.hour), (float)idx));
+						Irradiance->p_IrradianceCalculated[0][idx] = 0;
 					}
-					// beam, skydiff, and grounddiff IN THE PLANE OF ARRAY (W/m2)
-					double ibeam, iskydiff, ignddiff;
-					double aoi, stilt, sazi, rot, btd;
+				}
 
-					// Ensure that the usePOAFromWF flag is false unless a reference cell has been used. 
-					//  This will later get forced to false if any shading has been applied (in any scenario)
-					//  also this will also be forced to false if using the cec mcsp thermal model OR if using the spe module model with a diffuse util. factor < 1.0
-					Subarrays[nn]->poa.usePOAFromWF = false;
-					if (radmode == Irradiance_IO::POA_R){
-						ipoa = wf.poa;
-						Subarrays[nn]->poa.usePOAFromWF = true;
-					}
-					else if (radmode == Irradiance_IO::POA_P){
-						ipoa = wf.poa;
+				// calculate diffuse if total & beam are selected as inputs
+				if (radmode == Irradiance_IO::DN_GH)
+				{
+					Irradiance->p_IrradianceCalculated[1][idx] = (ssc_number_t)(wf.gh - wf.dn * cos(solzen*3.1415926 / 180));
+					if (Irradiance->p_IrradianceCalculated[1][idx] < -1)
+					{
+						messages.push_back(log_item(SSC_WARNING, util::format("SAM calculated negative diffuse horizontal irradiance %lg W/m2 at time [y:%d m:%d d:%d h:%d], set to zero.",
+							Irradiance->p_IrradianceCalculated[1][idx], wf.year, wf.month, wf.day, wf.hour), (float)idx));
+						Irradiance->p_IrradianceCalculated[1][idx] = 0;
 					}
+				}
+			}
 
-					if (Subarrays[nn]->Module->simpleEfficiencyForceNoPOA && (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P)){  // only will be true if using a poa model AND spe module model AND spe_fp is < 1
-						Subarrays[nn]->poa.usePOAFromWF = false;
-						if (idx == 0)
-							log("The combination of POA irradiance as in input, single point efficiency module model, and module diffuse utilization factor less than one means that SAM must use a POA decomposition model to calculate the incident diffuse irradiance", SSC_WARNING);
-					}
+			// record sub-array plane of array output before computing shading and soiling
+			if (iyear == 0)
+			{
+				if (radmode != Irradiance_IO::POA_R)
+					PVSystem->p_poaNominalFront[nn][idx] = (ssc_number_t)((ibeam + iskydiff + ignddiff));
+				else
+					PVSystem->p_poaNominalFront[nn][idx] = (ssc_number_t)((ipoa));
+			}
 
-					if (Subarrays[nn]->Module->mountingSpecificCellTemperatureForceNoPOA && (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P)){
-						Subarrays[nn]->poa.usePOAFromWF = false;
-						if (idx == 0)
-							log("The combination of POA irradiance as input and heat transfer method for cell temperature means that SAM must use a POA decomposition model to calculate the beam irradiance required by the cell temperature model", SSC_WARNING);
-					}
 
+			// record sub-array contribution to total POA power for this time step  (W)
+			if (radmode != Irradiance_IO::POA_R)
+				ts.poaFrontNominal = (ibeam + iskydiff + ignddiff) * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+			else
+				ts.poaFrontNominal = (ipoa)* ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
 
-					// Get Incident angles and irradiances
-					irr.get_sun(&solazi, &solzen, &solalt, 0, 0, 0, &sunup, 0, 0, 0);
-					irr.get_angles(&aoi, &stilt, &sazi, &rot, &btd);
-					irr.get_poa(&ibeam, &iskydiff, &ignddiff, 0, 0, 0);
-					alb = irr.getAlbedo();
+			// record sub-array contribution to total POA beam power for this time step (W)
+			ts.poaFrontBeamNominal = ibeam * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
 
-					if (iyear == 0)
-						Irradiance->p_sunPositionTime[idx] = (ssc_number_t)irr.get_sunpos_calc_hour();
+			// for non-linear shading from shading database
+			if (Subarrays[nn]->shadeCalculator.use_shade_db())
+			{
+				double shadedb_gpoa = ibeam + iskydiff + ignddiff;
+				double shadedb_dpoa = iskydiff + ignddiff;
 
-					// save weather file beam, diffuse, and global for output and for use later in pvsamv1- year 1 only
-					/*jmf 2016: these calculations are currently redundant with calculations in irrad.calc() because ibeam and idiff in that function are DNI and DHI, **NOT** in the plane of array
-					we'll have to fix this redundancy in the pvsamv1 rewrite. it will require allowing irradproc to report the errors below
-					and deciding what to do if the weather file DOES contain the third component but it's not being used in the calculations.*/
-					if (iyear == 0)
-					{
-						// Apply all irradiance component data from weather file (if it exists)
-						Irradiance->p_weatherFilePOA[0][idx] = (ssc_number_t)wf.poa;
-						Irradiance->p_weatherFileDNI[idx] = (ssc_number_t)wf.dn;
-						Irradiance->p_weatherFileGHI[idx] = (ssc_number_t)(wf.gh);
-						Irradiance->p_weatherFileDHI[idx] = (ssc_number_t)(wf.df);
-
-						// calculate beam if global & diffuse are selected as inputs
-						if (radmode == Irradiance_IO::GH_DF)
-						{
-							Irradiance->p_IrradianceCalculated[2][idx] = (ssc_number_t)((wf.gh - wf.df) / cos(solzen*3.1415926 / 180));
-							if (Irradiance->p_IrradianceCalculated[2][idx] < -1)
-							{
-								log(util::format("SAM calculated negative direct normal irradiance %lg W/m2 at time [y:%d m:%d d:%d h:%d], set to zero.",
-									Irradiance->p_IrradianceCalculated[2][idx], wf.year, wf.month, wf.day, wf.hour), SSC_WARNING, (float)idx);
-								Irradiance->p_IrradianceCalculated[2][idx] = 0;
-							}
-						}
+				// update cell temperature - unshaded value per Sara 1/25/16
+				double tcell = wf.tdry;
+				if (sunup > 0)
+				{
+					// calculate cell temperature using selected temperature model
+					pvinput_t in(ibeam, iskydiff, ignddiff, 0, ipoa,
+						wf.tdry, wf.tdew, wf.wspd, wf.wdir, wf.pres,
+						solzen, aoi, hdr.elev,
+						stilt, sazi,
+						((double)wf.hour) + wf.minute / 60.0,
+						radmode, Subarrays[nn]->poa.usePOAFromWF);
+					// voltage set to -1 for max power
+					(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, -1.0, tcell);
+				}
+				double shadedb_str_vmp_stc = Subarrays[nn]->nModulesPerString * Subarrays[nn]->Module->voltageMaxPower;
+				double shadedb_mppt_lo = PVSystem->Inverter->mpptLowVoltage;
+				double shadedb_mppt_hi = PVSystem->Inverter->mpptHiVoltage;
 
-						// calculate global if beam & diffuse are selected as inputs
-						if (radmode == Irradiance_IO::DN_DF)
-						{
-							Irradiance->p_IrradianceCalculated[0][idx] = (ssc_number_t)(wf.df + wf.dn * cos(solzen*3.1415926 / 180));
-							if (Irradiance->p_IrradianceCalculated[0][idx] < -1)
-							{
-								log(util::format("SAM calculated negative global horizontal irradiance %lg W/m2 at time [y:%d m:%d d:%d h:%d], set to zero.",
-									Irradiance->p_IrradianceCalculated[0][idx], wf.year, wf.month, wf.day, wf.hour), SSC_WARNING, (float)idx);
-								Irradiance->p_IrradianceCalculated[0][idx] = 0;
-							}
-						}
+				/// shading database if necessary, which is shared by all subarrays and safe to read concurrently
+				if (!Subarrays[nn]->shadeCalculator.fbeam_shade_db(shadeDatabase, hour, solalt, solazi, jj, step_per_hour, shadedb_gpoa, shadedb_dpoa, tcell, Subarrays[nn]->nModulesPerString, shadedb_str_vmp_stc, shadedb_mppt_lo, shadedb_mppt_hi))
+				{
+					throw exec_error("pvsamv1", util::format("Error calculating shading factor for subarray %d", nn));
+				}
+				if (iyear == 0)
+				{
+#ifdef SHADE_DB_OUTPUTS
+					p_shadedb_gpoa[nn][idx] = (ssc_number_t)shadedb_gpoa;
+					p_shadedb_dpoa[nn][idx] = (ssc_number_t)shadedb_dpoa;
+					p_shadedb_pv_cell_temp[nn][idx] = (ssc_number_t)tcell;
+					p_shadedb_mods_per_str[nn][idx] = (ssc_number_t)Subarrays[nn]->nModulesPerString;
+					p_shadedb_str_vmp_stc[nn][idx] = (ssc_number_t)shadedb_str_vmp_stc;
+					p_shadedb_mppt_lo[nn][idx] = (ssc_number_t)shadedb_mppt_lo;
+					p_shadedb_mppt_hi[nn][idx] = (ssc_number_t)shadedb_mppt_hi;
+					messages.push_back(log_item(SSC_NOTICE, "shade db hour " + util::to_string((int)hour) +"\n" + shadeCalculator->get_warning()));
+#endif
+					// fraction shaded for comparison
+					PVSystem->p_shadeDBShadeFraction[nn][idx] = (ssc_number_t)(Subarrays[nn]->shadeCalculator.dc_shade_factor());
+				}
+			}
+			else
+			{
+				if (!Subarrays[nn]->shadeCalculator.fbeam(hour, solalt, solazi, jj, step_per_hour))
+				{
+					throw exec_error("pvsamv1", util::format("Error calculating shading factor for subarray %d", nn));
+				}
+			}
 
-						// calculate diffuse if total & beam are selected as inputs
-						if (radmode == Irradiance_IO::DN_GH)
-						{
-							Irradiance->p_IrradianceCalculated[1][idx] = (ssc_number_t)(wf.gh - wf.dn * cos(solzen*3.1415926 / 180));
-							if (Irradiance->p_IrradianceCalculated[1][idx] < -1)
-							{
-								log(util::format("SAM calculated negative diffuse horizontal irradiance %lg W/m2 at time [y:%d m:%d d:%d h:%d], set to zero.",
-									Irradiance->p_IrradianceCalculated[1][idx], wf.year, wf.month, wf.day, wf.hour), SSC_WARNING, (float)idx);
-								Irradiance->p_IrradianceCalculated[1][idx] = 0;
-							}
-						}
+			// apply hourly shading factors to beam (if none enabled, factors are 1.0)
+			// shj 3/21/16 - update to handle negative shading loss
+			if (Subarrays[nn]->shadeCalculator.beam_shade_factor() != 1.0){
+				//							if (sa[nn].shad.beam_shade_factor() < 1.0){
+				// Sara 1/25/16 - shading database derate applied to dc only
+				// shading loss applied to beam if not from shading database
+				ibeam *= Subarrays[nn]->shadeCalculator.beam_shade_factor();
+				if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
+					Subarrays[nn]->poa.usePOAFromWF = false;
+					if (Subarrays[nn]->poa.poaShadWarningCount == 0){
+						messages.push_back(log_item(SSC_WARNING, util::format("Combining POA irradiance as input with the beam shading losses at time [y:%d m:%d d:%d h:%d] forces SAM to use a POA decomposition model to calculate incident beam irradiance",
+							wf.year, wf.month, wf.day, wf.hour), (float)idx));
 					}
-
-					// record sub-array plane of array output before computing shading and soiling
-					if (iyear == 0)
-					{
-						if (radmode != Irradiance_IO::POA_R)
-							PVSystem->p_poaNominalFront[nn][idx] = (ssc_number_t)((ibeam + iskydiff + ignddiff));
-						else
-							PVSystem->p_poaNominalFront[nn][idx] = (ssc_number_t)((ipoa));
+					else{
+						messages.push_back(log_item(SSC_NOTICE, util::format("Combining POA irradiance as input with the beam shading losses at time [y:%d m:%d d:%d h:%d] forces SAM to use a POA decomposition model to calculate incident beam irradiance",
+							wf.year, wf.month, wf.day, wf.hour), (float)idx));
 					}
+					Subarrays[nn]->poa.poaShadWarningCount++;
+				}
+			}
 
+			// apply sky diffuse shading factor (specified as constant, nominally 1.0 if disabled in UI)
+			if (Subarrays[nn]->shadeCalculator.fdiff() < 1.0){
+				iskydiff *= Subarrays[nn]->shadeCalculator.fdiff();
+				if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
+					if (idx == 0)
+						messages.push_back(log_item(SSC_WARNING, "Combining POA irradiance as input with the diffuse shading losses forces SAM to use a POA decomposition model to calculate incident diffuse irradiance"));
+					Subarrays[nn]->poa.usePOAFromWF = false;
+				}
+			}
+
+			double beam_shading_factor = Subarrays[nn]->shadeCalculator.beam_shade_factor();
 
-					// record sub-array contribution to total POA power for this time step  (W)
-					if (radmode != Irradiance_IO::POA_R)
-						ts_accum_poa_front_nom += (ibeam + iskydiff + ignddiff) * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+			//self-shading calculations
+			if (((Subarrays[nn]->trackMode == 0 || Subarrays[nn]->trackMode == 4) && (Subarrays[nn]->shadeMode == 1 || Subarrays[nn]->shadeMode == 2)) //fixed tilt or timeseries tilt, self-shading (linear or non-linear) OR
+				|| (Subarrays[nn]->trackMode == 1 && (Subarrays[nn]->shadeMode == 1 || Subarrays[nn]->shadeMode == 2) && Subarrays[nn]->backtrackingEnabled == 0)) //one-axis tracking, self-shading, not backtracking
+			{
+
+				if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
+					if (idx == 0)
+						messages.push_back(log_item(SSC_WARNING, "Combining POA irradiance as input with self shading forces SAM to employ a POA decomposition model to calculate incident beam irradiance"));
+					Subarrays[nn]->poa.usePOAFromWF = false;
+				}
+
+				// info to be passed to self-shading function
+				bool trackbool = (Subarrays[nn]->trackMode == 1);	// 0 for fixed tilt and timeseries tilt, 1 for one-axis
+				bool linear = (Subarrays[nn]->shadeMode == 2); //0 for full self-shading, 1 for linear self-shading
+
+				//geometric fraction of the array that is shaded for one-axis trackers.
+				//USES A DIFFERENT FUNCTION THAN THE SELF-SHADING BECAUSE SS IS MEANT FOR FIXED ONLY. shadeFraction1x IS FOR ONE-AXIS TRACKERS ONLY.
+				//used in the non-linear self-shading calculator for one-axis tracking only
+				double shad1xf = 0, tabulated[2];
+				if (trackbool)
+				{
+					if (Subarrays[nn]->selfShadingTable.lookup(solazi, solzen, tabulated))
+						shad1xf = tabulated[0];
 					else
-						ts_accum_poa_front_nom += (ipoa)* ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+						shad1xf = shadeFraction1x(solazi, solzen, Subarrays[nn]->tiltDegrees, Subarrays[nn]->azimuthDegrees, Subarrays[nn]->groundCoverageRatio, rot);
+				}
 
-					// record sub-array contribution to total POA beam power for this time step (W)
-					ts_accum_poa_front_beam_nom += ibeam * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+				//execute self-shading calculations
+				ssc_number_t beam_to_use; //some self-shading calculations require DNI, NOT ibeam (beam in POA). Need to know whether to use DNI from wf or calculated, depending on radmode
+				if (radmode == Irradiance_IO::DN_DF || radmode == Irradiance_IO::DN_GH) beam_to_use = (ssc_number_t)wf.dn;
+				else if (iyear == 0) beam_to_use = dnTopOfHour; // top of hour, as calculated for this subarray
+				else beam_to_use = Irradiance->p_IrradianceCalculated[2][hour * step_per_hour]; // top of hour in first year
 
-					// for non-linear shading from shading database
-					if (Subarrays[nn]->shadeCalculator.use_shade_db())
+				if (linear && trackbool) //one-axis linear
+				{
+					ibeam *= (1 - shad1xf); //derate beam irradiance linearly by the geometric shading fraction calculated above per Chris Deline 2/10/16
+					beam_shading_factor *= (1 - shad1xf);
+					if (iyear == 0)
 					{
-						double shadedb_gpoa = ibeam + iskydiff + ignddiff;
-						double shadedb_dpoa = iskydiff + ignddiff;
+						PVSystem->p_derateSelfShading[nn][idx] = (ssc_number_t)1;
+						PVSystem->p_derateLinear[nn][idx] = (ssc_number_t)(1 - shad1xf);
+						PVSystem->p_derateSelfShadingDiffuse[nn][idx] = (ssc_number_t)1; //no diffuse derate for linear shading
+						PVSystem->p_derateSelfShadingReflected[nn][idx] = (ssc_number_t)1; //no reflected derate for linear shading
+					}
+				}
 
-						// update cell temperature - unshaded value per Sara 1/25/16
-						double tcell = wf.tdry;
-						if (sunup > 0)
-						{
-							// calculate cell temperature using selected temperature model
-							pvinput_t in(ibeam, iskydiff, ignddiff, 0, ipoa,
-								wf.tdry, wf.tdew, wf.wspd, wf.wdir, wf.pres,
-								solzen, aoi, hdr.elev,
-								stilt, sazi,
-								((double)wf.hour) + wf.minute / 60.0,
-								radmode, Subarrays[nn]->poa.usePOAFromWF);
-							// voltage set to -1 for max power
-							(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, -1.0, tcell);
-						}
-						double shadedb_str_vmp_stc = Subarrays[nn]->nModulesPerString * Subarrays[nn]->Module->voltageMaxPower;
-						double shadedb_mppt_lo = PVSystem->Inverter->mpptLowVoltage;
-						double shadedb_mppt_hi = PVSystem->Inverter->mpptHiVoltage;
-						 
-						/// shading database if necessary
-						if (!Subarrays[nn]->shadeCalculator.fbeam_shade_db(shadeDatabase, hour, solalt, solazi, jj, step_per_hour, shadedb_gpoa, shadedb_dpoa, tcell, Subarrays[nn]->nModulesPerString, shadedb_str_vmp_stc, shadedb_mppt_lo, shadedb_mppt_hi))
-						{
-							throw exec_error("pvsamv1", util::format("Error calculating shading factor for subarray %d", nn));
-						}
+				else if (ss_exec(Subarrays[nn]->selfShadingInputs, stilt, sazi, solzen, solazi, beam_to_use, ibeam, (iskydiff + ignddiff), alb, trackbool, linear, shad1xf, Subarrays[nn]->selfShadingOutputs, &Subarrays[nn]->selfShadingTable))
+				{
+					if (linear) //fixed tilt linear
+					{
+						ibeam *= (1 - Subarrays[nn]->selfShadingOutputs.m_shade_frac_fixed);
+						beam_shading_factor *= (1 - Subarrays[nn]->selfShadingOutputs.m_shade_frac_fixed);
 						if (iyear == 0)
 						{
-#ifdef SHADE_DB_OUTPUTS
-							p_shadedb_gpoa[nn][idx] = (ssc_number_t)shadedb_gpoa;
-							p_shadedb_dpoa[nn][idx] = (ssc_number_t)shadedb_dpoa;
-							p_shadedb_pv_cell_temp[nn][idx] = (ssc_number_t)tcell;
-							p_shadedb_mods_per_str[nn][idx] = (ssc_number_t)Subarrays[nn]->nModulesPerString;
-							p_shadedb_str_vmp_stc[nn][idx] = (ssc_number_t)shadedb_str_vmp_stc;
-							p_shadedb_mppt_lo[nn][idx] = (ssc_number_t)shadedb_mppt_lo;
-							p_shadedb_mppt_hi[nn][idx] = (ssc_number_t)shadedb_mppt_hi;
-							log("shade db hour " + util::to_string((int)hour) +"\n" + shadeCalculator->get_warning());
-#endif
-							// fraction shaded for comparison
-							PVSystem->p_shadeDBShadeFraction[nn][idx] = (ssc_number_t)(Subarrays[nn]->shadeCalculator.dc_shade_factor());
-						} 
+							PVSystem->p_derateSelfShading[nn][idx] = (ssc_number_t)1;
+							PVSystem->p_derateLinear[nn][idx] = (ssc_number_t)(1 - Subarrays[nn]->selfShadingOutputs.m_shade_frac_fixed);
+							PVSystem->p_derateSelfShadingDiffuse[nn][idx] = (ssc_number_t)1; //no diffuse derate for linear shading
+							PVSystem->p_derateSelfShadingReflected[nn][idx] = (ssc_number_t)1; //no reflected derate for linear shading
+						}
 					}
-					else
+					else //non-linear: fixed tilt AND one-axis
 					{
-						if (!Subarrays[nn]->shadeCalculator.fbeam(hour, solalt, solazi, jj, step_per_hour))
+						if (iyear == 0)
 						{
-							throw exec_error("pvsamv1", util::format("Error calculating shading factor for subarray %d", nn));
+							PVSystem->p_derateSelfShadingDiffuse[nn][idx] = (ssc_number_t)Subarrays[nn]->selfShadingOutputs.m_diffuse_derate;
+							PVSystem->p_derateSelfShadingReflected[nn][idx] = (ssc_number_t)Subarrays[nn]->selfShadingOutputs.m_reflected_derate;
+							PVSystem->p_derateSelfShading[nn][idx] = (ssc_number_t)Subarrays[nn]->selfShadingOutputs.m_dc_derate;
+							PVSystem->p_derateLinear[nn][idx] = (ssc_number_t)1;
 						}
-					}
 
-					// apply hourly shading factors to beam (if none enabled, factors are 1.0) 
-					// shj 3/21/16 - update to handle negative shading loss
-					if (Subarrays[nn]->shadeCalculator.beam_shade_factor() != 1.0){
-						//							if (sa[nn].shad.beam_shade_factor() < 1.0){
-						// Sara 1/25/16 - shading database derate applied to dc only
-						// shading loss applied to beam if not from shading database
-						ibeam *= Subarrays[nn]->shadeCalculator.beam_shade_factor();
-						if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
-							Subarrays[nn]->poa.usePOAFromWF = false;
-							if (Subarrays[nn]->poa.poaShadWarningCount == 0){
-								log(util::format("Combining POA irradiance as input with the beam shading losses at time [y:%d m:%d d:%d h:%d] forces SAM to use a POA decomposition model to calculate incident beam irradiance",
-									wf.year, wf.month, wf.day, wf.hour), SSC_WARNING, (float)idx);
-							}
-							else{
-								log(util::format("Combining POA irradiance as input with the beam shading losses at time [y:%d m:%d d:%d h:%d] forces SAM to use a POA decomposition model to calculate incident beam irradiance",
-									wf.year, wf.month, wf.day, wf.hour), SSC_NOTICE, (float)idx);
-							}
-							Subarrays[nn]->poa.poaShadWarningCount++;
-						}
+						// Sky diffuse and ground-reflected diffuse are derated according to C. Deline's algorithm
+						iskydiff *= Subarrays[nn]->selfShadingOutputs.m_diffuse_derate;
+						ignddiff *= Subarrays[nn]->selfShadingOutputs.m_reflected_derate;
+						// Beam is not derated- all beam derate effects (linear and non-linear) are taken into account in the nonlinear_dc_shading_derate
+						Subarrays[nn]->poa.nonlinearDCShadingDerate = Subarrays[nn]->selfShadingOutputs.m_dc_derate;
 					}
+				}
+				else
+					throw exec_error("pvsamv1", util::format("Self-shading calculation failed at %d", (int)idx));
+			}
 
-					// apply sky diffuse shading factor (specified as constant, nominally 1.0 if disabled in UI)
-					if (Subarrays[nn]->shadeCalculator.fdiff() < 1.0){
-						iskydiff *= Subarrays[nn]->shadeCalculator.fdiff();
-						if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
-							if (idx == 0)
-								log("Combining POA irradiance as input with the diffuse shading losses forces SAM to use a POA decomposition model to calculate incident diffuse irradiance", SSC_WARNING);
-							Subarrays[nn]->poa.usePOAFromWF = false;
-						}
-					}
+			double poashad = (radmode == Irradiance_IO::POA_R) ? ipoa : (ibeam + iskydiff + ignddiff);
 
-					double beam_shading_factor = Subarrays[nn]->shadeCalculator.beam_shade_factor();
+			// determine sub-array contribution to total shaded plane of array for this hour
+			ts.poaFrontShaded = poashad * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
 
-					//self-shading calculations
-					if (((Subarrays[nn]->trackMode == 0 || Subarrays[nn]->trackMode == 4) && (Subarrays[nn]->shadeMode == 1 || Subarrays[nn]->shadeMode == 2)) //fixed tilt or timeseries tilt, self-shading (linear or non-linear) OR
-						|| (Subarrays[nn]->trackMode == 1 && (Subarrays[nn]->shadeMode == 1 || Subarrays[nn]->shadeMode == 2) && Subarrays[nn]->backtrackingEnabled == 0)) //one-axis tracking, self-shading, not backtracking
-					{
+			// apply soiling derate to all components of irradiance
+			double soiling_factor = 1.0;
+			int month_idx = wf.month - 1;
+			if (month_idx >= 0 && month_idx < 12)
+			{
+				soiling_factor = Subarrays[nn]->monthlySoiling[month_idx];
+				ibeam *= soiling_factor;
+				iskydiff *= soiling_factor;
+				ignddiff *= soiling_factor;
+				if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
+					ipoa *= soiling_factor;
+					if (soiling_factor < 1 && idx == 0)
+						messages.push_back(log_item(SSC_WARNING, "Soiling may already be accounted for in the input POA data. Please confirm that the input data does not contain soiling effects, or remove the additional losses on the Losses page."));
+				}
+				beam_shading_factor *= soiling_factor;
+			}
 
-						if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
-							if (idx == 0)
-								log("Combining POA irradiance as input with self shading forces SAM to employ a POA decomposition model to calculate incident beam irradiance", SSC_WARNING);
-							Subarrays[nn]->poa.usePOAFromWF = false;
-						}
+			// Calculate total front irradiation after soiling added to shading
+			ipoa_front = ibeam + iskydiff + ignddiff;
+			ts.poaFrontShadedSoiled = ipoa_front * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+
+			// Calculate rear-side irradiance for bifacial modules
+			if (Subarrays[0]->Module->isBifacial)
+			{
+				double slopeLength = Subarrays[nn]->selfShadingInputs.length * Subarrays[nn]->selfShadingInputs.nmody;
+				if (Subarrays[nn]->selfShadingInputs.mod_orient == 1) {
+					slopeLength = Subarrays[nn]->selfShadingInputs.width * Subarrays[nn]->selfShadingInputs.nmody;
+				}
+				irr.calc_rear_side(Subarrays[0]->Module->bifacialTransmissionFactor, Subarrays[0]->Module->bifaciality, Subarrays[0]->Module->groundClearanceHeight, slopeLength);
+				ipoa_rear = irr.get_poa_rear();
+				ipoa_rear_after_losses = ipoa_rear * (1 - Subarrays[nn]->rearIrradianceLossPercent);
+			}
 
-						// info to be passed to self-shading function
-						bool trackbool = (Subarrays[nn]->trackMode == 1);	// 0 for fixed tilt and timeseries tilt, 1 for one-axis
-						bool linear = (Subarrays[nn]->shadeMode == 2); //0 for full self-shading, 1 for linear self-shading
+			ts.poaRear = ipoa_rear * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
 
-						//geometric fraction of the array that is shaded for one-axis trackers.
-						//USES A DIFFERENT FUNCTION THAN THE SELF-SHADING BECAUSE SS IS MEANT FOR FIXED ONLY. shadeFraction1x IS FOR ONE-AXIS TRACKERS ONLY.
-						//used in the non-linear self-shading calculator for one-axis tracking only
-						double shad1xf = 0;
-						if (trackbool)
-							shad1xf = shadeFraction1x(solazi, solzen, Subarrays[nn]->tiltDegrees, Subarrays[nn]->azimuthDegrees, Subarrays[nn]->groundCoverageRatio, rot);
+			if (iyear == 0)
+			{
+				// save sub-array level outputs
+				PVSystem->p_poaShadedFront[nn][idx] = (ssc_number_t)poashad;
+				PVSystem->p_poaShadedSoiledFront[nn][idx] = (ssc_number_t)ipoa_front;
+				PVSystem->p_poaBeamFront[nn][idx] = (ssc_number_t)ibeam;
+				PVSystem->p_poaDiffuseFront[nn][idx] = (ssc_number_t)(iskydiff + ignddiff);
+				PVSystem->p_poaRear[nn][idx] = (ssc_number_t)(ipoa_rear_after_losses);
+				PVSystem->p_beamShadingFactor[nn][idx] = (ssc_number_t)beam_shading_factor;
+				PVSystem->p_axisRotation[nn][idx] = (ssc_number_t)rot;
+				PVSystem->p_idealRotation[nn][idx] = (ssc_number_t)(rot - btd);
+				PVSystem->p_angleOfIncidence[nn][idx] = (ssc_number_t)aoi;
+				PVSystem->p_surfaceTilt[nn][idx] = (ssc_number_t)stilt;
+				PVSystem->p_surfaceAzimuth[nn][idx] = (ssc_number_t)sazi;
+				PVSystem->p_derateSoiling[nn][idx] = (ssc_number_t)soiling_factor;
+			}
 
-						//execute self-shading calculations
-						ssc_number_t beam_to_use; //some self-shading calculations require DNI, NOT ibeam (beam in POA). Need to know whether to use DNI from wf or calculated, depending on radmode
-						if (radmode == Irradiance_IO::DN_DF || radmode == Irradiance_IO::DN_GH) beam_to_use = (ssc_number_t)wf.dn;
-						else beam_to_use = Irradiance->p_IrradianceCalculated[2][hour * step_per_hour]; // top of hour in first year
+			// accumulate incident total radiation (W) in this timestep (all subarrays)
+			ts.poaFrontBeamEffective = ibeam * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+
+			// save the required irradiance inputs on array plane for the module output calculations.
+			Subarrays[nn]->poa.poaBeamFront = ibeam;
+			Subarrays[nn]->poa.poaDiffuseFront = iskydiff;
+			Subarrays[nn]->poa.poaGroundFront = ignddiff;
+			Subarrays[nn]->poa.poaRear = ipoa_rear_after_losses;
+			Subarrays[nn]->poa.poaTotal = (radmode == Irradiance_IO::POA_R) ? ipoa :(ipoa_front + ipoa_rear_after_losses);
+			Subarrays[nn]->poa.angleOfIncidenceDegrees = aoi;
+			Subarrays[nn]->poa.sunUp = sunup;
+			Subarrays[nn]->poa.surfaceTiltDegrees = stilt;
+			Subarrays[nn]->poa.surfaceAzimuthDegrees = sazi;
+
+			ts.solazi = solazi;
+			ts.solzen = solzen;
+			ts.solalt = solalt;
+			ts.sunup = sunup;
+			ts.albedo = alb;
+			ts.ipoa = ipoa;
+			ts.ipoaFront = ipoa_front;
+			ts.ipoaRear = ipoa_rear;
+			ts.ipoaRearAfterLosses = ipoa_rear_after_losses;
+			ts.poaBeamFront = ibeam;
+			ts.poaDiffuseFront = iskydiff;
+			ts.poaGroundFront = ignddiff;
+			ts.poaTotal = Subarrays[nn]->poa.poaTotal;
+			ts.angleOfIncidenceDegrees = aoi;
+			ts.surfaceTiltDegrees = stilt;
+			ts.surfaceAzimuthDegrees = sazi;
+			ts.usePOAFromWF = Subarrays[nn]->poa.usePOAFromWF;
+			ts.nonlinearDCShadingDerate = Subarrays[nn]->poa.nonlinearDCShadingDerate;
+			ts.dcShadeFactor = Subarrays[nn]->shadeCalculator.dc_shade_factor();
+
+			if (precalculateModules)
+				ts.mpptVoltageClipping = moduleOutput(nn, wf, solzen, -1, ts.moduleOut, messages);
+		}
+	};
 
-						if (linear && trackbool) //one-axis linear
-						{
-							ibeam *= (1 - shad1xf); //derate beam irradiance linearly by the geometric shading fraction calculated above per Chris Deline 2/10/16
-							beam_shading_factor *= (1 - shad1xf);
-							if (iyear == 0)
-							{
-								PVSystem->p_derateSelfShading[nn][idx] = (ssc_number_t)1;
-								PVSystem->p_derateLinear[nn][idx] = (ssc_number_t)(1 - shad1xf);
-								PVSystem->p_derateSelfShadingDiffuse[nn][idx] = (ssc_number_t)1; //no diffuse derate for linear shading
-								PVSystem->p_derateSelfShadingReflected[nn][idx] = (ssc_number_t)1; //no reflected derate for linear shading
-							}
-						}
+	// the DC output of later years differs from the first year only by degradation, DC adjustment factors and lifetime
+	// losses, which scale each subarray's net power, so it can be found from the first year without running the module
+	// models again. the inverter and AC losses are still calculated for every year.
+	bool lifetimeFromFirstYear = system_use_lifetime_output && nyears > 1 && as_boolean("system_lifetime_fast");
+	if (lifetimeFromFirstYear && (en_batt || PVSystem->enableSnowModel))
+	{
+		log(util::format("Lifetime DC output cannot be scaled from the first year with %s enabled, every year will be simulated.",
+			en_batt ? "battery storage" : "the snow model"), SSC_WARNING);
+		lifetimeFromFirstYear = false;
+	}
+	std::vector<std::vector<double>> dcPowerNetFirstYear;
+	if (lifetimeFromFirstYear)
+		dcPowerNetFirstYear.resize(num_subarrays, std::vector<double>(nrec, 0.0));
 
-						else if (ss_exec(Subarrays[nn]->selfShadingInputs, stilt, sazi, solzen, solazi, beam_to_use, ibeam, (iskydiff + ignddiff), alb, trackbool, linear, shad1xf, Subarrays[nn]->selfShadingOutputs))
-						{
-							if (linear) //fixed tilt linear
-							{
-								ibeam *= (1 - Subarrays[nn]->selfShadingOutputs.m_shade_frac_fixed);
-								beam_shading_factor *= (1 - Subarrays[nn]->selfShadingOutputs.m_shade_frac_fixed);
-								if (iyear == 0)
-								{
-									PVSystem->p_derateSelfShading[nn][idx] = (ssc_number_t)1;
-									PVSystem->p_derateLinear[nn][idx] = (ssc_number_t)(1 - Subarrays[nn]->selfShadingOutputs.m_shade_frac_fixed);
-									PVSystem->p_derateSelfShadingDiffuse[nn][idx] = (ssc_number_t)1; //no diffuse derate for linear shading
-									PVSystem->p_derateSelfShadingReflected[nn][idx] = (ssc_number_t)1; //no reflected derate for linear shading
-								}
-							}
-							else //non-linear: fixed tilt AND one-axis
-							{
-								if (iyear == 0)
-								{
-									PVSystem->p_derateSelfShadingDiffuse[nn][idx] = (ssc_number_t)Subarrays[nn]->selfShadingOutputs.m_diffuse_derate;
-									PVSystem->p_derateSelfShadingReflected[nn][idx] = (ssc_number_t)Subarrays[nn]->selfShadingOutputs.m_reflected_derate;
-									PVSystem->p_derateSelfShading[nn][idx] = (ssc_number_t)Subarrays[nn]->selfShadingOutputs.m_dc_derate;
-									PVSystem->p_derateLinear[nn][idx] = (ssc_number_t)1;
-								}
+	for (size_t iyear = 0; iyear < nyears; iyear++)
+	{
+		// the weather year repeats, so the snow model can replay the snow cover of an earlier year
+		if (PVSystem->enableSnowModel)
+			for (size_t nn = 0; nn < num_subarrays; nn++)
+				Subarrays[nn]->snowModel.startYear();
 
-								// Sky diffuse and ground-reflected diffuse are derated according to C. Deline's algorithm
-								iskydiff *= Subarrays[nn]->selfShadingOutputs.m_diffuse_derate;
-								ignddiff *= Subarrays[nn]->selfShadingOutputs.m_reflected_derate;
-								// Beam is not derated- all beam derate effects (linear and non-linear) are taken into account in the nonlinear_dc_shading_derate
-								Subarrays[nn]->poa.nonlinearDCShadingDerate = Subarrays[nn]->selfShadingOutputs.m_dc_derate;
-							}
-						}
-						else
-							throw exec_error("pvsamv1", util::format("Self-shading calculation failed at %d", (int)idx));
-					}
+		size_t simulateHours = 8760;
+		if (iyear > 0 && lifetimeFromFirstYear)
+		{
+			simulateHours = 0;
+			size_t firstYearIdx = 0;
+			for (hour = 0; hour < 8760; hour++)
+			{
+				ireport++;
+				if (ireport - ireplast > irepfreq)
+				{
+					percent_complete = percent_baseline + 100.0f *(float)(hour + iyear * 8760) / (float)(insteps);
+					if (!update("", percent_complete))
+						throw exec_error("pvsamv1", "simulation canceled at hour " + util::to_string(hour + 1.0) + " in year " + util::to_string((int)iyear + 1) + "in dc loop");
+					ireplast = ireport;
+				}
 
-					double poashad = (radmode == Irradiance_IO::POA_R) ? ipoa : (ibeam + iskydiff + ignddiff);
+				if (nload == 8760)
+					cur_load = p_load_in[hour];
 
-					// determine sub-array contribution to total shaded plane of array for this hour
-					ts_accum_poa_front_shaded += poashad * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+				for (size_t jj = 0; jj < step_per_hour; jj++)
+				{
+					if (nload == nrec)
+						cur_load = p_load_in[hour*step_per_hour + jj];
+					p_load_full.push_back((ssc_number_t)cur_load);
 
-					// apply soiling derate to all components of irradiance
-					double soiling_factor = 1.0;
-					int month_idx = wf.month - 1;
-					if (month_idx >= 0 && month_idx < 12)
-					{
-						soiling_factor = Subarrays[nn]->monthlySoiling[month_idx];
-						ibeam *= soiling_factor;
-						iskydiff *= soiling_factor;
-						ignddiff *= soiling_factor;
-						if (radmode == Irradiance_IO::POA_R || radmode == Irradiance_IO::POA_P){
-							ipoa *= soiling_factor;
-							if (soiling_factor < 1 && idx == 0)
-								log("Soiling may already be accounted for in the input POA data. Please confirm that the input data does not contain soiling effects, or remove the additional losses on the Losses page.", SSC_WARNING);
-						}
-						beam_shading_factor *= soiling_factor;
-					}
+					for (int mpptInput = 0; mpptInput < PVSystem->Inverter->nMpptInputs; mpptInput++)
+						PVSystem->p_mpptVoltage[mpptInput][idx] = PVSystem->p_mpptVoltage[mpptInput][firstYearIdx];
 
-					// Calculate total front irradiation after soiling added to shading
-					ipoa_front = ibeam + iskydiff + ignddiff;
-					ts_accum_poa_front_shaded_soiled += ipoa_front * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
-					
-					// Calculate rear-side irradiance for bifacial modules
-					if (Subarrays[0]->Module->isBifacial)
+					// same losses in the same order as the simulated years
+					PVSystem->p_systemDCPower[idx] = 0;
+					for (size_t nn = 0; nn < num_subarrays; nn++)
 					{
-						double slopeLength = Subarrays[nn]->selfShadingInputs.length * Subarrays[nn]->selfShadingInputs.nmody;
-						if (Subarrays[nn]->selfShadingInputs.mod_orient == 1) {
-							slopeLength = Subarrays[nn]->selfShadingInputs.width * Subarrays[nn]->selfShadingInputs.nmody;
+						double dcPowerNet = dcPowerNetFirstYear[nn][firstYearIdx];
+						dcPowerNet *= PVSystem->dcDegradationFactor[iyear + 1];
+						dcPowerNet *= dc_haf(hour);
+						if (PVSystem->enableDCLifetimeLosses)
+						{
+							int dc_loss_index = (int)iyear * 365 + (int)floor(hour / 24);
+							dcPowerNet *= (100 - PVSystem->p_dcLifetimeLosses[dc_loss_index]) / 100;
 						}
-						irr.calc_rear_side(Subarrays[0]->Module->bifacialTransmissionFactor, Subarrays[0]->Module->bifaciality, Subarrays[0]->Module->groundClearanceHeight, slopeLength);
-						ipoa_rear = irr.get_poa_rear();
-						ipoa_rear_after_losses = ipoa_rear * (1 - Subarrays[nn]->rearIrradianceLossPercent);
+						PVSystem->p_systemDCPower[idx] += (ssc_number_t)(dcPowerNet * util::watt_to_kilowatt);
+						PVSystem->p_dcPowerNetPerMppt[Subarrays[nn]->mpptInput - 1][idx] += (ssc_number_t)(dcPowerNet);
 					}
+					idx++;
+					firstYearIdx++;
+				}
+			}
+		}
 
-					ts_accum_poa_rear += ipoa_rear * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
-					ts_accum_poa_rear_after_losses = ts_accum_poa_rear * (1 - Subarrays[nn]->rearIrradianceLossPercent);
+		for (size_t blockHour = 0; blockHour < simulateHours; blockHour += blockHours)
+		{
+			size_t nhours = (blockHour + blockHours < 8760) ? blockHours : 8760 - blockHour;
+			size_t nsteps = nhours * step_per_hour;
+			size_t blockIdx = idx;
 
-					if (iyear == 0) 
+			for (hour = blockHour; hour < blockHour + nhours; hour++)
+			{
+				// report progress updates to the caller
+				ireport++;
+				if (ireport - ireplast > irepfreq)
+				{
+					percent_complete = percent_baseline + 100.0f *(float)(hour + iyear * 8760) / (float)(insteps);
+					if (!update("", percent_complete))
+						throw exec_error("pvsamv1", "simulation canceled at hour " + util::to_string(hour + 1.0) + " in year " + util::to_string((int)iyear + 1) + "in dc loop");
+					ireplast = ireport;
+				}
+
+				// only hourly electric load, even
+				// if PV simulation is subhourly.  load is assumed constant over the hour.
+				// if no load profile supplied, load = 0
+				if (nload == 8760)
+					cur_load = p_load_in[hour];
+
+				for (size_t jj = 0; jj < step_per_hour; jj++)
+				{
+					// electric load is subhourly
+					// if no load profile supplied, load = 0
+					if (nload == nrec)
+						cur_load = p_load_in[hour*step_per_hour + jj];
+
+					// log cur_load to check both hourly and sub hourly load data
+					// load data over entrie lifetime period not currently supported.
+					//					log(util::format("year=%d, hour=%d, step per hour=%d, load=%g",
+					//						iyear, hour, jj, cur_load), SSC_WARNING, (float)idx);
+					p_load_full.push_back((ssc_number_t)cur_load);
+
+					size_t k = (hour - blockHour) * step_per_hour + jj;
+					if (!wdprov->read(&blockWeather[k]))
+						throw exec_error("pvsamv1", "could not read data line " + util::to_string((int)(blockIdx + k + 1)) + " in weather file");
+				}
+			}
+			Irradiance->weatherRecord = blockWeather[nsteps - 1];
+
+			// calculate each subarray over the block, the subarrays are divided among the threads
+			auto runSubarrays = [&](size_t ithread)
+			{
+				for (size_t i = ithread; i < activeSubarrays.size(); i += nthreads)
+				{
+					try
 					{
-						// save sub-array level outputs			
-						PVSystem->p_poaShadedFront[nn][idx] = (ssc_number_t)poashad;
-						PVSystem->p_poaShadedSoiledFront[nn][idx] = (ssc_number_t)ipoa_front;
-						PVSystem->p_poaBeamFront[nn][idx] = (ssc_number_t)ibeam;
-						PVSystem->p_poaDiffuseFront[nn][idx] = (ssc_number_t)(iskydiff + ignddiff);
-						PVSystem->p_poaRear[nn][idx] = (ssc_number_t)(ipoa_rear_after_losses);
-						PVSystem->p_beamShadingFactor[nn][idx] = (ssc_number_t)beam_shading_factor;
-						PVSystem->p_axisRotation[nn][idx] = (ssc_number_t)rot;
-						PVSystem->p_idealRotation[nn][idx] = (ssc_number_t)(rot - btd);
-						PVSystem->p_angleOfIncidence[nn][idx] = (ssc_number_t)aoi;
-						PVSystem->p_surfaceTilt[nn][idx] = (ssc_number_t)stilt;
-						PVSystem->p_surfaceAzimuth[nn][idx] = (ssc_number_t)sazi;
-						PVSystem->p_derateSoiling[nn][idx] = (ssc_number_t)soiling_factor;
+						calculateSubarray(activeSubarrays[i], iyear, blockHour, blockIdx, nsteps);
 					}
+					catch (...)
+					{
+						subarrayErrors[activeSubarrays[i]] = std::current_exception();
+					}
+				}
+			};
+			if (nthreads > 1)
+			{
+				std::vector<std::thread> threads;
+				for (size_t i = 0; i < nthreads; i++)
+					threads.push_back(std::thread(runSubarrays, i));
+				for (size_t i = 0; i < threads.size(); i++)
+					threads[i].join();
+			}
+			else
+				runSubarrays(0);
+
+			for (size_t i = 0; i < activeSubarrays.size(); i++)
+			{
+				int nn = activeSubarrays[i];
+				flushMessages(subarrayMessages[nn]);
+				if (subarrayErrors[nn])
+					std::rethrow_exception(subarrayErrors[nn]);
+			}
+
+			for (size_t k = 0; k < nsteps; k++)
+			{
+				hour = blockHour + k / step_per_hour;
+				const weather_record &wf = blockWeather[k];
+
+				// Reset dcPower calculation for new timestep
+				dcPowerNetTotalSystem = 0;
+
+				double solazi = 0, solzen = 0, solalt = 0, alb = 0;
+				int sunup = 0;
+				if (lastSubarray >= 0)
+				{
+					const subarray_timestep &ts = blockSubarrays[lastSubarray][k];
+					solazi = ts.solazi;
+					solzen = ts.solzen;
+					solalt = ts.solalt;
+					sunup = ts.sunup;
+					alb = ts.albedo;
+				}
+
+				// accumulators for radiation power (W) over this
+				// timestep from each subarray
+				double ts_accum_poa_front_nom = 0.0;
+				double ts_accum_poa_front_beam_nom = 0.0;
+				double ts_accum_poa_front_shaded = 0.0;
+				double ts_accum_poa_front_shaded_soiled = 0.0;
+				double ts_accum_poa_front_total = 0.0;
+				double ts_accum_poa_rear = 0.0;
+				double ts_accum_poa_rear_after_losses = 0.0;
+				double ts_accum_poa_total_eff = 0.0;
+				double ts_accum_poa_front_beam_eff = 0.0;
 
-					// accumulate incident total radiation (W) in this timestep (all subarrays)
-					ts_accum_poa_front_beam_eff += ibeam * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
-
-					// save the required irradiance inputs on array plane for the module output calculations.
-					Subarrays[nn]->poa.poaBeamFront = ibeam;
-					Subarrays[nn]->poa.poaDiffuseFront = iskydiff;
-					Subarrays[nn]->poa.poaGroundFront = ignddiff;
-					Subarrays[nn]->poa.poaRear = ipoa_rear_after_losses;
-					Subarrays[nn]->poa.poaTotal = (radmode == Irradiance_IO::POA_R) ? ipoa :(ipoa_front + ipoa_rear_after_losses);
-					Subarrays[nn]->poa.angleOfIncidenceDegrees = aoi;
-					Subarrays[nn]->poa.sunUp = sunup;
-					Subarrays[nn]->poa.surfaceTiltDegrees = stilt;
-					Subarrays[nn]->poa.surfaceAzimuthDegrees = sazi;
+				// restore the plane-of-array irradiance calculated for each subarray at this time step
+				for (size_t i = 0; i < activeSubarrays.size(); i++)
+				{
+					int nn = activeSubarrays[i];
+					const subarray_timestep &ts = blockSubarrays[nn][k];
+
+					ts_accum_poa_front_nom += ts.poaFrontNominal;
+					ts_accum_poa_front_beam_nom += ts.poaFrontBeamNominal;
+					ts_accum_poa_front_shaded += ts.poaFrontShaded;
+					ts_accum_poa_front_shaded_soiled += ts.poaFrontShadedSoiled;
+					ts_accum_poa_rear += ts.poaRear;
+					ts_accum_poa_rear_after_losses = ts_accum_poa_rear * (1 - Subarrays[nn]->rearIrradianceLossPercent);
+					ts_accum_poa_front_beam_eff += ts.poaFrontBeamEffective;
+
+					Subarrays[nn]->poa.poaBeamFront = ts.poaBeamFront;
+					Subarrays[nn]->poa.poaDiffuseFront = ts.poaDiffuseFront;
+					Subarrays[nn]->poa.poaGroundFront = ts.poaGroundFront;
+					Subarrays[nn]->poa.poaRear = ts.ipoaRearAfterLosses;
+					Subarrays[nn]->poa.poaTotal = ts.poaTotal;
+					Subarrays[nn]->poa.angleOfIncidenceDegrees = ts.angleOfIncidenceDegrees;
+					Subarrays[nn]->poa.sunUp = ts.sunup != 0;
+					Subarrays[nn]->poa.surfaceTiltDegrees = ts.surfaceTiltDegrees;
+					Subarrays[nn]->poa.surfaceAzimuthDegrees = ts.surfaceAzimuthDegrees;
+					Subarrays[nn]->poa.usePOAFromWF = ts.usePOAFromWF;
+					Subarrays[nn]->poa.nonlinearDCShadingDerate = ts.nonlinearDCShadingDerate;
 				}
 
 				std::vector<double> mpptVoltageClipping; //a vector to store power that is clipped due to the inverter MPPT low & high voltage limits for each subarray
 				for (int nn = 0; nn < PVSystem->numberOfSubarrays; nn++)
 					mpptVoltageClipping.push_back(0.0);
 
+				// string voltage of each subarray at this time step, the output array only holds the first year
+				std::vector<ssc_number_t> dcStringVoltage(num_subarrays, 0);
+
 				//Calculate power of each MPPT input
 				for (int mpptInput = 0; mpptInput < PVSystem->Inverter->nMpptInputs; mpptInput++) //remember that actual named mppt inputs are 1-indexed, and these are 0-indexed
 				{
@@ -1678,7 +2021,7 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 					//mismatch calculations assume that the inverter MPPT operates all strings on that MPPT input at the same voltage.
 					//this algorithm sweeps across a range of string voltages, calculating total power for all strings on this MPPT input at each voltage.
 					//it finds the maximum total power of all string voltages swept, then uses that in subsequent power calculations for each subarray. 
-					if (PVSystem->enableMismatchVoltageCalc)
+					if (PVSystem->enableMismatchVoltageCalc && sunup > 0) // no power to sweep at night
 					{
 						double vmax = PVSystem->Inverter->mpptHiVoltage; //the upper MPPT range of the inverter is the high end for string voltages that it will control
 						double vmin = PVSystem->Inverter->mpptLowVoltage; //the lower MPPT range of the inverter is the low end for string voltages that it will control
@@ -1734,66 +2077,18 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 					for (int nSubarray = 0; nSubarray < nSubarraysOnMpptInput; nSubarray++) //sweep across all subarrays connected to this MPPT input
 					{
 						int nn = SubarraysOnMpptInput[nSubarray]; //get the index of the subarray we're checking here
-						//initalize pvinput and pvoutput structures for the model
-						pvinput_t in(Subarrays[nn]->poa.poaBeamFront, Subarrays[nn]->poa.poaDiffuseFront, Subarrays[nn]->poa.poaGroundFront, Subarrays[nn]->poa.poaRear, Subarrays[nn]->poa.poaTotal,
-							wf.tdry, wf.tdew, wf.wspd, wf.wdir, wf.pres,
-							solzen, Subarrays[nn]->poa.angleOfIncidenceDegrees, hdr.elev,
-							Subarrays[nn]->poa.surfaceTiltDegrees, Subarrays[nn]->poa.surfaceAzimuthDegrees,
-							((double)wf.hour) + wf.minute / 60.0,
-							radmode, Subarrays[nn]->poa.usePOAFromWF);
-						pvoutput_t out(0, 0, 0, 0, 0, 0, 0, 0);
-
-						double tcell = wf.tdry;
-						if (Subarrays[nn]->poa.sunUp)
+						pvoutput_t out;
+						if (precalculateModules && blockSubarrays[nn].size() > 0)
 						{
-							//module voltage value to be passed into module power function. 
-							//if -1 is passed in, power will be calculated at max power point. 
-							//if a voltage value is passed in, power will be calculated at the specified voltage for all single-diode module models
-							double module_voltage = -1;
-							if (stringVoltage != -1) module_voltage = stringVoltage / Subarrays[nn]->nModulesPerString;
-							// calculate cell temperature using selected temperature model
-							// calculate module power output using conversion model previously specified
-							(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, module_voltage, tcell);
-							(*Subarrays[nn]->Module->moduleModel)(in, tcell, module_voltage, out);
-
-							if (iyear == 0) mpptVoltageClipping[nn] = out.Power; //initialize the voltage clipping loss with the power at module MPP, subtract from this later for the actual MPPT clipping loss
-
-							// if mismatch is enabled, the voltage already was clipped to the inverter MPPT range as needed
-							// if mismatch isn't enabled, need to check the voltage at the module's MPP against the inverter MPPT voltage range
-							// if the module voltage is outside the inverter range, recalculate module power using the inverter voltage limit
-							if (!PVSystem->enableMismatchVoltageCalc && PVSystem->clipMpptWindow)
-							{
-								double voltageMpptLow1Module = PVSystem->Inverter->mpptLowVoltage / Subarrays[nn]->nModulesPerString;
-								double voltageMpptHi1Module = PVSystem->Inverter->mpptHiVoltage / Subarrays[nn]->nModulesPerString;
-								if (out.Voltage < voltageMpptLow1Module)
-								{
-									module_voltage = voltageMpptLow1Module;
-									(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, module_voltage, tcell);
-									(*Subarrays[nn]->Module->moduleModel)(in, tcell, module_voltage, out);
-								}
-								else if (out.Voltage > voltageMpptHi1Module)
-								{
-									module_voltage = voltageMpptHi1Module;
-									(*Subarrays[nn]->Module->cellTempModel)(in, *Subarrays[nn]->Module->moduleModel, module_voltage, tcell);
-									(*Subarrays[nn]->Module->moduleModel)(in, tcell, module_voltage, out);
-								}
-							}
-							if (iyear == 0)	mpptVoltageClipping[nn] -= out.Power; //subtract the power that remains after voltage clipping in order to get the total loss. if no power was lost, all the power will be subtracted away again.
+							out = blockSubarrays[nn][k].moduleOut;
+							if (iyear == 0) mpptVoltageClipping[nn] = blockSubarrays[nn][k].mpptVoltageClipping;
 						}
-
-						//check for weird results
-						if (out.Voltage > Subarrays[nn]->Module->moduleModel->VocRef()*1.3)
-							log(util::format("Module voltage is unrealistically high (exceeds 1.3*VocRef) at [mdhm: %d %d %d %lg]: %lg V\n", wf.month, wf.day, wf.hour, wf.minute, out.Voltage), SSC_NOTICE);
-						if (!std::isfinite(out.Power))
+						else
 						{
-							out.Power = 0;
-							out.Voltage = 0;
-							out.Current = 0;
-							out.Efficiency = 0;
-							out.CellTemp = tcell;
-							log(util::format("Non-finite power output calculated at [mdhm: %d %d %d %lg], set to zero.\n"
-								"could be due to anomolous equation behavior at very low irradiances (poa: %lg W/m2)",
-								wf.month, wf.day, wf.hour, wf.minute, Subarrays[nn]->poa.poaTotal), SSC_NOTICE);
+							std::vector<log_item> messages;
+							double clipping = moduleOutput(nn, wf, solzen, stringVoltage, out, messages);
+							if (iyear == 0) mpptVoltageClipping[nn] = clipping;
+							flushMessages(messages);
 						}
 
 						// save DC module outputs for this subarray
@@ -1806,20 +2101,22 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 						Subarrays[nn]->Module->angleOfIncidenceModifier = out.AOIModifier;
 
 						// Output front-side irradiance after the cover- needs to be after the module model for now because cover effects are part of the module model
-						if (iyear == 0)
+						if (iyear == 0 && blockSubarrays[nn].size() > 0)
 						{
-							ipoa_front *= out.AOIModifier;
-							PVSystem->p_poaFront[nn][idx] = (radmode == Irradiance_IO::POA_R) ? (ssc_number_t)ipoa : (ssc_number_t)(ipoa_front);
-							PVSystem->p_poaTotal[nn][idx] = (radmode == Irradiance_IO::POA_R) ? (ssc_number_t)ipoa : (ssc_number_t)(ipoa_front + ipoa_rear);
+							const subarray_timestep &ts = blockSubarrays[nn][k];
+							double ipoa_front = ts.ipoaFront * out.AOIModifier;
+							PVSystem->p_poaFront[nn][idx] = (radmode == Irradiance_IO::POA_R) ? (ssc_number_t)ts.ipoa : (ssc_number_t)(ipoa_front);
+							PVSystem->p_poaTotal[nn][idx] = (radmode == Irradiance_IO::POA_R) ? (ssc_number_t)ts.ipoa : (ssc_number_t)(ipoa_front + ts.ipoaRear);
 
 							ts_accum_poa_front_total += ipoa_front * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
-							ts_accum_poa_total_eff += ((radmode == Irradiance_IO::POA_R) ? ipoa : (ipoa_front + ipoa_rear_after_losses)) * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
+							ts_accum_poa_total_eff += ((radmode == Irradiance_IO::POA_R) ? ts.ipoa : (ipoa_front + ts.ipoaRearAfterLosses)) * ref_area_m2 * Subarrays[nn]->nModulesPerString * Subarrays[nn]->nStrings;
 						}
 
 						//assign final string voltage output
+						dcStringVoltage[nn] = (ssc_number_t)Subarrays[nn]->Module->dcVoltage * Subarrays[nn]->nModulesPerString;
 						if (iyear == 0)
 						{
-							PVSystem->p_dcStringVoltage[nn][idx] = (ssc_number_t)Subarrays[nn]->Module->dcVoltage * Subarrays[nn]->nModulesPerString;
+							PVSystem->p_dcStringVoltage[nn][idx] = dcStringVoltage[nn];
 						}
 
 					}
@@ -1828,7 +2125,7 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 					//if only one subarray, the voltage at the MPPT input is the same as the string voltage of that subarray (the first and only subarray on the MPPT input)
 					//alternatively, if mismatch was enabled, the string voltage is the same for all subarrays, so the voltage at the MPPT input is the same as the string voltage of any subarray
 					if (SubarraysOnMpptInput.size() == 1 || PVSystem->enableMismatchVoltageCalc)
-						PVSystem->p_mpptVoltage[mpptInput][idx] = (ssc_number_t)PVSystem->p_dcStringVoltage[SubarraysOnMpptInput[0]][idx];
+						PVSystem->p_mpptVoltage[mpptInput][idx] = dcStringVoltage[SubarraysOnMpptInput[0]];
 					//if mismatch wasn't enabled and there are more than one subarray on this MPPT input, we assume the MPPT input voltage is a weighted average of the string voltages
 					else
 					{
@@ -1839,7 +2136,7 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 						{
 							int nn = SubarraysOnMpptInput[nSubarray]; //get the index of the subarray itself
 							nStrings += Subarrays[nn]->nStrings;
-							totalVoltage += PVSystem->p_dcStringVoltage[nn][idx] * Subarrays[nn]->nStrings;
+							totalVoltage += dcStringVoltage[nn] * Subarrays[nn]->nStrings;
 						}
 						PVSystem->p_mpptVoltage[mpptInput][idx] = (ssc_number_t)(totalVoltage / nStrings);
 					}
@@ -1858,7 +2155,7 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 
 					// Sara 1/25/16 - shading database derate applied to dc only
 					// shading loss applied to beam if not from shading database
-					Subarrays[nn]->Module->dcPowerW *= Subarrays[nn]->shadeCalculator.dc_shade_factor();
+					Subarrays[nn]->Module->dcPowerW *= (blockSubarrays[nn].size() > 0) ? blockSubarrays[nn][k].dcShadeFactor : Subarrays[nn]->shadeCalculator.dc_shade_factor();
 
 					// Calculate and apply snow coverage losses if activated
 					if (PVSystem->enableSnowModel)
@@ -1909,6 +2206,8 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 
 					// apply pre-inverter power derate
 					dcPowerNetPerSubarray[nn] = Subarrays[nn]->dcPowerSubarray * (1 - Subarrays[nn]->dcLossTotalPercent);
+					if (lifetimeFromFirstYear && iyear == 0)
+						dcPowerNetFirstYear[nn][idx] = dcPowerNetPerSubarray[nn];
 
 					//module degradation and lifetime DC losses apply to all subarrays
 					if (system_use_lifetime_output == 1)
@@ -2013,9 +2312,57 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 
 	double annual_dc_loss_ond = 0, annual_ac_loss_ond = 0; // (TR)
 
+	// without a DC-connected battery the inverter input is known for the whole year, so the inverter is run one year at a time
+	bool inverterPerYear = !(en_batt && (batt_topology == ChargeController::DC_CONNECTED));
+	size_t stepsPerYear = 8760 * step_per_hour;
+	std::vector<double> ambientTPerYear(stepsPerYear);
+	std::vector<double> dcPowerPerYear_kW, dcVoltagePerYear;
+	std::vector<std::vector<double>> dcPowerNetPerMpptPerYear_kW, dcVoltagePerMpptPerYear;
+	SharedInverter::Series inverterPerStep;
+	inverterPerStep.resize(stepsPerYear);
 
 	for (size_t iyear = 0; iyear < nyears; iyear++)
 	{
+		size_t yearIdx = idx;
+		for (size_t k = 0; k < stepsPerYear; k++)
+		{
+			wdprov->read(&Irradiance->weatherRecord);
+			ambientTPerYear[k] = Irradiance->weatherRecord.tdry;
+		}
+
+		if (inverterPerYear)
+		{
+			if (PVSystem->Inverter->inverterType == INVERTER_PVYIELD) //PVyield inverter model not currently enabled for multiple MPPT
+			{
+				dcPowerPerYear_kW.resize(stepsPerYear);
+				dcVoltagePerYear.resize(stepsPerYear);
+				for (size_t k = 0; k < stepsPerYear; k++)
+				{
+					dcPowerPerYear_kW[k] = PVSystem->p_systemDCPower[yearIdx + k];
+					dcVoltagePerYear[k] = PVSystem->p_mpptVoltage[0][yearIdx + k];
+				}
+				sharedInverter->calculateACPower(dcPowerPerYear_kW, dcVoltagePerYear, ambientTPerYear, inverterPerStep);
+			}
+			else
+			{
+				// inverter: runs at all hours of the day, even if no DC power.  important
+				// for capturing tare losses
+				dcPowerNetPerMpptPerYear_kW.resize(PVSystem->Inverter->nMpptInputs);
+				dcVoltagePerMpptPerYear.resize(PVSystem->Inverter->nMpptInputs);
+				for (int m = 0; m < PVSystem->Inverter->nMpptInputs; m++)
+				{
+					dcPowerNetPerMpptPerYear_kW[m].resize(stepsPerYear);
+					dcVoltagePerMpptPerYear[m].resize(stepsPerYear);
+					for (size_t k = 0; k < stepsPerYear; k++)
+					{
+						dcPowerNetPerMpptPerYear_kW[m][k] = PVSystem->p_dcPowerNetPerMppt[m][yearIdx + k] * util::watt_to_kilowatt;
+						dcVoltagePerMpptPerYear[m][k] = PVSystem->p_mpptVoltage[m][yearIdx + k];
+					}
+				}
+				sharedInverter->calculateACPower(dcPowerNetPerMpptPerYear_kW, dcVoltagePerMpptPerYear, ambientTPerYear, inverterPerStep);
+			}
+		}
+
 		for (hour = 0; hour < 8760; hour++)
 		{
 			// report progress updates to the caller	
@@ -2031,6 +2378,7 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 			for (size_t jj = 0; jj < step_per_hour; jj++)
 			{
 				double dcPower_kW = PVSystem->p_systemDCPower[idx];
+				size_t k = idx - yearIdx;
 
 				// Battery replacement
 				if (en_batt && (batt_topology == ChargeController::DC_CONNECTED))
@@ -2041,38 +2389,23 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 
 				double acpwr_gross = 0, ac_wiringloss = 0, transmissionloss = 0;
 				cur_load = p_load_full[idx];
-				wdprov->read(&Irradiance->weatherRecord);
-				weather_record wf = Irradiance->weatherRecord;
-
-				//set DC voltages for use in AC power calculation
-				for (int m = 0; m < PVSystem->Inverter->nMpptInputs; m++)
-				{
-					dcVoltagePerMppt[m] = PVSystem->p_mpptVoltage[m][idx];
-					dcPowerNetPerMppt_kW[m] = PVSystem->p_dcPowerNetPerMppt[m][idx] * util::watt_to_kilowatt;
-				}
 
 				//run AC power calculation
-				if (en_batt && (batt_topology == ChargeController::DC_CONNECTED)) // DC-connected battery
+				if (!inverterPerYear) // DC-connected battery
 				{
+					//DC batteries not allowed with multiple MPPT, so can just use MPPT 1's voltage
+					double dcVoltage = PVSystem->p_mpptVoltage[0][idx];
+
 					// Compute PV clipping before adding battery
-					sharedInverter->calculateACPower(dcPower_kW, dcVoltagePerMppt[0], wf.tdry); //DC batteries not allowed with multiple MPPT, so can just use MPPT 1's voltage
+					sharedInverter->calculateACPower(dcPower_kW, dcVoltage, ambientTPerYear[k]);
 
 					// Run PV plus battery through sharedInverter, returns AC power
-					batt.advance(*this, dcPower_kW, dcVoltagePerMppt[0], cur_load, sharedInverter->powerClipLoss_kW);
+					batt.advance(*this, dcPower_kW, dcVoltage, cur_load, sharedInverter->powerClipLoss_kW);
+					sharedInverter->saveToSeries(inverterPerStep, k);
 					acpwr_gross = batt.outGenPower[idx];
 				}
-				else if (PVSystem->Inverter->inverterType == INVERTER_PVYIELD) //PVyield inverter model not currently enabled for multiple MPPT
-				{
-					sharedInverter->calculateACPower(dcPower_kW, dcVoltagePerMppt[0], wf.tdry);
-					acpwr_gross = sharedInverter->powerAC_kW;
-				}
 				else
-				{
-					// inverter: runs at all hours of the day, even if no DC power.  important
-					// for capturing tare losses
-					sharedInverter->calculateACPower(dcPowerNetPerMppt_kW, dcVoltagePerMppt, wf.tdry);
-					acpwr_gross = sharedInverter->powerAC_kW;
-				}		
+					acpwr_gross = inverterPerStep.powerAC_kW[k];
 				
 				ac_wiringloss = fabs(acpwr_gross) * PVSystem->acLossPercent * 0.01;
 				transmissionloss = fabs(acpwr_gross) * PVSystem->transmissionLossPercent * 0.01;
@@ -2082,19 +2415,19 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 				{ 
 					annual_ac_gross += acpwr_gross * ts_hour;
 
-					annual_dc_loss_ond += sharedInverter->dcWiringLoss_ond_kW * ts_hour; // (TR)
-					annual_ac_loss_ond += sharedInverter->dcWiringLoss_ond_kW *  ts_hour; // (TR)
+					annual_dc_loss_ond += inverterPerStep.dcWiringLoss_ond_kW[k] * ts_hour; // (TR)
+					annual_ac_loss_ond += inverterPerStep.dcWiringLoss_ond_kW[k] *  ts_hour; // (TR)
 
-					PVSystem->p_inverterEfficiency[idx] = (ssc_number_t)(sharedInverter->efficiencyAC);
-					PVSystem->p_inverterClipLoss[idx] = (ssc_number_t)(sharedInverter->powerClipLoss_kW);
-					PVSystem->p_inverterPowerConsumptionLoss[idx] = (ssc_number_t)(sharedInverter->powerConsumptionLoss_kW);
-					PVSystem->p_inverterNightTimeLoss[idx] = (ssc_number_t)(sharedInverter->powerNightLoss_kW);
-					PVSystem->p_inverterThermalLoss[idx] = (ssc_number_t)(sharedInverter->powerTempLoss_kW);
+					PVSystem->p_inverterEfficiency[idx] = (ssc_number_t)(inverterPerStep.efficiencyAC[k]);
+					PVSystem->p_inverterClipLoss[idx] = (ssc_number_t)(inverterPerStep.powerClipLoss_kW[k]);
+					PVSystem->p_inverterPowerConsumptionLoss[idx] = (ssc_number_t)(inverterPerStep.powerConsumptionLoss_kW[k]);
+					PVSystem->p_inverterNightTimeLoss[idx] = (ssc_number_t)(inverterPerStep.powerNightLoss_kW[k]);
+					PVSystem->p_inverterThermalLoss[idx] = (ssc_number_t)(inverterPerStep.powerTempLoss_kW[k]);
 					PVSystem->p_acWiringLoss[idx] = (ssc_number_t)(ac_wiringloss);
 					PVSystem->p_transmissionLoss[idx] = (ssc_number_t)(transmissionloss);
-					PVSystem->p_inverterTotalLoss[idx] = (ssc_number_t)(sharedInverter->powerLossTotal_kW);
+					PVSystem->p_inverterTotalLoss[idx] = (ssc_number_t)(inverterPerStep.powerLossTotal_kW[k]);
 				}
-				PVSystem->p_systemDCPower[idx] = (ssc_number_t)(sharedInverter->powerDC_kW);
+				PVSystem->p_systemDCPower[idx] = (ssc_number_t)(inverterPerStep.powerDC_kW[k]);
 
 				//ac losses should always be subtracted, this means you can't just multiply by the derate because at nighttime it will add power
 				PVSystem->p_systemACPower[idx] = (ssc_number_t)(acpwr_gross - ac_wiringloss);
@@ -2207,6 +2540,10 @@ void cm_pvsamv1::exec( ) throw (compute_module::general_error)
 		} 
 
 	} 
+
+	// all timeseries outputs are written, move them from the output blocks to the compute module
+	IOManager->flushOutputs(this);
+
 	// Check the snow models and if neccessary report a warning
 	//  *This only needs to be done for subarray1 since all of the activated subarrays should 
 	//   have the same number of bad values
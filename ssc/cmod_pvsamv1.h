@@ -96,6 +96,9 @@ public:
 	//! Setup the Nominal Operating Cell Temperature (NOCT) model
 	void setup_noct_model(const std::string &prefix, noct_celltemp_t &noct_tc);
 	
+	//! Assign the module and inverter parameters named in a component library
+	void prepare_inputs() throw (compute_module::general_error);
+
 	//! Run the PV model
 	void exec() throw (compute_module::general_error);
 	
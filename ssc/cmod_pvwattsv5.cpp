@@ -137,226 +137,70 @@ static var_info _cm_vtab_pvwattsv5_part2[] = {
 class cm_pvwattsv5_base : public compute_module
 {
 protected:
-	double dc_nameplate, dc_ac_ratio, ac_nameplate, inv_eff_percent;
-	double loss_percent, tilt, azimuth, gamma;
-	bool use_ar_glass;
-	int module_type;
-	int track_mode;
-	double inoct;
-	int shade_mode_1x;
-	int array_type;
-	double gcr;
-
-	
-	double ibeam, iskydiff, ignddiff;
-	double solazi, solzen, solalt, aoi, stilt, sazi, rot, btd;
-	int sunup;		
-
-	pvwatts_celltemp *tccalc;
-
-	double poa, tpoa, pvt, dc, ac;
+	pvwatts5_system sys;
 
 public:
-	cm_pvwattsv5_base() {
-		tccalc = 0;
-		dc_nameplate = dc_ac_ratio = ac_nameplate = inv_eff_percent = std::numeric_limits<double>::quiet_NaN();
-		loss_percent = tilt = azimuth = gamma = std::numeric_limits<double>::quiet_NaN();
-		use_ar_glass = false;
-		module_type = track_mode = array_type = shade_mode_1x = -999;
-		inoct = gcr = std::numeric_limits<double>::quiet_NaN();
-
-		ibeam = iskydiff = ignddiff = std::numeric_limits<double>::quiet_NaN();
-		solazi = solzen = solalt = aoi = stilt = sazi = rot = btd = std::numeric_limits<double>::quiet_NaN();
-		sunup = 0;
-
-		poa = tpoa = pvt = dc = ac = std::numeric_limits<double>::quiet_NaN();
-	}
-
-	virtual ~cm_pvwattsv5_base()
-	{
-		if ( tccalc ) delete tccalc;
-	}
-
 	void setup_system_inputs()
 	{
-		dc_nameplate = as_double("system_capacity")*1000;
-		dc_ac_ratio = as_double("dc_ac_ratio");
-		ac_nameplate = dc_nameplate / dc_ac_ratio;
-		inv_eff_percent = as_double("inv_eff");
-		
-		loss_percent = as_double("losses");        
-		tilt = as_double("tilt");
-		azimuth = as_double("azimuth");
+		sys.setup( as_double("system_capacity"), as_double("dc_ac_ratio"), as_double("inv_eff"), as_double("losses"),
+			as_double("tilt"), as_double("azimuth"), as_integer("module_type"), as_integer("array_type"), 0.4 );
 
-		gamma = 0;
-		use_ar_glass = false;
-
-		module_type = as_integer("module_type");
-		switch( module_type )
-		{
-		case 0: // standard module
-			gamma = -0.0047; use_ar_glass = false; break;
-		case 1: // premium module
-			gamma = -0.0035; use_ar_glass = true; break;
-		case 2: // thin film module
-			gamma = -0.0020; use_ar_glass = false; break;
-		}
-
-		track_mode =  0;
-		inoct = 45;
-		shade_mode_1x = 0; // self shaded
-		
-		array_type = as_integer("array_type"); // 0, 1, 2, 3, 4		
-		switch( array_type )
-		{
-		case 0: // fixed open rack
-			track_mode = 0; inoct = 45; shade_mode_1x = 0; break;
-		case 1: // fixed roof mount
-			track_mode = 0; inoct = 49; shade_mode_1x = 0; break;
-		case 2: // 1 axis self-shaded
-			track_mode = 1; inoct = 45; shade_mode_1x = 0; break;
-		case 3: // 1 axis backtracked
-			track_mode = 1; inoct = 45; shade_mode_1x = 1; break;
-		case 4: // 2 axis
-			track_mode = 2; inoct = 45; shade_mode_1x = 0; break;
-		case 5: // azimuth axis
-			track_mode = 3; inoct = 45; shade_mode_1x = 0; break;
-		}
-
-		
-		gcr = 0.4;
-		if ( track_mode == 1 && is_assigned("gcr") ) gcr = as_double("gcr");
+		if ( sys.track_mode == 1 && is_assigned("gcr") ) sys.gcr = as_double("gcr");
 	}
 
-	void initialize_cell_temp( double ts_hour, double last_tcell = -9999, double last_poa = -9999 )
+	weather_data_provider *open_weather( const char *cmname )
 	{
-		tccalc = new pvwatts_celltemp ( inoct+273.15, PVWATTS_HEIGHT, ts_hour );
-		if ( last_tcell > -99 && last_poa >= 0 )
-			tccalc->set_last_values( last_tcell, last_poa );
+		if ( is_assigned( "solar_resource_file" ) )
+		{
+			const char *file = as_string("solar_resource_file");
+			std::unique_ptr<weatherfile> wfile( new weatherfile( file ) );
+			if (!wfile->ok()) throw exec_error(cmname, wfile->message());
+			if( wfile->has_message() ) log( wfile->message(), SSC_WARNING);
+			return wfile.release();
+		}
+		else if ( is_assigned( "solar_resource_data" ) )
+			return new weatherdata( lookup("solar_resource_data") );
+		else
+			throw exec_error(cmname, "no weather data supplied");
 	}
 
-	
-	int process_irradiance(int year, int month, int day, int hour, double minute, double ts_hour,
-		double lat, double lon, double tz, double dn, double df, double alb )
+	double time_convention( weather_data_provider *wdprov, const char *cmname, bool &instantaneous )
 	{
-		irrad irr;
-		irr.set_time( year, month, day, hour, minute, ts_hour );
-		irr.set_location( lat, lon, tz );
-		irr.set_sky_model(2, alb );
-		irr.set_beam_diffuse(dn, df);
-		irr.set_surface( track_mode, tilt, azimuth, 45.0, 
-			shade_mode_1x == 1, // backtracking mode
-			gcr );
-
-		int code = irr.calc();
-			
+		// assumes instantaneous values, unless hourly file with no minute column specified
+		double ts_shift_hours = 0.0;
+		instantaneous = true;
+		if ( wdprov->has_data_column( weather_data_provider::MINUTE ) )
+		{
+			// if we have an file with a minute column, then
+			// the starting time offset equals the time 
+			// of the first record (for correct plotting)
+			// this holds true even for hourly data with a minute column
+			weather_record rec;
+			if ( wdprov->read( &rec ) )
+				ts_shift_hours = rec.minute/60.0;
 
-		irr.get_sun( &solazi, &solzen, &solalt, 0, 0, 0, &sunup, 0, 0, 0 );		
-		irr.get_angles( &aoi, &stilt, &sazi, &rot, &btd );
-		irr.get_poa( &ibeam, &iskydiff, &ignddiff, 0, 0, 0);	
+			wdprov->rewind();
+		}
+		else if ( wdprov->nrecords() == 8760 )
+		{
+			// hourly file with no minute data column.  assume
+			// integrated/averaged values and use mid point convention for interpreting results
+			instantaneous = false;
+			ts_shift_hours = 0.5;
+		}
+		else
+			throw exec_error(cmname, "subhourly weather files must specify the minute for each record" );
 
-		return code;
+		return ts_shift_hours;
 	}
 
-	void powerout(double time, double &shad_beam, double shad_diff, double dni, double alb, double wspd, double tdry)
+	void log_selfshade_factors( const pvwatts5_step &pv, double time )
 	{
-		
-		if (sunup > 0)
-		{				
-			if ( sunup > 0 && track_mode == 1
-				&& shade_mode_1x == 0 ) // selfshaded mode
-			{	
-				double shad1xf = shadeFraction1x( solazi, solzen, tilt, azimuth, gcr, rot );
-				shad_beam *= (ssc_number_t)(1-shad1xf);
-
-				if ( shade_mode_1x == 0 && iskydiff > 0 )
-				{
-					double reduced_skydiff = iskydiff;
-					double Fskydiff = 1.0;
-					double reduced_gnddiff = ignddiff;
-					double Fgnddiff = 1.0;
-						
-					// worst-case mask angle using calculated surface tilt
-					double phi0 = 180/3.1415926*atan2( sind( stilt ), 1/gcr - cosd( stilt ) );
-
-					// calculate sky and gnd diffuse derate factors
-					// based on view factor reductions from self-shading
-					diffuse_reduce( solzen, stilt,
-						dni, iskydiff+ignddiff,
-						gcr, phi0, alb, 1000,
-
-						// outputs (pass by reference)
-						reduced_skydiff, Fskydiff,
-						reduced_gnddiff, Fgnddiff );
-
-					if ( Fskydiff >= 0 && Fskydiff <= 1 ) iskydiff *= Fskydiff;
-					else log( util::format("sky diffuse reduction factor invalid at time %lg: fskydiff=%lg, stilt=%lg", time, Fskydiff, stilt), SSC_NOTICE, (float)time );
-
-					if ( Fgnddiff >= 0 && Fgnddiff <= 1 ) ignddiff *= Fgnddiff;
-					else log( util::format("gnd diffuse reduction factor invalid at time %lg: fgnddiff=%lg, stilt=%lg", time, Fgnddiff, stilt), SSC_NOTICE, (float)time );
-				}
-
-			}
-
-			// apply hourly shading factors to beam (if none enabled, factors are 1.0)
-			ibeam *= shad_beam;
-				
-			// apply sky diffuse shading factor (specified as constant, nominally 1.0 if disabled in UI)
-			iskydiff *= shad_diff;
-				
-			poa = ibeam + iskydiff +ignddiff;
-				
-			double wspd_corr = wspd < 0 ? 0 : wspd;					
-
-			// module cover			
-			tpoa = poa;
-			if ( aoi > AOI_MIN && aoi < AOI_MAX )
-			{
-				double mod = iam( aoi, use_ar_glass );
-				tpoa = poa - ( 1.0 - mod )*dni*cosd(aoi);
-				if( tpoa < 0.0 ) tpoa = 0.0;
-				if( tpoa > poa ) tpoa = poa;
-			}
-						
-			// cell temperature
-			pvt = (*tccalc)( poa, wspd_corr, tdry );
-
-			// dc power output (Watts)
-			dc = dc_nameplate*(1.0+gamma*(pvt-25.0))*tpoa/1000.0;
-
-			// dc losses
-			dc = dc*(1-loss_percent/100);
-
-			// inverter efficiency
-			double etanom = inv_eff_percent/100.0;
-			double etaref = 0.9637;
-			double A =  -0.0162;
-			double B = -0.0059;
-			double C =  0.9858;
-			double pdc0 = ac_nameplate/etanom;
-			double plr = dc / pdc0;
-			ac = 0;
-				
-			if ( plr > 0 )
-			{ // normal operation
-				double eta = (A*plr + B/plr + C)*etanom/etaref;
-				ac = dc*eta;
-			}
-
-			if ( ac > ac_nameplate ) // clipping
-				ac = ac_nameplate;
+		if ( !( pv.Fskydiff >= 0 && pv.Fskydiff <= 1 ) )
+			log( util::format("sky diffuse reduction factor invalid at time %lg: fskydiff=%lg, stilt=%lg", time, pv.Fskydiff, pv.stilt), SSC_NOTICE, (float)time );
 
-			// make sure no negative AC values (no parasitic nighttime losses calculated)
-			if ( ac < 0 ) ac = 0;
-		}
-		else
-		{
-			poa = 0;
-			tpoa = 0;
-			pvt = tdry;
-			dc = 0;
-			ac = 0;
-		}
+		if ( !( pv.Fgnddiff >= 0 && pv.Fgnddiff <= 1 ) )
+			log( util::format("gnd diffuse reduction factor invalid at time %lg: fgnddiff=%lg, stilt=%lg", time, pv.Fgnddiff, pv.stilt), SSC_NOTICE, (float)time );
 	}
 };
 
@@ -370,6 +214,13 @@ public:
 		add_var_info( _cm_vtab_pvwattsv5_common );
 		add_var_info( _cm_vtab_pvwattsv5_part2 );
 		add_var_info(vtab_adjustment_factors);
+		add_var_info(vtab_component_library);
+	}
+
+	void prepare_inputs( ) throw( general_error )
+	{
+		// module and inverter parameters named in a component library
+		assign_library_components( this );
 	}
 
 
@@ -382,23 +233,7 @@ public:
 		if (!as_boolean("batt_simple_enable"))
 			add_var_info(vtab_technology_outputs);
 
-		std::unique_ptr<weather_data_provider> wdprov;
-
-		if ( is_assigned( "solar_resource_file" ) )
-		{
-			const char *file = as_string("solar_resource_file");
-			wdprov = std::unique_ptr<weather_data_provider>( new weatherfile( file ) );
-
-			weatherfile *wfile = dynamic_cast<weatherfile*>(wdprov.get());
-			if (!wfile->ok()) throw exec_error("pvwattsv5", wfile->message());
-			if( wfile->has_message() ) log( wfile->message(), SSC_WARNING);
-		}
-		else if ( is_assigned( "solar_resource_data" ) )
-		{
-			wdprov = std::unique_ptr<weather_data_provider>( new weatherdata( lookup("solar_resource_data") ) );
-		}
-		else
-			throw exec_error("pvwattsv5", "no weather data supplied");
+		std::unique_ptr<weather_data_provider> wdprov( open_weather( "pvwattsv5" ) );
 
 		setup_system_inputs(); // setup all basic system specifications
 				
@@ -414,31 +249,8 @@ public:
 		weather_header hdr;
 		wdprov->header( &hdr );
 					
-		// assumes instantaneous values, unless hourly file with no minute column specified
-		double ts_shift_hours = 0.0;
 		bool instantaneous = true;
-		if ( wdprov->has_data_column( weather_data_provider::MINUTE ) )
-		{
-			// if we have an file with a minute column, then
-			// the starting time offset equals the time 
-			// of the first record (for correct plotting)
-			// this holds true even for hourly data with a minute column
-			weather_record rec;
-			if ( wdprov->read( &rec ) )
-				ts_shift_hours = rec.minute/60.0;
-
-			wdprov->rewind();
-		}
-		else if ( wdprov->nrecords() == 8760 )
-		{
-			// hourly file with no minute data column.  assume
-			// integrated/averaged values and use mid point convention for interpreting results
-			instantaneous = false;
-			ts_shift_hours = 0.5;
-		}
-		else
-			throw exec_error("pvwattsv5", "subhourly weather files must specify the minute for each record" );
-
+		double ts_shift_hours = time_convention( wdprov.get(), "pvwattsv5", instantaneous );
 		assign( "ts_shift_hours", var_data( (ssc_number_t)ts_shift_hours ) );
 
 		weather_record wf;
@@ -468,7 +280,7 @@ public:
 
 		double ts_hour = 1.0/step_per_hour;
 
-		initialize_cell_temp( ts_hour );
+		pvwatts5_step pv( sys, hdr.lat, hdr.lon, hdr.tz, ts_hour, !instantaneous );
 
 		double annual_kwh = 0; 
 					
@@ -502,9 +314,7 @@ public:
 				if ( std::isfinite( wf.alb ) && wf.alb > 0 && wf.alb < 1 )
 					alb = wf.alb;					
 				
-				int code = process_irradiance(wf.year, wf.month, wf.day, wf.hour, wf.minute, 
-					instantaneous ? IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET : ts_hour,
-					hdr.lat, hdr.lon, hdr.tz, wf.dn, wf.df, alb );
+				int code = pv.process_irradiance( wf.year, wf.month, wf.day, wf.hour, wf.minute, wf.dn, wf.df, alb );
 
 				if ( -1 == code )
 				{
@@ -516,28 +326,29 @@ public:
 						util::format("failed to process irradiation on surface (code: %d) [y:%d m:%d d:%d h:%d]", 
 							code, wf.year, wf.month, wf.day, wf.hour));
 			
-				p_sunup[idx] = (ssc_number_t)sunup;
-				p_aoi[idx] = (ssc_number_t)aoi;
+				p_sunup[idx] = (ssc_number_t)pv.sunup;
+				p_aoi[idx] = (ssc_number_t)pv.aoi;
 				
 				double shad_beam = 1.0;
-				if ( shad.fbeam(hour, solalt, solazi, jj, step_per_hour) )
+				if ( shad.fbeam(hour, pv.solalt, pv.solazi, jj, step_per_hour) )
 					shad_beam = shad.beam_shade_factor();
 				
 				p_shad_beam[idx] = (ssc_number_t)shad_beam ;
 				
-				if ( sunup > 0 )
+				if ( pv.sunup > 0 )
 				{
-					powerout((double)idx, shad_beam, shad.fdiff(), wf.dn, alb, wf.wspd, wf.tdry);
+					pv.powerout( shad_beam, shad.fdiff(), wf.dn, alb, wf.wspd, wf.tdry );
+					log_selfshade_factors( pv, (double)idx );
 					p_shad_beam[idx] = (ssc_number_t)shad_beam; // might be updated by 1 axis self shading so report updated value
 
-					p_poa[idx] = (ssc_number_t)poa; // W/m2
-					p_tpoa[idx] = (ssc_number_t)tpoa;  // W/m2
-					p_tcell[idx] = (ssc_number_t)pvt;
-					p_dc[idx] = (ssc_number_t)dc; // power, Watts
-					p_ac[idx] = (ssc_number_t)ac; // power, Watts
+					p_poa[idx] = (ssc_number_t)pv.poa; // W/m2
+					p_tpoa[idx] = (ssc_number_t)pv.tpoa;  // W/m2
+					p_tcell[idx] = (ssc_number_t)pv.pvt;
+					p_dc[idx] = (ssc_number_t)pv.dc; // power, Watts
+					p_ac[idx] = (ssc_number_t)pv.ac; // power, Watts
 
 					// accumulate hourly energy (kWh) (was initialized to zero when allocated)
-					p_gen[idx] = (ssc_number_t)(ac * haf(hour) * 0.001f); // W to kW
+					p_gen[idx] = (ssc_number_t)(pv.ac * haf(hour) * 0.001f); // W to kW
 					
 					annual_kwh += p_gen[idx];
 				}
@@ -578,7 +389,7 @@ public:
 		assign("inverter_efficiency", var_data((ssc_number_t)(as_double("inv_eff"))));
 
 		// metric outputs moved to technology
-		double kWhperkW = 1000.0*annual_kwh / dc_nameplate;
+		double kWhperkW = 1000.0*annual_kwh / sys.dc_nameplate;
 		// adjustment for timestep values
 		kWhperkW *= ts_hour;
 		assign("capacity_factor", var_data((ssc_number_t)(kWhperkW / 87.6)));
@@ -656,23 +467,154 @@ public:
 		double last_poa = as_double("poa");
 
 		setup_system_inputs();
-		initialize_cell_temp( time_step, last_tcell, last_poa );
+		pvwatts5_step pv( sys, lat, lon, tz, time_step, false );
+		pv.set_last_values( last_tcell, last_poa );
 		
-		int code = process_irradiance(year, month, day, hour, minute, 
-			IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET,
-			lat, lon, tz, beam, diff, alb );
+		int code = pv.process_irradiance( year, month, day, hour, minute, beam, diff, alb );
 
 		if (code != 0)
 			throw exec_error( "pvwattsv5_1ts", "failed to calculate plane of array irradiance with given input parameters" );
 
 		double shad_beam = 1.0;
-		powerout(0, shad_beam, 1.0, beam, alb, wspd, tamb);
+		pv.powerout( shad_beam, 1.0, beam, alb, wspd, tamb );
+		log_selfshade_factors( pv, 0 );
 
-		assign( "poa", var_data( (ssc_number_t)poa ) );
-		assign( "tcell", var_data( (ssc_number_t)pvt ) );
-		assign( "dc", var_data( (ssc_number_t)dc ) );
-		assign( "ac", var_data( (ssc_number_t)ac ) );		
+		assign( "poa", var_data( (ssc_number_t)pv.poa ) );
+		assign( "tcell", var_data( (ssc_number_t)pv.pvt ) );
+		assign( "dc", var_data( (ssc_number_t)pv.dc ) );
+		assign( "ac", var_data( (ssc_number_t)pv.ac ) );		
 	}
 };
 
 DEFINE_MODULE_ENTRY( pvwattsv5_1ts, "pvwattsv5_1ts- single timestep calculation of PV system performance.", 1 )
+
+
+
+/* *****************************************************************************
+			FLEET VERSION: many systems against one weather file
+ ***************************************************************************** */
+
+static var_info _cm_vtab_pvwattsv5_fleet[] = {
+	{ SSC_INPUT,        SSC_ARRAY,       "system_capacity",                "System size (DC nameplate)",                  "kW",        "One value per system",       "PVWatts Fleet", "*",                       "",                                         "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "dc_ac_ratio",                    "DC to AC ratio",                              "ratio",     "One value per system",       "PVWatts Fleet", "*",                       "",                                         "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "losses",                         "System losses",                               "%",         "One value per system",       "PVWatts Fleet", "*",                       "",                                         "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "tilt",                           "Tilt angle",                                  "deg",       "One value per system",       "PVWatts Fleet", "*",                       "",                                         "" },
+	{ SSC_INPUT,        SSC_ARRAY,       "azimuth",                        "Azimuth angle",                               "deg",       "One value per system",       "PVWatts Fleet", "*",                       "",                                         "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "module_type",                    "Module type",                                 "0/1/2",     "Standard,Premium,Thin film", "PVWatts Fleet", "?=0",                     "MIN=0,MAX=2,INTEGER",                      "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "array_type",                     "Array type",                                  "0/1/2/3/4", "Fixed OR,Fixed Roof,1Axis,Backtracked,2Axis",  "PVWatts Fleet", "*",      "MIN=0,MAX=4,INTEGER",                      "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "inv_eff",                        "Inverter efficiency at rated power",          "%",         "",                           "PVWatts Fleet", "?=96",                    "MIN=90,MAX=99.5",                          "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "gcr",                            "Ground coverage ratio",                       "0..1",      "",                           "PVWatts Fleet", "?=0.4",                   "MIN=0,MAX=3",                              "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "fleet_threads",                  "Number of simulation threads",                "",          "0=all available",            "PVWatts Fleet", "?=0",                     "MIN=0,INTEGER",                            "" },
+	{ SSC_INPUT,        SSC_NUMBER,      "fleet_timeseries",               "Report time series AC power for each system", "0/1",       "",                           "PVWatts Fleet", "?=0",                     "BOOLEAN",                                  "" },
+
+	/* outputs */
+	{ SSC_OUTPUT,       SSC_ARRAY,       "annual_energy",                  "Annual energy",                               "kWh",       "One value per system",       "Annual",        "*",                       "",                                         "" },
+	{ SSC_OUTPUT,       SSC_MATRIX,      "monthly_energy",                 "Monthly energy",                              "kWh",       "Rows: systems, columns: months", "Monthly",   "*",                       "",                                         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "capacity_factor",                "Capacity factor",                             "%",         "One value per system",       "Annual",        "*",                       "",                                         "" },
+	{ SSC_OUTPUT,       SSC_ARRAY,       "kwh_per_kw",                     "First year kWh/kW",                           "",          "One value per system",       "Annual",        "*",                       "",                                         "" },
+	{ SSC_OUTPUT,       SSC_MATRIX,      "ac",                             "AC inverter power",                           "W",         "Rows: systems, columns: time steps", "Time Series", "fleet_timeseries=1", "",                                  "" },
+	{ SSC_OUTPUT,       SSC_NUMBER,      "ts_shift_hours",                 "Time offset for interpreting time series outputs",  "hours", "",                     "Miscellaneous", "*",                       "",                                         "" },
+
+	var_info_invalid };
+
+class cm_pvwattsv5_fleet : public cm_pvwattsv5_base
+{
+public:
+	
+	cm_pvwattsv5_fleet()
+	{
+		add_var_info( _cm_vtab_pvwattsv5_part1 );
+		add_var_info( _cm_vtab_pvwattsv5_fleet );
+	}
+
+	void exec( ) throw( general_error )
+	{
+		std::vector<double> capacity = as_vector_double("system_capacity");
+		std::vector<double> dc_ac_ratio = as_vector_double("dc_ac_ratio");
+		std::vector<double> losses = as_vector_double("losses");
+		std::vector<double> tilt = as_vector_double("tilt");
+		std::vector<double> azimuth = as_vector_double("azimuth");
+
+		size_t nsys = capacity.size();
+		if ( nsys == 0 )
+			throw exec_error( "pvwattsv5_fleet", "no systems specified" );
+		if ( dc_ac_ratio.size() != nsys || losses.size() != nsys || tilt.size() != nsys || azimuth.size() != nsys )
+			throw exec_error( "pvwattsv5_fleet", "system_capacity, dc_ac_ratio, losses, tilt and azimuth must have one value per system" );
+
+		int module_type = as_integer("module_type");
+		int array_type = as_integer("array_type");
+		double inv_eff = as_double("inv_eff");
+		double gcr = as_double("gcr");
+
+		pvwatts5_fleet fleet;
+		for ( size_t i=0;i<nsys;i++ )
+		{
+			if ( capacity[i] <= 0 || dc_ac_ratio[i] <= 0 || losses[i] < -5 || losses[i] > 99
+				|| tilt[i] < 0 || tilt[i] > 90 || azimuth[i] < 0 || azimuth[i] >= 360 )
+				throw exec_error( "pvwattsv5_fleet", util::format("invalid specification for system %d: capacity=%lg dc_ac_ratio=%lg losses=%lg tilt=%lg azimuth=%lg",
+					(int)(i+1), capacity[i], dc_ac_ratio[i], losses[i], tilt[i], azimuth[i]) );
+
+			pvwatts5_system s;
+			s.setup( capacity[i], dc_ac_ratio[i], inv_eff, losses[i], tilt[i], azimuth[i], module_type, array_type, 0.4 );
+			if ( s.track_mode == 1 && is_assigned("gcr") ) s.gcr = gcr;
+			fleet.add_system( s );
+		}
+
+		std::unique_ptr<weather_data_provider> wdprov( open_weather( "pvwattsv5_fleet" ) );
+
+		bool instantaneous = true;
+		double ts_shift_hours = time_convention( wdprov.get(), "pvwattsv5_fleet", instantaneous );
+		assign( "ts_shift_hours", var_data( (ssc_number_t)ts_shift_hours ) );
+
+		size_t nrec = wdprov->nrecords();
+		size_t step_per_hour = nrec/8760;
+		if ( step_per_hour < 1 || step_per_hour > 60 || step_per_hour*8760 != nrec )
+			throw exec_error( "pvwattsv5_fleet", util::format("invalid number of data records (%d): must be an integer multiple of 8760", (int)nrec ) );
+		double ts_hour = 1.0/step_per_hour;
+
+		std::vector<weather_record> wf( nrec );
+		for ( size_t i=0;i<nrec;i++ )
+			if ( !wdprov->read( &wf[i] ) )
+				throw exec_error("pvwattsv5_fleet", util::format("could not read data line %d of %d in weather file", (int)(i+1), (int)nrec ));
+
+		weather_header hdr;
+		wdprov->header( &hdr );
+
+		// sun position is shared by every system in the fleet
+		sunpos_cache sun;
+		sun.calc( wf, hdr.lat, hdr.lon, hdr.tz, instantaneous ? IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET : ts_hour );
+
+		bool timeseries = as_boolean("fleet_timeseries");
+		fleet.run( wf, sun, ts_hour, as_integer("fleet_threads"), timeseries );
+
+		if ( fleet.nbeam_exceeded() > 0 )
+			log( util::format("beam irradiance exceeded extraterrestrial value in %d records", (int)fleet.nbeam_exceeded()) );
+
+		ssc_number_t *p_annual = allocate( "annual_energy", nsys );
+		ssc_number_t *p_monthly = allocate( "monthly_energy", nsys, 12 );
+		ssc_number_t *p_cf = allocate( "capacity_factor", nsys );
+		ssc_number_t *p_kwhperkw = allocate( "kwh_per_kw", nsys );
+		ssc_number_t *p_ac = timeseries ? allocate( "ac", nsys, nrec ) : 0;
+
+		for ( size_t i=0;i<nsys;i++ )
+		{
+			for ( int m=0;m<12;m++ )
+				p_monthly[i*12+m] = (ssc_number_t)fleet.monthly_energy( i, m );
+
+			double annual_kwh = fleet.annual_energy( i );
+			double kWhperkW = annual_kwh / capacity[i];
+			p_annual[i] = (ssc_number_t)annual_kwh;
+			p_cf[i] = (ssc_number_t)(kWhperkW / 87.6);
+			p_kwhperkw[i] = (ssc_number_t)kWhperkW;
+
+			if ( p_ac )
+			{
+				const float *ac = fleet.ac( i );
+				for ( size_t r=0;r<nrec;r++ )
+					p_ac[i*nrec+r] = (ssc_number_t)ac[r];
+			}
+		}
+	}
+};
+
+DEFINE_MODULE_ENTRY( pvwattsv5_fleet, "pvwattsv5_fleet- PVWatts V5 simulation of many systems sharing one weather file.", 1 )
@@ -47,9 +47,11 @@
 *  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************************************/
 
+#include <cstdlib>
 #include <string>
 #include "common.h"
 #include "lib_weatherfile.h"
+#include "lib_component_library.h"
 
 var_info vtab_standard_financial[] = {
 
@@ -320,6 +322,81 @@ var_info vtab_technology_outputs[] = {
 		{ SSC_OUTPUT, SSC_ARRAY, "gen", "System power generated", "kW", "", "Time Series", "*", "", "" },
 		var_info_invalid };
 
+var_info vtab_component_library[] = {
+/*   VARTYPE           DATATYPE         NAME                               LABEL                                       UNITS     META                                     GROUP                 REQUIRED_IF                 CONSTRAINTS                      UI_HINTS*/
+
+	{ SSC_INPUT,        SSC_STRING,      "module_library",                "Module library file",                     "",     "columns named by input variable",      "Component Library",     "?",                     "",                           "" },
+	{ SSC_INPUT,        SSC_STRING,      "module_name",                   "Module name in library",                  "",     "",                                     "Component Library",     "?",                     "",                           "" },
+	{ SSC_INPUT,        SSC_STRING,      "inverter_library",              "Inverter library file",                   "",     "columns named by input variable",      "Component Library",     "?",                     "",                           "" },
+	{ SSC_INPUT,        SSC_STRING,      "inverter_name",                 "Inverter name in library",                "",     "",                                     "Component Library",     "?",                     "",                           "" },
+
+var_info_invalid };
+
+static void assign_library_component( compute_module *cm, const std::string &type, std::vector<std::string> &fields )
+{
+	var_data *file = cm->lookup( type + "_library" );
+	var_data *name = cm->lookup( type + "_name" );
+	if ( !name || name->type != SSC_STRING )
+		return;
+	if ( !file || file->type != SSC_STRING )
+		throw compute_module::general_error( type + "_name given without " + type + "_library" );
+
+	std::string err;
+	std::shared_ptr<const component_library> library = component_library::open( file->str, err );
+	if ( !library )
+		throw compute_module::general_error( err );
+
+	size_t i = library->find( name->str );
+	if ( i == component_library::npos )
+		throw compute_module::general_error( util::format( "%s '%s' not found in %s", type.c_str(), name->str.c_str(), file->str.c_str() ) );
+
+	// only columns that are inputs of this compute module are assigned, the rest are descriptive
+	library->fields( i, fields );
+	const std::vector<std::string> &columns = library->columns();
+	for ( int k = 0; cm->info( k ) != 0; k++ )
+	{
+		const var_info *vi = cm->info( k );
+		if ( vi->var_type != SSC_INPUT && vi->var_type != SSC_INOUT )
+			continue;
+
+		size_t c = std::find( columns.begin() + 1, columns.end(), vi->name ) - columns.begin();
+		if ( c >= columns.size() || fields[c].empty() )
+			continue;
+
+		if ( vi->data_type == SSC_STRING )
+			cm->assign_input( vi->name, var_data( fields[c] ) );
+		else if ( vi->data_type == SSC_NUMBER || vi->data_type == SSC_ARRAY )
+		{
+			// arrays are listed as numbers separated by semicolons
+			std::vector<ssc_number_t> values;
+			const char *p = fields[c].c_str();
+			while ( *p )
+			{
+				char *end = 0;
+				double v = strtod( p, &end );
+				while ( end && ( *end == ' ' || *end == '\t' ) ) end++;
+				if ( end == p || ( *end != 0 && *end != ';' ) )
+					throw compute_module::general_error( util::format( "invalid value '%s' for %s of %s '%s'", fields[c].c_str(), vi->name, type.c_str(), name->str.c_str() ) );
+				values.push_back( (ssc_number_t)v );
+				p = ( *end == ';' ) ? end + 1 : end;
+			}
+			if ( vi->data_type == SSC_NUMBER && values.size() == 1 )
+				cm->assign_input( vi->name, var_data( values[0] ) );
+			else if ( vi->data_type == SSC_ARRAY && values.size() > 0 )
+				cm->assign_input( vi->name, var_data( &values[0], values.size() ) );
+			else
+				throw compute_module::general_error( util::format( "invalid value '%s' for %s of %s '%s'", fields[c].c_str(), vi->name, type.c_str(), name->str.c_str() ) );
+		}
+	}
+}
+
+void assign_library_components( compute_module *cm )
+{
+	std::vector<std::string> fields;
+	assign_library_component( cm, "module", fields );
+	assign_library_component( cm, "inverter", fields );
+}
+
 
 adjustment_factors::adjustment_factors( compute_module *cm, const std::string &prefix )
 : m_cm(cm), m_prefix(prefix)
@@ -607,9 +684,35 @@ bool shading_factor_calculator::setup( compute_module *cm, const std::string &pr
 	if (cm->is_assigned(prefix + "shading:diff"))
 		m_diffFactor = 1 - cm->as_double(prefix + "shading:diff") / 100;
 
+	compile_schedule();
+
 	return ok;
 }
 
+void shading_factor_calculator::compile_schedule()
+{
+	// the beam factor of each input row is the same every year, so the timestep and month x hour factors
+	// are multiplied once here rather than at each step
+	size_t nrows = m_beamFactors.nrows();
+	bool use_db = use_shade_db();
+	m_beamSchedule.resize(nrows);
+	m_stringSchedule.clear();
+	if (use_db)
+		m_stringSchedule.resize(nrows);
+	for (size_t r = 0; r < nrows; r++)
+	{
+		double factor = use_db ? 1.0 : m_beamFactors.at(r, 0);
+		if (m_enMxH && (r < m_mxhFactors.nrows()))
+			factor *= m_mxhFactors(r, 0);
+		m_beamSchedule[r] = factor;
+
+		// string shade fractions are looked up in the shading database once per row, which also finds
+		// the rows with no partial shading that need no database lookup
+		if (use_db)
+			m_stringSchedule[r] = ShadeDB8_mpp::get_shade_pattern(&m_beamFactors.at(r, 0), m_beamFactors.ncols());
+	}
+}
+
 std::string shading_factor_calculator::get_error(size_t i)
 {
 	if( i < m_errors.size() ) return m_errors[i];
@@ -640,12 +743,10 @@ bool shading_factor_calculator::fbeam(size_t hour, double solalt, double solazi,
 	bool ok = false;
 	double factor = 1.0;
 	size_t irow = get_row_index_for_input(hour,hour_step,steps_per_hour);
-	if (irow < m_beamFactors.nrows())
+	if (irow < m_beamSchedule.size())
 	{
-		factor = m_beamFactors.at(irow, 0);
-		// apply mxh factor
-		if (m_enMxH && (irow < m_mxhFactors.nrows()))
-			factor *= m_mxhFactors(irow, 0);
+		// timestep and mxh factors
+		factor = m_beamSchedule[irow];
 		// apply azi alt shading factor
 		if (m_enAzAlt)
 			factor *= util::bilinear(solalt, solazi, m_azaltvals);
@@ -664,15 +765,11 @@ bool shading_factor_calculator::fbeam_shade_db(ShadeDB8_mpp * p_shadedb, size_t
 	double dc_factor = 1.0;
 	double beam_factor = 1.0;
 	size_t irow = get_row_index_for_input(hour, hour_step, steps_per_hour);
-	if (irow < m_beamFactors.nrows())
+	if (irow < m_stringSchedule.size())
 	{
-		std::vector<double> shad_fracs;
-		for (size_t icol = 0; icol < m_beamFactors.ncols(); icol++)
-			shad_fracs.push_back(m_beamFactors.at(irow, icol));
-		dc_factor = 1.0 - p_shadedb->get_shade_loss(gpoa, dpoa, shad_fracs, true, pv_cell_temp, mods_per_str, str_vmp_stc, mppt_lo, mppt_hi);
-		// apply mxh factor
-		if (m_enMxH && (irow < m_mxhFactors.nrows()))
-			beam_factor *= m_mxhFactors(irow, 0);
+		dc_factor = 1.0 - p_shadedb->get_shade_loss(gpoa, dpoa, m_stringSchedule[irow], true, pv_cell_temp, mods_per_str, str_vmp_stc, mppt_lo, mppt_hi);
+		// mxh factor
+		beam_factor = m_beamSchedule[irow];
 		// apply azi alt shading factor
 		if (m_enAzAlt)
 			beam_factor *= util::bilinear(solalt, solazi, m_azaltvals);
@@ -69,6 +69,13 @@ extern var_info vtab_adjustment_factors[];
 extern var_info vtab_dc_adjustment_factors[];
 extern var_info vtab_sf_adjustment_factors[];
 extern var_info vtab_technology_outputs[];
+extern var_info vtab_component_library[];
+
+/* assigns the module and inverter parameters named by the component library inputs,
+   to be called from compute_module::prepare_inputs().  library values take the place
+   of any values already given for the same inputs for this run only, the caller's
+   data is not changed */
+void assign_library_components( compute_module *cm );
 
 class adjustment_factors
 {
@@ -118,6 +125,11 @@ class shading_factor_calculator
 	bool m_enMxH;
 	util::matrix_t<double> m_mxhFactors;
 
+	// shading schedule compiled at setup, one entry per row of the shading inputs
+	std::vector<double> m_beamSchedule; // timestep and month x hour beam factors combined
+	std::vector<ShadeDB8_mpp::shade_pattern> m_stringSchedule; // shading database pattern of the string shade fractions
+	void compile_schedule();
+
 public:
 	shading_factor_calculator();
 	bool setup(compute_module *cm, const std::string &prefix = "");
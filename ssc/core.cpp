@@ -71,6 +71,7 @@ bool compute_module::compute( handler_interface *handler, var_table *data )
 {
 	m_handler = NULL;
 	m_vartab = NULL;
+	m_inputs.clear();
 
 	if (!handler)
 	{
@@ -94,6 +95,7 @@ bool compute_module::compute( handler_interface *handler, var_table *data )
 	
 	try { // catch any 'general_error' that can be thrown during precheck, exec, and postcheck
 
+		prepare_inputs();
 		if (!verify("precheck input", SSC_INPUT)) return false;
 		exec();
 		if (!verify("postcheck output", SSC_OUTPUT)) return false;
@@ -273,15 +275,29 @@ bool compute_module::is_ssc_array_output( const std::string &name ) throw( gener
 var_data *compute_module::lookup( const std::string &name ) throw( general_error )
 {
 	if (!m_vartab) throw general_error("invalid data container object reference");
+	if (m_inputs.size() > 0)
+	{
+		var_data *v = m_inputs.lookup(name);
+		if (v) return v;
+	}
 	return m_vartab->lookup(name);
 }
 
 var_data *compute_module::assign( const std::string &name, const var_data &value ) throw( general_error )
 {
 	if (!m_vartab) throw general_error("invalid data container object reference");
+	// a value written during the run replaces an input assigned for the run
+	if (m_inputs.size() > 0)
+		m_inputs.unassign( name );
 	return m_vartab->assign( name, value );
 }
 
+var_data *compute_module::assign_input( const std::string &name, const var_data &value ) throw( general_error )
+{
+	if (!m_vartab) throw general_error("invalid data container object reference");
+	return m_inputs.assign( name, value );
+}
+
 ssc_number_t *compute_module::allocate( const std::string &name, size_t length ) throw( general_error )
 {
 	var_data *v = assign(name, var_data());
@@ -241,6 +241,10 @@ protected:
 	   note: can throw exceptions of type 'compute_module::error' */
 	virtual void exec( ) throw( general_error ) = 0;
 
+	/* can be implemented to fill in inputs from other inputs before the
+	   inputs are checked, i.e. parameters looked up from a component library */
+	virtual void prepare_inputs( ) throw( general_error ) { }
+
 	
 	/* can be called in constructors to build up the variable table references */
 	void add_var_info( var_info vi[] );
@@ -257,6 +261,9 @@ public:
 	bool is_ssc_array_output( const std::string &name ) throw( general_error );
 	var_data *lookup( const std::string &name ) throw( general_error );
 	var_data *assign( const std::string &name, const var_data &value ) throw( general_error );
+	/* assigns an input for the current 'compute' only, in place of any value in the
+	   caller's data, which is left unchanged.  for use from prepare_inputs */
+	var_data *assign_input( const std::string &name, const var_data &value ) throw( general_error );
 	ssc_number_t *allocate( const std::string &name, size_t length ) throw( general_error );
 	ssc_number_t *allocate( const std::string &name, size_t nrows, size_t ncols ) throw( general_error );
 	util::matrix_t<ssc_number_t>& allocate_matrix( const std::string &name, size_t nrows, size_t ncols ) throw( general_error );
@@ -311,6 +318,9 @@ private:
 	  and are NULL otherwise */
 	handler_interface   *m_handler;
 	var_table           *m_vartab;
+
+	/* inputs assigned by prepare_inputs, looked up ahead of m_vartab */
+	var_table           m_inputs;
 };
 
 
@@ -74,8 +74,10 @@ extern module_entry_info
 	cm_entry_singlediode,
 	cm_entry_singlediodeparams,
 	cm_entry_iec61853par,
+	cm_entry_iec61853par_batch,
 	cm_entry_iec61853interp,
 	cm_entry_6parsolve,
+	cm_entry_6parsolve_batch,
 	cm_entry_pvsamv1,
 	cm_entry_pvwattsv0,
 	cm_entry_pvwattsv1,
@@ -83,6 +85,7 @@ extern module_entry_info
 	cm_entry_pvwattsv1_poa,
 	cm_entry_pvwattsv5,
 	cm_entry_pvwattsv5_1ts,
+	cm_entry_pvwattsv5_fleet,
 	cm_entry_pv6parmod,
 	cm_entry_pvsandiainv,
 	cm_entry_wfreader,
@@ -147,6 +150,7 @@ extern module_entry_info
 	cm_entry_iscc_design_point,
 	cm_entry_battery,
 	cm_entry_battwatts,
+	cm_entry_battery_sizing,
    	cm_entry_lcoefcr,
 	cm_entry_pv_get_shade_loss_mpp,
 	cm_entry_inv_cec_cg;
@@ -156,8 +160,10 @@ static module_entry_info *module_table[] = {
 	&cm_entry_singlediode,
 	&cm_entry_singlediodeparams,
 	&cm_entry_iec61853par,
+	&cm_entry_iec61853par_batch,
 	&cm_entry_iec61853interp,
 	&cm_entry_6parsolve,
+	&cm_entry_6parsolve_batch,
 	&cm_entry_pv6parmod,
 	&cm_entry_pvsamv1,
 	//&cm_entry_pvwattsv0,
@@ -166,6 +172,7 @@ static module_entry_info *module_table[] = {
 	&cm_entry_pvwattsv1_poa,
 	&cm_entry_pvwattsv5,
 	&cm_entry_pvwattsv5_1ts,
+	&cm_entry_pvwattsv5_fleet,
 	&cm_entry_pvsandiainv,
 	&cm_entry_wfreader,
 	&cm_entry_irradproc,
@@ -229,6 +236,7 @@ static module_entry_info *module_table[] = {
 	&cm_entry_iscc_design_point,
 	&cm_entry_battery,
 	&cm_entry_battwatts,
+	&cm_entry_battery_sizing,
 	&cm_entry_lcoefcr,
 	&cm_entry_pv_get_shade_loss_mpp,
 	&cm_entry_inv_cec_cg,
@@ -0,0 +1,29 @@
+#ifndef __BENCHMARK_TEST_H__
+#define __BENCHMARK_TEST_H__
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+
+/**
+* Timing for the benchmark tests.  The benchmarks are named DISABLED_Benchmark_* so they stay out of the
+* default run, and are run with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*.  Each time is
+* recorded as a property of the running test, which gtest lists in its --gtest_output=xml report.
+*/
+
+/// Run work once and return the time it took (ms)
+template <typename F>
+double benchmark_ms(F work)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	work();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Record a time (ms) as a test property, in microseconds so short times keep their precision
+inline void record_benchmark(const std::string &name, double ms)
+{
+	::testing::Test::RecordProperty(name + "_us", (int)(1000 * ms));
+}
+
+#endif
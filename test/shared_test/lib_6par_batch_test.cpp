@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <lib_6par_batch.h>
+
+/**
+* Batch CEC 6 parameter fitting compared with solving each module on its own
+*/
+
+class BatchSolve6parTest : public ::testing::Test {
+protected:
+	std::vector<module6par> modules;
+	double e = 1e-4;
+public:
+	/// A synthetic library of crystalline silicon product lines, each listed in several power bins
+	void SetUp() {
+		int nser[] = { 60, 72, 96 };
+		for (int family = 0; family < 16; family++) {
+			int ns = nser[family % 3];
+			double f = 0.5 + 0.5 * sin(family * 0.731);
+			double g = 0.5 + 0.5 * sin(family * 1.913 + 1);
+			for (int bin = 0; bin < 5; bin++) {
+				double Voc = ns * (0.62 + 0.06 * f) * (1 + 0.005 * bin);
+				double Isc = (5.5 + 4.5 * g) * (1 + 0.01 * bin);
+				double Vmp = Voc * (0.80 + 0.03 * g);
+				double Imp = Isc * (0.93 + 0.02 * f);
+				modules.push_back(module6par(family % 2 == 0 ? module6par::monoSi : module6par::multiSi, Vmp, Imp, Voc, Isc,
+					-0.0031 * Voc, 0.0005 * Isc, -0.40 - 0.05 * f, ns, 298.15));
+			}
+		}
+	}
+};
+
+TEST_F(BatchSolve6parTest, ColdStartMatchesSingle_lib_6par_batch) {
+	std::vector<module6par> batch = modules;
+	std::vector<module6par_batch::status> status;
+	module6par_batch().solve(batch, status, 1, false);
+
+	for (size_t i = 0; i < modules.size(); i++) {
+		module6par m = modules[i];
+		int err = m.solve_with_sanity_and_heuristics<double>(300, 1e-7);
+		EXPECT_EQ(err, status[i].err) << "module " << i;
+		EXPECT_EQ(-1, status[i].warm_source);
+		if (err == 0) {
+			EXPECT_EQ(m.a, batch[i].a);
+			EXPECT_EQ(m.Il, batch[i].Il);
+			EXPECT_EQ(m.Io, batch[i].Io);
+			EXPECT_EQ(m.Rs, batch[i].Rs);
+			EXPECT_EQ(m.Rsh, batch[i].Rsh);
+			EXPECT_EQ(m.Adj, batch[i].Adj);
+		}
+	}
+}
+
+TEST_F(BatchSolve6parTest, WarmStartMatchesColdStart_lib_6par_batch) {
+	std::vector<module6par> warm = modules, cold = modules;
+	std::vector<module6par_batch::status> warm_status, cold_status;
+	module6par_batch().solve(warm, warm_status, 4, true);
+	module6par_batch().solve(cold, cold_status, 4, false);
+
+	int nwarm = 0, warm_iter = 0, cold_iter = 0;
+	for (size_t i = 0; i < modules.size(); i++) {
+		ASSERT_EQ(0, cold_status[i].err) << "module " << i;
+		ASSERT_EQ(0, warm_status[i].err) << "module " << i;
+		EXPECT_NEAR(warm[i].a, cold[i].a, e * cold[i].a) << "module " << i;
+		EXPECT_NEAR(warm[i].Il, cold[i].Il, e * cold[i].Il) << "module " << i;
+		EXPECT_NEAR(warm[i].Io, cold[i].Io, 1e-3 * cold[i].Io) << "module " << i;
+		EXPECT_NEAR(warm[i].Rs, cold[i].Rs, e * cold[i].Rs) << "module " << i;
+		EXPECT_NEAR(warm[i].Rsh, cold[i].Rsh, 1e-3 * cold[i].Rsh) << "module " << i;
+		EXPECT_NEAR(warm[i].Adj, cold[i].Adj, 1e-3 * fabs(cold[i].Adj) + 1e-6) << "module " << i;
+		if (warm_status[i].warm_source >= 0) {
+			nwarm++;
+			EXPECT_EQ(modules[i].Type, modules[warm_status[i].warm_source].Type);
+			EXPECT_EQ(modules[i].Nser, modules[warm_status[i].warm_source].Nser);
+		}
+		warm_iter += warm_status[i].iterations;
+		cold_iter += cold_status[i].iterations;
+	}
+	EXPECT_GT(nwarm, (int)modules.size() / 2);
+	EXPECT_LT(warm_iter, cold_iter);
+}
+
+TEST_F(BatchSolve6parTest, ThreadCountInvariant_lib_6par_batch) {
+	std::vector<module6par> serial = modules, parallel = modules;
+	std::vector<module6par_batch::status> serial_status, parallel_status;
+	module6par_batch().solve(serial, serial_status, 1, true);
+	module6par_batch().solve(parallel, parallel_status, 3, true);
+
+	for (size_t i = 0; i < modules.size(); i++) {
+		EXPECT_EQ(serial_status[i].err, parallel_status[i].err);
+		EXPECT_EQ(serial_status[i].iterations, parallel_status[i].iterations);
+		EXPECT_EQ(serial_status[i].warm_source, parallel_status[i].warm_source);
+		EXPECT_EQ(serial[i].a, parallel[i].a);
+		EXPECT_EQ(serial[i].Rsh, parallel[i].Rsh);
+	}
+}
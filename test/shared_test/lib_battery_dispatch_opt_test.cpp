@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <lib_battery_dispatch_opt.h>
+
+/**
+* Optimized behind-the-meter dispatch over one day of hourly steps
+*/
+
+class DispatchOptTest : public ::testing::Test {
+protected:
+	dispatch_opt_window window;
+	dispatch_opt_lp lp;
+	std::vector<double> P_battery, P_grid;
+public:
+	void SetUp() {
+		window.dt_hour = 1.;
+		window.P_net.assign(24, 10.);
+		window.price_buy.assign(24, 0.10);
+		window.price_sell.assign(24, 0.);
+		window.demand_period.assign(24, 0);
+		window.tier_peak.resize(1);
+		window.tier_charge.resize(1);
+		window.peak_to_date.assign(1, 0.);
+		window.E_max = 20.;
+		window.E_initial = 20.;
+		window.P_charge_max = 10.;
+		window.P_discharge_max = 10.;
+		window.eta_charge = 1.;
+		window.eta_discharge = 1.;
+		window.can_grid_charge = false;
+	}
+	double peak() { return *std::max_element(P_grid.begin(), P_grid.end()); }
+};
+
+TEST_F(DispatchOptTest, ShaveDemandPeak_lib_battery_dispatch_opt) {
+	window.P_net[17] = 18.;
+	window.P_net[18] = 20.;
+	window.tier_peak[0].assign(1, 1e38);
+	window.tier_charge[0].assign(1, 15.);
+
+	ASSERT_TRUE(lp.solve(window, P_battery, P_grid));
+	ASSERT_EQ(24, (int)P_battery.size());
+	EXPECT_NEAR(10., peak(), 1e-6);
+	EXPECT_NEAR(8., P_battery[17], 1e-6);
+	EXPECT_NEAR(10., P_battery[18], 1e-6);
+	for (size_t t = 0; t != 24; t++)
+		EXPECT_NEAR(window.P_net[t] - P_battery[t], P_grid[t], 1e-6);
+
+	// a higher peak earlier in the month is already paid, so shaving below it is worth nothing
+	window.peak_to_date[0] = 25.;
+	window.E_initial = 0.;
+	ASSERT_TRUE(lp.solve(window, P_battery, P_grid));
+	EXPECT_NEAR(20., peak(), 1e-6);
+}
+
+TEST_F(DispatchOptTest, TimeOfUseDemandTiers_lib_battery_dispatch_opt) {
+	// period 1 in the evening, with a second tier cheaper than the first
+	window.P_net[18] = 16.;
+	window.P_net[19] = 16.;
+	window.demand_period.assign(24, 2);
+	window.demand_period[18] = 1;
+	window.demand_period[19] = 1;
+	window.tier_peak.resize(3);
+	window.tier_charge.resize(3);
+	window.tier_peak[1] = { 12., 1e38 };
+	window.tier_charge[1] = { 20., 5. };
+	window.peak_to_date.assign(3, 0.);
+	window.E_max = 8.;
+	window.E_initial = 0.;
+	window.can_grid_charge = true;
+
+	ASSERT_TRUE(lp.solve(window, P_battery, P_grid));
+	EXPECT_NEAR(12., std::max(P_grid[18], P_grid[19]), 1e-6);
+
+	// charging for the evening is cheaper off period 1
+	double E_charged = 0;
+	for (size_t t = 0; t != 18; t++)
+		E_charged -= std::min(P_battery[t], 0.);
+	EXPECT_NEAR(8., E_charged, 1e-6);
+
+	// the warm start from the previous basis reaches the same solution
+	std::vector<double> P_battery_cold = P_battery;
+	ASSERT_TRUE(lp.solve(window, P_battery, P_grid));
+	for (size_t t = 0; t != 24; t++)
+		EXPECT_NEAR(P_battery_cold[t], P_battery[t], 1e-6);
+}
+
+TEST_F(DispatchOptTest, EnergyArbitrage_lib_battery_dispatch_opt) {
+	for (size_t t = 12; t != 24; t++)
+		window.price_buy[t] = 0.30;
+	window.E_initial = 0.;
+	window.eta_charge = 0.95;
+	window.eta_discharge = 0.95;
+
+	// no grid charging and no PV surplus leaves nothing to do
+	ASSERT_TRUE(lp.solve(window, P_battery, P_grid));
+	for (size_t t = 0; t != 24; t++)
+		EXPECT_NEAR(0., P_battery[t], 1e-6);
+
+	window.can_grid_charge = true;
+	ASSERT_TRUE(lp.solve(window, P_battery, P_grid));
+	double E_charge = 0, E_discharge = 0;
+	for (size_t t = 0; t != 24; t++)
+	{
+		if (t < 12)
+			EXPECT_LE(P_battery[t], 1e-6);
+		else
+			EXPECT_GE(P_battery[t], -1e-6);
+		E_charge -= std::min(P_battery[t], 0.);
+		E_discharge += std::max(P_battery[t], 0.);
+	}
+	EXPECT_NEAR(20., E_charge, 1e-6);
+	EXPECT_NEAR(20., E_discharge, 1e-6);
+}
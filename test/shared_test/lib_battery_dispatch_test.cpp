@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <lib_battery_dispatch.h>
+#include <lib_power_electronics.h>
+
+#include "benchmark_test.h"
+
+/**
+* Front-of-meter automated dispatch of a 14s88p lithium ion bank under a PPA price signal
+*/
+
+class FrontOfMeterDispatch : public ::testing::Test
+{
+protected:
+	util::matrix_t<double> cycles_vs_DOD;
+	util::matrix_t<double> cap_vs_temp;
+	util::matrix_t<size_t> ppa_weekday_schedule;
+	util::matrix_t<size_t> ppa_weekend_schedule;
+	std::vector<double> ppa_factors;
+	double_vec pv_prediction;
+	double_vec cliploss_prediction;
+
+	battery_t * battery;
+	dispatch_automatic_front_of_meter_t * dispatch;
+	battery_metrics_t * metrics;
+	ChargeController * controller;
+
+	/// A clear-sky bell from 6 to 18 hours (kW)
+	double P_pv(size_t step_of_day, size_t steps_per_hour)
+	{
+		double hour = (double)step_of_day / steps_per_hour;
+		return (hour > 6 && hour < 18) ? 8 * std::sin(M_PI * (hour - 6) / 12) : 0;
+	}
+
+	void SetUp()
+	{
+		double table[] = { 20, 0, 100, 20, 650, 96, 20, 1500, 87, 20, 2650, 76, 20, 4500, 70, 20, 6450, 60,
+			80, 0, 100, 80, 150, 96, 80, 300, 87, 80, 500, 76, 80, 1000, 70, 80, 1400, 60,
+			100, 0, 100, 100, 100, 96, 100, 200, 87, 100, 300, 76, 100, 400, 70, 100, 500, 60 };
+		cycles_vs_DOD.assign(table, 18, 3);
+		double temps[] = { -10, 60, 0, 80, 25, 100, 40, 100 };
+		cap_vs_temp.assign(temps, 4, 2);
+
+		// period 2 is the evening peak from 17 to 21 hours, every day
+		ppa_weekday_schedule.resize_fill(12, 24, 1);
+		for (size_t m = 0; m != 12; m++)
+			for (size_t h = 17; h != 21; h++)
+				ppa_weekday_schedule.at(m, h) = 2;
+		ppa_weekend_schedule = ppa_weekday_schedule;
+		ppa_factors = { 1.0, 2.5 };
+
+		battery = 0;
+		dispatch = 0;
+		metrics = 0;
+		controller = 0;
+	}
+
+	void CreateModel(double dt_hour, size_t nyears)
+	{
+		size_t steps_per_hour = (size_t)(1 / dt_hour);
+		size_t nrec = 8760 * steps_per_hour;
+		double_vec no_loss(nrec, 0.);
+
+		battery = new battery_t(dt_hour, battery_t::LITHIUM_ION);
+		capacity_t * capacity = new capacity_lithium_ion_t(198, 50, 95, 15);
+		voltage_t * voltage = new voltage_dynamic_t(14, 88, 3.6, 4.1, 4.05, 3.4, 2.25, 0.04, 2.0, 0.2, 0.001);
+		lifetime_t * lifetime = new lifetime_t(new lifetime_cycle_t(cycles_vs_DOD),
+			new lifetime_calendar_t(lifetime_calendar_t::LITHIUM_ION_CALENDAR_MODEL, util::matrix_t<double>(), dt_hour, 1.02f, 2.66e-3f, -7280, 930), 0, 0);
+		thermal_t * thermal = new thermal_t(50, 0.27, 0.27, 0.27, 1004, 500, 20, cap_vs_temp);
+		losses_t * losses = new losses_t(lifetime, thermal, capacity, losses_t::TIMESERIES, no_loss, no_loss, no_loss, no_loss);
+		battery->initialize(capacity, voltage, lifetime, thermal, losses);
+
+		dispatch = new dispatch_automatic_front_of_meter_t(battery, dt_hour, 15, 95, dispatch_t::RESTRICT_POWER, 0, 0, 5, 5, 0,
+			dispatch_t::FOM_LOOK_AHEAD, dispatch_t::FRONT, nyears, 24, 1, true, false, false,
+			8, 0, dispatch_t::INPUT_CYCLE_COST, 0, ppa_factors, ppa_weekday_schedule, ppa_weekend_schedule, 0, 100, 96, 96);
+
+		// the forecast is held by the dispatch, it must outlive it
+		pv_prediction.clear();
+		for (size_t idx = 0; idx != nrec * nyears; idx++)
+			pv_prediction.push_back(P_pv(idx % (24 * steps_per_hour), steps_per_hour));
+		cliploss_prediction.assign(nrec * nyears, 0.);
+		dispatch->update_pv_data(pv_prediction);
+		dispatch->update_cliploss_data(cliploss_prediction);
+
+		metrics = new battery_metrics_t(dt_hour);
+		controller = new ACBatteryController(dispatch, metrics, 96, 96);
+	}
+
+	void TearDown()
+	{
+		if (controller)
+			delete controller;
+		if (metrics)
+			delete metrics;
+		if (dispatch)
+			delete dispatch;
+		if (battery)
+		{
+			battery->delete_clone();
+			delete battery;
+		}
+		controller = 0;
+		metrics = 0;
+		dispatch = 0;
+		battery = 0;
+	}
+
+	/// Run the model for the given number of years, return the energy discharged in the peak period (kWh)
+	double Run(double dt_hour, size_t nyears)
+	{
+		size_t steps_per_hour = (size_t)(1 / dt_hour);
+		double E_peak = 0;
+		size_t idx = 0;
+		for (size_t year = 0; year != nyears; year++)
+		{
+			for (size_t hour = 0; hour != 8760; hour++)
+			{
+				for (size_t step = 0; step != steps_per_hour; step++, idx++)
+				{
+					controller->run(year, hour, step, idx, pv_prediction[idx], 0, 0, 0);
+					double P_battery = dispatch->getBatteryPower()->powerBattery;
+					if (hour % 24 >= 17 && hour % 24 < 21 && P_battery > 0)
+						E_peak += P_battery * dt_hour;
+				}
+			}
+		}
+		return E_peak;
+	}
+};
+
+TEST_F(FrontOfMeterDispatch, DischargeAtPeakPrice_lib_battery_dispatch)
+{
+	CreateModel(1, 1);
+	double E_peak = Run(1, 1);
+
+	// the battery charges from PV during the day and sells into the evening peak, about 6 kWh a day
+	EXPECT_GT(E_peak, 365 * 4.);
+	EXPECT_GT(metrics->energy_discharge_annual(), 0.);
+	EXPECT_GT(metrics->energy_pv_charge_annual(), 0.);
+}
+
+TEST_F(FrontOfMeterDispatch, DISABLED_Benchmark_lib_battery_dispatch)
+{
+	// time 15 minute front-of-meter runs of one and of 25 years
+	const double dt_hour = 0.25;
+	double E_peak_1 = 0, E_peak_25 = 0;
+
+	CreateModel(dt_hour, 1);
+	double ms_1 = benchmark_ms([&]() { E_peak_1 = Run(dt_hour, 1); });
+	TearDown();
+
+	CreateModel(dt_hour, 25);
+	double ms_25 = benchmark_ms([&]() { E_peak_25 = Run(dt_hour, 25); });
+
+	record_benchmark("fom_1yr_15min", ms_1);
+	record_benchmark("fom_25yr_15min", ms_25);
+
+	EXPECT_GT(E_peak_1, 0.);
+	EXPECT_GT(E_peak_25, E_peak_1);
+}
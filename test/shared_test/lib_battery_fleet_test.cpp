@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <lib_battery.h>
+#include <lib_battery_fleet.h>
+
+#include "benchmark_test.h"
+
+/**
+* A fleet of batteries against one capacity model per battery, and dispatch to per-battery targets
+*/
+
+class BatteryFleet : public ::testing::Test
+{
+protected:
+	static const size_t n = 4;
+	double dt_hour;
+	double SOC_init, SOC_max, SOC_min;
+
+	void SetUp()
+	{
+		dt_hour = 0.25;
+		SOC_init = 50;
+		SOC_max = 95;
+		SOC_min = 15;
+	}
+
+	/// A different cycle for each battery, which runs into both state-of-charge limits (A)
+	double Current(size_t i, size_t step, double q)
+	{
+		double I = q * (0.2 + 0.1 * i) * ((step / (8 + 4 * i)) % 2 == 0 ? 1 : -1);
+		return (step % 7 == 3) ? 0 : I;
+	}
+
+	/// Returns the number of steps a battery took less current than asked
+	size_t Compare(battery_fleet_t & fleet, std::vector<capacity_t *> & models, double q, size_t nsteps)
+	{
+		size_t limited = 0;
+		std::vector<double> I(n);
+		for (size_t step = 0; step != nsteps; step++)
+		{
+			for (size_t i = 0; i != n; i++)
+				I[i] = Current(i, step, q);
+			fleet.update_capacity(&I[0]);
+
+			for (size_t i = 0; i != n; i++)
+			{
+				double I_model = Current(i, step, q);
+				models[i]->updateCapacity(I_model, dt_hour);
+				EXPECT_NEAR(I_model, I[i], 1e-9) << "battery " << i << " step " << step;
+				EXPECT_NEAR(models[i]->q0(), fleet.q0()[i], 1e-9) << "battery " << i << " step " << step;
+				EXPECT_NEAR(models[i]->SOC(), fleet.SOC()[i], 1e-9) << "battery " << i << " step " << step;
+				if (I[i] != Current(i, step, q))
+					limited++;
+			}
+		}
+		return limited;
+	}
+};
+
+TEST_F(BatteryFleet, LithiumIonMatchesCapacityModel_lib_battery_fleet)
+{
+	battery_fleet_t fleet(n, dt_hour, 50.4, 100, SOC_init, SOC_max, SOC_min);
+	std::vector<capacity_t *> models;
+	for (size_t i = 0; i != n; i++)
+		models.push_back(new capacity_lithium_ion_t(100, SOC_init, SOC_max, SOC_min));
+
+	EXPECT_GT(Compare(fleet, models, 100, 200), 0u);
+
+	for (size_t i = 0; i != n; i++)
+		delete models[i];
+}
+
+TEST_F(BatteryFleet, KibamMatchesCapacityModel_lib_battery_fleet)
+{
+	// the DC4006 lead acid battery of lib_battery_test
+	battery_fleet_t fleet(n, dt_hour, 12., 415, 5, 340, 374, SOC_init, SOC_max, SOC_min);
+	std::vector<capacity_t *> models;
+	for (size_t i = 0; i != n; i++)
+	{
+		models.push_back(new capacity_kibam_t(415, 5, 340, 374, SOC_init, SOC_max, SOC_min));
+		models[i]->updateCapacityForThermal(100);
+	}
+
+	EXPECT_GT(Compare(fleet, models, 415, 200), 0u);
+
+	for (size_t i = 0; i != n; i++)
+		delete models[i];
+}
+
+TEST_F(BatteryFleet, DispatchTargets_lib_battery_fleet)
+{
+	// 10 kWh at 50 V, with a 50 A limit
+	battery_fleet_t fleet(n, dt_hour, 50., 200, SOC_init, SOC_max, SOC_min);
+	fleet.set_current_limits(50, 50);
+
+	double P_target[n] = { 2, -2, 4, 0 };
+	double P_battery[n];
+	fleet.run(P_target, P_battery);
+	EXPECT_NEAR(2., P_battery[0], 1e-9);
+	EXPECT_NEAR(-2., P_battery[1], 1e-9);
+	EXPECT_NEAR(2.5, P_battery[2], 1e-9);
+	EXPECT_NEAR(0., P_battery[3], 1e-9);
+	EXPECT_NEAR(50 - 100 * 40 * dt_hour / 200, fleet.SOC()[0], 1e-9);
+
+	// run into the state-of-charge limits and stay there
+	for (size_t step = 0; step != 100; step++)
+		fleet.run(P_target, P_battery);
+	EXPECT_NEAR(SOC_min, fleet.SOC()[0], 1e-9);
+	EXPECT_NEAR(SOC_max, fleet.SOC()[1], 1e-9);
+	EXPECT_NEAR(SOC_min, fleet.SOC()[2], 1e-9);
+	EXPECT_NEAR(SOC_init, fleet.SOC()[3], 1e-9);
+	EXPECT_NEAR(0., P_battery[0], 1e-9);
+	EXPECT_NEAR(0., P_battery[1], 1e-9);
+}
+
+TEST_F(BatteryFleet, DISABLED_Benchmark_lib_battery_fleet)
+{
+	// time a year of hourly dispatch for 10,000 residential batteries, each self-consuming its own PV
+	const size_t nfleet = 10000;
+	battery_fleet_t fleet(nfleet, 1., 50., 200, SOC_init, SOC_max, SOC_min);
+	fleet.set_current_limits(100, 100);
+
+	std::vector<double> P_target(nfleet), P_battery(nfleet);
+	double E_discharge = 0;
+	double ms = benchmark_ms([&]() {
+		for (size_t hour = 0; hour != 8760; hour++)
+		{
+			double h = (double)(hour % 24);
+			double pv_shape = (h > 6 && h < 18) ? std::sin(M_PI * (h - 6) / 12) : 0;
+			double load_peak = (h >= 17 && h < 22) ? 1.5 : 0;
+			for (size_t i = 0; i != nfleet; i++)
+				P_target[i] = 1 + 0.5 * (i % 3) + load_peak - (3 + (i % 5)) * pv_shape;
+			fleet.run(&P_target[0], &P_battery[0]);
+			E_discharge += std::max(P_battery[0], 0.);
+		}
+	});
+	record_benchmark("fleet_10k_1yr_1hr", ms);
+
+	EXPECT_GT(E_discharge, 0.);
+	EXPECT_GT(fleet.q0_total(), 0.);
+}
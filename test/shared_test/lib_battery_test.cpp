@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <lib_battery.h>
 
+#include "benchmark_test.h"
+
 class BatteryProperties : public ::testing::Test
 {
 protected:
@@ -165,4 +167,361 @@ TEST_F(LeadAcidBattery, LeadAcidCapacityUnitTest_lib_battery)
 	*/
 	
 
-}
\ No newline at end of file
+}
+
+class LithiumIonLifetime : public BatteryProperties
+{
+protected:
+	util::matrix_t<double> cycles_vs_DOD;
+
+	void SetUp()
+	{
+		BatteryProperties::SetUp();
+		double table[] = { 20, 0, 100, 20, 650, 96, 20, 1500, 87, 20, 2650, 76, 20, 4500, 70, 20, 6450, 60,
+			80, 0, 100, 80, 150, 96, 80, 300, 87, 80, 500, 76, 80, 1000, 70, 80, 1400, 60,
+			100, 0, 100, 100, 100, 96, 100, 200, 87, 100, 300, 76, 100, 400, 70, 100, 500, 60 };
+		cycles_vs_DOD.assign(table, 18, 3);
+	}
+};
+
+TEST_F(LithiumIonLifetime, CycleCapacity_lib_battery)
+{
+	lifetime_cycle_t cycle(cycles_vs_DOD);
+	EXPECT_EQ(cycle.runCycleLifetime(0), 100);
+
+	// one cycle at 80% DOD, between the first two rows of its curve
+	EXPECT_NEAR(cycle.computeCycleDamageAtDOD(80), 4. / 150, 1e-9);
+	for (int i = 0; i < 2000; i++)
+	{
+		cycle.runCycleLifetime(10);
+		cycle.runCycleLifetime(90);
+	}
+	EXPECT_EQ(cycle.cycles_elapsed(), 2000);
+	EXPECT_NEAR(cycle.cycle_range(), 80, 1e-6);
+
+	// 2000 cycles at an average depth just under 80% is extrapolated past the last 80% row, 60% at 1400 cycles
+	double q = cycle.runCycleLifetime(10);
+	EXPECT_NEAR(q, 45.02, 0.01);
+
+	cycle.replaceBattery();
+	EXPECT_EQ(cycle.runCycleLifetime(0), 100);
+}
+
+TEST_F(LithiumIonLifetime, RainflowResidual_lib_battery)
+{
+	// a damped oscillation leaves every turning point on the residual stack, more than are kept inline
+	lifetime_cycle_t cycle(cycles_vs_DOD);
+	for (int i = 0; i < 40; i++)
+		cycle.runCycleLifetime(50 + ((i % 2) ? 1 : -1) * (40 - i));
+	EXPECT_EQ(cycle.cycles_elapsed(), 0);
+
+	// a copy continues the count exactly where the original left off
+	lifetime_cycle_t * snapshot = cycle.clone();
+	double q = cycle.runCycleLifetime(100);
+	EXPECT_EQ(cycle.cycles_elapsed(), 8);
+	EXPECT_NEAR(cycle.cycle_range(), 31, 1e-9);
+
+	lifetime_cycle_t other(cycles_vs_DOD);
+	other.copy(snapshot);
+	EXPECT_EQ(other.runCycleLifetime(100), q);
+	EXPECT_EQ(other.cycles_elapsed(), 8);
+	delete snapshot;
+
+	// the closed cycles are gone, the next swing counts against the remaining residual
+	cycle.runCycleLifetime(0);
+	other.runCycleLifetime(0);
+	EXPECT_EQ(cycle.cycles_elapsed(), other.cycles_elapsed());
+	EXPECT_EQ(cycle.cycle_range(), other.cycle_range());
+}
+
+TEST_F(LithiumIonLifetime, StateSnapshot_lib_battery)
+{
+	// a 14s88p bank of 2.25 Ah cells
+	util::matrix_t<double> cap_vs_temp;
+	double temps[] = { -10, 60, 0, 80, 25, 100, 40, 100 };
+	cap_vs_temp.assign(temps, 4, 2);
+	double_vec no_loss(8760, 0.);
+
+	battery_t battery(1, battery_t::LITHIUM_ION);
+	capacity_t * capacity = new capacity_lithium_ion_t(198, 50, 95, 15);
+	voltage_t * voltage = new voltage_dynamic_t(14, 88, 3.6, 4.1, 4.05, 3.4, 2.25, 0.04, 2.0, 0.2, 0.001);
+	lifetime_t * lifetime = new lifetime_t(new lifetime_cycle_t(cycles_vs_DOD),
+		new lifetime_calendar_t(lifetime_calendar_t::LITHIUM_ION_CALENDAR_MODEL, util::matrix_t<double>(), 1, 1.02f, 2.66e-3f, -7280, 930), 0, 0);
+	thermal_t * thermal = new thermal_t(50, 0.27, 0.27, 0.27, 1004, 500, 293.15, cap_vs_temp);
+	losses_t * losses = new losses_t(lifetime, thermal, capacity, losses_t::TIMESERIES, no_loss, no_loss, no_loss, no_loss);
+	battery.initialize(capacity, voltage, lifetime, thermal, losses);
+
+	size_t idx = 0;
+	for (; idx < 100; idx++)
+		battery.run(idx, (idx % 12 < 6) ? 30 : -30);
+
+	// run a day, restore the saved state and run it again
+	battery_state state;
+	battery.save_state(state);
+	int cycles_saved = battery.lifetime_model()->cycleModel()->cycles_elapsed();
+	std::vector<double> soc, V, T, q;
+	for (size_t i = 0; i < 24; i++)
+	{
+		battery.run(idx + i, (i % 8 < 3) ? 40 : -25);
+		soc.push_back(battery.battery_soc());
+		V.push_back(battery.battery_voltage());
+		T.push_back(battery.thermal_model()->T_battery());
+		q.push_back(battery.lifetime_model()->capacity_percent());
+	}
+	int cycles = battery.lifetime_model()->cycleModel()->cycles_elapsed();
+	EXPECT_GT(cycles, cycles_saved);
+	EXPECT_GT(T[0], 293.15); // warmed from room temperature (K) by the cycling
+
+	battery.restore_state(state);
+	for (size_t i = 0; i < 24; i++)
+	{
+		battery.run(idx + i, (i % 8 < 3) ? 40 : -25);
+		EXPECT_EQ(battery.battery_soc(), soc[i]);
+		EXPECT_EQ(battery.battery_voltage(), V[i]);
+		EXPECT_EQ(battery.thermal_model()->T_battery(), T[i]);
+		EXPECT_EQ(battery.lifetime_model()->capacity_percent(), q[i]);
+	}
+	EXPECT_EQ(battery.lifetime_model()->cycleModel()->cycles_elapsed(), cycles);
+	battery.delete_clone();
+}
+
+TEST_F(LithiumIonLifetime, DISABLED_Benchmark_lib_battery)
+{
+	// time a 20 year, one minute lifetime simulation with a daily cycle of varying depth
+	const double dt_hour = 1. / 60;
+	const size_t nsteps = 20 * 8760 * 60;
+	capacity_lithium_ion_t capacity(q, SOC_init, SOC_max, SOC_min);
+	lifetime_cycle_t cycle(cycles_vs_DOD);
+	lifetime_calendar_t calendar(lifetime_calendar_t::LITHIUM_ION_CALENDAR_MODEL, util::matrix_t<double>(), dt_hour);
+	lifetime_t lifetime(&cycle, &calendar, 1, 60);
+
+	double ms = benchmark_ms([&]() {
+		for (size_t idx = 0; idx < nsteps; idx++)
+		{
+			size_t minute = idx % 1440;
+			size_t day = idx / 1440;
+			double depth = 0.3 + 0.5 * (day % 7) / 6.;
+			double I = 0;
+			if (minute >= 600 && minute < 840)
+				I = -q * depth / 4;		// charge over four hours
+			else if (minute >= 1080 && minute < 1320)
+				I = q * depth / 4;		// discharge over four hours
+			I += ((minute / 15) % 2 == 0) ? 2 : -2;	// load following between the daily cycle
+
+			capacity.updateCapacity(I, dt_hour);
+			lifetime.runLifetimeModels(idx, &capacity, 293.15);
+			if (lifetime.check_replaced())
+				capacity.replace_battery();
+			capacity.updateCapacityForLifetime(lifetime.capacity_percent());
+		}
+	});
+	record_benchmark("lifetime_20yr_1min", ms);
+
+	RecordProperty("cycles", cycle.cycles_elapsed());
+	EXPECT_GT(cycle.cycles_elapsed(), 0);
+	EXPECT_GT(lifetime.capacity_percent(), 0);
+}
+
+class voltage_table_lookup_t : public voltage_table_t
+{
+public:
+	voltage_table_lookup_t(int num_cells_series, int num_strings, double voltage, util::matrix_t<double> &voltage_table, double R) :
+		voltage_table_t(num_cells_series, num_strings, voltage, voltage_table, R){}
+	using voltage_table_t::exactVoltageFound;
+	using voltage_table_t::prepareInterpolation;
+};
+
+class BatteryVoltage : public BatteryProperties
+{
+protected:
+	util::matrix_t<double> voltage_matrix;
+
+	void SetUp()
+	{
+		BatteryProperties::SetUp();
+
+		// unsorted, with uneven spacing
+		double table[] = { 50, 3.7, 0, 4.1, 3, 4.05, 100, 3.0, 90, 3.4, 10, 4.0, 97.5, 3.2 };
+		voltage_matrix.assign(table, 7, 2);
+	}
+
+	/// Returns the battery power [W] at the end of a step of current I, from a restored state
+	double RunStep(capacity_t & capacity, voltage_t & voltage, double I, double dt_hour)
+	{
+		capacity_state capacity_initial;
+		voltage_state voltage_initial;
+		capacity.save_state(capacity_initial);
+		voltage.save_state(voltage_initial);
+
+		capacity.updateCapacity(I, dt_hour);
+		voltage.updateVoltage(&capacity, 0, dt_hour);
+		double P = I * voltage.battery_voltage();
+
+		capacity.restore_state(capacity_initial);
+		voltage.restore_state(voltage_initial);
+		return P;
+	}
+};
+
+TEST_F(BatteryVoltage, TableLookup_lib_battery)
+{
+	// the grid lookup finds the same rows as a search of the sorted table
+	voltage_table_lookup_t voltage(14, 1, 3.6, voltage_matrix, 0.01);
+	std::vector<table_point> sorted;
+	for (size_t r = 0; r != voltage_matrix.nrows(); r++)
+		sorted.push_back(table_point(voltage_matrix.at(r, 0), voltage_matrix.at(r, 1)));
+	std::sort(sorted.begin(), sorted.end(), byDOD());
+
+	std::vector<double> DODs;
+	for (int i = -500; i <= 10500; i++)
+		DODs.push_back(i * 0.01);
+	for (size_t r = 0; r != sorted.size(); r++)
+		DODs.push_back(sorted[r].DOD());
+
+	for (size_t i = 0; i != DODs.size(); i++)
+	{
+		double DOD = DODs[i];
+		bool exact = false;
+		double V_exact = 0, V = 0;
+		size_t lo = 0, hi = sorted.size() - 1;
+		for (size_t r = 0; r != sorted.size(); r++)
+		{
+			if (!exact && sorted[r].DOD() == DOD)
+			{
+				exact = true;
+				V_exact = sorted[r].V();
+			}
+			if (sorted[r].DOD() <= DOD)
+				lo = r;
+			if (sorted[r].DOD() >= DOD)
+			{
+				hi = r;
+				break;
+			}
+		}
+		ASSERT_EQ(exact, voltage.exactVoltageFound(DOD, V)) << "DOD " << DOD;
+		if (exact)
+			EXPECT_EQ(V_exact, V);
+		else
+		{
+			double DOD_lo, V_lo, DOD_hi, V_hi;
+			voltage.prepareInterpolation(DOD_lo, V_lo, DOD_hi, V_hi, DOD);
+			EXPECT_EQ(sorted[lo].DOD(), DOD_lo) << "DOD " << DOD;
+			EXPECT_EQ(sorted[lo].V(), V_lo);
+			EXPECT_EQ(sorted[hi].DOD(), DOD_hi) << "DOD " << DOD;
+			EXPECT_EQ(sorted[hi].V(), V_hi);
+		}
+	}
+}
+
+TEST_F(BatteryVoltage, CurrentForTargetPower_lib_battery)
+{
+	// the current delivers the target power at the end of the step, across table segments in an hour at this size
+	const double dt_hour = 1.;
+	capacity_lithium_ion_t capacity(15, 60, 100, 0);
+	voltage_table_t table(14, 1, 4.1, voltage_matrix, 0.01);
+	voltage_dynamic_t dynamic(14, 1, 3.6, 4.1, 4.05, 3.4, 15, 0.3, 13.3, 0.2, 0.01);
+
+	double powers[] = { 300, 150, 20, -20, -150, -300 };
+	for (size_t i = 0; i != 6; i++)
+	{
+		double P = powers[i];
+		double I = table.calculate_current_for_target_power(P, &capacity, dt_hour);
+		EXPECT_NEAR(P, RunStep(capacity, table, I, dt_hour), 1e-6 * fabs(P)) << "table " << P;
+
+		I = dynamic.calculate_current_for_target_power(P, &capacity, dt_hour);
+		EXPECT_NEAR(P, RunStep(capacity, dynamic, I, dt_hour), 1e-5 * fabs(P)) << "dynamic " << P;
+
+		// dividing by the nominal voltage misses the target
+		I = P / table.battery_voltage_nominal();
+		EXPECT_GT(fabs(P - RunStep(capacity, table, I, dt_hour)), 1e-3 * fabs(P));
+	}
+}
+
+class thermal_reference_t : public thermal_t
+{
+public:
+	thermal_reference_t(double mass, double length, double width, double height, double Cp, double h, double T_room, const util::matrix_t<double> &cap_vs_temp) :
+		thermal_t(mass, length, width, height, Cp, h, T_room, cap_vs_temp){}
+	using thermal_t::rk4;
+	using thermal_t::trapezoidal;
+	void set_T_battery(double T){ _T_battery = T; }
+	void set_R(double R){ _R = R; }
+};
+
+class BatteryThermal : public BatteryProperties
+{
+protected:
+	util::matrix_t<double> cap_vs_temp;
+
+	void SetUp()
+	{
+		BatteryProperties::SetUp();
+		double temps[] = { -10, 60, 0, 80, 25, 100, 40, 100 };
+		cap_vs_temp.assign(temps, 4, 2);
+	}
+};
+
+TEST_F(BatteryThermal, ClosedFormStep_lib_battery)
+{
+	// the 14s88p bank of StateSnapshot_lib_battery, stepped through its cycles, against the iterative forms
+	const double R = 0.2 * 14 / 88;
+	thermal_t thermal(50, 0.27, 0.27, 0.27, 1004, 500, 293.15, cap_vs_temp);
+	thermal_reference_t reference(50, 0.27, 0.27, 0.27, 1004, 500, 293.15, cap_vs_temp);
+	reference.set_R(R);
+
+	double dt_hours[] = { 1., 1. / 60 };
+	for (size_t d = 0; d != 2; d++)
+	{
+		double dt_hour = dt_hours[d];
+		size_t nsteps = (size_t)(24 / dt_hour);
+		for (size_t idx = 0; idx != nsteps; idx++)
+		{
+			size_t hour = (size_t)(idx * dt_hour);
+			double I = (hour % 12 < 6) ? 300 : -300;
+			if (hour >= 12)
+				I = (hour % 8 < 3) ? 400 : -250;
+
+			double T_initial = thermal.T_battery();
+			thermal.updateTemperature(I, R, dt_hour);
+
+			// rk4 in one second steps is converged
+			reference.set_T_battery(T_initial);
+			size_t nsub = (size_t)(dt_hour * 3600);
+			for (size_t s = 0; s != nsub; s++)
+				reference.set_T_battery(reference.rk4(I, 1.));
+			EXPECT_NEAR(reference.T_battery(), thermal.T_battery(), 1e-9) << "step " << idx;
+
+			// the previous single trapezoidal step agrees to within a percent of the change once the step is
+			// short beside the time constant
+			if (dt_hour < 1)
+			{
+				reference.set_T_battery(T_initial);
+				double dT = fabs(thermal.T_battery() - T_initial);
+				EXPECT_NEAR(reference.trapezoidal(I, dt_hour * 3600), thermal.T_battery(), 1e-2 * dT + 1e-9) << "step " << idx;
+			}
+		}
+		EXPECT_GT(thermal.T_battery(), 293.15);
+	}
+}
+
+TEST_F(BatteryThermal, CapacityLookup_lib_battery)
+{
+	// the grid lookup interpolates the same rows as a search of the table, including beyond its ends
+	thermal_reference_t thermal(50, 0.27, 0.27, 0.27, 1004, 500, 20, cap_vs_temp);
+	util::matrix_t<double> cap_vs_T = cap_vs_temp;
+	for (size_t r = 0; r != cap_vs_T.nrows(); r++)
+		cap_vs_T.at(r, 0) += 273.15;
+
+	for (int i = -2000; i <= 5000; i++)
+	{
+		double T = 273.15 + i * 0.01;
+		thermal.set_T_battery(T);
+		EXPECT_EQ(util::linterp_col(cap_vs_T, 0, T, 1), thermal.capacity_percent()) << "T " << T;
+	}
+	for (size_t r = 0; r != cap_vs_T.nrows(); r++)
+	{
+		thermal.set_T_battery(cap_vs_T.at(r, 0));
+		EXPECT_EQ(cap_vs_T.at(r, 1), thermal.capacity_percent());
+	}
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <lib_cec6par.h>
+
+#include "benchmark_test.h"
+
+/**
+* Cell temperature model tests and a per-model timing benchmark
+*/
+
+class CellTempTest : public ::testing::Test {
+protected:
+	cec6par_module_t module;
+	double e = 0.05;
+public:
+	void SetUp() {
+		module.Area = 1.631;
+		module.Vmp = 54.7;
+		module.Imp = 5.83;
+		module.Voc = 64.4;
+		module.Isc = 6.24;
+		module.alpha_isc = 0.0026;
+		module.beta_voc = -0.177;
+		module.a = 2.5776;
+		module.Il = 6.246;
+		module.Io = 9.4e-11;
+		module.Rs = 0.0928;
+		module.Rsh = 602.5;
+		module.Adj = 7.3;
+	}
+
+	/// A synthetic year of hourly conditions with a daily cycle and passing clouds
+	pvinput_t hour(int h, double tilt = 25) {
+		int hr = h % 24;
+		double s = sin(M_PI * (hr - 6) / 12.);
+		if (s < 0) s = 0;
+		double cloud = 0.6 + 0.4 * sin(h * 0.37);
+		double ib = 800 * s * cloud, id = 120 * s, ig = 30 * s;
+		return pvinput_t(ib, id, ig, 0, ib + id + ig, 20 + 10 * sin(h / 24 / 58.) + 8 * s, 5, 1 + 3 * fabs(sin(h * 0.11)), 200, 1013,
+			90 - 70 * s, 40 - 20 * s, 300, tilt, 180, hr, 0, s > 0);
+	}
+
+	void setupMCSP(mcsp_celltemp_t &tc, int MC, int HTD, int MSO) {
+		tc.DcDerate = 0.95;
+		tc.MC = MC;
+		tc.HTD = HTD;
+		tc.MSO = MSO;
+		tc.Nrows = 2;
+		tc.Ncols = 10;
+		tc.Length = 1.6;
+		tc.Width = 1.0;
+		tc.Wgap = 0.05;
+		tc.TbackInteg = 40;
+	}
+
+	void setupNOCT(noct_celltemp_t &tc) {
+		tc.standoff_tnoct_adj = 2;
+		tc.ffv_wind = 0.61;
+		tc.Tnoct = 46;
+	}
+};
+
+TEST_F(CellTempTest, MCSPWarmStartMatchesColdStart_lib_cec6par) {
+	int configs[][3] = { { 1, 1, 1 }, { 2, 1, 1 }, { 3, 1, 1 }, { 4, 1, 1 }, { 4, 1, 2 }, { 4, 1, 3 }, { 1, 2, 1 } };
+	for (auto &c : configs) {
+		mcsp_celltemp_t warm, cold;
+		setupMCSP(warm, c[0], c[1], c[2]);
+		setupMCSP(cold, c[0], c[1], c[2]);
+		warm.WarmStart = true;
+		for (int h = 0; h < 24 * 30; h++) {
+			pvinput_t in = hour(h);
+			double tw = in.Tdry, tcold = in.Tdry;
+			ASSERT_TRUE(warm(in, module, -1, tw));
+			ASSERT_TRUE(cold(in, module, -1, tcold));
+			EXPECT_NEAR(tw, tcold, e) << "MC=" << c[0] << " HTD=" << c[1] << " MSO=" << c[2] << " hour " << h;
+		}
+	}
+}
+
+TEST_F(CellTempTest, MCSPTiltChange_lib_cec6par) {
+	// constants that depend on tilt must follow a tracking surface
+	mcsp_celltemp_t tracked;
+	setupMCSP(tracked, 1, 1, 1);
+	for (int h = 6; h < 18; h++) {
+		double tilt = 5 + 4 * h;
+		pvinput_t in = hour(h, tilt);
+		mcsp_celltemp_t fresh;
+		setupMCSP(fresh, 1, 1, 1);
+		double t1 = in.Tdry, t2 = in.Tdry;
+		tracked(in, module, -1, t1);
+		fresh(in, module, -1, t2);
+		EXPECT_NEAR(t1, t2, e) << "tilt " << tilt;
+	}
+}
+
+TEST_F(CellTempTest, NOCT_lib_cec6par) {
+	noct_celltemp_t noct;
+	setupNOCT(noct);
+	// without cover effects the NOCT model reduces to the closed form below
+	pvinput_t in = hour(12);
+	in.radmode = 3;
+	double G = in.Ibeam + in.Idiff + in.Ignd;
+	double eff_ref = module.Imp * module.Vmp / (1000 * module.Area);
+	double expected = in.Tdry + G / 800 * (46 + 2 - 20) * (1 - eff_ref / 0.9) * 9.5 / (5.7 + 3.8 * in.Wspd * 0.61);
+	double tc = in.Tdry;
+	noct(in, module, -1, tc);
+	EXPECT_NEAR(tc, expected, 0.001);
+
+	in = hour(0);
+	tc = in.Tdry;
+	noct(in, module, -1, tc);
+	EXPECT_NEAR(tc, in.Tdry, e);
+}
+
+TEST_F(CellTempTest, DISABLED_Benchmark_lib_cec6par) {
+	// time one year of hourly steps for each cell temperature model
+	const int nsteps = 8760;
+	auto run = [&](pvcelltemp_t &tc, const char *name) {
+		bool ok = true;
+		double ms = benchmark_ms([&]() {
+			for (int h = 0; h < nsteps; h++) {
+				pvinput_t in = hour(h);
+				double t = in.Tdry;
+				ok = tc(in, module, -1, t) && ok;
+			}
+		});
+		EXPECT_TRUE(ok) << name;
+		record_benchmark(name, ms);
+	};
+
+	noct_celltemp_t noct;
+	setupNOCT(noct);
+	run(noct, "noct");
+
+	const char *names[] = { "mcsp_rack", "mcsp_flush", "mcsp_integ", "mcsp_gap" };
+	for (int mc = 1; mc <= 4; mc++) {
+		mcsp_celltemp_t mcsp;
+		setupMCSP(mcsp, mc, 1, 1);
+		run(mcsp, names[mc - 1]);
+	}
+}
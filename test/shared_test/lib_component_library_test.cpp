@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <lib_component_library.h>
+
+/**
+* Indexing and looking up components in a module library
+*/
+
+class ComponentLibraryTest : public ::testing::Test {
+protected:
+	std::string text;
+public:
+	void SetUp() {
+		text = "Name,cec_material,cec_v_oc_ref,cec_i_sc_ref,Notes\r\n"
+			"Acme 300,1,45.1,9.2,\r\n"
+			"\"Widgets, Inc. WX-350\",2,47.3,9.7,\"rated \"\"bifacial\"\"\"\r\n"
+			"\r\n"
+			"Short Row,3\r\n"
+			"Acme 300,4,1,1,duplicate";
+	}
+};
+
+TEST_F(ComponentLibraryTest, FindAndFields_lib_component_library) {
+	component_library lib;
+	ASSERT_TRUE(lib.parse(text));
+	ASSERT_EQ(5, (int)lib.columns().size());
+	EXPECT_EQ("cec_i_sc_ref", lib.columns()[3]);
+	EXPECT_EQ(4, (int)lib.size());
+
+	std::vector<std::string> fields;
+	size_t i = lib.find("Widgets, Inc. WX-350");
+	ASSERT_NE(component_library::npos, i);
+	lib.fields(i, fields);
+	ASSERT_EQ(5, (int)fields.size());
+	EXPECT_EQ("2", fields[1]);
+	EXPECT_EQ("47.3", fields[2]);
+	EXPECT_EQ("rated \"bifacial\"", fields[4]);
+
+	// the first of two entries with the same name, trailing empty field
+	lib.fields(lib.find("Acme 300"), fields);
+	EXPECT_EQ("1", fields[1]);
+	EXPECT_EQ("", fields[4]);
+
+	// missing fields are empty
+	lib.fields(lib.find("Short Row"), fields);
+	EXPECT_EQ("3", fields[1]);
+	EXPECT_EQ("", fields[2]);
+
+	EXPECT_EQ(component_library::npos, lib.find("Acme"));
+	EXPECT_FALSE(lib.parse("Name\n"));
+}
+
+TEST_F(ComponentLibraryTest, OpenShared_lib_component_library) {
+	std::string file = "component_library_test.csv";
+	FILE *fp = fopen(file.c_str(), "wb");
+	ASSERT_TRUE(fp != 0);
+	fputs(text.c_str(), fp);
+	fclose(fp);
+
+	std::string err;
+	std::shared_ptr<const component_library> a = component_library::open(file, err);
+	std::shared_ptr<const component_library> b = component_library::open(file, err);
+	ASSERT_TRUE(a != 0);
+	EXPECT_EQ(a.get(), b.get());
+	EXPECT_EQ("Short Row", a->name(a->find("Short Row")));
+	remove(file.c_str());
+
+	EXPECT_TRUE(component_library::open(file, err) == 0);
+	EXPECT_FALSE(err.empty());
+}
+
+TEST_F(ComponentLibraryTest, OpenCacheBounded_lib_component_library) {
+	std::vector<std::string> files;
+	for (size_t i = 0; i <= component_library::max_cached; i++)
+	{
+		files.push_back("component_library_test_" + std::to_string(i) + ".csv");
+		FILE *fp = fopen(files.back().c_str(), "wb");
+		ASSERT_TRUE(fp != 0);
+		fputs(text.c_str(), fp);
+		fclose(fp);
+	}
+
+	// opening one more file than the cache holds drops the least recently opened
+	std::string err;
+	std::shared_ptr<const component_library> first = component_library::open(files[0], err);
+	std::shared_ptr<const component_library> last;
+	for (size_t i = 1; i < files.size(); i++)
+		last = component_library::open(files[i], err);
+	ASSERT_TRUE(first != 0);
+	ASSERT_TRUE(last != 0);
+	EXPECT_EQ(last.get(), component_library::open(files.back(), err).get());
+	std::shared_ptr<const component_library> reopened = component_library::open(files[0], err);
+	ASSERT_TRUE(reopened != 0);
+	EXPECT_NE(first.get(), reopened.get());
+	EXPECT_EQ("Short Row", reopened->name(reopened->find("Short Row")));
+
+	for (size_t i = 0; i < files.size(); i++)
+		remove(files[i].c_str());
+}
@@ -109,6 +109,42 @@ TEST_F(SunsetCaseIrradProc, solarposTest_lib_irradproc){
 	}
 }
 
+/**
+*   Night time steps from the daily sunrise and sunset compared with solarpos_timestep() for a year of
+*   hourly and 15 minute steps, including a high latitude with polar days and nights
+*/
+TEST_F(IrradTest, daylightMaskTest_lib_irradproc){
+	double lats[] = { lat, 70.0 };
+	double delts[] = { 1, 0.25, IRRADPROC_NO_INTERPOLATE_SUNRISE_SUNSET };
+	for (double la : lats) {
+		for (double delt : delts) {
+			daylight_mask daylight(la, lon, tz, delt);
+			int steps = (delt == 0.25) ? 4 : 1;
+			int nnight = 0;
+			for (int m = 1; m <= 12; m++) {
+				for (int d = 1; d <= (int)util::nday[m - 1]; d++) {
+					for (int i = 0; i < 24 * steps; i++) {
+						int h = i / steps;
+						double minute = 60.0 * (i % steps) / steps;
+						double sun[9], cached[9];
+						int tsp[3], cached_tsp[3];
+						solarpos_timestep(year, m, d, h, minute, delt, la, lon, tz, sun, tsp);
+						bool night = daylight.night(year, m, d, h, minute);
+						solarpos_timestep(year, m, d, h, minute, delt, la, lon, tz, daylight.noon(), cached, cached_tsp);
+						ASSERT_EQ(tsp[2] == 0, night) << "lat " << la << " delt " << delt << " m " << m << " d " << d << " h " << h << " min " << minute;
+						for (int k = 0; k < 3; k++)
+							EXPECT_EQ(tsp[k], cached_tsp[k]);
+						for (int k = 0; k < 9; k++)
+							EXPECT_EQ(sun[k], cached[k]);
+						if (night) nnight++;
+					}
+				}
+			}
+			EXPECT_GT(nnight, 0);
+		}
+	}
+}
+
 /**
 * Solar Incidence Function Test
 * Mode = 0 for fixed tilt.
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <lib_pv_shade_loss_mpp.h>
+
+/**
+* The closed form string shade pattern index compared with the original enumeration of the shading database patterns
+*/
+
+class ShadeDB8PatternTest : public ::testing::Test {
+protected:
+	ShadeDB8_mpp db; // not initialized, so only the steps which never read the database may be evaluated
+public:
+	/// The nested loops of the original get_shade_loss, which count the patterns { s_max, i2, i3, ... } up to the matching one
+	static size_t enumerate(std::vector<double> shade_frac, bool &found) {
+		size_t num_strings = shade_frac.size();
+		std::sort(shade_frac.begin(), shade_frac.end(), std::greater<double>());
+		std::vector<int> str_shade;
+		for (size_t i = 0; i < num_strings; i++)
+			str_shade.push_back((int)round(shade_frac[i] / 10.0));
+		found = (num_strings == 1);
+		if (num_strings == 1)
+			return 1;
+		size_t counter = 0;
+		std::vector<int> cur_case(num_strings, 0);
+		cur_case[0] = *std::max_element(str_shade.begin(), str_shade.end());
+		enumerate_level(1, cur_case[0], str_shade, cur_case, counter, found);
+		return counter;
+	}
+
+	/// The loop for string i, which like the original stops after the match only once the loop over the last string has run out
+	/// if there are three or more strings
+	static void enumerate_level(size_t i, int upper, const std::vector<int> &str_shade, std::vector<int> &cur_case, size_t &counter, bool &found) {
+		size_t num_strings = str_shade.size();
+		for (int s = 0; s <= upper; s++) {
+			cur_case[i] = s;
+			if (i == num_strings - 1) {
+				counter++;
+				if (str_shade == cur_case)
+					found = true;
+				if (num_strings == 2 && found) break;
+			}
+			else {
+				enumerate_level(i + 1, s, str_shade, cur_case, counter, found);
+				if (found) break;
+			}
+		}
+	}
+
+	/// Shade fractions (%) for a number of strings from a simple generator, with some strings unshaded or fully shaded
+	static std::vector<double> shade_fractions(size_t num_strings, unsigned &seed) {
+		std::vector<double> shade_frac(num_strings);
+		for (size_t i = 0; i < num_strings; i++) {
+			seed = seed * 1103515245 + 12345;
+			unsigned r = (seed >> 8) % 1000;
+			shade_frac[i] = (r < 200) ? 0 : ((r > 900) ? 100 : (r - 200) / 7.0);
+		}
+		return shade_frac;
+	}
+};
+
+TEST_F(ShadeDB8PatternTest, RankMatchesEnumeration_lib_pv_shade_loss_mpp) {
+	unsigned seed = 17;
+	int nlookup = 0;
+	for (size_t num_strings = 1; num_strings <= 8; num_strings++) {
+		for (int trial = 0; trial < 2000; trial++) {
+			std::vector<double> shade_frac = shade_fractions(num_strings, seed);
+			ShadeDB8_mpp::shade_pattern pattern = ShadeDB8_mpp::get_shade_pattern(&shade_frac[0], num_strings);
+			double s_sum = 0;
+			for (size_t i = 0; i < num_strings; i++)
+				s_sum += round(shade_frac[i] / 10.0);
+			if (s_sum <= 0) {
+				EXPECT_EQ(ShadeDB8_mpp::shade_pattern::NO_LOSS, pattern.type);
+				continue;
+			}
+			ASSERT_EQ(ShadeDB8_mpp::shade_pattern::LOOKUP, pattern.type);
+			bool found;
+			size_t counter = enumerate(shade_frac, found);
+			EXPECT_TRUE(found);
+			EXPECT_EQ(counter, pattern.counter) << "strings " << num_strings << " trial " << trial;
+			nlookup++;
+		}
+	}
+	EXPECT_GT(nlookup, 10000);
+}
+
+TEST_F(ShadeDB8PatternTest, NoLoss_lib_pv_shade_loss_mpp) {
+	// unshaded strings, or no irradiance, have no loss whatever the number of strings
+	for (size_t num_strings = 1; num_strings <= 12; num_strings++) {
+		std::vector<double> unshaded(num_strings, 0.);
+		unshaded[0] = 4; // rounds to zero
+		ShadeDB8_mpp::shade_pattern pattern = ShadeDB8_mpp::get_shade_pattern(&unshaded[0], num_strings);
+		EXPECT_EQ(ShadeDB8_mpp::shade_pattern::NO_LOSS, pattern.type);
+		EXPECT_EQ(0., db.get_shade_loss(800, 100, pattern));
+		EXPECT_EQ(0., db.get_shade_loss(800, 100, &unshaded[0], num_strings));
+
+		std::vector<double> shaded(num_strings, 50.);
+		EXPECT_EQ(0., db.get_shade_loss(0, 0, &shaded[0], num_strings));
+		EXPECT_EQ(0., db.get_shade_loss(-1, 0, ShadeDB8_mpp::get_shade_pattern(&shaded[0], num_strings)));
+	}
+}
+
+TEST_F(ShadeDB8PatternTest, MoreThanEightStrings_lib_pv_shade_loss_mpp) {
+	// shaded patterns of more than 8 strings are not in the database, and lose all power only while the sun is up
+	std::vector<double> shade_frac(12, 0.);
+	shade_frac[3] = 30;
+	ShadeDB8_mpp::shade_pattern pattern = ShadeDB8_mpp::get_shade_pattern(&shade_frac[0], shade_frac.size());
+	EXPECT_EQ(ShadeDB8_mpp::shade_pattern::FULL_LOSS, pattern.type);
+	EXPECT_EQ(1., db.get_shade_loss(800, 100, pattern));
+	EXPECT_EQ(0., db.get_shade_loss(0, 0, pattern));
+
+	double gpoa = 800, dpoa = 100;
+	EXPECT_EQ(1., db.get_shade_loss(gpoa, dpoa, shade_frac));
+}
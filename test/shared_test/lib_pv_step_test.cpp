@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include <lib_pv_step.h>
+#include <lib_cec6par.h>
+#include <lib_irradproc.h>
+#include <lib_weatherfile.h>
+
+/// Cell temperature model with a first order lag, to check that state is carried between time steps
+class lagged_celltemp_t : public pvcelltemp_t
+{
+public:
+	double Tlast = -999;
+	virtual bool operator() (pvinput_t &input, pvmodule_t &, double, double &Tcell) {
+		double Tss = input.Tdry + 0.03 * (input.Ibeam + input.Idiff + input.Ignd);
+		Tcell = (Tlast < -99) ? Tss : 0.5 * (Tlast + Tss);
+		Tlast = Tcell;
+		return true;
+	}
+};
+
+class PVStepModelTest : public ::testing::Test {
+protected:
+	spe_module_t module;
+	lagged_celltemp_t celltemp;
+	sandia_inverter_t sinv;
+	partload_inverter_t plinv;
+	ond_inverter ondinv;
+	SharedInverter * inv;
+	PVStepModel * model;
+	std::vector<pvinput_t> in;
+	double e = 0.001;
+public:
+	void SetUp() {
+		module.VmpNominal = 30;
+		module.VocNominal = 36;
+		module.Area = 1.6;
+		module.Gamma = -0.4;
+		for (int i = 0; i < 5; i++) {
+			module.Rad[i] = 200. * (i + 1);
+			module.Eff[i] = 0.15;
+		}
+		module.Reference = 4;
+
+		sinv.Paco = 4000;
+		sinv.Pdco = 4200;
+		sinv.Vdco = 300;
+		sinv.Pso = 20;
+		sinv.Pntare = 1;
+		sinv.C0 = sinv.C1 = sinv.C2 = sinv.C3 = 0;
+
+		inv = new SharedInverter(SharedInverter::SANDIA_INVERTER, 1, &sinv, &plinv, &ondinv);
+		model = new PVStepModel(inv);
+		model->addSubarray(&module, &celltemp, 10, 2, 0.05);
+		in.resize(1);
+	}
+	void TearDown() {
+		delete model;
+		delete inv;
+	}
+	void setIrradiance(double ibeam, double tdry) {
+		in[0] = pvinput_t(ibeam, 100, 20, 0, ibeam + 120, tdry, 0, 1, 0, 1013, 30, 20, 0, 20, 180, 12, 0, false);
+	}
+};
+
+TEST_F(PVStepModelTest, DCPowerAndInverter_lib_pv_step) {
+	setIrradiance(880, 20);
+	model->step(in, true, 20);
+
+	// 1000 W/m2 on a 15% 1.6 m2 module, 25 'C steady state cell temperature
+	double tcell = 20 + 0.03 * 1000;
+	double modulePower = 0.15 * 1000 * 1.6 * (1 - 0.004 * (tcell - 25));
+	const PVStepModel::SubarrayOutput & out = model->subarrayOutput(0);
+	EXPECT_NEAR(out.cellTemperature, tcell, e);
+	EXPECT_NEAR(out.modulePowerW, modulePower, e);
+	EXPECT_NEAR(model->dcPower_kW, modulePower * 20 * 0.95 * 0.001, e);
+	EXPECT_NEAR(model->mpptVoltage(0), 300, e);
+	EXPECT_NEAR(model->acPower_kW, inv->powerAC_kW, e);
+	EXPECT_GT(model->acPower_kW, 0.9 * model->dcPower_kW);
+	EXPECT_LT(model->acPower_kW, model->dcPower_kW);
+}
+
+TEST_F(PVStepModelTest, CellTemperatureState_lib_pv_step) {
+	setIrradiance(880, 20);
+	model->step(in, true, 20);
+	double t1 = model->subarrayOutput(0).cellTemperature;
+
+	// a cloud passes: the lagged cell temperature is between the old and the new steady state
+	setIrradiance(0, 20);
+	model->step(in, true, 20);
+	double t2 = model->subarrayOutput(0).cellTemperature;
+	EXPECT_NEAR(t2, 0.5 * (t1 + 20 + 0.03 * 120), e);
+}
+
+TEST_F(PVStepModelTest, Night_lib_pv_step) {
+	setIrradiance(0, 10);
+	model->step(in, false, 10);
+	EXPECT_NEAR(model->subarrayOutput(0).cellTemperature, 10, e);
+	EXPECT_NEAR(model->dcPower_kW, 0, e);
+	EXPECT_NEAR(model->acPower_kW, -0.001, e);
+}
+
+TEST_F(PVStepModelTest, WeatherRecord_lib_pv_step) {
+	// a clear day at a fixed tilt, stepped on weather records and on module inputs from the irradiance model
+	double lat = 33.45, lon = -112.07, tz = -7, elev = 358;
+	model->setSite(lat, lon, tz, elev, 1, true);
+	model->setSurface(0, 0, 20, 180);
+
+	lagged_celltemp_t celltemp2;
+	PVStepModel model2(inv);
+	model2.addSubarray(&module, &celltemp2, 10, 2, 0.05);
+
+	double dailyAC = 0;
+	for (int h = 0; h < 24; h++) {
+		weather_record wf;
+		wf.year = 2017; wf.month = 6; wf.day = 21; wf.hour = h; wf.minute = 30;
+		double sun = (h > 5 && h < 19) ? sin(M_PI * (h - 5) / 14.) : 0;
+		wf.dn = 850 * sun;
+		wf.df = 100 * sun;
+		wf.gh = wf.df + 0.9 * wf.dn;
+		wf.tdry = 25 + 10 * sun;
+		wf.tdew = 5; wf.wspd = 2; wf.wdir = 180; wf.pres = 1013;
+		ASSERT_EQ(0, model->step(wf));
+
+		irrad irr;
+		irr.set_time(wf.year, wf.month, wf.day, wf.hour, wf.minute, 1);
+		irr.set_location(lat, lon, tz);
+		irr.set_sky_model(2, 0.2);
+		irr.set_beam_diffuse(wf.dn, wf.df);
+		irr.set_surface(0, 20, 180, 45, false, 0.3);
+		ASSERT_EQ(0, irr.calc());
+		double solazi, solzen, solalt, aoi, stilt, sazi, rot, btd, ibeam, iskydiff, ignddiff;
+		int sunup;
+		irr.get_sun(&solazi, &solzen, &solalt, 0, 0, 0, &sunup, 0, 0, 0);
+		irr.get_angles(&aoi, &stilt, &sazi, &rot, &btd);
+		irr.get_poa(&ibeam, &iskydiff, &ignddiff, 0, 0, 0);
+		in[0] = pvinput_t(ibeam, iskydiff, ignddiff, 0, 0, wf.tdry, wf.tdew, wf.wspd, wf.wdir, wf.pres,
+			solzen, aoi, elev, stilt, sazi, h + 0.5, 0, false);
+		model2.step(in, sunup > 0, wf.tdry);
+
+		const PVStepModel::SubarrayOutput & out = model->subarrayOutput(0);
+		EXPECT_NEAR(out.poaFront, ibeam + iskydiff + ignddiff, e) << "hour " << h;
+		EXPECT_NEAR(out.cellTemperature, model2.subarrayOutput(0).cellTemperature, e) << "hour " << h;
+		EXPECT_NEAR(model->acPower_kW, model2.acPower_kW, e) << "hour " << h;
+		if (sunup <= 0)
+			EXPECT_NEAR(model->dcPower_kW, 0, e) << "hour " << h;
+		dailyAC += model->acPower_kW;
+	}
+	EXPECT_GT(dailyAC, 10.);
+}
+
+TEST_F(PVStepModelTest, MCSPWarmStart_lib_pv_step) {
+	// the step model warm starts an MCSP cell temperature model, which must match one started cold at every step
+	cec6par_module_t cec;
+	cec.Area = 1.631;
+	cec.Vmp = 54.7;
+	cec.Imp = 5.83;
+	cec.Voc = 64.4;
+	cec.Isc = 6.24;
+	cec.alpha_isc = 0.0026;
+	cec.beta_voc = -0.177;
+	cec.a = 2.5776;
+	cec.Il = 6.246;
+	cec.Io = 9.4e-11;
+	cec.Rs = 0.0928;
+	cec.Rsh = 602.5;
+	cec.Adj = 7.3;
+
+	mcsp_celltemp_t warm, cold;
+	for (mcsp_celltemp_t * tc : { &warm, &cold }) {
+		tc->DcDerate = 0.95;
+		tc->MC = 1;
+		tc->HTD = 1;
+		tc->MSO = 1;
+		tc->Nrows = 2;
+		tc->Ncols = 6;
+		tc->Length = 1.6;
+		tc->Width = 1.0;
+		tc->Wgap = 0.05;
+		tc->TbackInteg = 40;
+	}
+	PVStepModel mcspModel(inv);
+	mcspModel.addSubarray(&cec, &warm, 6, 2, 0.05);
+	EXPECT_TRUE(warm.WarmStart);
+	EXPECT_FALSE(cold.WarmStart);
+
+	for (int h = 0; h < 24 * 14; h++) {
+		int hr = h % 24;
+		double s = std::max(0., sin(M_PI * (hr - 6) / 12.));
+		double cloud = 0.6 + 0.4 * sin(h * 0.37);
+		double ib = 800 * s * cloud, id = 120 * s, ig = 30 * s;
+		in[0] = pvinput_t(ib, id, ig, 0, ib + id + ig, 20 + 8 * s, 5, 1 + 3 * fabs(sin(h * 0.11)), 200, 1013,
+			90 - 70 * s, 40 - 20 * s, 300, 25, 180, hr, 0, false);
+		mcspModel.step(in, s > 0, in[0].Tdry);
+
+		double tcold = in[0].Tdry;
+		pvoutput_t out(0, 0, 0, 0, 0, 0, 0, 0);
+		if (s > 0) {
+			ASSERT_TRUE(cold(in[0], cec, -1, tcold));
+			cec(in[0], tcold, -1, out);
+		}
+		EXPECT_NEAR(mcspModel.subarrayOutput(0).cellTemperature, tcold, 0.05) << "hour " << h;
+		EXPECT_NEAR(mcspModel.subarrayOutput(0).modulePowerW, out.Power, 0.05) << "hour " << h;
+	}
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <lib_irradproc.h>
+#include <lib_pvshade.h>
+
+/**
+* Tabulated self-shading geometry compared with the exact calculation
+*/
+
+class SelfShadeTableTest : public ::testing::Test {
+protected:
+	ssinputs inputs;
+	double tol = 0.001;
+public:
+	void SetUp() {
+		inputs.nmodx = 12;
+		inputs.nmody = 2;
+		inputs.nrows = 10;
+		inputs.nstrx = 1;
+		inputs.mod_orient = 0;
+		inputs.str_orient = 1;
+		inputs.ndiode = 3;
+		inputs.width = 0.98;
+		inputs.length = 1.67;
+		inputs.row_space = inputs.nmody * inputs.length / 0.5;
+		inputs.Vmp = 31;
+		inputs.FF0 = 0.78;
+		inputs.mask_angle_calc_method = 0;
+	}
+};
+
+TEST_F(SelfShadeTableTest, FixedTiltMatchesExact_lib_pvshade) {
+	double tilt = 30, azimuth = 180;
+	ss_table table;
+	table.init_fixed(inputs, tilt, azimuth, tol);
+	EXPECT_GT(table.exact_fraction(), 0);
+	EXPECT_LT(table.exact_fraction(), 0.5);
+
+	int ntabulated = 0;
+	for (double zen = 0.3; zen < 90; zen += 0.7) {
+		for (double azi = 0.1; azi < 360; azi += 1.3) {
+			ssoutputs exact, tabulated;
+			for (int linear = 0; linear < 2; linear++) {
+				ASSERT_TRUE(ss_exec(inputs, tilt, azimuth, zen, azi, 800, 600, 150, 0.2, false, linear == 1, 0, exact));
+				ASSERT_TRUE(ss_exec(inputs, tilt, azimuth, zen, azi, 800, 600, 150, 0.2, false, linear == 1, 0, tabulated, &table));
+				if (linear)
+					EXPECT_NEAR(exact.m_shade_frac_fixed, tabulated.m_shade_frac_fixed, tol) << "zen " << zen << " azi " << azi;
+				else {
+					EXPECT_NEAR(exact.m_dc_derate, tabulated.m_dc_derate, tol) << "zen " << zen << " azi " << azi;
+					EXPECT_DOUBLE_EQ(exact.m_diffuse_derate, tabulated.m_diffuse_derate);
+				}
+			}
+			double values[2];
+			if (table.lookup(azi, zen, values)) ntabulated++;
+		}
+	}
+	EXPECT_GT(ntabulated, 0);
+}
+
+TEST_F(SelfShadeTableTest, OneAxisMatchesExact_lib_pvshade) {
+	double axis_tilt = 0, axis_azimuth = 180, rotlim = 45, gcr = 0.5;
+	ss_table table;
+	table.init_1x(inputs, axis_tilt, axis_azimuth, rotlim, gcr, tol);
+	EXPECT_LT(table.exact_fraction(), 0.5);
+
+	for (double zen = 0.3; zen < 90; zen += 0.7) {
+		for (double azi = 0.1; azi < 360; azi += 1.3) {
+			double angle[5];
+			incidence(1, axis_tilt, axis_azimuth, rotlim, zen * M_PI / 180, azi * M_PI / 180, false, gcr, angle);
+			double exact = shadeFraction1x(azi, zen, axis_tilt, axis_azimuth, gcr, angle[3] * 180 / M_PI);
+			double values[2];
+			if (table.lookup(azi, zen, values))
+				EXPECT_NEAR(exact, values[0], tol) << "zen " << zen << " azi " << azi;
+		}
+	}
+}
+
+TEST_F(SelfShadeTableTest, OutOfRange_lib_pvshade) {
+	ss_table table;
+	double values[2];
+	EXPECT_FALSE(table.lookup(180, 45, values));
+	table.init_fixed(inputs, 30, 180, tol);
+	EXPECT_FALSE(table.lookup(180, 95, values));
+	EXPECT_FALSE(table.lookup(-1, 45, values));
+	EXPECT_FALSE(table.lookup(360, 45, values));
+}
@@ -186,3 +186,53 @@ TEST_F(sharedInverterTest, tempDerateTest_lib_shared_inverter) {
 	EXPECT_NEAR(pAC, 60, e) << "case 9";
 
 }
+
+TEST_F(sharedInverterTest, seriesMatchesTimestep_lib_shared_inverter) {
+	sinv.Paco = 3800;
+	sinv.Pdco = 3928.11;
+	sinv.Vdco = 398.497;
+	sinv.Pso = 19.4516;
+	sinv.Pntare = 0.99;
+	sinv.C0 = -3.0e-6;
+	sinv.C1 = -5.1e-5;
+	sinv.C2 = 0.00198;
+	sinv.C3 = -0.00226;
+	std::vector<double> c1 = { 200., 20., -0.2, 40., -0.4 };
+	std::vector<double> c2 = { 300., 30., -0.3, 60., -0.6 };
+	EXPECT_FALSE(inv->setTempDerateCurves({ c1, c2 }));
+
+	std::vector<double> powerDC_kW, voltage, T;
+	for (size_t i = 0; i < 48; i++) {
+		powerDC_kW.push_back(i % 24 < 6 ? 0 : 0.2 * (i % 24));
+		voltage.push_back(250 + 5 * (i % 24));
+		T.push_back(15 + (i % 24));
+	}
+
+	SharedInverter::Series series;
+	inv->calculateACPower(powerDC_kW, voltage, T, series);
+	ASSERT_EQ(series.powerAC_kW.size(), powerDC_kW.size());
+	for (size_t i = 0; i < powerDC_kW.size(); i++) {
+		inv->calculateACPower(powerDC_kW[i], voltage[i], T[i]);
+		EXPECT_DOUBLE_EQ(series.powerAC_kW[i], inv->powerAC_kW) << "step " << i;
+		EXPECT_DOUBLE_EQ(series.efficiencyAC[i], inv->efficiencyAC) << "step " << i;
+		EXPECT_DOUBLE_EQ(series.powerClipLoss_kW[i], inv->powerClipLoss_kW) << "step " << i;
+		EXPECT_DOUBLE_EQ(series.powerTempLoss_kW[i], inv->powerTempLoss_kW) << "step " << i;
+		EXPECT_DOUBLE_EQ(series.powerNightLoss_kW[i], inv->powerNightLoss_kW) << "step " << i;
+	}
+
+	// two MPPT inputs with half of the power on each
+	std::vector<std::vector<double>> powerDCPerMppt_kW(2), voltagePerMppt(2);
+	for (size_t m = 0; m < 2; m++) {
+		for (size_t i = 0; i < powerDC_kW.size(); i++) {
+			powerDCPerMppt_kW[m].push_back(0.5 * powerDC_kW[i]);
+			voltagePerMppt[m].push_back(voltage[i] + 10 * m);
+		}
+	}
+	inv->calculateACPower(powerDCPerMppt_kW, voltagePerMppt, T, series);
+	for (size_t i = 0; i < powerDC_kW.size(); i++) {
+		inv->calculateACPower({ powerDCPerMppt_kW[0][i], powerDCPerMppt_kW[1][i] }, { voltagePerMppt[0][i], voltagePerMppt[1][i] }, T[i]);
+		EXPECT_DOUBLE_EQ(series.powerAC_kW[i], inv->powerAC_kW) << "step " << i;
+		EXPECT_DOUBLE_EQ(series.powerConsumptionLoss_kW[i], inv->powerConsumptionLoss_kW) << "step " << i;
+		EXPECT_DOUBLE_EQ(series.powerLossTotal_kW[i], inv->powerLossTotal_kW) << "step " << i;
+	}
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <lib_snowmodel.h>
+
+/**
+* Replaying a recorded year of snow cover compared with stepping through every year
+*/
+
+class SnowModelTest : public ::testing::Test {
+protected:
+	int nyears = 4;
+public:
+	/// A weather year with snow storms in winter, snow on the ground over the new year, and some bad depths
+	void weather(int h, float &poa, float &tilt, float &tdry, float &depth, int &sunup) {
+		int hr = h % 24, day = h / 24;
+		double s = sin(M_PI * (hr - 6) / 12.);
+		sunup = s > 0;
+		poa = (float)(sunup ? 900 * s : 0);
+		tilt = (float)(sunup ? 30 + 20 * cos(M_PI * hr / 12.) : 0);
+		tdry = (float)(day < 30 || day > 340 ? -5 + 10 * s : 20);
+		depth = 0;
+		if (day >= 10 && day < 16) depth = (float)(30 * (16 * 24 - h) / (6 * 24.));
+		if (day >= 358 || day < 3) depth = 60;
+		if (h % 997 == 5) depth = -5;
+	}
+
+	void run(bool replay, std::vector<float> &loss, std::vector<float> &coverage, int &badValues) {
+		pvsnowmodel snow;
+		snow.setup(2, 30, false);
+		for (int y = 0; y < nyears; y++) {
+			if (replay) snow.startYear();
+			for (int h = 0; h < 8760; h++) {
+				float poa, tilt, tdry, depth, l = 0;
+				int sunup;
+				weather(h, poa, tilt, tdry, depth, sunup);
+				snow.getLoss(poa, tilt, 2, tdry, depth, sunup, 1.0f, l);
+				loss.push_back(l);
+				coverage.push_back(snow.coverage);
+			}
+		}
+		badValues = snow.badValues;
+	}
+};
+
+TEST_F(SnowModelTest, ReplayMatchesStepping_lib_snowmodel) {
+	std::vector<float> loss, coverage, replayLoss, replayCoverage;
+	int bad = 0, replayBad = 0;
+	run(false, loss, coverage, bad);
+	run(true, replayLoss, replayCoverage, replayBad);
+
+	ASSERT_EQ(loss.size(), replayLoss.size());
+	for (size_t i = 0; i < loss.size(); i++) {
+		EXPECT_EQ(loss[i], replayLoss[i]) << "hour " << i;
+		EXPECT_EQ(coverage[i], replayCoverage[i]) << "hour " << i;
+	}
+	EXPECT_EQ(bad, replayBad);
+
+	// the first year sees the new year snow fall, later years start with it already on the ground
+	EXPECT_EQ(1, coverage[0]);
+	EXPECT_EQ(0, coverage[8760]);
+	EXPECT_EQ(coverage[8760], coverage[2 * 8760]);
+}
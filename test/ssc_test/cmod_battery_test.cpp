@@ -0,0 +1,420 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "../ssc/core.h"
+#include "../ssc/cmod_battery.h"
+#include "../shared_test/benchmark_test.h"
+
+/**
+* battery_core runs a behind-the-meter lithium ion battery on plain arrays of PV and load, without a compute_module
+*/
+class BatteryCore : public ::testing::Test
+{
+protected:
+	batt_variables vars;
+	std::vector<double> P_pv;
+	std::vector<double> P_load;
+
+	/// Size a lithium ion bank of NMC cells as battwatts does
+	void size_bank(double kwh, double kw)
+	{
+		double current_max = 15;
+		double bank_voltage = kw * 1000. / current_max;
+		vars.batt_kwh = kwh;
+		vars.batt_kw = kw;
+		vars.batt_computed_series = (int)std::ceil(bank_voltage / vars.batt_Vnom_default);
+		vars.batt_computed_strings = (int)std::ceil((kwh * 1000.) / (vars.batt_Qfull * vars.batt_computed_series * vars.batt_Vnom_default)) - 1;
+		vars.batt_current_charge_max = 1000 * (kw / kwh) * kwh / bank_voltage;
+		vars.batt_current_discharge_max = vars.batt_current_charge_max;
+		vars.batt_power_charge_max = kw;
+		vars.batt_power_discharge_max = kw;
+		vars.batt_mass = kwh * 1000 / 197.33;
+		vars.batt_length = vars.batt_width = vars.batt_height = std::pow(kwh / 501.25, 1. / 3.);
+	}
+
+	void SetUp()
+	{
+		vars = batt_variables();
+		vars.en_batt = true;
+		vars.analysis_period = 1;
+		vars.batt_chem = battery_t::LITHIUM_ION;
+		vars.batt_meter_position = dispatch_t::BEHIND;
+		vars.batt_dispatch = dispatch_t::LOOK_AHEAD;
+		vars.batt_dispatch_auto_can_charge = true;
+		vars.batt_look_ahead_hours = 24;
+		vars.batt_dispatch_update_frequency_hours = 1;
+
+		vars.batt_voltage_choice = voltage_t::VOLTAGE_MODEL;
+		vars.batt_Vnom_default = 3.6;
+		vars.batt_Vfull = 4.1;
+		vars.batt_Vexp = 4.05;
+		vars.batt_Vnom = 3.4;
+		vars.batt_Qfull = 2.25;
+		vars.batt_Qexp = 1.78;
+		vars.batt_Qnom = 88.9;
+		vars.batt_C_rate = 0.2;
+		vars.batt_resistance = 0.1;
+		vars.batt_current_choice = dispatch_t::RESTRICT_CURRENT;
+
+		double lifetime[] = { 20, 0, 100, 20, 650, 96, 20, 1500, 87, 80, 0, 100, 80, 150, 96, 80, 300, 87 };
+		vars.batt_lifetime_matrix.assign(lifetime, 6, 3);
+		vars.batt_calendar_choice = lifetime_calendar_t::NONE;
+		vars.batt_calendar_q0 = 1.02;
+		vars.batt_calendar_a = 2.66e-3;
+		vars.batt_calendar_b = -7280;
+		vars.batt_calendar_c = 930;
+
+		double cap_vs_temp[] = { -15, 65, 0, 85, 25, 100, 40, 104 };
+		vars.cap_vs_temp.assign(cap_vs_temp, 4, 2);
+		vars.batt_Cp = 1004;
+		vars.batt_h_to_ambient = 500;
+		vars.T_room = 20;
+
+		vars.batt_topology = ChargeController::AC_CONNECTED;
+		vars.batt_ac_dc_efficiency = 96;
+		vars.batt_dc_ac_efficiency = 96;
+		vars.batt_dc_dc_bms_efficiency = 99;
+		vars.batt_loss_choice = losses_t::MONTHLY;
+		vars.batt_losses_charging = { 0 };
+		vars.batt_losses_discharging = { 0 };
+		vars.batt_losses_idle = { 0 };
+
+		vars.batt_initial_SOC = 50;
+		vars.batt_maximum_SOC = 95;
+		vars.batt_minimum_SOC = 15;
+		vars.batt_minimum_modetime = 10;
+
+		size_bank(10, 5);
+
+		// a clear-sky bell of PV from 6 to 18 hours, and a load with an evening peak
+		for (size_t h = 0; h != 8760; h++)
+		{
+			double hour = (double)(h % 24);
+			P_pv.push_back((hour > 6 && hour < 18) ? 6 * std::sin(M_PI * (hour - 6) / 12) : 0);
+			P_load.push_back((hour >= 17 && hour < 21) ? 5 : 1);
+		}
+	}
+};
+
+TEST_F(BatteryCore, EnergyBalance_cmod_battery)
+{
+	battery_core core(&vars, 1, 1.);
+	battery_core_results results;
+	core.run(&P_pv[0], &P_load[0], P_pv.size(), results);
+
+	ASSERT_EQ(8760, (int)results.P_battery.size());
+	ASSERT_EQ(1, (int)results.E_discharge_annual.size());
+	for (size_t idx = 0; idx != 8760; idx++)
+		EXPECT_NEAR(P_load[idx], results.P_pv_to_load[idx] + results.P_batt_to_load[idx] + results.P_grid_to_load[idx], 1e-3);
+
+	// the battery charges from the midday surplus and shaves the evening peak
+	EXPECT_GT(results.E_discharge_annual[0], 365 * 5.);
+	double grid_peak = *std::max_element(results.P_grid_to_load.begin(), results.P_grid_to_load.end());
+	EXPECT_LT(grid_peak, 5.);
+	EXPECT_GT(results.average_roundtrip_efficiency, 80.);
+
+	// a second core on the same inputs reproduces the run exactly
+	battery_core other(&vars, 1, 1.);
+	battery_core_results other_results;
+	other.run(&P_pv[0], &P_load[0], P_pv.size(), other_results);
+	for (size_t idx = 0; idx != 8760; idx++)
+		EXPECT_EQ(results.P_battery[idx], other_results.P_battery[idx]);
+}
+
+TEST_F(BatteryCore, Lifetime_cmod_battery)
+{
+	// one year of inputs repeats for each year of the analysis period
+	vars.system_use_lifetime_output = true;
+	vars.analysis_period = 3;
+	battery_core core(&vars, 3, 1.);
+	battery_core_results results;
+	core.run(&P_pv[0], &P_load[0], P_pv.size(), results);
+
+	ASSERT_EQ(3 * 8760, (int)results.SOC.size());
+	ASSERT_EQ(3, (int)results.E_discharge_annual.size());
+	EXPECT_GT(results.E_discharge_annual[2], 0.);
+	EXPECT_LT(core.lifetime_model->capacity_percent(), 100.);
+
+	// the core is left in its final state, so it does not run again
+	EXPECT_THROW(core.run(&P_pv[0], &P_load[0], P_pv.size(), results), std::logic_error);
+
+	std::vector<double> two_days(48, 0.);
+	battery_core other(&vars, 3, 1.);
+	EXPECT_THROW(other.run(&two_days[0], &two_days[0], two_days.size(), results), std::invalid_argument);
+}
+
+TEST_F(BatteryCore, OptimizedLookAhead_cmod_battery)
+{
+	// a peak price at 20 hours only, with a 4 kW load the 5 kW bank can serve whole, and no demand charges
+	vars.batt_dispatch = dispatch_t::OPTIMIZED_LOOK_AHEAD;
+	vars.batt_dispatch_opt_time_limit = 1;
+	vars.ec_rate_defined = true;
+	vars.ec_weekday_schedule.resize_fill(12, 24, 1);
+	for (size_t m = 0; m != 12; m++)
+		vars.ec_weekday_schedule.at(m, 20) = 2;
+	vars.ec_weekend_schedule = vars.ec_weekday_schedule;
+	double tou[] = { 1, 1, 1e38, 0, 0.10, 0, 2, 1, 1e38, 0, 0.40, 0 };
+	vars.ec_tou_matrix.assign(tou, 2, 6);
+	vars.dc_rate_defined = false;
+	for (size_t idx = 20; idx < 8760; idx += 24)
+		P_load[idx] = 4;
+
+	battery_core core(&vars, 1, 1.);
+	battery_core_results results;
+	core.run(&P_pv[0], &P_load[0], P_pv.size(), results);
+
+	// the optimization discharges with the sign of the peak shaving, > 0, and charges only from the midday surplus
+	for (size_t idx = 0; idx != 8760; idx++)
+	{
+		if (results.P_battery[idx] < 0)
+			EXPECT_GT(P_pv[idx], P_load[idx]) << "step " << idx;
+		EXPECT_NEAR(P_load[idx], results.P_pv_to_load[idx] + results.P_batt_to_load[idx] + results.P_grid_to_load[idx], 1e-3);
+	}
+
+	// its power is planned at the battery terminals, which covers the conversion loss, so the peak load is served
+	// whole rather than short by the discharge efficiency
+	for (size_t idx = 20; idx < 8760; idx += 24)
+	{
+		EXPECT_GT(results.P_battery[idx], 0.) << "step " << idx;
+		EXPECT_NEAR(P_load[idx], results.P_batt_to_load[idx], 0.01) << "step " << idx;
+		EXPECT_LT(results.P_grid_to_load[idx], 0.01) << "step " << idx;
+	}
+
+	// the heuristic discharges into the same evening load
+	vars.batt_dispatch = dispatch_t::LOOK_AHEAD;
+	battery_core heuristic(&vars, 1, 1.);
+	battery_core_results heuristic_results;
+	heuristic.run(&P_pv[0], &P_load[0], P_pv.size(), heuristic_results);
+	for (size_t idx = 20; idx < 8760; idx += 24)
+		EXPECT_GT(heuristic_results.P_battery[idx], 0.) << "step " << idx;
+}
+
+TEST_F(BatteryCore, DISABLED_Benchmark_cmod_battery)
+{
+	// time a sizing sweep of one year hourly candidates
+	const size_t n_candidates = 40;
+	battery_core_results results;
+	double E_discharge_max = 0;
+
+	double ms = benchmark_ms([&]() {
+		for (size_t i = 0; i != n_candidates; i++)
+		{
+			size_bank(2. + i * 0.5, 1. + i * 0.25);
+			battery_core core(&vars, 1, 1.);
+			core.run(&P_pv[0], &P_load[0], P_pv.size(), results);
+			E_discharge_max = std::max(E_discharge_max, results.E_discharge_annual[0]);
+		}
+	});
+	record_benchmark("sizing_1yr_1hr", ms);
+
+	EXPECT_GT(E_discharge_max, 0.);
+}
+
+/**
+* battery_sizing evaluates a set of bank sizes on the battery_core, configured through the ssc data interface
+*/
+class BatterySizing : public BatteryCore
+{
+protected:
+	ssc_data_t data;
+
+	void SetUp()
+	{
+		BatteryCore::SetUp();
+		data = ssc_data_create();
+		ssc_module_exec_set_print(0);
+
+		ssc_data_set_number(data, "analysis_period", 1);
+		ssc_data_set_number(data, "batt_chem", vars.batt_chem);
+		ssc_data_set_number(data, "batt_meter_position", vars.batt_meter_position);
+		ssc_data_set_number(data, "batt_dispatch_choice", vars.batt_dispatch);
+		ssc_data_set_number(data, "batt_dispatch_auto_can_gridcharge", 0);
+		ssc_data_set_number(data, "batt_dispatch_auto_can_charge", 1);
+		ssc_data_set_number(data, "batt_computed_series", vars.batt_computed_series);
+		ssc_data_set_number(data, "batt_computed_strings", vars.batt_computed_strings);
+		ssc_data_set_number(data, "batt_computed_bank_capacity", vars.batt_kwh);
+		ssc_data_set_number(data, "batt_current_choice", vars.batt_current_choice);
+		ssc_data_set_number(data, "batt_current_charge_max", vars.batt_current_charge_max);
+		ssc_data_set_number(data, "batt_current_discharge_max", vars.batt_current_discharge_max);
+		ssc_data_set_number(data, "batt_power_charge_max", vars.batt_power_charge_max);
+		ssc_data_set_number(data, "batt_power_discharge_max", vars.batt_power_discharge_max);
+
+		ssc_data_set_number(data, "batt_Vnom_default", vars.batt_Vnom_default);
+		ssc_data_set_number(data, "batt_Vfull", vars.batt_Vfull);
+		ssc_data_set_number(data, "batt_Vexp", vars.batt_Vexp);
+		ssc_data_set_number(data, "batt_Vnom", vars.batt_Vnom);
+		ssc_data_set_number(data, "batt_Qfull", vars.batt_Qfull);
+		ssc_data_set_number(data, "batt_Qfull_flow", 0);
+		ssc_data_set_number(data, "batt_Qexp", vars.batt_Qexp);
+		ssc_data_set_number(data, "batt_Qnom", vars.batt_Qnom);
+		ssc_data_set_number(data, "batt_C_rate", vars.batt_C_rate);
+		ssc_data_set_number(data, "batt_resistance", vars.batt_resistance);
+		ssc_number_t voltage_matrix[2] = { 0, 0 };
+		ssc_data_set_matrix(data, "batt_voltage_matrix", voltage_matrix, 1, 2);
+
+		ssc_data_set_number(data, "batt_ac_or_dc", vars.batt_topology);
+		ssc_data_set_number(data, "batt_ac_dc_efficiency", vars.batt_ac_dc_efficiency);
+		ssc_data_set_number(data, "batt_dc_ac_efficiency", vars.batt_dc_ac_efficiency);
+		ssc_data_set_number(data, "batt_dc_dc_efficiency", vars.batt_dc_dc_bms_efficiency);
+		ssc_number_t no_loss[1] = { 0 };
+		ssc_data_set_array(data, "batt_losses", no_loss, 1);
+		ssc_data_set_array(data, "batt_losses_charging", no_loss, 1);
+		ssc_data_set_array(data, "batt_losses_discharging", no_loss, 1);
+		ssc_data_set_array(data, "batt_losses_idle", no_loss, 1);
+
+		ssc_data_set_number(data, "batt_initial_SOC", vars.batt_initial_SOC);
+		ssc_data_set_number(data, "batt_maximum_SOC", vars.batt_maximum_SOC);
+		ssc_data_set_number(data, "batt_minimum_SOC", vars.batt_minimum_SOC);
+		ssc_data_set_number(data, "batt_minimum_modetime", vars.batt_minimum_modetime);
+
+		ssc_number_t lifetime[18];
+		for (size_t i = 0; i != 18; i++)
+			lifetime[i] = (ssc_number_t)vars.batt_lifetime_matrix.data()[i];
+		ssc_data_set_matrix(data, "batt_lifetime_matrix", lifetime, 6, 3);
+		ssc_data_set_number(data, "batt_calendar_choice", vars.batt_calendar_choice);
+		ssc_number_t calendar[4] = { 0, 100, 3650, 80 };
+		ssc_data_set_matrix(data, "batt_calendar_lifetime_matrix", calendar, 2, 2);
+		ssc_data_set_number(data, "batt_calendar_q0", vars.batt_calendar_q0);
+		ssc_data_set_number(data, "batt_calendar_a", vars.batt_calendar_a);
+		ssc_data_set_number(data, "batt_calendar_b", vars.batt_calendar_b);
+		ssc_data_set_number(data, "batt_calendar_c", vars.batt_calendar_c);
+		ssc_data_set_number(data, "batt_replacement_option", 0);
+		ssc_data_set_number(data, "batt_replacement_capacity", 0);
+		ssc_data_set_number(data, "batt_replacement_cost", 0);
+
+		ssc_number_t cap_vs_temp[8] = { -15, 65, 0, 85, 25, 100, 40, 104 };
+		ssc_data_set_matrix(data, "cap_vs_temp", cap_vs_temp, 4, 2);
+		ssc_data_set_number(data, "batt_mass", vars.batt_mass);
+		ssc_data_set_number(data, "batt_length", vars.batt_length);
+		ssc_data_set_number(data, "batt_width", vars.batt_width);
+		ssc_data_set_number(data, "batt_height", vars.batt_height);
+		ssc_data_set_number(data, "batt_Cp", vars.batt_Cp);
+		ssc_data_set_number(data, "batt_h_to_ambient", vars.batt_h_to_ambient);
+		ssc_data_set_number(data, "T_room", vars.T_room);
+
+		std::vector<ssc_number_t> gen(P_pv.begin(), P_pv.end()), load(P_load.begin(), P_load.end());
+		ssc_data_set_array(data, "gen", &gen[0], (int)gen.size());
+		ssc_data_set_array(data, "load", &load[0], (int)load.size());
+
+		// a flat energy rate, with the evening peak at three times the price
+		ssc_number_t sched[288];
+		for (size_t i = 0; i != 288; i++)
+			sched[i] = (i % 24 >= 17 && i % 24 < 21) ? 2 : 1;
+		ssc_number_t tou[12] = { 1, 1, 1e38, 0, 0.10, 0, 2, 1, 1e38, 0, 0.30, 0 };
+		ssc_data_set_number(data, "en_electricity_rates", 1);
+		ssc_data_set_matrix(data, "ur_ec_sched_weekday", sched, 12, 24);
+		ssc_data_set_matrix(data, "ur_ec_sched_weekend", sched, 12, 24);
+		ssc_data_set_matrix(data, "ur_ec_tou_mat", tou, 2, 6);
+	}
+
+	void TearDown()
+	{
+		ssc_data_free(data);
+	}
+
+	/// Run the module, return false and print the log if it fails and the failure is not expected
+	bool compute(bool expect_failure = false)
+	{
+		ssc_module_t module = ssc_module_create("battery_sizing");
+		if (module == NULL)
+			return false;
+		bool ok = ssc_module_exec(module, data) != 0;
+		if (!ok && !expect_failure)
+		{
+			int type;
+			float time;
+			const char *text;
+			for (int i = 0; (text = ssc_module_log(module, i, &type, &time)) != 0; i++)
+				printf("%s\n", text);
+		}
+		ssc_module_free(module);
+		return ok;
+	}
+};
+
+TEST_F(BatterySizing, Candidates_cmod_battery)
+{
+	ssc_number_t candidates[] = { 10, 5, dispatch_t::LOOK_AHEAD, 2, 1, dispatch_t::LOOK_AHEAD, 20, 5, dispatch_t::LOOK_AHEAD, 10, 5, dispatch_t::LOOK_BEHIND };
+	ssc_data_set_matrix(data, "batt_sizing_candidates", candidates, 4, 3);
+	ASSERT_TRUE(compute());
+
+	int nrows, ncols;
+	ssc_number_t *results = ssc_data_get_matrix(data, "batt_sizing_results", &nrows, &ncols);
+	ASSERT_EQ(4, nrows);
+	ASSERT_EQ(9, ncols);
+
+	// the first candidate is the base bank, and matches a battery_core run of it
+	battery_core core(&vars, 1, 1.);
+	battery_core_results core_results;
+	core.run(&P_pv[0], &P_load[0], P_pv.size(), core_results);
+	EXPECT_NEAR(core_results.E_discharge_annual[0], results[3], 1e-3 * results[3]);
+	EXPECT_NEAR(core_results.average_roundtrip_efficiency, results[8], 1e-3);
+
+	// a larger bank discharges more and saves more, each candidate pays for its evening peak energy
+	EXPECT_LT(results[9 + 3], results[3]);
+	EXPECT_LT(results[9 + 7], results[7]);
+	EXPECT_GT(results[18 + 3], results[3]);
+	for (int c = 0; c != 4; c++)
+	{
+		EXPECT_GT(results[c * 9 + 7], 0.);
+		EXPECT_GT(results[c * 9 + 5], 0.);
+		EXPECT_LE(results[c * 9 + 4], 100.);
+	}
+
+	// threads evaluate the candidates independently
+	ssc_data_set_number(data, "nthreads", 1);
+	std::vector<ssc_number_t> threaded(results, results + 36);
+	ASSERT_TRUE(compute());
+	results = ssc_data_get_matrix(data, "batt_sizing_results", &nrows, &ncols);
+	for (int i = 0; i != 36; i++)
+		EXPECT_EQ(threaded[i], results[i]);
+}
+
+TEST_F(BatterySizing, MixedDispatch_cmod_battery)
+{
+	// look ahead and look behind need no inputs of their own, so either may be evaluated against the other
+	ssc_number_t automated[] = { 10, 5, dispatch_t::LOOK_BEHIND, 10, 5, dispatch_t::LOOK_AHEAD };
+	ssc_data_set_matrix(data, "batt_sizing_candidates", automated, 2, 3);
+	ASSERT_TRUE(compute());
+	int nrows, ncols;
+	ssc_number_t *results = ssc_data_get_matrix(data, "batt_sizing_results", &nrows, &ncols);
+	ASSERT_EQ(2, nrows);
+	ssc_number_t look_ahead_discharge = results[9 + 3];
+
+	// options whose inputs were not read for the base option, unknown options, and fractional options are rejected before any runs
+	ssc_number_t rejected[] = { dispatch_t::MAINTAIN_TARGET, dispatch_t::CUSTOM_DISPATCH, dispatch_t::MANUAL, dispatch_t::OPTIMIZED_LOOK_AHEAD, 9, 1.5 };
+	for (size_t i = 0; i != sizeof(rejected) / sizeof(rejected[0]); i++)
+	{
+		ssc_number_t candidates[] = { 10, 5, dispatch_t::LOOK_AHEAD, 10, 5, rejected[i] };
+		ssc_data_set_matrix(data, "batt_sizing_candidates", candidates, 2, 3);
+		EXPECT_FALSE(compute(true)) << "dispatch " << rejected[i];
+	}
+
+	// with target power as the base option, its targets are read and the automated options run alongside it
+	ssc_data_set_number(data, "batt_dispatch_choice", dispatch_t::MAINTAIN_TARGET);
+	ssc_data_set_number(data, "batt_target_choice", dispatch_automatic_behind_the_meter_t::TARGET_SINGLE_MONTHLY);
+	ssc_number_t targets[12];
+	for (size_t m = 0; m != 12; m++)
+		targets[m] = 4;
+	ssc_data_set_array(data, "batt_target_power_monthly", targets, 12);
+	ssc_number_t mixed[] = { 10, 5, dispatch_t::MAINTAIN_TARGET, 10, 5, dispatch_t::LOOK_AHEAD, 10, 5, dispatch_t::LOOK_BEHIND };
+	ssc_data_set_matrix(data, "batt_sizing_candidates", mixed, 3, 3);
+	ASSERT_TRUE(compute());
+
+	results = ssc_data_get_matrix(data, "batt_sizing_results", &nrows, &ncols);
+	ASSERT_EQ(3, nrows);
+	for (int c = 0; c != 3; c++)
+	{
+		EXPECT_EQ(mixed[c * 3 + 2], results[c * 9 + 2]);
+		EXPECT_GT(results[c * 9 + 3], 0.);
+	}
+	EXPECT_EQ(look_ahead_discharge, results[9 + 3]);
+	EXPECT_NE(results[3], results[9 + 3]);
+
+	ssc_number_t optimized[] = { 10, 5, dispatch_t::OPTIMIZED_LOOK_AHEAD };
+	ssc_data_set_matrix(data, "batt_sizing_candidates", optimized, 1, 3);
+	EXPECT_FALSE(compute(true));
+}
+
@@ -547,4 +547,60 @@ TEST_F(CMPvsamv1PowerIntegration, SnowModel)
 	ssc_data_get_number(data, "annual_energy", &annual_energy);
 	EXPECT_NEAR(annual_energy, 11354.7, m_error_tolerance_hi) << "Annual energy.";
 
-}
\ No newline at end of file
+}
+
+/// Test PVSAMv1 lifetime output scaled from the first year DC output against simulating every year
+TEST_F(CMPvsamv1PowerIntegration, LifetimeFromFirstYear)
+{
+	// annual energies agree within 1e-6 of the year's energy, and power within 1e-4 kW at each step
+	const double annual_tolerance = 1e-6;
+	const double power_tolerance = 1e-4;
+	const size_t nyears = 5;
+
+	ssc_number_t p_dc_degradation[1] = { 0.5 };
+	ssc_data_set_array(data, "dc_degradation", p_dc_degradation, 1);
+	std::map<std::string, double> pairs;
+	pairs["system_use_lifetime_output"] = 1;
+	pairs["analysis_period"] = (double)nyears;
+	pairs["system_lifetime_fast"] = 0;
+
+	int pvsam_errors = modify_ssc_data_and_run_module(data, "pvsamv1", pairs);
+	ASSERT_FALSE(pvsam_errors);
+	SetCalculated("annual_energy");
+	double annual_energy_full = calculated_value;
+	int n_gen, n_dc;
+	ssc_number_t *p_gen = ssc_data_get_array(data, "gen", &n_gen);
+	ssc_number_t *p_dc = ssc_data_get_array(data, "dc_net", &n_dc);
+	ASSERT_EQ(8760 * nyears, (size_t)n_gen);
+	ASSERT_EQ(8760 * nyears, (size_t)n_dc);
+	std::vector<ssc_number_t> gen_full(p_gen, p_gen + n_gen), dc_full(p_dc, p_dc + n_dc);
+
+	pairs["system_lifetime_fast"] = 1;
+	pvsam_errors = modify_ssc_data_and_run_module(data, "pvsamv1", pairs);
+	ASSERT_FALSE(pvsam_errors);
+	SetCalculated("annual_energy");
+	EXPECT_NEAR(calculated_value, annual_energy_full, annual_tolerance * annual_energy_full) << "Annual energy.";
+	p_gen = ssc_data_get_array(data, "gen", &n_gen);
+	p_dc = ssc_data_get_array(data, "dc_net", &n_dc);
+	ASSERT_EQ(8760 * nyears, (size_t)n_gen);
+	ASSERT_EQ(8760 * nyears, (size_t)n_dc);
+
+	// the degradation trajectory, year by year
+	std::vector<double> ac_full(nyears, 0), ac_fast(nyears, 0), dc_year_full(nyears, 0), dc_year_fast(nyears, 0);
+	for (size_t i = 0; i < 8760 * nyears; i++)
+	{
+		EXPECT_NEAR(p_gen[i], gen_full[i], power_tolerance) << "AC power at step " << i;
+		EXPECT_NEAR(p_dc[i], dc_full[i], power_tolerance) << "DC power at step " << i;
+		ac_full[i / 8760] += gen_full[i];
+		ac_fast[i / 8760] += p_gen[i];
+		dc_year_full[i / 8760] += dc_full[i];
+		dc_year_fast[i / 8760] += p_dc[i];
+	}
+	for (size_t y = 0; y < nyears; y++)
+	{
+		EXPECT_NEAR(ac_fast[y], ac_full[y], annual_tolerance * ac_full[y]) << "AC energy in year " << y + 1;
+		EXPECT_NEAR(dc_year_fast[y], dc_year_full[y], annual_tolerance * dc_year_full[y]) << "DC energy in year " << y + 1;
+		if (y > 0)
+			EXPECT_NEAR(dc_year_fast[y] / dc_year_fast[y - 1], 0.995, 1e-3) << "DC degradation in year " << y + 1;
+	}
+}
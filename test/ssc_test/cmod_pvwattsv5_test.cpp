@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <vector>
 
 #include "../ssc/core.h"
 #include "../ssc/vartab.h"
@@ -37,4 +39,90 @@ TEST_F(CMPvwattsV5Integration, DefaultNoFinancialModel){
 	ssc_data_get_number(data, "capacity_factor", &capacity_factor);
 	EXPECT_NEAR(capacity_factor, 19.7197, error_tolerance) << "Capacity factor";
 
-}
\ No newline at end of file
+}
+
+/// Fleet of two systems sharing the weather file gives the same energy as separate PVWattsV5 runs
+TEST_F(CMPvwattsV5Integration, FleetMatchesSingleSystems){
+	ssc_number_t single_energy[2];
+	std::vector<ssc_number_t> single_ac[2];
+	ssc_number_t tilt[2] = { 20, 30 };
+	ssc_number_t azimuth[2] = { 180, 200 };
+	for (size_t i = 0; i < 2; i++)
+	{
+		ssc_data_set_number(data, "tilt", tilt[i]);
+		ssc_data_set_number(data, "azimuth", azimuth[i]);
+		compute();
+		ssc_data_get_number(data, "annual_energy", &single_energy[i]);
+		int n;
+		ssc_number_t *ac = ssc_data_get_array(data, "ac", &n);
+		single_ac[i].assign(ac, ac + n);
+	}
+	EXPECT_NEAR(single_energy[0], 6909.79, error_tolerance) << "Annual energy.";
+
+	ssc_data_t fleet_data = ssc_data_create();
+	ssc_number_t capacity[2] = { 4, 4 };
+	ssc_number_t dc_ac_ratio[2] = { 1.2000000476837158, 1.2000000476837158 };
+	ssc_number_t losses[2] = { 14.075660705566406, 14.075660705566406 };
+	const char *file = ssc_data_get_string(data, "solar_resource_file");
+	ssc_data_set_string(fleet_data, "solar_resource_file", file);
+	ssc_data_set_array(fleet_data, "system_capacity", capacity, 2);
+	ssc_data_set_array(fleet_data, "dc_ac_ratio", dc_ac_ratio, 2);
+	ssc_data_set_array(fleet_data, "losses", losses, 2);
+	ssc_data_set_array(fleet_data, "tilt", tilt, 2);
+	ssc_data_set_array(fleet_data, "azimuth", azimuth, 2);
+	ssc_data_set_number(fleet_data, "array_type", 0);
+	ssc_data_set_number(fleet_data, "fleet_threads", 2);
+	ssc_data_set_number(fleet_data, "fleet_timeseries", 1);
+
+	ssc_module_t module = ssc_module_create("pvwattsv5_fleet");
+	ASSERT_TRUE(module != NULL);
+	EXPECT_TRUE(ssc_module_exec(module, fleet_data) != 0);
+	ssc_module_free(module);
+
+	int count;
+	ssc_number_t* fleet_energy = ssc_data_get_array(fleet_data, "annual_energy", &count);
+	ASSERT_EQ(count, 2);
+	for (size_t i = 0; i < 2; i++)
+		EXPECT_NEAR(fleet_energy[i], single_energy[i], 0.1) << "Annual energy of system " << i;
+
+	int nrows, ncols;
+	ssc_number_t* fleet_ac = ssc_data_get_matrix(fleet_data, "ac", &nrows, &ncols);
+	ASSERT_EQ(nrows, 2);
+	ASSERT_EQ(ncols, (int)single_ac[0].size());
+	for (size_t i = 0; i < 2; i++)
+		for (int j = 0; j < ncols; j++)
+			ASSERT_NEAR(fleet_ac[i*ncols + j], single_ac[i][j], 1.0) << "AC power of system " << i << " at step " << j;
+
+	ssc_data_free(fleet_data);
+}
+
+/// Inverter parameters from a component library are used for the run without changing the caller's data
+TEST_F(CMPvwattsV5Integration, LibraryInputsLeaveData){
+	compute();
+	ssc_number_t default_energy;
+	ssc_data_get_number(data, "annual_energy", &default_energy);
+
+	const char *file = "pvwattsv5_inverter_library.csv";
+	FILE *fp = fopen(file, "w");
+	ASSERT_TRUE(fp != NULL);
+	fprintf(fp, "Name,inv_eff\nLow Efficiency,90\n");
+	fclose(fp);
+
+	ssc_data_set_string(data, "inverter_library", file);
+	ssc_data_set_string(data, "inverter_name", "Low Efficiency");
+	compute();
+	ssc_number_t library_energy, inv_eff;
+	ssc_data_get_number(data, "annual_energy", &library_energy);
+	ssc_data_get_number(data, "inv_eff", &inv_eff);
+	EXPECT_NEAR(library_energy, default_energy * 90 / 96, 0.01 * default_energy) << "Annual energy with the library inverter.";
+	EXPECT_EQ(96, inv_eff) << "Caller's inverter efficiency.";
+
+	// without a component name the given inputs are used again
+	ssc_data_unassign(data, "inverter_name");
+	compute();
+	ssc_number_t energy;
+	ssc_data_get_number(data, "annual_energy", &energy);
+	EXPECT_NEAR(energy, default_energy, error_tolerance) << "Annual energy.";
+
+	remove(file);
+}